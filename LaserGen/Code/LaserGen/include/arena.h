@@ -0,0 +1,63 @@
+/**
+ * @file arena.h
+ * @author Patryk Sienkiewicz (@Patsen95)
+ *
+ * Static memory arena. All generator's tables and buffers are carved out of it at init,
+ * so nothing is allocated on heap while generator is running.
+ * Memory is released in stack order - back to a mark taken before allocation.
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <stddef.h>
+
+
+// Total arena size, must cover everything allocated in WaveGen::init() (checked at compile time)
+#define ARENA_SIZE		6144	// bytes
+
+#define ARENA_ALIGN		4
+
+
+typedef struct
+{
+	uint32 capacity;
+	uint32 used;
+	uint32 highWater;	// Max used bytes since boot
+	uint32 failed;		// Number of rejected allocations
+} arenastats_t;
+
+class Arena
+{
+public:
+	Arena(uint8 *storage, uint32 size);
+
+	/// @brief Takes block of memory from arena.
+	/// @return Pointer to the block or NULL if arena is exhausted
+	void* alloc(uint32 size, uint32 align = ARENA_ALIGN);
+
+	template<typename T>
+	T* allocArray(uint32 count)
+	{
+		return static_cast<T*>(alloc(sizeof(T) * count, alignof(T) > ARENA_ALIGN ? alignof(T) : ARENA_ALIGN));
+	}
+
+	/// @brief Returns current allocation point, @see release().
+	uint32 mark() const;
+
+	/// @brief Frees everything allocated after mark was taken.
+	void release(uint32 mark);
+
+	arenastats_t stats() const;
+
+private:
+	uint8 *m_storage;
+	uint32 m_size;
+	uint32 m_used;
+	uint32 m_highWater;
+	uint32 m_failed;
+};
+
+// Arena backed by static storage of ARENA_SIZE bytes
+extern Arena g_arena;
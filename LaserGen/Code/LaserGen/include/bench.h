@@ -0,0 +1,34 @@
+/**
+ * @file bench.h
+ * @author Patryk Sienkiewicz (@Patsen95)
+ * 
+ * Benchmarks of generator's hot paths (frame packing, table generation,
+ * command parsing and per-sample output). Built only with LASERGEN_BENCH defined:
+ * on target with [env:esp32dev_bench], on PC with [env:native_bench] (catches regressions
+ * off-device, CPU cycles are reported only on target).
+ * Results are printed through serial port (stdout on PC) as a single JSON object.
+ */
+
+#pragma once
+
+#include "gen.h"
+
+
+#ifdef LASERGEN_BENCH
+
+// Number of iterations for each benchmark case
+#define BENCH_ITERATIONS	10000
+
+typedef struct
+{
+	const char *name;
+	uint32 iterations;
+	uint32 elapsedUs;		// Total time of all iterations
+	uint32 cycles;			// CPU cycles of all iterations
+} benchresult_t;
+
+/// @brief Runs all benchmark cases and prints results as JSON.
+/// @param wg Initialized generator instance
+void runBenchmarks(WaveGen &wg);
+
+#endif
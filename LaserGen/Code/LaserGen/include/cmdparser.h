@@ -1,6 +1,12 @@
 #pragma once
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
 
 #include "util.h"
 
@@ -16,11 +22,15 @@
 
 #define FRAME_SIZE		4
 
+// Max length of command & signal names (including terminator)
+#define NAME_LEN		6
 
+
+// Frame owns copies of names, so it stays valid after input buffer is reused
 typedef struct cmdframe_t
 {
-	char* _cmd;
-	char* _sig;
+	char _cmd[NAME_LEN];
+	char _sig[NAME_LEN];
 	float _value1;
 	float _value2;
 };
@@ -38,8 +48,11 @@ public:
 	float getValue(uint8 valParam);
 	cmdframe_t getComFrame();
 
+	void setEcho(bool enable);
+
 private:
 	ParsingMode m_parsingMode;
+	bool m_echo;
 	char* m_tokens[FRAME_SIZE];
 	cmdframe_t m_theframe;
 
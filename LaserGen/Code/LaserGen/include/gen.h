@@ -12,10 +12,11 @@
 #include "dacxx6x.h"
 #include "util.h"
 #include "cmdparser.h"
+#include "rtthread.h"
+#include "mailbox.h"
+#include "arena.h"
 
 
-#define TIMER_DIVIDER 	80
-
 #define SIG_PEAK		16384
 #define MAX_AMPLITUDE 	(SIG_PEAK / 2)
 
@@ -24,9 +25,22 @@
 // This param influences resolution of the generated signal
 #define SAMPLES_PER_SECOND	1000
 
+// Highest frequency which isn't aliased at this rate
+#define MAX_FREQUENCY		(SAMPLES_PER_SECOND / 2)
+
 #define MICROS_PER_SECOND	1000000UL	// ESP32 timer max resolution
 #define MICROS_PER_SAMPLE	(MICROS_PER_SECOND / SAMPLES_PER_SECOND)
 
+// Samples rendered at once. New parameters are picked up only at block boundary.
+#define GEN_BLOCK_SIZE		32
+
+// Phase accumulator is a 16.16 fixed point index into wavetable
+#define PHASE_FRAC_BITS		16
+#define PHASE_WRAP			((uint32)MAX_PHASE_CNT << PHASE_FRAC_BITS)
+
+// Arena space taken by WaveGen: wavetable, 2 block buffers and 2 frame buffers (+ alignment)
+#define GEN_ARENA_BYTES		(MAX_PHASE_CNT * sizeof(uint16) + 2 * GEN_BLOCK_SIZE * (sizeof(uint16) + FRAME_BYTES) + 5 * ARENA_ALIGN)
+
 
 typedef enum
 {
@@ -35,6 +49,12 @@ typedef enum
 	SAW
 } wavetype_t;
 
+typedef enum
+{
+	NEAREST = 0,
+	LINEAR
+} interp_t;
+
 typedef struct
 {
 	float frequency;
@@ -43,13 +63,22 @@ typedef struct
 	float offset;
 	uint16 *wavetable;
 	wavetype_t waveType;
+	interp_t interp;		// Wavetable interpolation
+	bool enabled;
 } osc_t;
 
+// Complete configuration of all generator's oscillators
+typedef struct
+{
+	osc_t sine;
+	osc_t saw;
+} oscset_t;
+
 
 /*
 	1. Generate base sine wavetable
-	2. Modify it in output buffer
-	3. Send it to dac on timer event running with precalculated frequency
+	2. Render it block by block into output buffers (render task, core 1)
+	3. Send buffered samples to DAC on every sample clock tick
  */
 
 class WaveGen
@@ -60,27 +89,64 @@ public:
 
 	void init();
 
+	// Fills oscillator's wavetable with one full-scale period of the base waveform
+	void generateTable(osc_t *osc);
 
+	// Starts render task and sample clock
 	void enable();
+	// Stops sample clock, render task stays idle
 	void disable();
 
 	// void sweep(uint16 start, uint16 end);
 
+	// Hands new oscillator's configuration over to render task (control side, see rtthread.h).
+	// Amplitude is clamped to 0..1, offset to -1..1 (of full scale) and frequency to 0..MAX_FREQUENCY.
+	void setParams(const oscset_t &set);
+	// Returns configuration last passed to setParams() (control side)
+	oscset_t getParams() const;
+
+	// Switches wavetable interpolation of both oscillators, passed to render task the same way as setParams()
+	void setInterpolation(interp_t mode);
+
+	// Renders count samples of oscillator's signal, advancing its phase accumulator
+	void render(const osc_t *osc, uint32 *phase, uint16 *out, uint16 count);
+	// Block boundary: picks up parameters from setParams(), renders and packs next block of both channels.
+	// Called by render task, host tests call it directly instead of the sample clock.
+	void renderBlock();
+	// Samples of the last rendered block of the channel (DAC_A - sine, DAC_B - saw)
+	const uint16 *block(uint8 channel) const;
+
+	uint32 samplesOut() const;
+	uint32 overruns() const;
+
 	osc_t m_sineOsc;
 private:
-	hw_timer_t *m_timerSine;
-	hw_timer_t *m_timerSaw;
+	rt_task_t m_renderTask;
 	dac8162 *m_dac;
 
+	bool m_initialized;
+	uint32 m_arenaMark;		// Arena position before init(), everything above belongs to this instance
+
+	// Block buffers, filled by render() and packed into DAC frames drained by sample clock
 	uint16 *m_phaseBuf_sin;
 	uint16 *m_phaseBuf_saw;
+	uint8 *m_frameBuf_sin;
+	uint8 *m_frameBuf_saw;
+	uint16 m_bufPos;
 
 	osc_t m_sawOsc;
+	uint32 m_phaseSin;
+	uint32 m_phaseSaw;
 
-	uint16 interpolate(uint16 *w_tab, uint16 index);
+	Mailbox<oscset_t> m_params;
+	oscset_t m_published;
 
-	void onTimer_Sin();
-	void onTimer_Saw();
-};
+	volatile uint32 m_samples;
+	volatile uint32 m_overruns;
 
+	static uint16 interpolate(const uint16 *w_tab, uint32 phase, interp_t mode);
 
+	void applyParams(const oscset_t &set);
+	void renderLoop();
+	static void renderTask(void *arg);
+};
@@ -0,0 +1,57 @@
+/**
+ * @file mailbox.h
+ * @author Patryk Sienkiewicz (@Patsen95)
+ *
+ * Lock-free, single producer / single consumer mailbox used to hand over parameters between tasks.
+ * Implemented as a triple buffer: writer fills its private back slot and swaps it with the middle one,
+ * reader swaps its private front slot with the middle one only when something new was published.
+ * Neither side ever waits for the other one and reader never sees a partially written value,
+ * so it's also safe to fetch from an ISR.
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <atomic>
+
+
+template<typename T>
+class Mailbox
+{
+public:
+	Mailbox() : m_middle(1), m_back(0), m_front(2) { }
+
+	/// @brief Stores new value, replacing one that wasn't fetched yet. Producer side only.
+	void publish(const T &value)
+	{
+		m_buf[m_back] = value;
+
+		// Release makes the whole value visible before reader can pick its slot up
+		uint8 _prev = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+		m_back = _prev & INDEX;
+	}
+
+	/// @brief Takes value out of mailbox, if a new one was published since last call. Consumer side only.
+	/// @param out Destination, untouched if there is nothing new
+	/// @return True if out was updated
+	bool fetch(T &out)
+	{
+		if(!(m_middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+
+		uint8 _prev = m_middle.exchange(m_front, std::memory_order_acq_rel);
+		m_front = _prev & INDEX;
+		out = m_buf[m_front];
+		return true;
+	}
+
+private:
+	static const uint8 INDEX = 0x03;
+	static const uint8 FRESH = 0x04;	// set when middle slot holds value not yet fetched
+
+	T m_buf[3];
+	std::atomic<uint8> m_middle;	// shared: index of middle slot + FRESH flag
+	uint8 m_back;					// owned by producer
+	uint8 m_front;					// owned by consumer
+};
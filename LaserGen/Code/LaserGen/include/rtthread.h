@@ -0,0 +1,95 @@
+/**
+ * @file rtthread.h
+ * @author Patryk Sienkiewicz (@Patsen95)
+ *
+ * Thin threading layer used by the generator.
+ * On ESP32 it maps onto FreeRTOS tasks (pinned to cores) and a hardware timer,
+ * on host build it falls back to std::thread, so the same code can be run and tested on PC.
+ *
+ * Threading model:
+ *	- core 1: render task (highest priority) - renders sample blocks and streams them into DAC,
+ *			  woken once per sample by the sample clock
+ *	- core 0: control task - serial command parsing and telemetry
+ *	- sample clock ISR only notifies render task, it never touches Serial or SPI
+ *	- tasks exchange data only through mailboxes (see mailbox.h)
+ */
+
+#pragma once
+
+#include "util.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+
+// Core assignment
+#define RT_CORE_RENDER		1
+#define RT_CORE_CONTROL		0
+
+// Task priorities (FreeRTOS: higher value = higher priority)
+#define RT_PRIO_RENDER		(configMAX_PRIORITIES - 1)
+#define RT_PRIO_CONTROL		1
+
+// Task stack sizes
+#define RT_STACK_RENDER		4096	// bytes
+#define RT_STACK_CONTROL	4096	// bytes
+
+// Hardware timer used as sample clock
+#define RT_CLOCK_TIMER		0
+
+
+#ifdef ARDUINO
+typedef TaskHandle_t rt_task_t;
+#else
+#define configMAX_PRIORITIES	25
+
+struct rt_thread_t
+{
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable cond;
+	uint32 notifications = 0;
+};
+typedef rt_thread_t* rt_task_t;
+#endif
+
+typedef void (*rt_entry_t)(void *arg);
+
+
+/// @brief Creates a new task (thread) and starts it immediately.
+/// @param task Output task handle
+/// @param entry Task function, it should never return
+/// @param arg Argument passed to the task function
+/// @param name Task name (debug purposes only)
+/// @param stack Stack size in bytes (ignored on host)
+/// @param prio Task priority (ignored on host)
+/// @param core Core the task is pinned to (ignored on host)
+/// @return True if task was created
+bool rtSpawn(rt_task_t *task, rt_entry_t entry, void *arg, const char *name, uint32 stack, uint8 prio, int8 core);
+
+/// @brief Wakes the task up. Safe to be called from any task.
+void rtNotify(rt_task_t task);
+
+/// @brief Blocks calling task until it's notified or timeout expires.
+/// @param timeoutMs Timeout in milliseconds
+/// @return Number of pending notifications (0 when timed out)
+uint32 rtWait(uint32 timeoutMs);
+
+/// @brief Puts calling task to sleep.
+void rtSleep(uint32 ms);
+
+/// @brief Starts periodic sample clock which notifies given task on every tick.
+/// On ESP32 it runs from hardware timer interrupt.
+/// @param task Task to be woken on every tick
+/// @param periodUs Tick period in microseconds
+void rtClockStart(rt_task_t task, uint32 periodUs);
+
+/// @brief Stops sample clock.
+void rtClockStop();
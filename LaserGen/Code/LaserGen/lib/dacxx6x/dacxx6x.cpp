@@ -28,6 +28,7 @@
 #include "dacxx6x.h"
 
 #include <math.h>
+#include <string.h>
 
 
 void packData(DataFrame *dt, uint16 data)
@@ -56,6 +57,43 @@ void packCmd(DataFrame *dt, uint8 cmd)
 }
 
 
+void packFrames(uint8 *out, const uint16 *data, size_t count, uint8 addr, uint8 cmd, uint8 bitOffset)
+{
+	DataFrame _dt = {0};
+	packAddress(&_dt, addr);
+	packCmd(&_dt, cmd);
+	const uint32_t _t = _dt.raw[0];
+	size_t i = 0;
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	// 4 frames = 12 bytes = 3 words: [T D0h D0l T] [D1h D1l T D2h] [D2l T D3h D3l]
+	for(; i + 4 <= count; i += 4, out += 4 * FRAME_BYTES)
+	{
+		// Byte-swapped data, so the higher byte lands first in memory
+		uint32_t _s0 = __builtin_bswap16((uint16)(data[i] << bitOffset));
+		uint32_t _s1 = __builtin_bswap16((uint16)(data[i + 1] << bitOffset));
+		uint32_t _s2 = __builtin_bswap16((uint16)(data[i + 2] << bitOffset));
+		uint32_t _s3 = __builtin_bswap16((uint16)(data[i + 3] << bitOffset));
+
+		uint32_t _w[3];
+		_w[0] = _t | (_s0 << 8) | (_t << 24);
+		_w[1] = _s1 | (_t << 16) | (_s2 << 24);
+		_w[2] = (_s2 >> 8) | (_t << 8) | (_s3 << 16);
+		memcpy(out, _w, sizeof(_w));
+	}
+#endif
+
+	// Remaining frames (or all of them on big-endian targets)
+	for(; i < count; i++, out += FRAME_BYTES)
+	{
+		uint16 _d = data[i] << bitOffset;
+		out[0] = _t;
+		out[1] = _d >> 8;
+		out[2] = _d & 0xff;
+	}
+}
+
+
 /**************************************************************************/
 dacxx6x::channel_t::channel_t(dacxx6x &parent, uint8 ch_addr)
 	: m_inst(parent)
@@ -169,22 +207,29 @@ SPISettings dacxx6x::m_spiSettings;
 
 /**************************************************************************/
 dacxx6x::dacxx6x()
+	: dacxx6x(true) { }
+
+dacxx6x::dacxx6x(bool useSpi)
 {
 // Note: This condition is used ONLY to determine if code is compiled with an Arduino API.
 #ifdef ARDUINO
-	m_spiDev = new SPIClass(VSPI);
+	m_spiDev = useSpi ? new SPIClass(VSPI) : NULL;
 	m_spiSettings = SPISettings(1000000UL, SPI_MSBFIRST, SPI_MODE0);
-
+#else
+	// TODO: ESP IDF version
+	(void)useSpi;
+#endif
 	m_spiMosi = -1;
 	m_spiSck = -1;
 	m_spiCs = -1;
 
 	m_pinLdac = -1;
+	m_pinClr = -1;
 
+	m_powerDownMode = (uint8)PwrDownMode::A_B_1K;
 	m_vref = m_intVref;
-#else
-	// TODO: ESP IDF version
-#endif
+	m_bitOffset = 0;
+
 	// Channel objects init
 	ch_a = new channel_t(*this, DAC_A);
 	ch_b = new channel_t(*this, DAC_B);
@@ -192,8 +237,13 @@ dacxx6x::dacxx6x()
 
 dacxx6x::~dacxx6x()
 {
+#ifdef ARDUINO
 	if(m_spiDev)
+	{
 		m_spiDev->end();
+		delete m_spiDev;
+	}
+#endif
 
 	delete ch_a;
 	delete ch_b;
@@ -223,7 +273,9 @@ void dacxx6x::init(int8 mosi, int8 sck, int8 cs, uint32_t clock)
 #endif
 	// Set default configuration
 	restoreDefault();
+#ifdef ARDUINO
 	delay(1);
+#endif
 }
 
 void dacxx6x::setVref(float vref)
@@ -361,8 +413,38 @@ void dacxx6x::restoreDefault()
 	setIntRef(VrefCtrl::ENABLE);			// internal vref enabled
 }
 
+void dacxx6x::packBlock(uint8 *out, const uint16 *data, size_t count, uint8 address, uint8 command) const
+{
+	packFrames(out, data, count, address, command, m_bitOffset);
+}
+
+void dacxx6x::stream(const uint8 *frames, size_t count)
+{
+#ifdef ARDUINO
+	if(!m_spiDev)
+		return;
+
+	m_spiDev->beginTransaction(m_spiSettings);
+	for(size_t i = 0; i < count; i++, frames += FRAME_BYTES)
+	{
+		// DAC latches frame on rising edge of SYNC, so CS must be toggled after each one
+		digitalWrite(m_spiCs, LOW);
+		m_spiDev->writeBytes(frames, FRAME_BYTES);
+		digitalWrite(m_spiCs, HIGH);
+	}
+	m_spiDev->endTransaction();
+#else
+	// TODO: ESP IDF version
+	(void)frames;
+	(void)count;
+#endif
+}
+
 /**************************************************************************/
-dac8162::dac8162() { }
+dac8162::dac8162()
+{
+	m_bitOffset = 2;
+}
 
 dac8162::~dac8162() { }
 
@@ -370,7 +452,7 @@ DataFrame dac8162::write(uint16 data, uint8 address, uint8 command, bool sending
 {
 	// Create 24-bit dataframe and pack all data into it
 	DataFrame _dt = {0};
-	_dt.bitOffset = 2;
+	_dt.bitOffset = m_bitOffset;
 
 	if (sendingConfig)
 		_dt.data = data;
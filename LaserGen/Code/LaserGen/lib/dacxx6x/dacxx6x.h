@@ -47,6 +47,9 @@
 
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
 // Helper types
 typedef signed char 	int8;
 typedef signed short 	int16;
@@ -129,6 +132,9 @@ enum VrefCtrl
 #define ADDRESS_MASK		0x07
 #define COMMAND_MASK		0x38
 
+// Size of a single frame in a packed frame stream
+#define FRAME_BYTES			3
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -191,6 +197,17 @@ extern "C" {
 	{
 		return (dt->raw[0] >> 3) & 0x7;
 	}
+
+	/// @brief Converts an array of 16-bit values into contiguous stream of 24-bit big-endian frames (FRAME_BYTES each),
+	/// all with the same address and command. Works on 32-bit words, packing 4 frames per iteration.
+	/// Output is byte-for-byte the same as packing every value separately with packData(), packAddress() and packCmd().
+	/// @param out Output buffer, at least count * FRAME_BYTES long (no alignment required).
+	/// @param data Values to be packed.
+	/// @param count Number of values.
+	/// @param addr Address value for all frames.
+	/// @param cmd Command value for all frames.
+	/// @param bitOffset Data segment offset, @see DataFrame.
+	void packFrames(uint8 *out, const uint16 *data, size_t count, uint8 addr, uint8 cmd, uint8 bitOffset);
 #ifdef __cplusplus
 }
 #endif
@@ -253,7 +270,7 @@ private:
 
 public:
 	dacxx6x();
-	~dacxx6x();
+	virtual ~dacxx6x();
 
 	/// @brief Initializes library and configures SPI interface.
 	/// @param mosi (Optional) SPI MOSI pin
@@ -310,13 +327,30 @@ public:
 	/// @brief Restores DAC to initial state provided by this library (same as init() method).
 	void restoreDefault();
 
+	/// @brief Packs values into frame stream for this chip model, @see packFrames().
+	/// @param out Output buffer, at least count * FRAME_BYTES long
+	/// @param data Values to be packed
+	/// @param count Number of values
+	/// @param address Address segment for all frames
+	/// @param command Command segment for all frames
+	void packBlock(uint8 *out, const uint16 *data, size_t count, uint8 address, uint8 command) const;
+
+	/// @brief Sends already packed frames to DAC in a single SPI transaction (chip select is toggled between frames).
+	/// @param frames Frame stream, @see packBlock()
+	/// @param count Number of frames
+	virtual void stream(const uint8 *frames, size_t count);
+
 	/// @brief Reference to specific DAC channel.
 	channel_t *ch_a, *ch_b;
 
 protected:
+	/// @brief Creates interface without SPI device, for models which never talk to a chip (e.g. benchmark stand-ins).
+	/// Such model must override write() and stream(), init() mustn't be called.
+	/// @param useSpi If true, SPI device is created (same as default constructor)
+	explicit dacxx6x(bool useSpi);
 
 #ifdef ARDUINO
-	SPIClass *m_spiDev;
+	SPIClass *m_spiDev;			// NULL if created without SPI
 	static SPISettings m_spiSettings;
 #else
 
@@ -332,6 +366,7 @@ protected:
 	int8 m_pinClr;
 
 	uint8 m_powerDownMode;
+	uint8 m_bitOffset;		// Data segment offset specific for chip model
 	float m_vref;
 	static const float m_intVref;
 
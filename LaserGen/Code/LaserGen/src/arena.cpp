@@ -0,0 +1,43 @@
+#include "arena.h"
+
+
+alignas(ARENA_ALIGN) static uint8 s_arenaStorage[ARENA_SIZE];
+
+Arena g_arena(s_arenaStorage, ARENA_SIZE);
+
+
+/**************************************************************************/
+Arena::Arena(uint8 *storage, uint32 size)
+	: m_storage(storage), m_size(size), m_used(0), m_highWater(0), m_failed(0) { }
+
+void* Arena::alloc(uint32 size, uint32 align)
+{
+	uint32 _start = (m_used + align - 1) & ~(align - 1);
+
+	if(_start > m_size || size > m_size - _start)
+	{
+		m_failed++;
+		return NULL;
+	}
+
+	m_used = _start + size;
+	if(m_used > m_highWater)
+		m_highWater = m_used;
+	return m_storage + _start;
+}
+
+uint32 Arena::mark() const
+{
+	return m_used;
+}
+
+void Arena::release(uint32 mark)
+{
+	if(mark < m_used)
+		m_used = mark;
+}
+
+arenastats_t Arena::stats() const
+{
+	return { m_size, m_used, m_highWater, m_failed };
+}
@@ -0,0 +1,306 @@
+#include "bench.h"
+
+#ifdef LASERGEN_BENCH
+
+#include <string.h>
+
+#ifdef ARDUINO
+#define BENCH_PRINT(...)	Serial.printf(__VA_ARGS__)
+#else
+#include <stdio.h>
+#include <chrono>
+#define BENCH_PRINT(...)	printf(__VA_ARGS__)
+#endif
+
+
+// Results of all cases are collected before printing, so serial output doesn't disturb measurements
+#define MAX_BENCH_CASES		16
+
+// Defeats dead-code elimination of benchmarked expressions
+static volatile uint32 s_sink;
+
+static benchresult_t s_results[MAX_BENCH_CASES];
+static uint8 s_resultCnt = 0;
+
+
+/**************************************************************************/
+/// @brief DAC stand-in which packs frames the same way as dac8162, but stores them in memory instead of sending through SPI.
+class NullDac : public dacxx6x
+{
+public:
+	uint32 frames;
+
+	NullDac() : dacxx6x(false), frames(0)
+	{
+		m_bitOffset = 2;
+	}
+
+	void stream(const uint8 *frames, size_t count) override
+	{
+		// One frame per SPI write, as the real one
+		for(size_t i = 0; i < count; i++, frames += FRAME_BYTES)
+		{
+			memcpy(m_last, frames, FRAME_BYTES);
+			s_sink = m_last[0] ^ m_last[1] ^ m_last[2];
+		}
+		this->frames += count;
+	}
+
+private:
+	uint8 m_last[FRAME_BYTES];
+
+	DataFrame write(uint16 data, uint8 address, uint8 command, bool sendingConfig = true) override
+	{
+		DataFrame _dt = {0};
+		_dt.bitOffset = 2;
+
+		if (sendingConfig)
+			_dt.data = data;
+		else
+			packData(&_dt, data);
+		packAddress(&_dt, address);
+		packCmd(&_dt, command);
+
+		s_sink = _dt.raw[0] ^ _dt.raw[1] ^ _dt.raw[2];
+		frames++;
+		return _dt;
+	}
+};
+
+
+/**************************************************************************/
+static uint32 s_t0, s_c0;
+
+// CPU cycles are counted only on target, host reports 0
+static inline uint32 benchCycles()
+{
+#ifdef ARDUINO
+	return ESP.getCycleCount();
+#else
+	return 0;
+#endif
+}
+
+static inline uint32 benchMicros()
+{
+#ifdef ARDUINO
+	return micros();
+#else
+	using namespace std::chrono;
+	return (uint32)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static inline void benchBegin()
+{
+	s_c0 = benchCycles();
+	s_t0 = benchMicros();
+}
+
+static inline void benchEnd(const char *name, uint32 iterations)
+{
+	uint32 _us = benchMicros() - s_t0;
+	uint32 _cycles = benchCycles() - s_c0;
+
+	if(s_resultCnt >= MAX_BENCH_CASES)
+		return;
+	s_results[s_resultCnt++] = { name, iterations, _us, _cycles };
+}
+
+static void printResults()
+{
+#ifdef ARDUINO
+	BENCH_PRINT("{\"suite\":\"lasergen\",\"cpu_mhz\":%u,\"results\":[", (unsigned)getCpuFrequencyMhz());
+#else
+	BENCH_PRINT("{\"suite\":\"lasergen\",\"host\":true,\"results\":[");
+#endif
+	for(uint8 i = 0; i < s_resultCnt; i++)
+	{
+		const benchresult_t &r = s_results[i];
+		float _nsPerOp = (r.elapsedUs * 1000.0f) / r.iterations;
+		float _opsPerSec = (r.elapsedUs > 0) ? (r.iterations * 1000000.0f) / r.elapsedUs : 0.0f;
+
+		BENCH_PRINT("%s{\"name\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.1f,\"cycles_per_op\":%.1f,\"ops_per_sec\":%.0f}",
+			(i > 0) ? "," : "", r.name, r.iterations, _nsPerOp, (float)r.cycles / r.iterations, _opsPerSec);
+	}
+	BENCH_PRINT("]}\n");
+}
+
+
+/**************************************************************************/
+static void benchPacking()
+{
+	DataFrame _dt = {0};
+	_dt.bitOffset = 2;
+
+	benchBegin();
+	for(uint32 i = 0; i < BENCH_ITERATIONS; i++)
+	{
+		packData(&_dt, (uint16)i);
+		s_sink = _dt.raw[1];
+	}
+	benchEnd("packData", BENCH_ITERATIONS);
+
+	benchBegin();
+	for(uint32 i = 0; i < BENCH_ITERATIONS; i++)
+	{
+		packAddress(&_dt, (uint8)i & 0x7);
+		s_sink = _dt.raw[0];
+	}
+	benchEnd("packAddress", BENCH_ITERATIONS);
+
+	benchBegin();
+	for(uint32 i = 0; i < BENCH_ITERATIONS; i++)
+	{
+		packCmd(&_dt, (uint8)i & 0x7);
+		s_sink = _dt.raw[0];
+	}
+	benchEnd("packCmd", BENCH_ITERATIONS);
+
+	benchBegin();
+	for(uint32 i = 0; i < BENCH_ITERATIONS; i++)
+	{
+		DataFrame _f = {0};
+		_f.bitOffset = 2;
+		packData(&_f, (uint16)i);
+		packAddress(&_f, DAC_A);
+		packCmd(&_f, CMD_WRITE_UPDATE_IN_REG);
+		s_sink = _f.raw[0] ^ _f.raw[1] ^ _f.raw[2];
+	}
+	benchEnd("packFrame", BENCH_ITERATIONS);
+
+	// Batch packing of the same amount of frames, block by block
+	uint16 _codes[GEN_BLOCK_SIZE];
+	uint8 _frames[GEN_BLOCK_SIZE * FRAME_BYTES];
+	for(uint16 i = 0; i < GEN_BLOCK_SIZE; i++)
+		_codes[i] = i * 512;
+
+	benchBegin();
+	for(uint32 i = 0; i < BENCH_ITERATIONS / GEN_BLOCK_SIZE; i++)
+	{
+		packFrames(_frames, _codes, GEN_BLOCK_SIZE, DAC_A, CMD_WRITE_UPDATE_IN_REG, 2);
+		s_sink = _frames[i % sizeof(_frames)];
+	}
+	benchEnd("packFrames_batch", (BENCH_ITERATIONS / GEN_BLOCK_SIZE) * GEN_BLOCK_SIZE);
+}
+
+static void benchTable(WaveGen &wg)
+{
+	const uint32 _runs = 10;
+
+	benchBegin();
+	for(uint32 i = 0; i < _runs; i++)
+		wg.generateTable(&wg.m_sineOsc);
+	benchEnd("generateTable", _runs * MAX_PHASE_CNT);
+}
+
+static void benchParser()
+{
+	static const char *_lines[] = { "freq sin 1000.5\n", "amp saw 0.75\n", "en sin t\n", "swp sin 10 100\n" };
+	const uint8 _lineCnt = sizeof(_lines) / sizeof(_lines[0]);
+	const uint32 _runs = BENCH_ITERATIONS / 10;
+	char _buf[IN_BUF_SIZE];
+	CmdParser _parser;
+
+	_parser.setEcho(false);
+
+	benchBegin();
+	for(uint32 i = 0; i < _runs; i++)
+	{
+		const char *_line = _lines[i % _lineCnt];
+		size_t _len = strlen(_line);
+
+		// Parser tokenizes in place, so input has to be restored on every run
+		memcpy(_buf, _line, _len + 1);
+		_parser.parse(_buf, _len);
+		s_sink = (uint32)_parser.getComFrame()._value1;
+	}
+	benchEnd("CmdParser::parse", _runs);
+}
+
+static void benchRender(WaveGen &wg)
+{
+	static const struct { interp_t mode; const char *name; } _modes[] =
+	{
+		{ interp_t::NEAREST, "render_nearest" },
+		{ interp_t::LINEAR, "render_linear" }
+	};
+	const uint32 _blocks = BENCH_ITERATIONS / GEN_BLOCK_SIZE;
+	uint16 _block[GEN_BLOCK_SIZE];
+	osc_t _osc = wg.m_sineOsc;
+	uint32 _phase = 0;
+
+	_osc.frequency = 123.4f;	// non-integer step, so linear interpolation really interpolates
+
+	for(uint8 m = 0; m < sizeof(_modes) / sizeof(_modes[0]); m++)
+	{
+		_osc.interp = _modes[m].mode;
+
+		benchBegin();
+		for(uint32 i = 0; i < _blocks; i++)
+		{
+			wg.render(&_osc, &_phase, _block, GEN_BLOCK_SIZE);
+			s_sink = _block[0];
+		}
+		benchEnd(_modes[m].name, _blocks * GEN_BLOCK_SIZE);
+	}
+
+	_osc.waveType = wavetype_t::SAW;
+
+	benchBegin();
+	for(uint32 i = 0; i < _blocks; i++)
+	{
+		wg.render(&_osc, &_phase, _block, GEN_BLOCK_SIZE);
+		s_sink = _block[0];
+	}
+	benchEnd("render_saw", _blocks * GEN_BLOCK_SIZE);
+}
+
+// End-to-end, the same way as render task: block rendering, batch packing and streaming every frame into (mock) SPI
+static void benchSamplePath(WaveGen &wg)
+{
+	NullDac _dac;
+	uint16 _block[GEN_BLOCK_SIZE];
+	uint8 _frames[GEN_BLOCK_SIZE * FRAME_BYTES];
+	osc_t _osc = wg.m_sineOsc;
+	uint32 _phase = 0;
+
+	benchBegin();
+	for(uint32 i = 0; i < BENCH_ITERATIONS / GEN_BLOCK_SIZE; i++)
+	{
+		wg.render(&_osc, &_phase, _block, GEN_BLOCK_SIZE);
+		_dac.packBlock(_frames, _block, GEN_BLOCK_SIZE, DAC_A, CMD_WRITE_UPDATE_IN_REG);
+		for(uint16 n = 0; n < GEN_BLOCK_SIZE; n++)
+			_dac.stream(&_frames[n * FRAME_BYTES], 1);
+	}
+	benchEnd("samplePath", _dac.frames);
+}
+
+
+/**************************************************************************/
+void runBenchmarks(WaveGen &wg)
+{
+	s_resultCnt = 0;
+
+	benchPacking();
+	benchTable(wg);
+	benchParser();
+	benchRender(wg);
+	benchSamplePath(wg);
+
+	printResults();
+}
+
+#ifndef ARDUINO
+// Host build ([env:native_bench]) - generator's hot paths run without DAC, tasks and sample clock
+int main()
+{
+	static WaveGen _wg;
+
+	_wg.init();
+	runBenchmarks(_wg);
+	return 0;
+}
+#endif
+
+#endif
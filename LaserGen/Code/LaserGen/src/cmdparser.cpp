@@ -2,11 +2,17 @@
 
 
 #define to_uint(x)		((uint16)atoi(x))
+#ifdef ARDUINO
 #define to_float(x)		((float)atoff(x))
+#else
+#define to_float(x)		((float)atof(x))
+#endif
+
+#define set_name(dst, src)	(snprintf((dst), NAME_LEN, "%s", (src)))
 
 
 CmdParser::CmdParser(ParsingMode mode)
-	: m_parsingMode(mode) 
+	: m_parsingMode(mode), m_echo(true)
 	{
 		m_theframe =
 			{
@@ -15,6 +21,9 @@ CmdParser::CmdParser(ParsingMode mode)
 				._value1 = -1.0f,
 				._value2 = -1.0f
 			};
+
+		for(uint8 i = 0; i < FRAME_SIZE; i++)
+			m_tokens[i] = (char*)"";
 	}
 
 void CmdParser::parse(char* buf, size_t len)
@@ -23,6 +32,10 @@ void CmdParser::parse(char* buf, size_t len)
 	char *inputStr = buf;
 	uint8 idx = 0;
 
+	// Tokens missing in this line mustn't point into previous one
+	for(uint8 i = 0; i < FRAME_SIZE; i++)
+		m_tokens[i] = (char*)"";
+
 	// Tokenize input string
 	while((token = strtok_r(inputStr, " ", &inputStr))) // space as separator
 	{
@@ -47,11 +60,11 @@ void CmdParser::parse(char* buf, size_t len)
 			char *_val2 = m_tokens[_VALUE2];
 
 			if(!strcmp(_sig, "sin") || !strcmp(_sig, "saw"))
-				m_theframe._sig = _sig;
+				set_name(m_theframe._sig, _sig);
 
 			if(!strcmp(_cmd, "en"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value2 = -1.0f;
 
 				if(!strcmp(_val1, "t\n"))
@@ -64,35 +77,49 @@ void CmdParser::parse(char* buf, size_t len)
 
 			if(!strcmp(_cmd, "amp"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value1 = to_float(_val1);
 				m_theframe._value2 = -1.0f;
 			}
 
 			if(!strcmp(_cmd, "freq"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value1 = to_float(_val1);
 				m_theframe._value2 = -1.0f;
 			}
 
 			if(!strcmp(_cmd, "ph"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value1 = to_float(_val1);
 				m_theframe._value2 = -1.0f;
 			}
 
 			if(!strcmp(_cmd, "dc"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value1 = to_float(_val1);
 				m_theframe._value2 = -1.0f;
 			}
 
+			if(!strcmp(_cmd, "ipol"))
+			{
+				set_name(m_theframe._cmd, _cmd);
+				m_theframe._value2 = -1.0f;
+
+				// Applies to both signals, so the mode comes in place of signal's name
+				if(!strcmp(_sig, "l\n"))
+					m_theframe._value1 = 1.0f;
+				else if(!strcmp(_sig, "n\n"))
+					m_theframe._value1 = 0.0f;
+				else
+					m_theframe._value1 = -1.0f;
+			}
+
 			if(!strcmp(_cmd, "swe"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value2 = -1.0f;
 
 				if (!strcmp(_val1, "t\n"))
@@ -105,27 +132,28 @@ void CmdParser::parse(char* buf, size_t len)
 
 			if(!strcmp(_cmd, "swp"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value1 = to_float(_val1);
 				m_theframe._value2 = to_float(_val2);
 			}
 
 			if(!strcmp(_cmd, "swr"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value1 = to_float(_val1);
 				m_theframe._value2 = -1.0f;
 			}
 
 			if(!strcmp(_cmd, "swf"))
 			{
-				m_theframe._cmd = _cmd;
+				set_name(m_theframe._cmd, _cmd);
 				m_theframe._value1 = to_float(_val1);
 				m_theframe._value2 = -1.0f;
 			}
 			break;
 	}
-	reprint();
+	if(m_echo)
+		reprint();
 }
 
 char* CmdParser::getParam(uint8 param)
@@ -158,10 +186,19 @@ cmdframe_t CmdParser::getComFrame()
 	return m_theframe;
 }
 
+void CmdParser::setEcho(bool enable)
+{
+	m_echo = enable;
+}
+
 void CmdParser::reprint()
 {
+#ifdef ARDUINO
 	Serial.println(m_theframe._cmd);
 	Serial.println(m_theframe._sig);
 	Serial.println(m_theframe._value1);
 	Serial.println(m_theframe._value2);
+#else
+	printf("%s\n%s\n%.2f\n%.2f\n", m_theframe._cmd, m_theframe._sig, m_theframe._value1, m_theframe._value2);
+#endif
 }
@@ -3,83 +3,268 @@
 #include <math.h>
 
 
+// Fixed point gain (Q15) used for amplitude scaling
+#define GAIN_FRAC_BITS	15
+#define GAIN_ONE		(1 << GAIN_FRAC_BITS)
 
-// void IRAM_ATTR WaveGen::onTimer_Sin()
-// {
+static_assert(GEN_ARENA_BYTES <= ARENA_SIZE, "ARENA_SIZE too small for generator's buffers");
 
-// }
 
-// void IRAM_ATTR WaveGen::onTimer_Saw()
-// {
+static inline uint32 phaseIncrement(float frequency)
+{
+	if(frequency <= 0.0f)
+		return 0;
+	return (uint32)(fmodf(frequency / SAMPLES_PER_SECOND, 1.0f) * PHASE_WRAP) % PHASE_WRAP;
+}
 
-// }
+static inline uint32 phaseOffset(float degrees)
+{
+	float _turns = fmodf(degrees / 360.0f, 1.0f);
+	if(_turns < 0.0f)
+		_turns += 1.0f;
+	return (uint32)(_turns * PHASE_WRAP) % PHASE_WRAP;
+}
+
+static inline float clampf(float val, float lo, float hi)
+{
+	// NaN ends up at the low bound
+	return fminf(fmaxf(val, lo), hi);
+}
+
+// Keeps values which render() takes as they are within range of its fixed point math
+static void clampOsc(osc_t *osc)
+{
+	osc->frequency = clampf(osc->frequency, 0.0f, MAX_FREQUENCY);
+	osc->amplitude = clampf(osc->amplitude, 0.0f, 1.0f);
+	osc->offset = clampf(osc->offset, -1.0f, 1.0f);
+}
+
+// Scales centered sample by amplitude, adds DC offset and clamps it to DAC range
+static inline uint16 shapeSample(int32 centered, int32 gain, int32 offset)
+{
+	int32 _val = MAX_AMPLITUDE + ((centered * gain) >> GAIN_FRAC_BITS) + offset;
+
+	if(_val < 0)
+		_val = 0;
+	if(_val > SIG_PEAK - 1)
+		_val = SIG_PEAK - 1;
+	return (uint16)_val;
+}
 
 /**************************************************************************/
-WaveGen::WaveGen() { }
+WaveGen::WaveGen()
+	: m_renderTask(NULL), m_dac(NULL), m_initialized(false), m_arenaMark(0),
+	  m_phaseBuf_sin(NULL), m_phaseBuf_saw(NULL), m_frameBuf_sin(NULL), m_frameBuf_saw(NULL)
+{
+	m_sineOsc.wavetable = NULL;
+}
+
 WaveGen::~WaveGen()
 {
-	delete m_timerSine;
-	// delete m_timerSaw;
+	// Tables & buffers live in arena
+	if(m_initialized)
+		g_arena.release(m_arenaMark);
 	delete m_dac;
-	delete m_phaseBuf_sin;
-	delete m_phaseBuf_saw;
 }
 
 void WaveGen::init()
 {
+	// Re-initialization reuses the same arena space
+	if(m_initialized)
+		g_arena.release(m_arenaMark);
+	else
+		m_arenaMark = g_arena.mark();
+
 	m_sineOsc = {
 		.frequency = 100.0f, // 100 Hz
 		.amplitude = 1.0f,
 		.phase = 0,
 		.offset = 0,
-		.wavetable = new uint16(MAX_PHASE_CNT),
-		.waveType = wavetype_t::SINE
+		.wavetable = g_arena.allocArray<uint16>(MAX_PHASE_CNT),
+		.waveType = wavetype_t::SINE,
+		.interp = interp_t::LINEAR,
+		.enabled = false
 		};
 
+	m_sawOsc = m_sineOsc;
+	m_sawOsc.wavetable = NULL;
+	m_sawOsc.waveType = wavetype_t::SAW;
 
-	// 
-	
-	for (uint16 i = 0; i < MAX_PHASE_CNT - 1; i++)
-		m_sineOsc.wavetable[i] = MAX_AMPLITUDE + m_sineOsc.amplitude * MAX_AMPLITUDE * sinf(2.0f * M_PI * i / MAX_PHASE_CNT);
+	generateTable(&m_sineOsc);
 
-	// m_phaseBuf_sin = new uint16(MAX_PHASE_CNT);
+	m_phaseBuf_sin = g_arena.allocArray<uint16>(GEN_BLOCK_SIZE);
+	m_phaseBuf_saw = g_arena.allocArray<uint16>(GEN_BLOCK_SIZE);
+	m_frameBuf_sin = g_arena.allocArray<uint8>(GEN_BLOCK_SIZE * FRAME_BYTES);
+	m_frameBuf_saw = g_arena.allocArray<uint8>(GEN_BLOCK_SIZE * FRAME_BYTES);
+	m_bufPos = GEN_BLOCK_SIZE;	// forces rendering on first tick
+	m_phaseSin = 0;
+	m_phaseSaw = 0;
+	m_samples = 0;
+	m_overruns = 0;
 
+	m_published.sine = m_sineOsc;
+	m_published.saw = m_sawOsc;
 
+	// DAC object is created once and kept for generator's lifetime
+	if(!m_dac)
+		m_dac = new dac8162();
+	m_dac->init();
 
-	// Init timers
-	// m_timerSine = timerBegin(0, TIMER_DIVIDER, true);
-	// m_sawTimer = timerBegin(1, TIMER_DIVIDER, true);
+	m_initialized = true;
+}
 
-	// m_dac = new dac8162();
-	// m_dac->init();
+void WaveGen::generateTable(osc_t *osc)
+{
+	for (uint16 i = 0; i < MAX_PHASE_CNT; i++)
+		osc->wavetable[i] = MAX_AMPLITUDE + MAX_AMPLITUDE * sinf(2.0f * M_PI * i / MAX_PHASE_CNT);
+}
 
-	// timerAttachInterrupt(m_sinTimer, &onTimer_Sin, true);
-	// timerAlarmWrite(m_sinTimer, MICROS_PER_SAMPLE, true);
+void WaveGen::enable()
+{
+	if(!m_renderTask)
+		rtSpawn(&m_renderTask, &WaveGen::renderTask, this, "render", RT_STACK_RENDER, RT_PRIO_RENDER, RT_CORE_RENDER);
+	rtClockStart(m_renderTask, MICROS_PER_SAMPLE);
 }
 
-// void WaveGen::enableSin()
-// {
-// 	timerAlarmEnable(m_sinTimer);
-// }
+void WaveGen::disable()
+{
+	rtClockStop();
+}
 
-// void WaveGen::disableSin()
-// {
-// 	timerAlarmDisable(m_sinTimer);
-// }
+void WaveGen::setParams(const oscset_t &set)
+{
+	// Centered sample (Q0, |x| <= MAX_AMPLITUDE) times gain (Q15, <= GAIN_ONE) fits int32 only for these
+	m_published = set;
+	clampOsc(&m_published.sine);
+	clampOsc(&m_published.saw);
+	m_params.publish(m_published);
+}
 
-// void WaveGen::enableSaw()
-// {
-// 	timerAlarmEnable(m_sawTimer);
-// }
+oscset_t WaveGen::getParams() const
+{
+	return m_published;
+}
+
+void WaveGen::setInterpolation(interp_t mode)
+{
+	oscset_t _set = m_published;
+
+	_set.sine.interp = mode;
+	_set.saw.interp = mode;
+	setParams(_set);
+}
+
+void WaveGen::render(const osc_t *osc, uint32 *phase, uint16 *out, uint16 count)
+{
+	const uint32 _inc = phaseIncrement(osc->frequency);
+	const int32 _gain = (int32)(osc->amplitude * GAIN_ONE);
+	const int32 _offset = (int32)(osc->offset * MAX_AMPLITUDE);
+	// Phase shift is applied on output only, so changing it doesn't disturb the accumulator
+	const uint32 _shift = phaseOffset(osc->phase);
+	uint32 _ph = *phase;
 
-// void WaveGen::disableSaw()
-// {
-// 	timerAlarmDisable(m_sawTimer);
-// }
+	for(uint16 i = 0; i < count; i++)
+	{
+		uint32 _pos = _ph + _shift;
+		if(_pos >= PHASE_WRAP)
+			_pos -= PHASE_WRAP;
+
+		int32 _centered;
+		if(osc->waveType == wavetype_t::SAW)
+			_centered = (int32)(((uint64_t)_pos * SIG_PEAK) / PHASE_WRAP) - MAX_AMPLITUDE;
+		else
+			_centered = (int32)interpolate(osc->wavetable, _pos, osc->interp) - MAX_AMPLITUDE;
+
+		out[i] = shapeSample(_centered, _gain, _offset);
+
+		_ph += _inc;
+		if(_ph >= PHASE_WRAP)
+			_ph -= PHASE_WRAP;
+	}
+	*phase = _ph;
+}
+
+void WaveGen::renderBlock()
+{
+	oscset_t _set;
+
+	if(m_params.fetch(_set))
+		applyParams(_set);
+
+	render(&m_sineOsc, &m_phaseSin, m_phaseBuf_sin, GEN_BLOCK_SIZE);
+	render(&m_sawOsc, &m_phaseSaw, m_phaseBuf_saw, GEN_BLOCK_SIZE);
+	m_dac->packBlock(m_frameBuf_sin, m_phaseBuf_sin, GEN_BLOCK_SIZE, DAC_A, CMD_WRITE_UPDATE_IN_REG);
+	m_dac->packBlock(m_frameBuf_saw, m_phaseBuf_saw, GEN_BLOCK_SIZE, DAC_B, CMD_WRITE_UPDATE_IN_REG);
+	m_bufPos = 0;
+}
+
+const uint16 *WaveGen::block(uint8 channel) const
+{
+	return (channel == DAC_B) ? m_phaseBuf_saw : m_phaseBuf_sin;
+}
+
+uint32 WaveGen::samplesOut() const
+{
+	return m_samples;
+}
+
+uint32 WaveGen::overruns() const
+{
+	return m_overruns;
+}
 
 /**************************************************************************/
-uint16 WaveGen::interpolate(uint16 *w_tab, uint16 index)
+uint16 WaveGen::interpolate(const uint16 *w_tab, uint32 phase, interp_t mode)
+{
+	uint16 _idx = phase >> PHASE_FRAC_BITS;
+
+	if(mode == interp_t::NEAREST)
+		return w_tab[_idx];
+
+	uint16 _next = (_idx + 1 < MAX_PHASE_CNT) ? _idx + 1 : 0;
+	int32 _frac = phase & ((1 << PHASE_FRAC_BITS) - 1);
+	int32 _a = w_tab[_idx];
+	int32 _b = w_tab[_next];
+
+	return (uint16)(_a + (((_b - _a) * _frac) >> PHASE_FRAC_BITS));
+}
+
+void WaveGen::applyParams(const oscset_t &set)
+{
+	// SPI is used only from render task, so channels are switched here
+	if(set.sine.enabled != m_sineOsc.enabled)
+		set.sine.enabled ? m_dac->ch_a->enable() : m_dac->ch_a->disable();
+	if(set.saw.enabled != m_sawOsc.enabled)
+		set.saw.enabled ? m_dac->ch_b->enable() : m_dac->ch_b->disable();
+
+	m_sineOsc = set.sine;
+	m_sawOsc = set.saw;
+}
+
+void WaveGen::renderLoop()
 {
+	for(;;)
+	{
+		uint32 _pending = rtWait(100);
+		if(_pending == 0)
+			continue;
+		if(_pending > 1)
+			m_overruns++;
+
+		if(m_bufPos >= GEN_BLOCK_SIZE)
+			renderBlock();
 
-	return 0;
+		if(m_sineOsc.enabled)
+			m_dac->stream(&m_frameBuf_sin[m_bufPos * FRAME_BYTES], 1);
+		if(m_sawOsc.enabled)
+			m_dac->stream(&m_frameBuf_saw[m_bufPos * FRAME_BYTES], 1);
+
+		m_bufPos++;
+		m_samples++;
+	}
+}
+
+void WaveGen::renderTask(void *arg)
+{
+	static_cast<WaveGen*>(arg)->renderLoop();
 }
@@ -1,11 +1,14 @@
 #include <Arduino.h>
 
 #include "gen.h"
+#include "bench.h"
 
 
 WaveGen wg;
 CmdParser parser;
 
+static void controlTask(void *arg);
+
 
 void setup()
 {
@@ -20,41 +23,95 @@ void setup()
 
 	wg.init();
 
+#ifdef LASERGEN_BENCH
+	runBenchmarks(wg);
+#endif
 
-}
+	wg.enable();
 
-uint16 i = 0;
+	rt_task_t _control;
+	rtSpawn(&_control, &controlTask, NULL, "control", RT_STACK_CONTROL, RT_PRIO_CONTROL, RT_CORE_CONTROL);
+}
 
 void loop()
 {
-	// if(i < MAX_PHASE_CNT - 1)
-	// 	i++;
-	// else
-	// 	i = 0;
+	// Everything runs in dedicated tasks (see rtthread.h), Arduino's loop task isn't needed anymore
+	vTaskDelete(NULL);
+}
 
-	// Serial.print(">Phase cnt:");
-	// Serial.println(i);
+/**************************************************************************/
+// Converts parsed command into new oscillators' configuration
+static bool applyFrame(const cmdframe_t &frame, oscset_t &set)
+{
+	if(!strlen(frame._sig))
+		return false;
+
+	osc_t *_osc = !strcmp(frame._sig, "saw") ? &set.saw : &set.sine;
 
-	// Serial.print(">Wavetable:");
-	// Serial.println(wg.m_sineOsc.wavetable[i]);
-	// delay(10);
+	if(!strcmp(frame._cmd, "en"))
+	{
+		if(frame._value1 < 0.0f)
+			return false;
+		_osc->enabled = (frame._value1 > 0.0f);
+	}
+	else if(!strcmp(frame._cmd, "amp"))
+		_osc->amplitude = frame._value1;
+	else if(!strcmp(frame._cmd, "freq"))
+		_osc->frequency = frame._value1;
+	else if(!strcmp(frame._cmd, "ph"))
+		_osc->phase = frame._value1;
+	else if(!strcmp(frame._cmd, "dc"))
+		_osc->offset = frame._value1;
+	else
+		return false;	// sweep is not supported by generator yet
+
+	return true;
 }
 
-void serialEvent()
+// Core 0: serial command parsing and telemetry
+static void controlTask(void *arg)
 {
-	static char buf[IN_BUF_SIZE];
-	static uint8 chars = 0;
+	char buf[IN_BUF_SIZE] = {0};
+	uint8 chars = 0;
 
-	char ch = Serial.read();
+	for(;;)
+	{
+		if(!Serial.available())
+		{
+			rtSleep(10);
+			continue;
+		}
 
-	if(chars < IN_BUF_SIZE - 1)
-	{		
-		buf[chars] = ch;
-		chars++;
+		char ch = Serial.read();
+		buf[chars++] = ch;
 
 		if(ch == '\n')
 		{
 			parser.parse(buf, chars);
+
+			// Telemetry only on request, so it doesn't get mixed into every command's echo
+			if(!strcmp(parser.getParam(_CMD), "stats\n"))
+			{
+				arenastats_t _mem = g_arena.stats();
+				Serial.printf("samples: %u, overruns: %u, arena: %u/%u B (peak %u)\n",
+					wg.samplesOut(), wg.overruns(), _mem.used, _mem.capacity, _mem.highWater);
+			}
+			else if(!strcmp(parser.getComFrame()._cmd, "ipol"))
+			{
+				// Both oscillators at once - "ipol l" (linear) or "ipol n" (nearest sample)
+				if(parser.getComFrame()._value1 >= 0.0f)
+					wg.setInterpolation(parser.getComFrame()._value1 > 0.0f ? interp_t::LINEAR : interp_t::NEAREST);
+			}
+			else
+			{
+				oscset_t _set = wg.getParams();
+				if(applyFrame(parser.getComFrame(), _set))
+					wg.setParams(_set);
+			}
+		}
+
+		if(ch == '\n' || chars >= IN_BUF_SIZE - 1)
+		{
 			chars = 0;
 			memset(buf, 0, (size_t)IN_BUF_SIZE);
 		}
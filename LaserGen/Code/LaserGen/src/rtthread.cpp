@@ -0,0 +1,141 @@
+#include "rtthread.h"
+
+
+#ifdef ARDUINO
+
+static hw_timer_t *s_clockTimer = NULL;
+static volatile rt_task_t s_clockTask = NULL;
+
+
+static void IRAM_ATTR onClockTick()
+{
+	BaseType_t _woken = pdFALSE;
+
+	vTaskNotifyGiveFromISR(s_clockTask, &_woken);
+	if(_woken == pdTRUE)
+		portYIELD_FROM_ISR();
+}
+
+/**************************************************************************/
+bool rtSpawn(rt_task_t *task, rt_entry_t entry, void *arg, const char *name, uint32 stack, uint8 prio, int8 core)
+{
+	return xTaskCreatePinnedToCore(entry, name, stack, arg, prio, task, core) == pdPASS;
+}
+
+void rtNotify(rt_task_t task)
+{
+	xTaskNotifyGive(task);
+}
+
+uint32 rtWait(uint32 timeoutMs)
+{
+	return ulTaskNotifyTake(pdFALSE, pdMS_TO_TICKS(timeoutMs));
+}
+
+void rtSleep(uint32 ms)
+{
+	vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void rtClockStart(rt_task_t task, uint32 periodUs)
+{
+	s_clockTask = task;
+
+	if(!s_clockTimer)
+	{
+		s_clockTimer = timerBegin(RT_CLOCK_TIMER, 80, true);	// 1 MHz timer tick
+		timerAttachInterrupt(s_clockTimer, &onClockTick, true);
+	}
+	timerAlarmWrite(s_clockTimer, periodUs, true);
+	timerAlarmEnable(s_clockTimer);
+}
+
+void rtClockStop()
+{
+	if(s_clockTimer)
+		timerAlarmDisable(s_clockTimer);
+}
+
+#else
+
+#include <atomic>
+#include <chrono>
+
+
+static thread_local rt_task_t s_self = nullptr;
+
+static std::thread s_clockThread;
+static std::atomic<bool> s_clockRun(false);
+
+
+/**************************************************************************/
+bool rtSpawn(rt_task_t *task, rt_entry_t entry, void *arg, const char *name, uint32 stack, uint8 prio, int8 core)
+{
+	// Plain threads - no names, priorities nor pinning on host
+	(void)name;
+	(void)stack;
+	(void)prio;
+	(void)core;
+
+	rt_task_t _t = new rt_thread_t();
+
+	*task = _t;
+	_t->thread = std::thread([_t, entry, arg]()
+	{
+		s_self = _t;
+		entry(arg);
+	});
+	_t->thread.detach();
+	return true;
+}
+
+void rtNotify(rt_task_t task)
+{
+	{
+		std::lock_guard<std::mutex> _lock(task->lock);
+		task->notifications++;
+	}
+	task->cond.notify_one();
+}
+
+uint32 rtWait(uint32 timeoutMs)
+{
+	std::unique_lock<std::mutex> _lock(s_self->lock);
+	s_self->cond.wait_for(_lock, std::chrono::milliseconds(timeoutMs), [] { return s_self->notifications > 0; });
+
+	uint32 _pending = s_self->notifications;
+	if(_pending > 0)
+		s_self->notifications--;
+	return _pending;
+}
+
+void rtSleep(uint32 ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void rtClockStart(rt_task_t task, uint32 periodUs)
+{
+	rtClockStop();
+
+	s_clockRun = true;
+	s_clockThread = std::thread([task, periodUs]()
+	{
+		auto _next = std::chrono::steady_clock::now();
+		while(s_clockRun)
+		{
+			_next += std::chrono::microseconds(periodUs);
+			std::this_thread::sleep_until(_next);
+			rtNotify(task);
+		}
+	});
+}
+
+void rtClockStop()
+{
+	s_clockRun = false;
+	if(s_clockThread.joinable())
+		s_clockThread.join();
+}
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * @file test_main.cpp
+ * @author Patryk Sienkiewicz (@Patsen95)
+ *
+ * Mailbox stress test - writer and reader threads hammer the triple buffer, reader checks
+ * it never sees a torn value nor goes back in time. Run with [env:native], which builds
+ * it with ThreadSanitizer, so a missing barrier is reported as a data race.
+ */
+
+#include <unity.h>
+
+#include "mailbox.h"
+
+#include <atomic>
+#include <thread>
+
+
+#define STRESS_WRITES		200000
+#define PAYLOAD_WORDS		16		// bigger than anything copied in one instruction
+
+
+/// @brief Payload which is consistent only if all words are the same.
+struct payload_t
+{
+	uint32 seq[PAYLOAD_WORDS];
+};
+
+/*****************************************************************************************/
+
+void setUp() { }
+void tearDown() { }
+
+/*****************************************************************************************/
+
+static void test_fetch_empty()
+{
+	Mailbox<payload_t> _mb;
+	payload_t _out = {};
+
+	TEST_ASSERT_FALSE(_mb.fetch(_out));
+}
+
+static void test_latest_wins()
+{
+	Mailbox<payload_t> _mb;
+	payload_t _val, _out;
+
+	for(uint32 i = 1; i <= 3; i++)
+	{
+		for(uint8 w = 0; w < PAYLOAD_WORDS; w++)
+			_val.seq[w] = i;
+		_mb.publish(_val);
+	}
+
+	TEST_ASSERT_TRUE(_mb.fetch(_out));
+	TEST_ASSERT_EQUAL_UINT32(3, _out.seq[0]);
+	TEST_ASSERT_FALSE(_mb.fetch(_out));		// nothing new since
+}
+
+static void test_stress_reader_writer()
+{
+	static Mailbox<payload_t> _mb;
+	std::atomic<bool> _done(false);
+	uint32 _fetched = 0, _torn = 0, _stale = 0;
+
+	std::thread _writer([&]()
+	{
+		payload_t _val;
+		for(uint32 i = 1; i <= STRESS_WRITES; i++)
+		{
+			for(uint8 w = 0; w < PAYLOAD_WORDS; w++)
+				_val.seq[w] = i;
+			_mb.publish(_val);
+		}
+		_done.store(true, std::memory_order_release);
+	});
+
+	payload_t _out;
+	uint32 _last = 0;
+	for(;;)
+	{
+		// Flag is taken before fetch, so the last value can't slip through
+		bool _finished = _done.load(std::memory_order_acquire);
+		if(_mb.fetch(_out))
+		{
+			_fetched++;
+			for(uint8 w = 1; w < PAYLOAD_WORDS; w++)
+				if(_out.seq[w] != _out.seq[0])
+				{
+					_torn++;
+					break;
+				}
+			if(_out.seq[0] <= _last)
+				_stale++;
+			_last = _out.seq[0];
+		}
+		else if(_finished)
+			break;
+	}
+	_writer.join();
+
+	TEST_ASSERT_EQUAL_UINT32(0, _torn);
+	TEST_ASSERT_EQUAL_UINT32(0, _stale);
+	TEST_ASSERT_EQUAL_UINT32(STRESS_WRITES, _last);		// last value is never lost
+	TEST_ASSERT_TRUE(_fetched > 0);
+}
+
+/*****************************************************************************************/
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_fetch_empty);
+	RUN_TEST(test_latest_wins);
+	RUN_TEST(test_stress_reader_writer);
+	return UNITY_END();
+}
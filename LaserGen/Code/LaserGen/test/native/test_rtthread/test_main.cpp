@@ -0,0 +1,175 @@
+/**
+ * @file test_main.cpp
+ * @author Patryk Sienkiewicz (@Patsen95)
+ *
+ * Host threading layer (rtthread.cpp) - task spawning, notifications, sample clock -
+ * and generator's parameter hand-over, which goes through it and keeps values in range.
+ */
+
+#include <unity.h>
+
+#include "rtthread.h"
+#include "gen.h"
+
+#include <atomic>
+
+
+#define CLOCK_PERIOD_US		1000
+#define CLOCK_RUN_MS		200
+
+
+static std::atomic<uint32> s_woken;
+static std::atomic<uint32> s_timeouts;
+static std::atomic<bool> s_stop;
+
+// Arena holds one generator, init() of the same one reuses its space
+static WaveGen s_wg;
+
+
+// Counts wake-ups the way render task does
+static void waiter(void *arg)
+{
+	(void)arg;
+
+	while(!s_stop)
+	{
+		if(rtWait(10))
+			s_woken++;
+		else
+			s_timeouts++;
+	}
+}
+
+/*****************************************************************************************/
+
+void setUp()
+{
+	s_woken = 0;
+	s_timeouts = 0;
+	s_stop = false;
+}
+
+void tearDown()
+{
+	s_stop = true;
+	rtSleep(30);	// waiter leaves on its next timeout
+}
+
+/*****************************************************************************************/
+
+static void test_notify_wakes_task()
+{
+	rt_task_t _task;
+
+	TEST_ASSERT_TRUE(rtSpawn(&_task, &waiter, NULL, "waiter", RT_STACK_RENDER, RT_PRIO_RENDER, RT_CORE_RENDER));
+	rtSleep(20);
+	TEST_ASSERT_EQUAL_UINT32(0, s_woken);
+	TEST_ASSERT_TRUE(s_timeouts > 0);
+
+	for(uint8 i = 0; i < 5; i++)
+	{
+		rtNotify(_task);
+		rtSleep(5);
+	}
+	TEST_ASSERT_EQUAL_UINT32(5, s_woken);
+}
+
+static void test_sample_clock_rate()
+{
+	rt_task_t _task;
+
+	rtSpawn(&_task, &waiter, NULL, "waiter", RT_STACK_RENDER, RT_PRIO_RENDER, RT_CORE_RENDER);
+	rtClockStart(_task, CLOCK_PERIOD_US);
+	rtSleep(CLOCK_RUN_MS);
+	rtClockStop();
+
+	uint32 _ticks = s_woken;
+	rtSleep(20);
+
+	// Pending notifications are consumed one per wait, so nothing is lost - only late on a busy host
+	TEST_ASSERT_UINT32_WITHIN(CLOCK_RUN_MS * 1000 / CLOCK_PERIOD_US / 2, CLOCK_RUN_MS * 1000 / CLOCK_PERIOD_US, _ticks);
+	TEST_ASSERT_UINT32_WITHIN(2, _ticks, s_woken);		// clock really stopped
+}
+
+// True if rendered block matches the reference sample by sample
+static bool sameBlock(const uint16 *block, const uint16 *ref)
+{
+	for(uint8 i = 0; i < GEN_BLOCK_SIZE; i++)
+		if(block[i] != ref[i])
+			return false;
+	return true;
+}
+
+static void test_interpolation_goes_through_params()
+{
+	WaveGen &_wg = s_wg;
+	uint16 _linear[GEN_BLOCK_SIZE], _nearest[GEN_BLOCK_SIZE];
+	uint32 _phase = 0, _phaseNearest = 0;
+
+	_wg.init();
+	TEST_ASSERT_EQUAL(interp_t::LINEAR, _wg.getParams().sine.interp);
+
+	// References from the same wavetable - 100 Hz steps by 163.9 entries, so the modes differ
+	osc_t _ref = _wg.getParams().sine;
+	_wg.render(&_ref, &_phase, _linear, GEN_BLOCK_SIZE);
+	_ref.interp = interp_t::NEAREST;
+	_wg.render(&_ref, &_phaseNearest, _nearest, GEN_BLOCK_SIZE);
+	TEST_ASSERT_FALSE(sameBlock(_linear, _nearest));
+
+	_wg.renderBlock();
+	TEST_ASSERT_TRUE(sameBlock(_wg.block(DAC_A), _linear));
+
+	// Control side sees the new mode at once, render side at the next block boundary
+	_wg.setInterpolation(interp_t::NEAREST);
+	TEST_ASSERT_EQUAL(interp_t::NEAREST, _wg.getParams().sine.interp);
+	TEST_ASSERT_EQUAL(interp_t::NEAREST, _wg.getParams().saw.interp);
+	TEST_ASSERT_TRUE(sameBlock(_wg.block(DAC_A), _linear));
+
+	_phaseNearest = _phase;
+	_ref.interp = interp_t::LINEAR;
+	_wg.render(&_ref, &_phase, _linear, GEN_BLOCK_SIZE);
+	_ref.interp = interp_t::NEAREST;
+	_wg.render(&_ref, &_phaseNearest, _nearest, GEN_BLOCK_SIZE);
+
+	_wg.renderBlock();
+	TEST_ASSERT_TRUE(sameBlock(_wg.block(DAC_A), _nearest));
+	TEST_ASSERT_FALSE(sameBlock(_wg.block(DAC_A), _linear));
+}
+
+static void test_params_are_clamped()
+{
+	WaveGen &_wg = s_wg;
+	uint16 _out[GEN_BLOCK_SIZE];
+	uint32 _phase = 0;
+
+	_wg.init();
+	oscset_t _set = _wg.getParams();
+	_set.sine.amplitude = 100.0f;		// gain far beyond int32 range of render()'s fixed point
+	_set.sine.offset = -5.0f;
+	_set.sine.frequency = 1e6f;
+	_set.saw.amplitude = -1.0f;
+	_wg.setParams(_set);
+
+	_set = _wg.getParams();
+	TEST_ASSERT_TRUE(_set.sine.amplitude == 1.0f);
+	TEST_ASSERT_TRUE(_set.sine.offset == -1.0f);
+	TEST_ASSERT_TRUE(_set.sine.frequency == MAX_FREQUENCY);
+	TEST_ASSERT_TRUE(_set.saw.amplitude == 0.0f);
+
+	_set.sine.offset = 0.0f;
+	_wg.render(&_set.sine, &_phase, _out, GEN_BLOCK_SIZE);
+	for(uint8 i = 0; i < GEN_BLOCK_SIZE; i++)
+		TEST_ASSERT_TRUE(_out[i] < SIG_PEAK);
+}
+
+/*****************************************************************************************/
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_notify_wakes_task);
+	RUN_TEST(test_sample_clock_rate);
+	RUN_TEST(test_interpolation_goes_through_params);
+	RUN_TEST(test_params_are_clamped);
+	return UNITY_END();
+}
@@ -0,0 +1,4 @@
+# Sanitizer must also be passed to the linker, build_flags go only to the compiler
+Import("env")
+
+env.Append(LINKFLAGS=["-fsanitize=thread", "-pthread"])
@@ -7,63 +7,272 @@
 
 
 #include "esp_aio.h"
-
-// #include "esp_system.h" // TODO: Watchdog functionality
+#include "channels.h"
+#include "acquire.h"
+#include "extadc.h"
+#include "calib.h"
+#include "filter.h"
+#include "local.h"
+#include "rms.h"
+#include "stats.h"
+#include "trigger.h"
+#include "backlog.h"
+#include "display.h"
+#include "relay.h"
+#include "power.h"
+#include "health.h"
 
 #include <Adafruit_ST7789.h>
 #include <Adafruit_GFX.h>
+#include <LittleFS.h>
+#include <esp_sleep.h>
+
 
+// Channel rows on the display: size 2 up to UI_BIG_ROWS channels, then size 1 in two columns
+#define UI_BIG_ROWS		4
+#define UI_SMALL_ROWS	11
 
-// Helper macro
-#define TO_VOLTS(val) ((float)(val * (3.3 / 4096)))
+#if (CH_COUNT > 2 * UI_SMALL_ROWS)
+#error "Too many channels to show on the display!"
+#endif
 
 
-// ESP's timer handler - needed for updating display independently from MQTT requests
+// ESP's timer handler - paces display task independently from MQTT requests
 hw_timer_t *Timer0_Cfg = NULL;
+TaskHandle_t ui_task = NULL;
+
+// Setup LCD on hardware SPI (VSPI routed to LCD pins)
+SPIClass lcd_spi(VSPI);
+Adafruit_ST7789 tft = Adafruit_ST7789(&lcd_spi, LCD_CS, LCD_DC, LCD_RST);
+Display ui(&tft);
+Backlight backlight(LCD_BL);		// Dimmed when nothing happens
 
-// Setup LCD
-Adafruit_ST7789 tft = Adafruit_ST7789(LCD_CS, LCD_DC, LCD_MOSI, LCD_SCLK, LCD_RST);
-GFXcanvas16 canvas(135, 240);
+// Values shown on the display - written by the main loop, read by display task
+Snapshot<ui_data_t> ui_data;
+
+// Dynamic display fields
+int8_t ui_Status;
+int8_t ui_Fault;
+int8_t ui_Rel[REL_COUNT];
+static_assert(REL_COUNT <= 4, "Only 4 relays fit on the main screen!");
+int8_t ui_Sens[CH_COUNT];
+int8_t ui_Stage[HL_STAGES];
+int8_t ui_Heap, ui_Block, ui_Rssi, ui_Mqtt, ui_Adc, ui_Uptime;
+
+// Shown page, switched by button
+uint8_t ui_page = UI_PAGE_MAIN;
 
 // Setup AIO connection object and remote variables
 ESP_AIO_Client aio(NETWORK_SSID, NETWORK_PASS, IO_USERNAME, IO_KEY);
 
-AIO_Publish *pub_SensAC = aio.makePublisher("/feeds/esp32-pwrmonitor.sens-ac");
-AIO_Publish *pub_Sens12 = aio.makePublisher("/feeds/esp32-pwrmonitor.sens-12");
-AIO_Publish *pub_Sens5 = aio.makePublisher("/feeds/esp32-pwrmonitor.sens-5");
-AIO_Publish *pub_Sens33 = aio.makePublisher("/feeds/esp32-pwrmonitor.sens-33");
-
-AIO_Subscribe *sub_RelAC = aio.makeSubscriber("/feeds/esp32-pwrmonitor.rel-ac");
-AIO_Subscribe *sub_Rel12 = aio.makeSubscriber("/feeds/esp32-pwrmonitor.rel-12");
-AIO_Subscribe *sub_Rel5 = aio.makeSubscriber("/feeds/esp32-pwrmonitor.rel-5");
-AIO_Subscribe *sub_Rel33 = aio.makeSubscriber("/feeds/esp32-pwrmonitor.rel-33");
+// All channels are sent together in one group message (feed index = channel index)
+#if (AIO_PACKED == 1 && AIO_GROUP_BATCH > 1)
+AIO_Group *grp_Sens = aio.attachPacked(AIO_PACKED_FEED, AIO_GROUP_BATCH);
+#else
+AIO_Group *grp_Sens = aio.attachGroup(AIO_GROUP);
+#endif
+// Measurements stored during outage are sent later in separate, bigger and timestamped messages
+#if (AIO_PACKED == 1)
+AIO_Group *grp_Backlog = aio.attachPacked(AIO_PACKED_FEED, AIO_PACKED_ROWS);
+#else
+AIO_Group *grp_Backlog = aio.attachGroup(AIO_GROUP, LOG_DRAIN_ROWS);
+#endif
+AIO_Publish *pub_Events = aio.makePublisher("/feeds/esp32-pwrmonitor.events");
+// Samples of captured faults - waveform of the faulted rail around the trigger
+AIO_Group *grp_Fault = aio.attachPacked(TRIG_FEED, TRIG_UPLOAD_ROWS);
+// Diagnostics - heap, RSSI, connection counters and stage timings in one message
+AIO_Group *grp_Health = aio.attachGroup(HEALTH_GROUP, 1);
+
+AIO_Subscribe *sub_Calibrate = aio.makeSubscriber("/feeds/esp32-pwrmonitor.calibrate");
+
+// Output relays - index = line of relay table, feeds are created with them by SetupRelays()
+Relays relays(&aio);
+AIO_Subscribe *sub_Rel[REL_COUNT];
+
+// Calibration - ADC transfer curve (synthetic signals are generated in mV) and per-channel corrections
+AdcCal adc_cal;
+ChannelCal chan_cal;
+
+// Continuous sampling of all ADC channels, external ones are polled from the loop
+#if (ACQ_USE_SYNTH == 1)
+SynthSource acq_src;
+SynthExtAdc ext_adc;
+ExtSampler ext_sampler(&ext_adc);
+#else
+AdcDmaSource adc_src(Channels::adcPins());
+CalSource acq_src(&adc_src, &adc_cal);		// Samples go further in calibrated mV
+#if (EXT_ADC_TYPE == 1)
+Ads1115 ext_adc(EXT_ADC_ADDR);
+ExtSampler ext_sampler(&ext_adc);
+#else
+ExtSampler ext_sampler(nullptr);
+#endif
+#endif
+Acquisition acq(&acq_src);
+TrueRMS *rms_meters[ACQ_CHANNELS] = {};		// CH_RMS channels, by scan slot
+RailStats rail_stats;
+FilterBank filters;		// Smooth readouts at decimated rate for display
+FaultTrigger fault_trig(&acq);
+Backlog backlog;
+
+// Watchdog and timing of loop, acquisition, publishing, display and MQTT
+Health health;
+health_report_t health_ui;		// The last report of debug screen window
+
+#if (LP_MODE == 1)
+// Duty cycle - records wait in RTC memory (kept over sleep and resets) until the radio is powered
+RTC_NOINIT_ATTR lp_rtc_buf_t lp_rtc_mem;
+RtcLog rtc_log(&lp_rtc_mem);
+DutyCycle duty;
+AIO_Publish *pub_Power = aio.makePublisher(LP_POWER_FEED);
+#endif
+
+// Local data plane - LAN dashboards and broker don't depend on the cloud uplink
+LocalStore local_store;
+#if (LOCAL_HTTP == 1)
+LocalHttp local_http(&local_store);
+#endif
+#if (LOCAL_MQTT == 1)
+LocalMqtt local_mqtt(LOCAL_MQTT_HOST, LOCAL_MQTT_PORT, LOCAL_MQTT_PREFIX);
+#endif
 
 // Data variables
-// Raw values from sensors
-float s_ac;
-float s_12;
-float s_5;
-float s_33;
-
-// Remote button states (default LOW)
-bool rel_ac_state = false;
-bool rel_12_state = false;
-bool rel_5_state = false;
-bool rel_33_state = false;
+// Channel values in volts, ordered as channel table
+float ch_values[CH_COUNT];
+// The same before per-channel correction (pin mV or external counts) - calibration points are taken from them
+float ch_readings[CH_COUNT];
+// Spread of values over the interval [V]
+local_stats_t ch_stats[CH_COUNT];
+
+// Description of the last detected fault (empty if none)
+char last_fault[UI_TEXT_LEN] = "";
+// Window being uploaded - copied, so the trigger captures next faults meanwhile
+capture_t fault_window;
+uint16_t fault_sent = 0;		// Samples of fault_window handed over for upload (all - nothing to upload)
 
 // Function predefs
-void onRel_AC(char *data, uint16_t len);
-void onRel_12(char *data, uint16_t len);
-void onRel_5(char *data, uint16_t len);
-void onRel_33(char *data, uint16_t len);
-
+void onRelay(char *data, uint16_t len);
+void onCalibrate(char *data, uint16_t len);
+
+void SetupDisplay();
+void DrawMainScreen(bool setup);
+void DrawHealthScreen(bool setup);
+void ShowHealth(const health_report_t *r);
+void CheckPageButton();
 void DisplayData();
+void DisplayTask(void *arg);
+void PublishUiData();
+void SetupRelays();
+void SetupChannels();
+void UpdateChannels();
+void ReportFault(const capture_t *cap);
+bool UploadFault();
+bool DrainBacklog();
+void SetupHealth();
+void ReportHealth(uint8_t window, health_report_t *r);
+void PublishHealth();
+void DutyCycleStep();
+void LightSleep(uint32_t ms);
 
 //############################################################################
-// Timer interrupt - refresh display
+// Timer interrupt - wake display task (GFX & SPI work can't be done in an interrupt)
 void IRAM_ATTR Timer0_ISR()
 {
-	DisplayData();
+	BaseType_t _woken = pdFALSE;
+
+	vTaskNotifyGiveFromISR(ui_task, &_woken);
+	if(_woken == pdTRUE)
+		portYIELD_FROM_ISR();
+}
+
+// Start of the current loop pass [us]
+uint32_t loop_start = 0;
+
+void DutyCycleStep()
+{
+#if (LP_MODE == 1)
+	lp_state_t _prev = duty.state();
+	bool _flushed = aio.hostConnected() && aio.pending() == 0 && backlog.pending() == 0 && grp_Backlog->rows() == 0;
+	lp_state_t _state = duty.tick(millis(), rtc_log.full(), _flushed);
+
+	if(_state == _prev)
+		return;
+
+	if(_prev == LP_AWAKE)
+	{
+		// End of sampling window - its summary waits in RTC memory
+		UpdateChannels();
+		time_t _now = time(nullptr);
+		uint32_t _time = (_now >= LOG_TIME_VALID) ? _now : millis() / 1000;
+		local_store.push(_time, ch_values, ch_stats);
+		rtc_log.push(_time, ch_values);
+	}
+
+	switch(_state)
+	{
+	case LP_UPLINK:
+	{
+		// Batch goes through store-and-forward log - DrainBacklog() sends it once broker is connected
+		uint32_t _time;
+		float _vals[CH_COUNT];
+		while(rtc_log.pop(&_time, _vals))
+			backlog.append(_time, _vals);
+		backlog.flush();
+
+		char _msg[AIO_QUEUE_TEXT];
+		snprintf(_msg, sizeof(_msg), "%.2f mA (awake %u s, uplink %u s, sleep %u s, %u lost)", duty.averageCurrent(),
+			(unsigned)(duty.residency(LP_AWAKE) / 1000), (unsigned)(duty.residency(LP_UPLINK) / 1000),
+			(unsigned)(duty.residency(LP_SLEEP) / 1000), (unsigned)rtc_log.lost());
+		DPRINT("[POWER] %s\n", _msg);
+		aio.enqueue(pub_Power, _msg);
+		aio.connect();
+		break;
+	}
+
+	case LP_SLEEP:
+		if(_prev == LP_UPLINK)
+		{
+			aio.disconnect();
+			WiFi.mode(WIFI_OFF);
+		}
+		LightSleep(duty.sleepTime(millis()));
+		break;
+
+	case LP_AWAKE:
+	{
+		// Window starts clean - samples taken before sleep don't count
+		stats_t _st[ACQ_CHANNELS];
+		rail_stats.snapshot(_st);
+		break;
+	}
+
+	default:
+		break;
+	}
+#endif
+}
+
+void LightSleep(uint32_t ms)
+{
+	if(ms == 0)
+		return;
+
+	// ADC DMA is stopped by acquisition task itself, LEDC doesn't run in light sleep
+	acq.suspend(true);
+	uint32_t _start = millis();
+	while(!acq.suspended() && millis() - _start < 2 * ACQ_READ_TIMEOUT)
+		delay(1);
+	backlight.off();
+	Serial.flush();
+
+	health.feed();
+	esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+	esp_light_sleep_start();
+
+	acq.suspend(false);
+	backlight.tick();
+	health.feed();
+	loop_start = micros();		// Sleep isn't loop latency
 }
 
 // ############################################################################
@@ -77,199 +286,722 @@ void setup()
 	// Timer configuration
 	Timer0_Cfg = timerBegin(0, 80, true);
 	timerAttachInterrupt(Timer0_Cfg, &Timer0_ISR, true);
-	timerAlarmWrite(Timer0_Cfg, 2000000, true);
+	timerAlarmWrite(Timer0_Cfg, UI_FRAME_MS * 1000, true);
 
 	// Setup serial connection
 	Serial.begin(9600);
 	while(!Serial);
 	Serial.println();
 
+	// Everything below is driven by channel table
+	if(!Channels::begin())
+		Serial.println("Channel table doesn't match config!");
+
 	// Initialize LCD and draw static elements
-	pinMode(LCD_BL, OUTPUT);
-	digitalWrite(LCD_BL, HIGH); // Enable LCD backlight
+	backlight.begin();
+#if (UI_PAGE_BUTTON >= 0)
+	pinMode(UI_PAGE_BUTTON, INPUT_PULLUP);
+#endif
+	lcd_spi.begin(LCD_SCLK, -1, LCD_MOSI, LCD_CS);
 	tft.init(135, 240);			// Initialize ST7789 240x135
-	tft.fillScreen(ST77XX_BLACK);
+	tft.setSPISpeed(LCD_SPI_FREQ);
+	SetupDisplay();
 	Serial.println("LCD initialized");
 
+	// All relays off before anything else happens
+	SetupRelays();
+
 	// Setup data subscription object
-	sub_RelAC->setCallback(onRel_AC);
-	sub_Rel12->setCallback(onRel_12);
-	sub_Rel5->setCallback(onRel_5);
-	sub_Rel33->setCallback(onRel_33);
+	sub_Calibrate->setCallback(onCalibrate);
+	aio.getMQTTClient()->subscribe(sub_Calibrate);
+
+	// Start sampling (ADC runs in its own task)
+	static const char *_calTypes[] = { "ideal", "nominal Vref", "eFuse Vref", "eFuse two-point" };
+	Serial.printf("ADC calibration: %s\n", _calTypes[adc_cal.begin()]);
+	SetupChannels();
+	acq.timing(health.stage(HL_ACQUIRE));
+	if(!acq.begin())
+		Serial.println("ADC acquisition failed to start!");
+	if(!ext_sampler.begin())
+		Serial.println("External ADC not found!");
+
+	// Display is refreshed by its own task, woken by the timer
+	xTaskCreatePinnedToCore(DisplayTask, "ui", UI_TASK_STACK, NULL, UI_TASK_PRIO, &ui_task, UI_CORE);
+	timerAlarmEnable(Timer0_Cfg);
+
+	// Data of outages are kept on flash and sent to the same feeds later
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		grp_Sens->addFeed(ch_table[c].feed);
+		grp_Backlog->addFeed(ch_table[c].feed);
+	}
+	grp_Fault->addFeed("volts");
+	if(!LittleFS.begin(true) || !backlog.begin(LOG_PATH))
+		Serial.println("Backlog storage unavailable!");
+	else
+		Serial.printf("Backlog: %u records waiting\n", backlog.pending());
+	if(chan_cal.load(CAL_PATH))
+		Serial.println("Channel calibration loaded");
+
+	// Watchdog is armed after the slow parts of setup (flash formatting), the last reset is reported
+	SetupHealth();
+	if(!health.begin())
+		Serial.println("Task watchdog unavailable!");
+	char _msg[64];
+	snprintf(_msg, sizeof(_msg), "Boot after %s reset", health.resetReason());
+	Serial.println(_msg);
+	aio.enqueue(pub_Events, _msg, false);
+
+#if (LP_MODE == 1)
+	// Radio is powered by the duty cycle only for uplinks
+	if(rtc_log.begin())
+		Serial.printf("RTC memory: %u records waiting\n", rtc_log.count());
+	duty.begin(millis());
+#else
+	// Connect to Adafruit IO - runs in background (aio.poll()), measurement goes on during outages
+	aio.connect();
+#endif
+}
 
-	aio.getMQTTClient()->subscribe(sub_RelAC);
-	aio.getMQTTClient()->subscribe(sub_Rel12);
-	aio.getMQTTClient()->subscribe(sub_Rel5);
-	aio.getMQTTClient()->subscribe(sub_Rel33);
+// Time of the last measurement summary
+uint32_t last_publish = 0;
+// Times of the last diagnostics message and debug screen update
+uint32_t last_health = 0;
+uint32_t last_health_ui = 0;
 
-	// TODO: Fix crashing error after enabling the timer
-	// Enable timer
-	// timerAlarmEnable(Timer0_Cfg);
+void loop() 
+{
+	loop_start = micros();
+	health.feed();
 
-	// Connect to Adafruit IO
-	aio.connect();
+	// Upload captured faults - every one is a separate event, they wait in the trigger while upload queue is full
+	const capture_t *_cap;
+	while((_cap = fault_trig.peek()) != nullptr && aio.pending() < AIO_QUEUE_SLOTS)
+	{
+		ReportFault(_cap);
+		fault_trig.release();
+	}
 
-	Serial.println();
-	Serial.println(aio.statusString());
+#if (LP_MODE == 1)
+	// Sampling windows, sleep and uplinks
+	DutyCycleStep();
+#else
+	if(millis() - last_publish >= PUBLISH_INTERVAL)
+	{
+		last_publish = millis();
+		uint32_t _start = micros();
+
+		UpdateChannels();
+
+		// RTC keeps time after NTP sync, otherwise time since boot is used
+		time_t _now = time(nullptr);
+		uint32_t _time = (_now >= LOG_TIME_VALID) ? _now : millis() / 1000;
+
+		local_store.push(_time, ch_values, ch_stats);
+#if (LOCAL_MQTT == 1)
+		local_mqtt.publish(ch_values);
+#endif
+
+		if(aio.hostConnected())
+		{
+			// Queue data for AIO - one message for all channels, sent as soon as rate limit allows
+			for(uint8_t c = 0; c < CH_COUNT; c++)
+				grp_Sens->set(c, ch_values[c], ch_table[c].decimals);
+
+			// Batched rows need their own timestamps (valid only after NTP sync)
+			if(grp_Sens->commit((AIO_GROUP_BATCH > 1 && _now >= LOG_TIME_VALID) ? _now : 0))
+				aio.enqueue(grp_Sens);
+		}
+		else
+		{
+			// No broker - keep measurement for later
+			backlog.append(_time, ch_values);
+		}
+		health.record(HL_PUBLISH, micros() - _start);
+	}
+#endif
+
+	uint32_t _start = micros();
+	// Fault waveform goes before stored measurements
+	if(UploadFault() || DrainBacklog())
+		health.record(HL_BACKLOG, micros() - _start);
+
+	// Debug screen gets its own, shorter window than diagnostics feed
+	if(millis() - last_health_ui >= HEALTH_UI_INTERVAL)
+	{
+		last_health_ui = millis();
+		ReportHealth(HL_WINDOW_UI, &health_ui);
+	}
+	if(aio.hostConnected() && millis() - last_health >= HEALTH_INTERVAL)
+	{
+		last_health = millis();
+		PublishHealth();
+	}
+
+	CheckPageButton();
+	PublishUiData();
+	backlight.tick();
+
+	// One external conversion per pass - collected result, next one started
+	ext_sampler.poll(millis());
+
+#if (LOCAL_HTTP == 1)
+	// Answers LAN requests straight from RAM, doesn't touch the uplink
+	local_http.poll();
+#endif
+#if (LOCAL_MQTT == 1)
+	// Connection to the local broker is made step by step, none of them waits longer than LOCAL_MQTT_CONNECT_MS
+	local_mqtt.poll();
+#endif
+
+	// Keep connection up (reconnects after drops), read incoming packets and send queued data.
+	// Never blocks longer than AIO_POLL_TIMEOUT (except TLS handshake and keepalive ping of a connection idle
+	// for 3/4 of keepalive - not while publishing), so relay commands are handled within tens of ms
+	_start = micros();
+	aio.poll();
+	health.record(HL_MQTT, micros() - _start);
+
+	health.record(HL_LOOP, micros() - loop_start);
 }
 
-uint16_t _lastTime = 0;
-uint16_t _endTime = 0;
+// ############################################################################
+void onRelay(char *data, uint16_t len)
+{
+	// Command feeds share the callback - library passes the buffer of the subscription which got the message
+	for(uint8_t r = 0; r < REL_COUNT; r++)
+	{
+		if(sub_Rel[r] && data == (char *)sub_Rel[r]->lastread)
+		{
+			relays.handle(r, data, len, aio.rxTime());
+			backlight.touch();
+			return;
+		}
+	}
+}
 
-void loop() 
+void SetupRelays()
 {
-	// uint16_t _time = millis();
-
-	// Generate test values with some random numbers
-	s_ac = random(230);
-	s_12 = random(0, 130) / 10.0;
-	s_5 = random(0, 60) / 10.0;
-	s_33 = random(0, 35) / 10.0;
-
-	// Send data to AIO
-	pub_SensAC->publish(s_ac);
-	pub_Sens12->publish(s_12);
-	pub_Sens5->publish(s_5);
-	pub_Sens33->publish(s_33);
-
-	// TODO: Auto-reset board after connection lost
-	// if(!aio.netConnected())
-	// {
-	// 	_endTime = millis();
-	// 	uint16_t _elapsed = _endTime - _lastTime;
-	// 	Serial.println(_elapsed);
-	// 	if (_elapsed >= 3000) // ~3s
-	// 		esp_restart();
-	// }
-
-	// Update display
-	DisplayData();
-
-	// Read incoming packets
-	aio.getMQTTClient()->processPackets(1000);
-
-	// Adafruit IO has minimum feed rate limit for publishing data
-	// so some delay is required
-	delay(THROTTLE_DELAY);
+	// Relay states are acknowledged on separate feeds (publishing to command feeds would echo back)
+	for(uint8_t r = 0; r < REL_COUNT; r++)
+	{
+		relays.add(rel_table[r].pin, aio.makePublisher(rel_table[r].stateFeed));
+		sub_Rel[r] = aio.makeSubscriber(rel_table[r].cmdFeed);
+		if(!sub_Rel[r])
+			continue;
+		sub_Rel[r]->setCallback(onRelay);
+		aio.getMQTTClient()->subscribe(sub_Rel[r]);
+	}
+	relays.begin();
 }
 
-// ############################################################################
-void onRel_AC(char *data, uint16_t len)
+void SetupChannels()
 {
-	if (rel_ac_state == false)
-		rel_ac_state = true;
-	else
-		rel_ac_state = false;
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		const channel_t *_ch = &ch_table[c];
+		int8_t _slot = Channels::slot(c);
+		if(_slot < 0)
+			continue;
+
+		// External channels are only averaged (slots are taken in table order, same as here)
+		if(_ch->source == CH_SRC_EXT)
+		{
+			ext_sampler.add(_ch->input);
+#if (ACQ_USE_SYNTH == 1)
+			ext_adc.setInput(_ch->input, 16000, 40);
+#endif
+			continue;
+		}
+
+#if (ACQ_USE_SYNTH == 1)
+		// Synthetic rails sit in the middle of their trigger window
+		if(_ch->mode == CH_RMS)
+			acq_src.setChannel(_slot, 1650, 1200, 50, 16);
+		else
+			acq_src.setChannel(_slot, _ch->trig[1] ? (_ch->trig[0] + _ch->trig[1]) / 2 : 1650, 0, 0, 8);
+#endif
+		// RMS is computed in mV, channel correction is applied to the result
+		if(_ch->mode == CH_RMS)
+		{
+			rms_meters[_slot] = new TrueRMS(_slot, 1.0f);
+			acq.attach(rms_meters[_slot]);
+		}
+		fault_trig.configure(_slot, _ch->trig[0], _ch->trig[1], _ch->trig[2]);
+	}
+	acq.attach(&rail_stats);
+	acq.attach(&fault_trig);
+	if(filters.begin())
+		acq.attach(&filters);
 }
 
-void onRel_12(char *data, uint16_t len)
+void UpdateChannels()
 {
-	if (rel_12_state == false)
-		rel_12_state = true;
-	else
-		rel_12_state = false;
+	// Summarize everything sampled since the previous publish
+	stats_t _st[ACQ_CHANNELS];
+	float _ext[EXT_MAX_CHANNELS];
+	rail_stats.snapshot(_st);
+	ext_sampler.snapshot(_ext);
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		const channel_t *_ch = &ch_table[c];
+		int8_t _slot = Channels::slot(c);
+		rms_result_t _rms;
+
+		if(_slot < 0)
+			continue;
+
+		if(_ch->source == CH_SRC_EXT)
+			ch_readings[c] = _ext[_slot];
+		else if(_ch->mode == CH_RMS)
+		{
+			// AC rail is reported as true RMS of the last mains cycle
+			if(rms_meters[_slot] && rms_meters[_slot]->result(&_rms))
+			{
+				ch_readings[c] = _rms.rms;
+				DPRINT("[%s] %.1f V RMS, %.2f Hz, peak %.1f V, crest %.2f\n", _ch->name, chan_cal.volts(c, _rms.rms), _rms.freq,
+					_rms.peak * chan_cal.gain(c), _rms.crest);
+			}
+		}
+		else if(_st[_slot].count > 0)
+			ch_readings[c] = _st[_slot].mean;
+		ch_values[c] = chan_cal.volts(c, ch_readings[c]);
+		ch_stats[c].min = ch_stats[c].max = ch_values[c];
+		ch_stats[c].stddev = 0;
+
+		if(_ch->source == CH_SRC_ADC && _ch->mode == CH_MEAN && _st[_slot].count > 0)
+		{
+			ch_stats[c].min = chan_cal.volts(c, _st[_slot].min);
+			ch_stats[c].max = chan_cal.volts(c, _st[_slot].max);
+			ch_stats[c].stddev = _st[_slot].stddev * chan_cal.gain(c);
+			DPRINT("[%s] n=%u mean=%.3f V sd=%.3f V min=%.3f V max=%.3f V\n", _ch->name, _st[_slot].count, ch_values[c],
+				ch_stats[c].stddev, ch_stats[c].min, ch_stats[c].max);
+		}
+	}
 }
 
-void onRel_5(char *data, uint16_t len)
+void onCalibrate(char *data, uint16_t len)
 {
-	if (rel_5_state == false)
-		rel_5_state = true;
-	else
-		rel_5_state = false;
+	// "<channel name> <actual volts>", taken from the last published reading
+	char _cmd[32];
+	snprintf(_cmd, sizeof(_cmd), "%.*s", (int)len, data);
+
+	char *_sep = strrchr(_cmd, ' ');
+	if(!_sep)
+		return;
+	*_sep = '\0';
+	float _volts = atof(_sep + 1);
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		if(strcasecmp(_cmd, ch_table[c].name) != 0)
+			continue;
+
+		char _msg[64];
+		if(chan_cal.point(c, ch_readings[c], _volts) && chan_cal.save(CAL_PATH))
+			snprintf(_msg, sizeof(_msg), "%s calibrated: %.2fV -> %.3fV", ch_table[c].name, ch_values[c], chan_cal.volts(c, ch_readings[c]));
+		else
+			snprintf(_msg, sizeof(_msg), "%s calibration failed", ch_table[c].name);
+		ch_values[c] = chan_cal.volts(c, ch_readings[c]);
+
+		DPRINT("[CAL] %s\n", _msg);
+		aio.enqueue(pub_Events, _msg, false);
+		backlight.touch();
+		return;
+	}
 }
 
-void onRel_33(char *data, uint16_t len)
+void ReportFault(const capture_t *cap)
 {
-	if (rel_33_state == false)
-		rel_33_state = true;
-	else
-		rel_33_state = false;
+	static const char *_causes[] = { "under", "over", "step" };
+
+	int8_t _c = Channels::fromSlot(CH_SRC_ADC, cap->channel);
+	if(_c < 0)
+		return;
+	const channel_t *_ch = &ch_table[_c];
+
+	// Min & max of the captured window show the depth of a dip / height of a spike
+	uint16_t _min = 0xffff, _max = 0;
+	for(uint16_t i = 0; i < cap->count; i++)
+	{
+		uint16_t _v = cap->scans[i].ch[cap->channel];
+		if(_v < _min)
+			_min = _v;
+		if(_v > _max)
+			_max = _v;
+	}
+
+	// Waveform goes after the summary, unless the previous one is still being sent
+	bool _upload = (fault_sent >= fault_window.count);
+	if(_upload)
+	{
+		memcpy(&fault_window, cap, offsetof(capture_t, scans) + cap->count * sizeof(acq_scan_t));
+		fault_sent = (cap->seq < TRIG_PRE) ? TRIG_PRE - cap->seq : 0;		// Padding before the first sample isn't sent
+	}
+
+	char _msg[AIO_QUEUE_TEXT];
+	snprintf(_msg, sizeof(_msg), "%s %s %.2fV (min %.2fV, max %.2fV) @%.3fs #%u%s", _ch->name, _causes[cap->cause],
+		chan_cal.volts(_c, cap->value), chan_cal.volts(_c, _min), chan_cal.volts(_c, _max), (float)cap->seq / ACQ_SAMPLE_RATE,
+		(unsigned)cap->seq, _upload ? "" : " (no window)");
+	snprintf(last_fault, sizeof(last_fault), "%s %s %.2fV", _ch->name, _causes[cap->cause], chan_cal.volts(_c, cap->value));
+
+	DPRINT("[FAULT] %s\n", _msg);
+	aio.enqueue(pub_Events, _msg, false);
+	backlight.touch();
 }
 
-void DisplayData()
+bool UploadFault()
 {
-	canvas.fillScreen(ST77XX_BLACK);
-	canvas.setCursor(0, 7);
-	canvas.setTextColor(ST77XX_WHITE);
-	canvas.setTextSize(1);
-	canvas.print("Status:");
-	canvas.setCursor(50, 7);
-	canvas.setTextColor(ST77XX_CYAN);
-	if (aio.hostConnected())
+	// Window is sent in pieces the same way as backlog - the next one is loaded after the previous went out
+	if(!aio.hostConnected())
+		return false;
+	if(grp_Fault->rows() > 0)
 	{
-		canvas.setTextColor(ST77XX_GREEN);
-		canvas.print("Connected");
+		// Queue was full when the piece was loaded - it gets the next free slot, so the window doesn't stall
+		if(!aio.queued(grp_Fault))
+			aio.enqueue(grp_Fault);
+		return false;
 	}
-	else
+	if(fault_sent >= fault_window.count)
+		return false;
+
+	int8_t _c = Channels::fromSlot(CH_SRC_ADC, fault_window.channel);
+	uint32_t _first = fault_window.seq - TRIG_PRE;		// Sample number of scans[0]
+	bool _full = false;
+
+	// One more decimal than published - steps of a transient are smaller than the rail's resolution
+	while(!_full && fault_sent < fault_window.count)
+	{
+		uint16_t _v = fault_window.scans[fault_sent].ch[fault_window.channel];
+		grp_Fault->set(0, chan_cal.volts(_c, _v), ch_table[_c].decimals + 1);
+		_full = grp_Fault->commit(_first + fault_sent);
+		fault_sent++;
+	}
+
+	if(!aio.enqueue(grp_Fault))
+		DPRINT("[FAULT] Queue full, window piece waits for a slot\n");
+	DPRINT("[FAULT] Window: %u of %u samples queued\n", fault_sent, fault_window.count);
+	return true;
+}
+
+bool DrainBacklog()
+{
+	// Next rows are loaded after the previous message went out, live data shares the rate limit with them
+	if(!aio.hostConnected())
+		return false;
+	if(grp_Backlog->rows() > 0)
+	{
+		// Queue was full when they were loaded (events of an outage) - they wait for a free slot
+		if(!aio.queued(grp_Backlog))
+			aio.enqueue(grp_Backlog);
+		return false;
+	}
+
+	// Group keeps rows until the broker took them - everything loaded before is sent, only now it leaves flash
+	backlog.commit();
+
+	time_t _now = time(nullptr);
+	uint32_t _boot = (_now >= LOG_TIME_VALID) ? _now - millis() / 1000 : 0;
+	uint32_t _time;
+	float _vals[CH_COUNT];
+	bool _full = false;
+
+	while(!_full && backlog.peek(&_time, _vals, _boot))
+	{
+		for(uint8_t c = 0; c < CH_COUNT; c++)
+			grp_Backlog->set(c, _vals[c], ch_table[c].decimals);
+		_full = grp_Backlog->commit(_time);
+	}
+
+	if(grp_Backlog->rows() == 0)
+		return false;
+
+	if(!aio.enqueue(grp_Backlog))
+		DPRINT("[BACKLOG] Queue full, rows wait for a slot\n");
+	DPRINT("[BACKLOG] %u records left, %u lost\n", backlog.pending(), backlog.lost());
+	return true;
+}
+
+void SetupHealth()
+{
+	// Feed keys of stage timings are made of stage names ("loop-p99", "loop-max"...)
+	static const char *_sysKeys[] = { "heap", "heap-min", "heap-block", "rssi", "reconnects", "pings", "overruns", "uptime" };
+	static char _stageKeys[HL_STAGES][2][16];
+
+	for(uint8_t i = 0; i < sizeof(_sysKeys) / sizeof(_sysKeys[0]); i++)
+		grp_Health->addFeed(_sysKeys[i]);
+	for(uint8_t s = 0; s < HL_STAGES; s++)
+	{
+		snprintf(_stageKeys[s][0], sizeof(_stageKeys[s][0]), "%s-p99", Health::stageName((hl_stage_t)s));
+		snprintf(_stageKeys[s][1], sizeof(_stageKeys[s][1]), "%s-max", Health::stageName((hl_stage_t)s));
+		grp_Health->addFeed(_stageKeys[s][0]);
+		grp_Health->addFeed(_stageKeys[s][1]);
+	}
+}
+
+void ReportHealth(uint8_t window, health_report_t *r)
+{
+	health.report(window, r);
+	r->reconnects = aio.reconnects();
+	r->pings = aio.pings();
+	r->overruns = acq.overruns();
+}
+
+void PublishHealth()
+{
+	health_report_t _r;
+	ReportHealth(HL_WINDOW_FEED, &_r);
+
+	// Feed order as in SetupHealth(), timings in ms
+	uint8_t _f = 0;
+	grp_Health->set(_f++, _r.heapFree, 0);
+	grp_Health->set(_f++, _r.heapMin, 0);
+	grp_Health->set(_f++, _r.heapBlock, 0);
+	grp_Health->set(_f++, _r.rssi, 0);
+	grp_Health->set(_f++, _r.reconnects, 0);
+	grp_Health->set(_f++, _r.pings, 0);
+	grp_Health->set(_f++, _r.overruns, 0);
+	grp_Health->set(_f++, _r.uptime, 0);
+	for(uint8_t s = 0; s < HL_STAGES; s++)
 	{
-		canvas.setTextColor(ST77XX_CYAN);
-		canvas.print("Not connected");
+		grp_Health->set(_f++, _r.stage[s].p99 / 1000.0f, 2);
+		grp_Health->set(_f++, _r.stage[s].max / 1000.0f, 2);
+		DPRINT("[HEALTH] %s: n=%u p50=%.2f p99=%.2f max=%.2f ms\n", Health::stageName((hl_stage_t)s), _r.stage[s].count,
+			_r.stage[s].p50 / 1000.0f, _r.stage[s].p99 / 1000.0f, _r.stage[s].max / 1000.0f);
 	}
+	DPRINT("[HEALTH] heap %u (min %u, block %u), RSSI %d, %u reconnects\n", _r.heapFree, _r.heapMin, _r.heapBlock, _r.rssi,
+		_r.reconnects);
+
+	if(grp_Health->commit())
+		aio.enqueue(grp_Health);
+}
+
+void CheckPageButton()
+{
+#if (UI_PAGE_BUTTON >= 0)
+	static bool _pressed = false;
+	static uint32_t _changed = 0;
+
+	// Level has to hold for a while to count (contact bounce)
+	bool _down = digitalRead(UI_PAGE_BUTTON) == LOW;
+	if(_down == _pressed || millis() - _changed < 50)
+		return;
+
+	_pressed = _down;
+	_changed = millis();
+	if(_down)
+	{
+		ui_page = (ui_page == UI_PAGE_MAIN) ? UI_PAGE_HEALTH : UI_PAGE_MAIN;
+		backlight.touch();
+	}
+#endif
+}
+
+void SetupDisplay()
+{
+	// Fields of both pages are created once, the debug one is drawn only when switched to
+	DrawHealthScreen(true);
+	DrawMainScreen(true);
+}
+
+void DrawMainScreen(bool setup)
+{
+	tft.fillScreen(ST77XX_BLACK);
+	tft.setCursor(0, 7);
+	tft.setTextColor(ST77XX_WHITE);
+	tft.setTextSize(1);
+	tft.print("Status:");
 
 	// Relays info
-	canvas.drawLine(0, 25, tft.width(), 25, ST77XX_ORANGE);
-	canvas.setTextColor(ST77XX_YELLOW);
-	canvas.setCursor(tft.width() / 2 - 35, 30);
-	canvas.setTextSize(2);
-	canvas.print("Relays");
-
-	if (!rel_ac_state)
-		canvas.setTextColor(ST77XX_RED);
-	else
-		canvas.setTextColor(ST77XX_GREEN);
-	canvas.setCursor(20, 55);
-	canvas.print("AC");
+	tft.drawLine(0, 25, tft.width(), 25, ST77XX_ORANGE);
+	tft.setTextColor(ST77XX_YELLOW);
+	tft.setCursor(tft.width() / 2 - 35, 30);
+	tft.setTextSize(2);
+	tft.print("Relays");
 
-	if (!rel_12_state)
-		canvas.setTextColor(ST77XX_RED);
-	else
-		canvas.setTextColor(ST77XX_GREEN);
-	canvas.setCursor(tft.width() - 60, 55);
-	canvas.print("12V");
+	// Sens info
+	tft.drawLine(0, 105, tft.width(), 105, ST77XX_ORANGE);
+	tft.setCursor(tft.width() / 2 - 25, 110);
+	tft.print("Sens");
+
+	// Channel labels - big rows for a few channels, small ones in two columns for more
+	tft.setTextColor(ST77XX_ORANGE);
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		int16_t _x = 5, _y = 140 + c * 25, _w = tft.width() - 70;
+		uint8_t _size = 2;
+
+		if(CH_COUNT > UI_BIG_ROWS)
+		{
+			_x = (c / UI_SMALL_ROWS) * (tft.width() / 2) + 2;
+			_y = 132 + (c % UI_SMALL_ROWS) * 10;
+			_w = tft.width() / 2 - 32;
+			_size = 1;
+		}
+
+		tft.setTextSize(_size);
+		tft.setCursor(_x, _y);
+		tft.print(ch_table[c].name);
+		tft.print(":");
+		if(setup)
+			ui_Sens[c] = ui.addField(_size == 2 ? 70 : _x + 30, _y, _w, _size);
+	}
+
+	if(!setup)
+		return;
+
+	// Only these parts are ever redrawn
+	ui_Status = ui.addField(50, 7, tft.width() - 50, 1);
+	ui_Fault = ui.addField(0, 16, tft.width(), 1);
+	// Relays in two columns, the right one aligned to the right
+	for(uint8_t r = 0; r < REL_COUNT; r++)
+	{
+		int16_t _w = strlen(rel_table[r].name) * UI_CHAR_W * 2;
+		ui_Rel[r] = ui.addField((r % 2) ? tft.width() - 20 - _w : 20, 55 + (r / 2) * 30, _w, 2);
+	}
+}
+
+void DrawHealthScreen(bool setup)
+{
+	static const char *_sysLabels[] = { "Heap", "Block", "RSSI", "MQTT", "ADC", "Up" };
+	int8_t *_sysFields[] = { &ui_Heap, &ui_Block, &ui_Rssi, &ui_Mqtt, &ui_Adc, &ui_Uptime };
+
+	tft.fillScreen(ST77XX_BLACK);
+	tft.setTextColor(ST77XX_YELLOW);
+	tft.setTextSize(2);
+	tft.setCursor(tft.width() / 2 - 35, 5);
+	tft.print("Health");
+	tft.drawLine(0, 25, tft.width(), 25, ST77XX_ORANGE);
+
+	// Stage timings - columns match "%5.2f%6.2f%6.1f" of the fields
+	tft.setTextSize(1);
+	tft.setTextColor(ST77XX_ORANGE);
+	tft.setCursor(2, 30);
+	tft.print("ms");
+	tft.setCursor(30, 30);
+	tft.print("  p50   p99   max");
+	for(uint8_t s = 0; s < HL_STAGES; s++)
+	{
+		tft.setCursor(2, 42 + s * 10);
+		tft.printf("%.4s", Health::stageName((hl_stage_t)s));
+		if(setup)
+			ui_Stage[s] = ui.addField(30, 42 + s * 10, tft.width() - 30, 1, ST77XX_BLACK, UI_PAGE_HEALTH);
+	}
+
+	// System counters
+	tft.drawLine(0, 104, tft.width(), 104, ST77XX_ORANGE);
+	for(uint8_t i = 0; i < sizeof(_sysLabels) / sizeof(_sysLabels[0]); i++)
+	{
+		tft.setCursor(2, 110 + i * 12);
+		tft.print(_sysLabels[i]);
+		if(setup)
+			*_sysFields[i] = ui.addField(40, 110 + i * 12, tft.width() - 40, 1, ST77XX_BLACK, UI_PAGE_HEALTH);
+	}
+
+	// Doesn't change until the next boot
+	tft.setCursor(2, 110 + 6 * 12 + 6);
+	tft.print("Reset: ");
+	tft.print(health.resetReason());
+}
+
+void ShowHealth(const health_report_t *r)
+{
+	char _buf[UI_TEXT_LEN];
+
+	for(uint8_t s = 0; s < HL_STAGES; s++)
+	{
+		const hl_stats_t *_st = &r->stage[s];
+		if(_st->count == 0)
+			strlcpy(_buf, "    -", sizeof(_buf));
+		else
+			snprintf(_buf, sizeof(_buf), "%5.2f%6.2f%6.1f", _st->p50 / 1000.0f, _st->p99 / 1000.0f, _st->max / 1000.0f);
+		ui.setText(ui_Stage[s], _buf, ST77XX_CYAN);
+	}
 
-	if (!rel_5_state)
-		canvas.setTextColor(ST77XX_RED);
+	snprintf(_buf, sizeof(_buf), "%u kB, min %u", r->heapFree / 1024, r->heapMin / 1024);
+	ui.setText(ui_Heap, _buf, ST77XX_CYAN);
+	snprintf(_buf, sizeof(_buf), "%u kB", r->heapBlock / 1024);
+	ui.setText(ui_Block, _buf, ST77XX_CYAN);
+	if(r->rssi)
+		snprintf(_buf, sizeof(_buf), "%d dBm", r->rssi);
 	else
-		canvas.setTextColor(ST77XX_GREEN);
-	canvas.setCursor(20, 85);
-	canvas.print("5V");
+		strlcpy(_buf, "off", sizeof(_buf));
+	ui.setText(ui_Rssi, _buf, ST77XX_CYAN);
+	snprintf(_buf, sizeof(_buf), "%u rec, %u ping", r->reconnects, r->pings);
+	ui.setText(ui_Mqtt, _buf, ST77XX_CYAN);
+	snprintf(_buf, sizeof(_buf), "%u overruns", r->overruns);
+	ui.setText(ui_Adc, _buf, r->overruns ? ST77XX_RED : ST77XX_CYAN);
+	snprintf(_buf, sizeof(_buf), "%ud %02u:%02u:%02u", r->uptime / 86400, (r->uptime / 3600) % 24, (r->uptime / 60) % 60,
+		r->uptime % 60);
+	ui.setText(ui_Uptime, _buf, ST77XX_CYAN);
+}
+
+void PublishUiData()
+{
+	ui_data_t _d;
+
+	// Filtered channels are shown as they go, the rest once per publish interval
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		float _mv;
+		_d.sens[c] = filters.latest(c, &_mv) ? chan_cal.volts(c, _mv) : ch_values[c];
+	}
+	_d.relays = 0;
+	for(uint8_t r = 0; r < REL_COUNT; r++)
+		_d.relays |= relays.state(r) << r;
+	_d.connected = aio.hostConnected();
+	strlcpy(_d.fault, last_fault, sizeof(_d.fault));
+	_d.page = ui_page;
+	_d.health = health_ui;
+
+	ui_data.publish(_d);
+}
+
+void DisplayTask(void *arg)
+{
+	// Frame is due every UI_FRAME_MS - hung SPI or GFX ends in watchdog reset
+	health.watch();
+	for(;;)
+	{
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		uint32_t _start = micros();
+		DisplayData();
+		health.record(HL_DISPLAY, micros() - _start);
+		health.feed();
+	}
+}
+
+void DisplayData()
+{
+	ui_data_t _d;
+	if(!ui_data.read(&_d))
+		return;
 
-	if (!rel_33_state)
-		canvas.setTextColor(ST77XX_RED);
+	// Static elements of the other page are drawn over the whole screen
+	if(_d.page != ui.page())
+	{
+		if(_d.page == UI_PAGE_HEALTH)
+			DrawHealthScreen(false);
+		else
+			DrawMainScreen(false);
+		ui.setPage(_d.page);
+	}
+	ShowHealth(&_d.health);
+
+	if (_d.connected)
+		ui.setText(ui_Status, "Connected", ST77XX_GREEN);
 	else
-		canvas.setTextColor(ST77XX_GREEN);
-	canvas.setCursor(tft.width() - 65, 85);
-	canvas.print("3.3V");
+		ui.setText(ui_Status, "Not connected", ST77XX_CYAN);
+	ui.setText(ui_Fault, _d.fault, ST77XX_RED);
 
-	// Sens info
-	canvas.drawLine(0, 105, tft.width(), 105, ST77XX_ORANGE);
-	canvas.setTextColor(ST77XX_YELLOW);
-	canvas.setCursor(tft.width() / 2 - 25, 110);
-	canvas.setTextSize(2);
-	canvas.print("Sens");
-	canvas.setTextColor(ST77XX_ORANGE);
-	canvas.setCursor(5, 140);
-	canvas.print("AC:");
-	canvas.setCursor(5, 165);
-	canvas.print("12V:");
-	canvas.setCursor(5, 190);
-	canvas.print("5V:");
-	canvas.setCursor(5, 215);
-	canvas.print("3.3V:");
-
-	canvas.setTextColor(ST77XX_CYAN);
-	canvas.setCursor(70, 140);
-	canvas.print(s_ac, 0);
-	canvas.print("V");
-	canvas.setCursor(70, 164);
-	canvas.print(s_12, 1);
-	canvas.print("V");
-	canvas.setCursor(70, 190);
-	canvas.print(s_5, 1);
-	canvas.print("V");
-	canvas.setCursor(70, 215);
-	canvas.print(s_33, 1);
-	canvas.print("V");
-
-	tft.drawRGBBitmap(0, 0, canvas.getBuffer(), canvas.width(), canvas.height());
+	// Relays info
+	for(uint8_t r = 0; r < REL_COUNT; r++)
+		ui.setText(ui_Rel[r], rel_table[r].name, (_d.relays & (1 << r)) ? ST77XX_GREEN : ST77XX_RED);
+
+	// Sens info - shown with one decimal less than published
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		ui.setValue(ui_Sens[c], _d.sens[c], ch_table[c].decimals ? ch_table[c].decimals - 1 : 0, "V", ST77XX_CYAN);
+
+	// Only changed fields are sent to LCD
+	ui.refresh();
 }
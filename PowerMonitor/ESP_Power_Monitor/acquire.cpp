@@ -0,0 +1,422 @@
+#include "acquire.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include "Arduino.h"
+#include "driver/adc.h"
+#else
+#include <chrono>
+#endif
+
+
+static uint32_t _micros()
+{
+#if defined(ARDUINO)
+	return micros();
+#else
+	using namespace std::chrono;
+	return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+#if defined(ARDUINO)
+// ############################################################################
+/*!
+	@brief	Creates ADC DMA source.
+	@param	*pins
+			Array of ACQ_CHANNELS GPIO numbers. All of them must be ADC1 pins (ADC2 is unusable with WiFi).
+			It's read in begin(), so it may be filled after construction (e.g. from channel registry).
+*/
+AdcDmaSource::AdcDmaSource(const uint8_t* pins)
+{
+	m_pins = pins;
+	memset(m_channels, 0, sizeof(m_channels));
+	m_filled = 0;
+}
+
+/*!
+	@brief	Configures ADC1 pattern table for all channels and starts continuous conversion.
+	@param	rate
+			Scan rate - every channel is sampled rate times per second.
+	@returns True if ADC driver was started.
+*/
+bool AdcDmaSource::begin(uint32_t rate)
+{
+	for(uint8_t i = 0; i < ACQ_CHANNELS; i++)
+	{
+		int8_t _ch = digitalPinToAnalogChannel(m_pins[i]);
+		if(_ch < 0 || _ch >= 8)		// not an ADC1 pin
+			return false;
+		m_channels[i] = _ch;
+	}
+
+	adc_digi_init_config_t _init = {};
+	_init.max_store_buf_size = sizeof(m_raw) * 4;
+	_init.conv_num_each_intr = sizeof(m_raw);
+	for(uint8_t i = 0; i < ACQ_CHANNELS; i++)
+		_init.adc1_chan_mask |= (1 << m_channels[i]);
+
+	if(adc_digi_initialize(&_init) != ESP_OK)
+		return false;
+
+	adc_digi_pattern_config_t _pattern[ACQ_CHANNELS] = {};
+	for(uint8_t i = 0; i < ACQ_CHANNELS; i++)
+	{
+		_pattern[i].atten = ADC_ATTEN_DB_11;	// full 0 - 3.3V range
+		_pattern[i].channel = m_channels[i];
+		_pattern[i].unit = 0;					// ADC1
+		_pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+	}
+
+	adc_digi_configuration_t _cfg = {};
+	_cfg.conv_limit_en = 1;			// required on ESP32
+	_cfg.conv_limit_num = 250;
+	_cfg.pattern_num = ACQ_CHANNELS;
+	_cfg.adc_pattern = _pattern;
+	_cfg.sample_freq_hz = rate * ACQ_CHANNELS;	// conversions per second
+	_cfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+	_cfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+
+	if(adc_digi_controller_configure(&_cfg) != ESP_OK)
+		return false;
+
+	return adc_digi_start() == ESP_OK;
+}
+
+/*!
+	@brief	Stops DMA conversions for sleep, restarts them after it.
+*/
+void AdcDmaSource::pause(bool paused)
+{
+	if(paused)
+		adc_digi_stop();
+	else
+	{
+		m_filled = 0;			// Scan interrupted by the stop is incomplete
+		adc_digi_start();
+	}
+}
+
+/*!
+	@brief	Reads DMA results and assembles them into scans.
+			Every result carries its channel number, so scans stay aligned even if a result is dropped.
+	@returns Number of complete scans written to dst.
+*/
+size_t AdcDmaSource::read(acq_scan_t* dst, size_t max, uint32_t timeout_ms)
+{
+	uint32_t _len = 0;
+	size_t _scans = 0;
+	uint32_t _want = max * ACQ_CHANNELS * SOC_ADC_DIGI_RESULT_BYTES;
+
+	if(_want > sizeof(m_raw))
+		_want = sizeof(m_raw);
+
+	if(adc_digi_read_bytes(m_raw, _want, &_len, timeout_ms) != ESP_OK)
+		return 0;
+
+	for(uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= _len; i += SOC_ADC_DIGI_RESULT_BYTES)
+	{
+		const adc_digi_output_data_t* _res = (const adc_digi_output_data_t*)&m_raw[i];
+
+		for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+		{
+			if(_res->type1.channel != m_channels[c])
+				continue;
+
+			// Channel seen twice - previous scan lost a result, start over
+			if(m_filled & (1 << c))
+				m_filled = 0;
+			m_partial.ch[c] = _res->type1.data;
+			m_filled |= (1 << c);
+			break;
+		}
+
+		if(m_filled == (1 << ACQ_CHANNELS) - 1)
+		{
+			dst[_scans++] = m_partial;
+			m_filled = 0;
+			if(_scans >= max)
+				break;
+		}
+	}
+	return _scans;
+}
+#endif
+
+// ############################################################################
+/*!
+	@brief	Creates synthetic source with all channels set to 0.
+*/
+SynthSource::SynthSource()
+{
+	memset(m_ch, 0, sizeof(m_ch));
+	m_rate = 1;
+	m_n = 0;
+	m_seed = 0x12345678;
+}
+
+/*!
+	@brief	Sets signal generated on a channel (all values in raw ADC counts).
+	@param	ch
+			Channel index.
+	@param	dc
+			DC level.
+	@param	amplitude
+			Sine amplitude (0 - DC only).
+	@param	freq
+			Sine frequency in Hz.
+	@param	noise
+			Peak value of added uniform noise.
+*/
+void SynthSource::setChannel(uint8_t ch, float dc, float amplitude, float freq, uint16_t noise)
+{
+	if(ch >= ACQ_CHANNELS)
+		return;
+	m_ch[ch].dc = dc;
+	m_ch[ch].amplitude = amplitude;
+	m_ch[ch].freq = freq;
+	m_ch[ch].noise = noise;
+}
+
+bool SynthSource::begin(uint32_t rate)
+{
+	m_rate = rate ? rate : 1;
+	m_n = 0;
+	return true;
+}
+
+/*!
+	@brief	Generates max scans. On target it also waits for the time they would take to acquire,
+			on host it returns immediately (simulated time).
+*/
+size_t SynthSource::read(acq_scan_t* dst, size_t max, uint32_t timeout_ms)
+{
+	for(size_t i = 0; i < max; i++, m_n++)
+	{
+		float _t = (float)m_n / m_rate;
+
+		for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+		{
+			float _v = m_ch[c].dc + m_ch[c].amplitude * sinf(2.0f * (float)M_PI * m_ch[c].freq * _t);
+
+			if(m_ch[c].noise)
+			{
+				m_seed = m_seed * 1664525UL + 1013904223UL;
+				_v += (int32_t)((m_seed >> 16) % (2 * m_ch[c].noise + 1)) - m_ch[c].noise;
+			}
+
+			if(_v < 0.0f)
+				_v = 0.0f;
+			if(_v > 4095.0f)
+				_v = 4095.0f;
+			dst[i].ch[c] = (uint16_t)_v;
+		}
+	}
+
+#if defined(ARDUINO)
+	delay((max * 1000UL) / m_rate);
+#endif
+	return max;
+}
+
+
+// ############################################################################
+/*!
+	@brief	Creates acquisition engine.
+	@param	*source
+			Sample source, not owned by the engine.
+*/
+Acquisition::Acquisition(AcqSource* source)
+{
+	m_source = source;
+	m_sinkCnt = 0;
+	m_head = 0;
+	m_overruns = 0;
+	m_timing = nullptr;
+	m_suspend = false;
+	m_suspended = false;
+}
+
+/*!
+	@brief	Starts the source. On target it also starts acquisition task pinned to ACQ_CORE,
+			otherwise poll() must be called by the user.
+	@returns True if started.
+*/
+bool Acquisition::begin()
+{
+	if(!m_source || !m_source->begin(ACQ_SAMPLE_RATE))
+		return false;
+
+#if defined(ARDUINO)
+	return xTaskCreatePinnedToCore(_task, "acq", ACQ_TASK_STACK, this, ACQ_TASK_PRIO, NULL, ACQ_CORE) == pdPASS;
+#else
+	return true;
+#endif
+}
+
+/*!
+	@brief	Adds processing stage called with every acquired block. Must be called before begin().
+	@returns False if there is no room for another sink.
+*/
+bool Acquisition::attach(AcqSink* sink)
+{
+	if(!sink || m_sinkCnt >= ACQ_MAX_SINKS)
+		return false;
+	m_sinks[m_sinkCnt++] = sink;
+	return true;
+}
+
+/*!
+	@brief	Reads one block straight into the ring buffer and passes it to all sinks.
+	@returns Number of scans acquired.
+*/
+size_t Acquisition::poll(uint32_t timeout_ms)
+{
+	// Source is stopped and restarted by the task reading it, never under its hands
+	if(m_suspend != m_suspended)
+	{
+		m_source->pause(m_suspend);
+		m_suspended = m_suspend;
+
+		// Nothing was sampled meanwhile - sinks mustn't join samples across the gap
+		if(!m_suspended)
+		{
+			for(uint8_t i = 0; i < m_sinkCnt; i++)
+				m_sinks[i]->onResume(m_head);
+		}
+	}
+	if(m_suspended)
+		return 0;
+
+	// Block never wraps around the end of the ring, so sinks always get contiguous memory
+	uint32_t _pos = m_head & ACQ_RING_MASK;
+	size_t _max = ACQ_RING_SIZE - _pos;
+	if(_max > ACQ_BLOCK_SIZE)
+		_max = ACQ_BLOCK_SIZE;
+
+	size_t _n = m_source->read(&m_ring[_pos], _max, timeout_ms);
+	if(_n == 0)
+		return 0;
+
+	uint32_t _seq = m_head;
+	uint32_t _start = _micros();
+
+	m_head = _seq + _n;
+	for(uint8_t i = 0; i < m_sinkCnt; i++)
+		m_sinks[i]->onBlock(&m_ring[_pos], _n, _seq);
+
+	// Processing must keep up with sampling, otherwise DMA buffer overflows
+	uint32_t _busy = _micros() - _start;
+	if(_busy > (_n * 1000000UL) / ACQ_SAMPLE_RATE)
+		m_overruns++;
+	if(m_timing)
+		m_timing->add(_busy);
+	return _n;
+}
+
+/*!
+	@returns Total number of scans acquired since start.
+*/
+uint32_t Acquisition::head() const
+{
+	return m_head;
+}
+
+/*!
+	@brief	Copies scans from ring buffer history (e.g. for fault capture).
+	@param	from
+			Sequence number of the first scan.
+	@param	*dst
+			Destination buffer.
+	@param	count
+			Number of scans.
+	@returns Number of scans copied. Less than count if part of them wasn't acquired yet,
+			 0 if they were already overwritten.
+*/
+size_t Acquisition::copy(uint32_t from, acq_scan_t* dst, size_t count) const
+{
+	uint32_t _head = m_head;
+
+	if(_head - from > ACQ_HISTORY)
+		return 0;
+	if(from + count > _head)
+		count = _head - from;
+
+	for(size_t i = 0; i < count; i++)
+		dst[i] = m_ring[(from + i) & ACQ_RING_MASK];
+
+	// Writer could overwrite the oldest scans while copying
+	if(m_head - from > ACQ_HISTORY)
+		return 0;
+	return count;
+}
+
+/*!
+	@brief	Copies the most recent scan.
+	@returns False if nothing was acquired yet.
+*/
+bool Acquisition::latest(acq_scan_t* dst) const
+{
+	uint32_t _head = m_head;
+
+	if(_head == 0)
+		return false;
+	return copy(_head - 1, dst, 1) == 1;
+}
+
+/*!
+	@returns Number of blocks processed slower than real time.
+*/
+uint32_t Acquisition::overruns() const
+{
+	return m_overruns;
+}
+
+/*!
+	@brief	Records processing time of every block (by all sinks) into histogram.
+			Set before begin() - the histogram is then written by acquisition task only.
+	@param	*hist
+			Histogram, nullptr - none.
+*/
+void Acquisition::timing(LatencyHist* hist)
+{
+	m_timing = hist;
+}
+
+/*!
+	@brief	Requests acquisition to stop (e.g. before light sleep) or to go on. Takes effect
+			with the next poll() - wait for suspended() before the source stops being clocked.
+*/
+void Acquisition::suspend(bool suspend)
+{
+	m_suspend = suspend;
+}
+
+/*!
+	@returns True if source is stopped.
+*/
+bool Acquisition::suspended() const
+{
+	return m_suspended;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Acquisition task - polls source forever.
+*/
+void Acquisition::_task(void* arg)
+{
+	Acquisition* _self = (Acquisition*)arg;
+
+	for(;;)
+	{
+		if(_self->poll(ACQ_READ_TIMEOUT) == 0 && _self->suspended())
+		{
+#if defined(ARDUINO)
+			delay(10);
+#endif
+		}
+	}
+}
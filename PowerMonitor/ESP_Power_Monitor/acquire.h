@@ -0,0 +1,169 @@
+/*
+	Continuous acquisition of voltage rails.
+	All channels are sampled in a round-robin scan at a fixed rate (ADC DMA on ESP32),
+	scans are stored in a ring buffer and handed over to processing stages in blocks.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef ACQUIRE_H
+#define ACQUIRE_H
+
+
+#include "config.h"
+#include "health.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define ACQ_MAX_SINKS		(8 + ACQ_CHANNELS)		// Stats, trigger, RMS meters...
+#define ACQ_RING_MASK		(ACQ_RING_SIZE - 1)
+#define ACQ_HISTORY			(ACQ_RING_SIZE - ACQ_BLOCK_SIZE)	// Scans safe to read back (one block is always being written)
+
+#if (ACQ_CHANNELS < 1 || ACQ_CHANNELS > 8)
+#error "ACQ_CHANNELS must be 1 - 8 (ADC1 pins)!"
+#endif
+#if (ACQ_RING_SIZE & ACQ_RING_MASK) != 0
+#error "ACQ_RING_SIZE must be a power of 2!"
+#endif
+
+
+/*!
+	@brief	Single scan - one raw ADC sample of every channel, taken in the same sampling period.
+*/
+typedef struct
+{
+	uint16_t ch[ACQ_CHANNELS];
+} acq_scan_t;
+
+
+// ############################################################################
+/*!
+	@brief	Interface of a sample source (ADC DMA, synthetic generator...).
+*/
+class AcqSource
+{
+public:
+	virtual ~AcqSource() {}
+
+	virtual bool begin(uint32_t rate) = 0;
+	virtual size_t read(acq_scan_t* dst, size_t max, uint32_t timeout_ms) = 0;
+
+	/*!
+		@brief	Stops / restarts conversions (before / after sleep). Called from the reading task.
+	*/
+	virtual void pause(bool paused) { }
+};
+
+/*!
+	@brief	Interface of a processing stage, called with every acquired block.
+			Runs in acquisition context, so it must never block.
+*/
+class AcqSink
+{
+public:
+	virtual ~AcqSink() {}
+
+	virtual void onBlock(const acq_scan_t* scans, size_t count, uint32_t seq) = 0;
+
+	/*!
+		@brief	Source restarted after a pause - sample seq doesn't follow the one before it,
+				state spanning samples (previous sample, open windows) must start over.
+	*/
+	virtual void onResume(uint32_t seq) { }
+};
+
+
+#if defined(ARDUINO)
+// ############################################################################
+/*!
+	@brief	Continuous ADC1 scan of all sensing pins through I2S DMA.
+*/
+class AdcDmaSource : public AcqSource
+{
+public:
+	AdcDmaSource(const uint8_t* pins);
+
+	bool begin(uint32_t rate) override;
+	size_t read(acq_scan_t* dst, size_t max, uint32_t timeout_ms) override;
+	void pause(bool paused) override;
+
+private:
+	const uint8_t* m_pins;
+	uint8_t m_channels[ACQ_CHANNELS];	// ADC1 channel numbers of pins
+	acq_scan_t m_partial;				// Scan being assembled from DMA results
+	uint8_t m_filled;					// Bitmask of channels present in m_partial
+	uint8_t m_raw[ACQ_BLOCK_SIZE * ACQ_CHANNELS * 2];
+};
+#endif
+
+// ############################################################################
+/*!
+	@brief	Synthetic signal source - sine or DC with noise on every channel.
+			Used for testing without sensing hardware and on host builds.
+*/
+class SynthSource : public AcqSource
+{
+public:
+	SynthSource();
+
+	void setChannel(uint8_t ch, float dc, float amplitude, float freq, uint16_t noise = 0);
+
+	bool begin(uint32_t rate) override;
+	size_t read(acq_scan_t* dst, size_t max, uint32_t timeout_ms) override;
+
+private:
+	struct
+	{
+		float dc;
+		float amplitude;
+		float freq;
+		uint16_t noise;
+	} m_ch[ACQ_CHANNELS];
+
+	uint32_t m_rate;
+	uint32_t m_n;
+	uint32_t m_seed;
+};
+
+
+// ############################################################################
+/*!
+	@brief	Acquisition engine - reads blocks from source into a ring buffer and dispatches them to sinks.
+*/
+class Acquisition
+{
+public:
+	Acquisition(AcqSource* source);
+
+	bool begin();
+	bool attach(AcqSink* sink);
+	size_t poll(uint32_t timeout_ms);
+
+	uint32_t head() const;
+	size_t copy(uint32_t from, acq_scan_t* dst, size_t count) const;
+	bool latest(acq_scan_t* dst) const;
+	uint32_t overruns() const;
+	void timing(LatencyHist* hist);
+
+	void suspend(bool suspend);
+	bool suspended() const;
+
+private:
+	AcqSource* m_source;
+	AcqSink* m_sinks[ACQ_MAX_SINKS];
+	uint8_t m_sinkCnt;
+
+	acq_scan_t m_ring[ACQ_RING_SIZE];
+	volatile uint32_t m_head;			// Total number of scans written
+	volatile uint32_t m_overruns;		// Blocks which took longer to process than to acquire
+	LatencyHist* m_timing;				// Processing time of blocks, nullptr - not recorded
+	volatile bool m_suspend;			// Requested by user...
+	volatile bool m_suspended;			// ...and done by the reading task
+
+	static void _task(void* arg);
+};
+
+
+#endif // ACQUIRE_H
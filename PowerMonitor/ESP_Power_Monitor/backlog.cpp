@@ -0,0 +1,285 @@
+#include "backlog.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/*!
+	@brief	Creates closed backlog.
+*/
+Backlog::Backlog()
+{
+	m_file = nullptr;
+	m_boot = 0;
+	m_head = 1;
+	m_tail = 1;
+	m_tailDone = 0;
+	m_next = 1;
+	m_lost = 0;
+	memset(&m_write, 0, sizeof(m_write));
+	memset(&m_read, 0, sizeof(m_read));
+	m_readPos = 0;
+}
+
+/*!
+	@brief	Class destructor. Records not flushed yet are lost.
+*/
+Backlog::~Backlog()
+{
+	if(m_file)
+		fclose(m_file);
+}
+
+/*!
+	@brief		Opens (or creates) ring file and finds stored chunks.
+	@param		*path
+				File path, e.g. "/littlefs/backlog.bin" (file system must be mounted).
+	@returns	False if file can't be opened.
+*/
+bool Backlog::begin(const char* path)
+{
+	m_file = fopen(path, "r+b");
+	if(!m_file)
+		m_file = fopen(path, "w+b");
+	if(!m_file)
+		return false;
+
+	// Chunk n always lives in slot n % LOG_SLOTS, so the newest and the oldest valid chunks give head & tail
+	uint32_t _min = 0, _max = 0, _boot = 0;
+	for(uint32_t i = 0; i < LOG_SLOTS; i++)
+	{
+		if(!_loadSlot(i, &m_read))
+			continue;
+		if(_min == 0 || m_read.seq < _min)
+			_min = m_read.seq;
+		if(m_read.seq > _max)
+			_max = m_read.seq;
+		if(m_read.boot > _boot)
+			_boot = m_read.boot;
+	}
+
+	m_head = _max + 1;
+	m_tail = _min ? _min : m_head;
+	m_tailDone = 0;
+	m_next = m_tail;
+	m_boot = _boot + 1;
+	memset(&m_read, 0, sizeof(m_read));
+	m_readPos = 0;
+	return true;
+}
+
+/*!
+	@brief		Adds measurement. Records are written to flash when LOG_BATCH of them are collected.
+	@param		time
+				UNIX time or seconds since boot if clock isn't set.
+	@param		*values
+				CH_COUNT values in volts.
+	@returns	False if full batch couldn't be written.
+*/
+bool Backlog::append(uint32_t time, const float* values)
+{
+	log_rec_t* _rec = &m_write.recs[m_write.count++];
+
+	_rec->time = time;
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		float _v = values[c] * LOG_VALUE_SCALE;
+		if(_v > INT16_MAX)
+			_v = INT16_MAX;
+		if(_v < INT16_MIN)
+			_v = INT16_MIN;
+		_rec->values[c] = (int16_t)lroundf(_v);
+	}
+
+	if(m_write.count >= LOG_BATCH)
+		return flush();
+	return true;
+}
+
+/*!
+	@brief		Writes collected records to flash (e.g. before sleep or reset).
+	@returns	False if write failed - records are lost then.
+*/
+bool Backlog::flush()
+{
+	if(m_write.count == 0)
+		return true;
+
+	bool _ok = false;
+
+	if(m_file)
+	{
+		// Ring is full - the oldest chunk gives way to the new one. Chunk already peeked isn't lost,
+		// its records are in RAM (m_read or caller's buffers)
+		if(m_head - m_tail >= LOG_SLOTS)
+		{
+			log_chunk_t _old;
+			if(m_tail >= m_next)
+				m_lost += (_loadSlot(m_tail % LOG_SLOTS, &_old) && _old.seq == m_tail) ? _old.count : LOG_BATCH;
+			m_tail++;
+			m_tailDone = 0;
+			if(m_next < m_tail)
+				m_next = m_tail;
+		}
+
+		m_write.seq = m_head;
+		m_write.boot = m_boot;
+		m_write.crc = _crc(&m_write);
+		_ok = _writeSlot(m_head % LOG_SLOTS, &m_write, sizeof(m_write));
+		if(_ok)
+			m_head++;
+	}
+
+	if(!_ok)
+		m_lost += m_write.count;
+	memset(&m_write, 0, sizeof(m_write));
+	return _ok;
+}
+
+/*!
+	@brief		Gives the next record without removing it - records stay on flash until commit(),
+				so whatever wasn't confirmed as sent before a reset is sent again.
+	@param		*time
+				Record's UNIX time.
+	@param		*values
+				CH_COUNT values in volts.
+	@param		clock_offset
+				UNIX time of boot, used to fix records taken before the clock was set. 0 - clock still not set.
+	@returns	False if there is no record after the previously peeked ones.
+*/
+bool Backlog::peek(uint32_t* time, float* values, uint32_t clock_offset)
+{
+	for(;;)
+	{
+		if(m_readPos >= m_read.count)
+		{
+			memset(&m_read, 0, sizeof(m_read));
+			m_readPos = 0;
+
+			// Corrupted chunks are skipped
+			while(m_next < m_head && !(_loadSlot(m_next % LOG_SLOTS, &m_read) && m_read.seq == m_next))
+			{
+				m_lost += LOG_BATCH;
+				m_next++;
+			}
+
+			if(m_next >= m_head)
+			{
+				// Nothing on flash - records still in RAM go through it as well
+				memset(&m_read, 0, sizeof(m_read));
+				if(m_write.count == 0 || !flush())
+					return false;
+				continue;
+			}
+			m_next++;
+		}
+
+		const log_rec_t* _rec = &m_read.recs[m_readPos++];
+		uint32_t _time = _rec->time;
+
+		// Boot-relative time can be fixed only in the boot which recorded it, after clock was set
+		if(_time < LOG_TIME_VALID)
+		{
+			if(m_read.boot != m_boot || clock_offset == 0)
+			{
+				m_lost++;
+				continue;
+			}
+			_time += clock_offset;
+		}
+
+		*time = _time;
+		for(uint8_t c = 0; c < CH_COUNT; c++)
+			values[c] = (float)_rec->values[c] / LOG_VALUE_SCALE;
+		return true;
+	}
+}
+
+/*!
+	@brief	Removes every record returned by peek() so far - call it once they reached the broker.
+			Slots of chunks sent completely are freed, the partly sent one is remembered only in RAM.
+*/
+void Backlog::commit()
+{
+	// Chunks before the loaded one are done, the loaded one only if all its records were peeked
+	uint32_t _done = (m_read.count && m_readPos < m_read.count) ? m_read.seq : m_next;
+
+	for(; m_tail < _done; m_tail++)
+	{
+		uint32_t _empty = 0;
+		_writeSlot(m_tail % LOG_SLOTS, &_empty, sizeof(_empty));
+		m_tailDone = 0;
+	}
+
+	if(m_read.count && m_read.seq == m_tail)
+		m_tailDone = m_readPos;
+}
+
+/*!
+	@returns	Number of records not committed yet (chunks on flash are counted as full).
+*/
+uint32_t Backlog::pending() const
+{
+	return (m_head - m_tail) * LOG_BATCH - m_tailDone + m_write.count;
+}
+
+/*!
+	@returns	Number of records lost (overwritten when full, corrupted or with unknown time).
+*/
+uint32_t Backlog::lost() const
+{
+	return m_lost;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Reads chunk from a slot and verifies it.
+	@returns	True if slot holds a valid chunk.
+*/
+bool Backlog::_loadSlot(uint32_t slot, log_chunk_t* chunk)
+{
+	if(fseek(m_file, slot * sizeof(log_chunk_t), SEEK_SET) != 0)
+		return false;
+	if(fread(chunk, sizeof(log_chunk_t), 1, m_file) != 1)
+		return false;
+
+	return chunk->seq != 0 && chunk->count <= LOG_BATCH && chunk->crc == _crc(chunk);
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Writes data at the beginning of a slot and commits it to flash.
+	@returns	True if written.
+*/
+bool Backlog::_writeSlot(uint32_t slot, const void* data, size_t len)
+{
+	if(fseek(m_file, slot * sizeof(log_chunk_t), SEEK_SET) != 0)
+		return false;
+	if(fwrite(data, len, 1, m_file) != 1)
+		return false;
+	if(fflush(m_file) != 0)
+		return false;
+	return fsync(fileno(m_file)) == 0;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] CRC-16/CCITT of chunk's header and used records.
+*/
+uint16_t Backlog::_crc(const log_chunk_t* chunk)
+{
+	const uint8_t* _data = (const uint8_t*)chunk;
+	size_t _len = offsetof(log_chunk_t, crc);
+	uint16_t _crc = 0xffff;
+
+	for(size_t i = 0; i < offsetof(log_chunk_t, recs) + chunk->count * sizeof(log_rec_t); i++)
+	{
+		// CRC field itself is skipped
+		if(i == _len)
+			i += sizeof(chunk->crc);
+
+		_crc ^= (uint16_t)_data[i] << 8;
+		for(uint8_t b = 0; b < 8; b++)
+			_crc = (_crc & 0x8000) ? (_crc << 1) ^ 0x1021 : (_crc << 1);
+	}
+	return _crc;
+}
@@ -0,0 +1,84 @@
+/*
+	Store-and-forward log of measurements taken while the broker is unreachable.
+	Records are collected in RAM and written to flash in chunks (one write per LOG_BATCH records),
+	chunks live in fixed slots of a single ring file, every one protected by CRC.
+	Plain stdio is used, so the same code runs on LittleFS (mounted into VFS) and on a host file.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+
+#include "acquire.h"
+
+#include <stdio.h>
+
+
+#define LOG_TIME_VALID		1600000000L		// Lower timestamps are seconds since boot (clock not set yet)
+#define LOG_VALUE_SCALE		100				// Values are stored in 10 mV units
+
+
+/*!
+	@brief	Single stored measurement (mean of every rail over one publish interval).
+*/
+typedef struct
+{
+	uint32_t time;				// UNIX time or seconds since boot (below LOG_TIME_VALID)
+	int16_t values[CH_COUNT];
+} log_rec_t;
+
+/*!
+	@brief	Chunk of records - unit of a flash write, occupies one slot of the ring file.
+*/
+typedef struct
+{
+	uint32_t seq;				// Chunk number, 0 - empty / already sent slot
+	uint32_t boot;				// Boot which wrote the chunk (boot-relative timestamps are valid only in it)
+	uint16_t count;
+	uint16_t crc;				// CRC-16 of everything else
+	log_rec_t recs[LOG_BATCH];
+} log_chunk_t;
+
+
+// ############################################################################
+/*!
+	@brief	Persistent FIFO of measurements with bounded size - the oldest chunk is overwritten when full.
+			Records are taken by peek() and removed by commit() once they were uploaded.
+*/
+class Backlog
+{
+public:
+	Backlog();
+	~Backlog();
+
+	bool begin(const char* path);
+	bool append(uint32_t time, const float* values);
+	bool flush();
+	bool peek(uint32_t* time, float* values, uint32_t clock_offset);
+	void commit();
+
+	uint32_t pending() const;
+	uint32_t lost() const;
+
+private:
+	FILE* m_file;
+	uint32_t m_boot;
+	uint32_t m_head;			// Sequence number of the next written chunk
+	uint32_t m_tail;			// Sequence number of the oldest chunk not committed yet
+	uint16_t m_tailDone;		// Its records already committed (the slot is freed only with the last one)
+	uint32_t m_next;			// Sequence number of the chunk peek() loads after m_read
+	uint32_t m_lost;			// Records overwritten, corrupted or with unknown time
+
+	log_chunk_t m_write;		// Chunk being filled
+	log_chunk_t m_read;			// Chunk being peeked
+	uint16_t m_readPos;			// Next record of m_read, m_read.count - nothing loaded
+
+	bool _loadSlot(uint32_t seq, log_chunk_t* chunk);
+	bool _writeSlot(uint32_t slot, const void* data, size_t len);
+	static uint16_t _crc(const log_chunk_t* chunk);
+};
+
+
+#endif // BACKLOG_H
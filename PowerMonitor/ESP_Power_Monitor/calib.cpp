@@ -0,0 +1,221 @@
+#include "calib.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include "esp_adc_cal.h"
+#endif
+
+
+#define CAL_FILE_MAGIC		0x314c4143UL	// "CAL1"
+#define CAL_MIN_SPAN		0.1f			// Points closer than 10% are treated as a new single point
+
+
+// ############################################################################
+/*!
+	@brief	Creates table of an ideal converter (3300 mV full scale).
+*/
+AdcCal::AdcCal()
+{
+	for(uint8_t k = 0; k < CAL_LUT_SIZE; k++)
+		m_lut[k] = (uint32_t)k * CAL_LUT_STEP * 3300 / 4096;
+	m_type = CAL_IDEAL;
+}
+
+/*!
+	@brief		Characterizes ADC1 at 11 dB attenuation from eFuse and fills the table.
+				Without ESP32 (host build) the ideal line is kept.
+	@returns	Source of calibration data.
+*/
+cal_type_t AdcCal::begin()
+{
+#if defined(ARDUINO)
+	esp_adc_cal_characteristics_t _chars;
+	esp_adc_cal_value_t _val = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, CAL_DEFAULT_VREF, &_chars);
+
+	for(uint8_t k = 0; k < CAL_LUT_SIZE - 1; k++)
+		setKnot(k, esp_adc_cal_raw_to_voltage((uint32_t)k * CAL_LUT_STEP, &_chars));
+
+	// Last knot lies just past 12 bit range - extended from the slope of the last counts
+	uint32_t _top = esp_adc_cal_raw_to_voltage(4095, &_chars);
+	uint32_t _prev = m_lut[CAL_LUT_SIZE - 2];
+	setKnot(CAL_LUT_SIZE - 1, _top + (_top - _prev) / (CAL_LUT_STEP - 1));
+
+	if(_val == ESP_ADC_CAL_VAL_EFUSE_TP)
+		m_type = CAL_EFUSE_TP;
+	else if(_val == ESP_ADC_CAL_VAL_EFUSE_VREF)
+		m_type = CAL_EFUSE_VREF;
+	else
+		m_type = CAL_NOMINAL;
+#endif
+	return m_type;
+}
+
+/*!
+	@brief	Sets a point of transfer curve.
+	@param	knot
+			Knot index, raw value knot * CAL_LUT_STEP.
+	@param	mv
+			Pin voltage giving that raw value.
+*/
+void AdcCal::setKnot(uint8_t knot, uint16_t mv)
+{
+	if(knot < CAL_LUT_SIZE)
+		m_lut[knot] = mv;
+}
+
+/*!
+	@brief	Converts block of scans in place.
+*/
+void AdcCal::apply(acq_scan_t* scans, size_t count) const
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+			scans[i].ch[c] = convert(scans[i].ch[c]);
+	}
+}
+
+/*!
+	@returns	Source of calibration data.
+*/
+cal_type_t AdcCal::type() const
+{
+	return m_type;
+}
+
+// ############################################################################
+/*!
+	@brief	Wraps raw source.
+	@param	*raw
+			Source of raw 12 bit samples.
+	@param	*cal
+			Conversion table.
+*/
+CalSource::CalSource(AcqSource* raw, const AdcCal* cal)
+{
+	m_raw = raw;
+	m_cal = cal;
+}
+
+bool CalSource::begin(uint32_t rate)
+{
+	return m_raw->begin(rate);
+}
+
+size_t CalSource::read(acq_scan_t* dst, size_t max, uint32_t timeout_ms)
+{
+	size_t _n = m_raw->read(dst, max, timeout_ms);
+	m_cal->apply(dst, _n);
+	return _n;
+}
+
+void CalSource::pause(bool paused)
+{
+	m_raw->pause(paused);
+}
+
+// ############################################################################
+/*!
+	@brief	Creates corrections with gains from channel table and no offsets.
+*/
+ChannelCal::ChannelCal()
+{
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		reset(c);
+}
+
+/*!
+	@brief		Loads corrections saved by save().
+	@returns	False if file is missing or was written for different channel table.
+*/
+bool ChannelCal::load(const char* path)
+{
+	FILE* _f = fopen(path, "rb");
+	if(!_f)
+		return false;
+
+	uint32_t _hdr[2];
+	float _gain[CH_COUNT];
+	float _offset[CH_COUNT];
+	bool _ok = fread(_hdr, sizeof(_hdr), 1, _f) == 1 && _hdr[0] == CAL_FILE_MAGIC && _hdr[1] == CH_COUNT &&
+		fread(_gain, sizeof(_gain), 1, _f) == 1 && fread(_offset, sizeof(_offset), 1, _f) == 1;
+	fclose(_f);
+
+	if(!_ok)
+		return false;
+
+	memcpy(m_gain, _gain, sizeof(m_gain));
+	memcpy(m_offset, _offset, sizeof(m_offset));
+	return true;
+}
+
+/*!
+	@returns	False if file couldn't be written.
+*/
+bool ChannelCal::save(const char* path) const
+{
+	FILE* _f = fopen(path, "wb");
+	if(!_f)
+		return false;
+
+	const uint32_t _hdr[2] = { CAL_FILE_MAGIC, CH_COUNT };
+	bool _ok = fwrite(_hdr, sizeof(_hdr), 1, _f) == 1 &&
+		fwrite(m_gain, sizeof(m_gain), 1, _f) == 1 && fwrite(m_offset, sizeof(m_offset), 1, _f) == 1;
+	return (fclose(_f) == 0) && _ok;
+}
+
+/*!
+	@brief		Adds calibration point - channel reading while its rail has a known voltage.
+				First point sets gain only (line through 0), second one far enough from it fits gain & offset.
+	@param		ch
+				Channel index.
+	@param		value
+				Channel reading (pin mV or counts).
+	@param		volts
+				Actual rail voltage.
+	@returns	False if point is unusable.
+*/
+bool ChannelCal::point(uint8_t ch, float value, float volts)
+{
+	if(ch >= CH_COUNT || fabsf(value) < 1.0f)
+		return false;
+
+	if(m_first[ch].valid && fabsf(value - m_first[ch].value) >= fabsf(value) * CAL_MIN_SPAN)
+	{
+		m_gain[ch] = (volts - m_first[ch].volts) / (value - m_first[ch].value);
+		m_offset[ch] = volts - m_gain[ch] * value;
+		m_first[ch].valid = false;
+		return true;
+	}
+
+	m_gain[ch] = volts / value;
+	m_offset[ch] = 0;
+	m_first[ch].value = value;
+	m_first[ch].volts = volts;
+	m_first[ch].valid = true;
+	return true;
+}
+
+/*!
+	@brief	Restores default correction of a channel.
+*/
+void ChannelCal::reset(uint8_t ch)
+{
+	if(ch >= CH_COUNT)
+		return;
+
+	m_gain[ch] = ch_table[ch].scale;
+	m_offset[ch] = 0;
+	m_first[ch].valid = false;
+}
+
+/*!
+	@returns	Volts per unit of channel reading.
+*/
+float ChannelCal::gain(uint8_t ch) const
+{
+	return (ch < CH_COUNT) ? m_gain[ch] : 0;
+}
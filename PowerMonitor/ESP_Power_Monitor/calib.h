@@ -0,0 +1,122 @@
+/*
+	ADC calibration.
+	Raw ESP32 ADC counts are far from linear near both ends of the range. The transfer curve
+	characterized from eFuse (two-point values or Vref, whatever the chip holds) is sampled into
+	a small table, every sample is then converted to millivolts at the pin by integer interpolation.
+	Unknown dividers and sensor ratios are corrected per channel by gain & offset, fitted from
+	one or two readings of a known voltage and kept on flash.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef CALIB_H
+#define CALIB_H
+
+
+#include "acquire.h"
+#include "channels.h"
+
+
+#define CAL_LUT_STEP		(1 << CAL_LUT_SHIFT)
+#define CAL_LUT_SIZE		((4096 >> CAL_LUT_SHIFT) + 1)	// Knots over 12 bit range, last one at 4096
+
+
+typedef enum
+{
+	CAL_IDEAL = 0,			// Straight line (not characterized yet)
+	CAL_NOMINAL,			// Nominal Vref - chip has no calibration in eFuse
+	CAL_EFUSE_VREF,			// Vref measured in factory
+	CAL_EFUSE_TP			// Two-point values measured in factory
+} cal_type_t;
+
+
+// ############################################################################
+/*!
+	@brief	Raw counts -> pin millivolts lookup table with linear interpolation.
+*/
+class AdcCal
+{
+public:
+	AdcCal();
+
+	cal_type_t begin();
+	void setKnot(uint8_t knot, uint16_t mv);
+
+	/*!
+		@brief	Converts raw 12 bit sample to millivolts - one table read and one multiply.
+	*/
+	inline uint16_t convert(uint16_t raw) const
+	{
+		uint16_t _i = (raw >> CAL_LUT_SHIFT) & (CAL_LUT_SIZE - 2);
+		int32_t _d = (int32_t)m_lut[_i + 1] - m_lut[_i];
+		return m_lut[_i] + ((_d * (raw & (CAL_LUT_STEP - 1))) >> CAL_LUT_SHIFT);
+	}
+
+	void apply(acq_scan_t* scans, size_t count) const;
+	cal_type_t type() const;
+
+private:
+	uint16_t m_lut[CAL_LUT_SIZE];
+	cal_type_t m_type;
+};
+
+
+// ############################################################################
+/*!
+	@brief	Source decorator - hands out scans of the wrapped source already in millivolts.
+*/
+class CalSource : public AcqSource
+{
+public:
+	CalSource(AcqSource* raw, const AdcCal* cal);
+
+	bool begin(uint32_t rate) override;
+	size_t read(acq_scan_t* dst, size_t max, uint32_t timeout_ms) override;
+	void pause(bool paused) override;
+
+private:
+	AcqSource* m_raw;
+	const AdcCal* m_cal;
+};
+
+
+// ############################################################################
+/*!
+	@brief	Per-channel linear correction: volts = gain * value + offset,
+			value being pin millivolts (ADC) or counts (external ADC).
+*/
+class ChannelCal
+{
+public:
+	ChannelCal();
+
+	bool load(const char* path);
+	bool save(const char* path) const;
+
+	bool point(uint8_t ch, float value, float volts);
+	void reset(uint8_t ch);
+
+	/*!
+		@returns	Channel value in volts.
+	*/
+	inline float volts(uint8_t ch, float value) const
+	{
+		return value * m_gain[ch] + m_offset[ch];
+	}
+
+	float gain(uint8_t ch) const;
+
+private:
+	float m_gain[CH_COUNT];
+	float m_offset[CH_COUNT];
+
+	struct
+	{
+		float value;
+		float volts;
+		bool valid;
+	} m_first[CH_COUNT];		// First point of two-point calibration
+};
+
+
+#endif // CALIB_H
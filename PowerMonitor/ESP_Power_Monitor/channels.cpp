@@ -0,0 +1,105 @@
+#include "channels.h"
+
+#include <string.h>
+
+
+// Table expanded from CHANNEL() lines
+#define CHANNEL(name, feed, source, input, mode, scale, decimals, filter, trig) \
+	{ name, feed, source, input, mode, scale, decimals, { trig } },
+
+const channel_t ch_table[CH_COUNT] =
+{
+	CHANNEL_TABLE
+};
+
+#undef CHANNEL
+
+static_assert(sizeof(ch_table) / sizeof(ch_table[0]) == CH_COUNT, "CH_COUNT doesn't match CHANNEL_TABLE!");
+static_assert(CH_COUNT <= AIO_GROUP_MAX_FEEDS, "All channels must fit into one group!");
+
+// Lines of each source counted from the table
+#define CHANNEL(name, feed, source, input, mode, scale, decimals, filter, trig) + ((source) == CH_SRC_ADC)
+static_assert(0 CHANNEL_TABLE == ACQ_CHANNELS, "ACQ_CHANNELS doesn't match CH_SRC_ADC lines of CHANNEL_TABLE!");
+#undef CHANNEL
+#define CHANNEL(name, feed, source, input, mode, scale, decimals, filter, trig) + ((source) == CH_SRC_EXT)
+static_assert(0 CHANNEL_TABLE <= EXT_MAX_CHANNELS, "Too many CH_SRC_EXT lines in CHANNEL_TABLE!");
+#undef CHANNEL
+
+
+int8_t Channels::s_slot[CH_COUNT];
+int8_t Channels::s_adc[ACQ_CHANNELS];
+int8_t Channels::s_ext[EXT_MAX_CHANNELS];
+uint8_t Channels::s_adcCnt = 0;
+uint8_t Channels::s_extCnt = 0;
+uint8_t Channels::s_pins[ACQ_CHANNELS];
+
+
+/*!
+	@brief		Assigns source slots to channels and collects ADC pins.
+	@returns	False if table has invalid lines (RMS of an external channel).
+*/
+bool Channels::begin()
+{
+	bool _ok = true;
+
+	s_adcCnt = 0;
+	s_extCnt = 0;
+	memset(s_adc, -1, sizeof(s_adc));
+	memset(s_ext, -1, sizeof(s_ext));
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		const channel_t* _ch = &ch_table[c];
+		s_slot[c] = -1;
+
+		if(_ch->source == CH_SRC_ADC && s_adcCnt < ACQ_CHANNELS)
+		{
+			s_pins[s_adcCnt] = _ch->input;
+			s_adc[s_adcCnt] = c;
+			s_slot[c] = s_adcCnt++;
+		}
+		else if(_ch->source == CH_SRC_EXT && s_extCnt < EXT_MAX_CHANNELS && _ch->mode == CH_MEAN)
+		{
+			s_ext[s_extCnt] = c;
+			s_slot[c] = s_extCnt++;
+		}
+		else
+			_ok = false;		// too many channels of a source or RMS of external one
+	}
+
+	return _ok && (s_adcCnt == ACQ_CHANNELS);
+}
+
+/*!
+	@returns	Slot of a channel in its source (scan index or external channel index), -1 if unassigned.
+*/
+int8_t Channels::slot(uint8_t ch)
+{
+	return (ch < CH_COUNT) ? s_slot[ch] : -1;
+}
+
+/*!
+	@returns	Channel which occupies slot of a source, -1 if none.
+*/
+int8_t Channels::fromSlot(ch_source_t source, uint8_t slot)
+{
+	if(source == CH_SRC_ADC)
+		return (slot < s_adcCnt) ? s_adc[slot] : -1;
+	return (slot < s_extCnt) ? s_ext[slot] : -1;
+}
+
+/*!
+	@returns	Number of channels read from a source.
+*/
+uint8_t Channels::count(ch_source_t source)
+{
+	return (source == CH_SRC_ADC) ? s_adcCnt : s_extCnt;
+}
+
+/*!
+	@returns	GPIOs of ACQ_CHANNELS scan slots (valid after begin()).
+*/
+const uint8_t* Channels::adcPins()
+{
+	return s_pins;
+}
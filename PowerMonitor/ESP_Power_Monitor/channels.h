@@ -0,0 +1,75 @@
+/*
+	Registry of measured channels.
+	Built at compile time from CHANNEL_TABLE in config.h - every other module iterates over it
+	instead of knowing rail names, pins or scaling. Channels come either from the internal ADC scan
+	(scan slot = order of CH_SRC_ADC lines) or from an external ADC (slot = order of CH_SRC_EXT lines).
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+
+#include "config.h"
+
+#include <stdint.h>
+
+
+typedef enum
+{
+	CH_SRC_ADC = 0,			// ESP32 ADC1, DMA scan
+	CH_SRC_EXT				// External ADC board
+} ch_source_t;
+
+typedef enum
+{
+	CH_MEAN = 0,			// Mean over publish interval
+	CH_RMS					// True RMS
+} ch_mode_t;
+
+
+/*!
+	@brief	Static description of a channel.
+*/
+typedef struct
+{
+	const char* name;		// Label on display and in events
+	const char* feed;		// Feed key in the group
+	ch_source_t source;
+	uint8_t input;			// GPIO (CH_SRC_ADC) or external ADC channel (CH_SRC_EXT)
+	ch_mode_t mode;
+	float scale;			// Volts per pin mV / external count (default calibration gain)
+	uint8_t decimals;		// Decimal places published
+	uint16_t trig[3];		// Fault trigger: low, high, slope [mV], 0 - disabled
+} channel_t;
+
+
+extern const channel_t ch_table[CH_COUNT];
+
+
+// ############################################################################
+/*!
+	@brief	Mapping between channels and slots of their sources, resolved once by begin().
+*/
+class Channels
+{
+public:
+	static bool begin();
+
+	static int8_t slot(uint8_t ch);
+	static int8_t fromSlot(ch_source_t source, uint8_t slot);
+	static uint8_t count(ch_source_t source);
+	static const uint8_t* adcPins();
+
+private:
+	static int8_t s_slot[CH_COUNT];
+	static int8_t s_adc[ACQ_CHANNELS];			// Channel of every scan slot
+	static int8_t s_ext[EXT_MAX_CHANNELS];		// Channel of every external slot
+	static uint8_t s_adcCnt;
+	static uint8_t s_extCnt;
+	static uint8_t s_pins[ACQ_CHANNELS];
+};
+
+
+#endif // CHANNELS_H
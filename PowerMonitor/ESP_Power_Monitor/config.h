@@ -19,8 +19,186 @@
 #define USE_LCD			1
 #define DISPLAY_STATUS	1		// 1 - display status on LCD (if attached)
 
-#define THROTTLE_DELAY	3000	// Minimum delay to satisfy AIO throttle limit.
-								// Should be set accordingly to amount of sent variables.
+#define PUBLISH_INTERVAL	2000	// ms between measurement summaries queued for upload (all rails go in one group message)
+
+#define AIO_RATE_LIMIT		30		// Messages per minute allowed by broker (30 on free plan, shared by all feeds and groups)
+#define AIO_RATE_BURST		2		// Messages which can be sent back-to-back after idle period
+#define AIO_QUEUE_SLOTS		12		// Feeds / groups waiting for upload - one slot each, newer value replaces older one
+									// (except events - every one takes a slot)
+#define AIO_QUEUE_TEXT		96		// Longest queued text value
+#define AIO_POLL_TIMEOUT	10		// ms spent waiting for incoming packets in every poll()
+
+#define AIO_NET_TIMEOUT		10000	// ms to wait for WiFi association before retrying
+#define AIO_TLS_TIMEOUT		10		// s, TLS handshake limit (the only part of connecting which blocks)
+#define AIO_BACKOFF_MIN		500		// ms, first retry delay - doubled after every failed attempt...
+#define AIO_BACKOFF_MAX		60000	// ms ...up to this value. Actual delay is randomized to 50-100% of it
+#define AIO_FAST_RECONNECT	1		// 1 - access point (BSSID, channel) is kept in RTC memory (survives deep sleep),
+									// association goes straight to it instead of scanning all channels
+#define AIO_KEEPALIVE_MIN	30		// s, MQTT keepalive is set on connect to twice the gap between published messages...
+#define AIO_KEEPALIVE_MAX	900		// s ...within these limits. Broker is pinged only after 3/4 of it without a message
+
+#define AIO_GROUP			"esp32-pwrmonitor"	// Group of all monitor's feeds
+#define AIO_GROUP_MAX_FEEDS	24		// Feeds in a group (at least CH_COUNT, 32 max)
+#define AIO_GROUP_BATCH		1		// Measurement rows sent in one message. Above 1 rows are timestamped
+									// and sent as JSON array (needs time synced over NTP)
+#define AIO_GROUP_PAYLOAD	512		// Message buffer (keep below MQTT library's MAXBUFFERSIZE)
+#define AIO_PACKED			0		// 1 - batched rows (backlog, AIO_GROUP_BATCH > 1) go in compact encoding (tspack.h)
+									// as base64 text of a single feed - ~30x smaller than JSON, decoded by receiver
+#define AIO_PACKED_FEED		"esp32-pwrmonitor.packed"
+#define AIO_PACKED_ROWS		60		// Backlog rows sent in one packed message (rows over AIO_GROUP_PAYLOAD go in the next one)
+
+#define AIO_MAX_TOPICS		32		// Distinct feed / group topics
+#define AIO_TOPIC_POOL		1024	// Bytes for all topic strings ("<user>/feeds/<name>")
+#define AIO_MAX_PUBLISHERS	16
+#define AIO_MAX_SUBSCRIBERS	8		// MQTT library handles MAXSUBSCRIPTIONS of them (5 by default)
+#define AIO_MAX_GROUPS		4
+
+#define NTP_SERVER		"pool.ntp.org"
+
+//********************* LOCAL DATA CONFIG *********************//
+#define LOCAL_HISTORY		300		// Rows kept in RAM for LAN clients (10 min of PUBLISH_INTERVAL)
+#define LOCAL_HTTP			1		// 1 - serve /metrics (Prometheus) and /json?rows=N on the LAN
+#define LOCAL_HTTP_PORT		80
+#define LOCAL_HTTP_REQ		256		// Bytes of request head kept (only the request line matters)
+#define LOCAL_HTTP_TIMEOUT	500		// ms for client to send its request
+#define LOCAL_HTTP_CHUNK	512		// Response is written in pieces of this size
+#define LOCAL_MQTT			0		// 1 - mirror every row to local broker ("<prefix>/<feed key>")
+#define LOCAL_MQTT_HOST		"192.168.1.2"
+#define LOCAL_MQTT_PORT		1883
+#define LOCAL_MQTT_PREFIX	"pwrmonitor"
+#define LOCAL_MQTT_RETRY	30000	// ms between connection attempts
+#define LOCAL_MQTT_CONNECT_MS	20	// TCP connect timeout - the broker is on the LAN, the loop waits at most this long
+
+//********************* STORE AND FORWARD CONFIG *********************//
+#define LOG_PATH			"/littlefs/backlog.bin"	// Measurements taken while broker is unreachable (LittleFS)
+#define LOG_BATCH			15		// Records written to flash at once (30 s of PUBLISH_INTERVAL)
+#define LOG_SLOTS			240		// Chunks kept in the file (2 h, ~46 kB), the oldest is overwritten when full
+#define LOG_DRAIN_ROWS		4		// Stored records sent in one group message (rows over AIO_GROUP_PAYLOAD go in the next one)
+
+//********************* LOW POWER CONFIG *********************//
+#define LP_MODE				0		// 1 - duty cycled (battery backup): light sleep between sampling windows,
+									// records kept in RTC memory, WiFi powered only to upload them
+#define LP_PERIOD			10000	// ms between starts of sampling windows
+#define LP_AWAKE_MS			300		// ms sampled in every window (RMS needs a few mains cycles)
+#define LP_FLUSH_INTERVAL	300000	// ms between uplinks (5 min)...
+#define LP_UPLINK_TIMEOUT	30000	// ms ...every one limited to this, the rest is sent by the next one
+#define LP_RTC_RECORDS		64		// Records kept in RTC memory (full buffer forces uplink)
+#define LP_POWER_FEED		"/feeds/esp32-pwrmonitor.power"	// Current estimate, published with every uplink
+// Board current in every state [mA] - average is estimated from time measured in them
+#define LP_CURRENT_AWAKE	40.0f	// CPU + ADC, radio off, backlight dimmed
+#define LP_CURRENT_UPLINK	120.0f	// WiFi + TLS
+#define LP_CURRENT_SLEEP	1.2f	// Light sleep, backlight off
+
+//********************* HEALTH CONFIG *********************//
+#define HEALTH_WDT_TIMEOUT	30		// s without loop / display pass before reset (above AIO_TLS_TIMEOUT and LP_PERIOD)
+#define HEALTH_INTERVAL		60000	// ms between diagnostics messages (stage timings, heap, RSSI, reconnects)
+#define HEALTH_GROUP		"esp32-pwrmonitor-health"	// Group of diagnostics feeds
+#define HEALTH_UI_INTERVAL	1000	// ms between updates of the debug screen
+
+//********************* CALIBRATION CONFIG *********************//
+#define CAL_DEFAULT_VREF	1100	// mV, used when eFuse holds neither two-point values nor measured Vref
+#define CAL_LUT_SHIFT		6		// Calibration table knot every 2^6 ADC counts (65 knots)
+#define CAL_PATH			"/littlefs/cal.bin"	// Per-channel corrections, set by "<channel> <volts>"
+											// written to calibrate feed while the rail has known voltage
+
+//********************* CHANNELS CONFIG *********************//
+// Every measured rail is a single CHANNEL() line - acquisition, statistics, fault triggers, logging,
+// display and publishing are all driven by this table (order = order on display and in the group)
+//	CHANNEL(name, feed key, source, input, mode, scale, decimals published, filter, trigger levels)
+//		source:		CH_SRC_ADC - ESP32 ADC1 scanned at ACQ_SAMPLE_RATE, input is GPIO
+//					CH_SRC_EXT - external ADC polled in background (see EXT_ADC_TYPE), input is its channel
+//		mode:		CH_MEAN - mean over PUBLISH_INTERVAL, CH_RMS - true RMS of mains cycle (ADC only)
+//		scale:		rail volts per calibrated mV at the pin (ADC) or per count (external ADC) - default gain,
+//					replaced by calibration done on the device (see CALIBRATION CONFIG)
+//		filter:		FILT_* chain smoothing readout on display, FILT_NONE for none (ADC only)
+//		trigger:	TRIG_* levels, TRIG_NONE for none (ADC only)
+// Host tests may bring their own table with CH_COUNT (test/*_channels.h, compiler's -include)
+#ifndef CHANNEL_TABLE
+#define CHANNEL_TABLE \
+	CHANNEL("AC",	"sens-ac",	CH_SRC_ADC,	SENS_AC,	CH_RMS,		AC_VOLTS_PER_MV,	1,	FILT_NONE,	TRIG_AC) \
+	CHANNEL("12V",	"sens-12",	CH_SRC_ADC,	SENS_12,	CH_MEAN,	DC_VOLTS_PER_MV,	2,	FILT_DC,	TRIG_12) \
+	CHANNEL("5V",	"sens-5",	CH_SRC_ADC,	SENS_5,		CH_MEAN,	DC_VOLTS_PER_MV,	2,	FILT_DC,	TRIG_5) \
+	CHANNEL("3.3V",	"sens-33",	CH_SRC_ADC,	SENS_33,	CH_MEAN,	DC_VOLTS_PER_MV,	2,	FILT_DC,	TRIG_33)
+// Example of rails on ADS1115 boards (4 inputs per board, inputs 4-7 are the board at EXT_ADC_ADDR + 1...):
+//	CHANNEL("24V",	"sens-24",	CH_SRC_EXT,	0,			CH_MEAN,	EXT_VOLTS_PER_COUNT * 11,	2,	FILT_NONE,	TRIG_NONE)
+
+#define CH_COUNT			4		// CHANNEL() lines
+#endif
+#define ACQ_CHANNELS		4		// CH_SRC_ADC lines (checked at compile time) - sampled together in one scan (ADC1 has 8 pins)
+
+#define DC_VOLTS_PER_MV		0.001f	// Rail connected directly to the pin (set accordingly to divider ratio)
+
+#define EXT_ADC_TYPE		0		// 0 - none, 1 - ADS1115 on I2C (ACQ_USE_SYNTH replaces it with a synthetic one)
+#define EXT_ADC_ADDR		0x48	// I2C address of the first board
+#define EXT_VOLTS_PER_COUNT	(4.096f / 32768)	// ADS1115 at +-4.096 V range
+#define EXT_MAX_CHANNELS	16		// CH_SRC_EXT lines
+#define EXT_CONV_TIMEOUT	10		// ms after which unfinished conversion is an error (ADS1115 needs ~1.2 ms)
+
+//********************* RELAYS CONFIG *********************//
+// Every output relay is a single RELAY() line - GPIO, feeds, callbacks and display follow this table
+//	RELAY(name, command feed, pin)
+//		command feed:	path of the feed with ON/OFF/TOGGLE commands, new state is acknowledged
+//						on "<command feed>-state" (publishing to the command feed would echo back)
+#define RELAY_TABLE \
+	RELAY("AC",		"/feeds/esp32-pwrmonitor.rel-ac",	REL_AC) \
+	RELAY("12V",	"/feeds/esp32-pwrmonitor.rel-12",	REL_12) \
+	RELAY("5V",		"/feeds/esp32-pwrmonitor.rel-5",	REL_5) \
+	RELAY("3.3V",	"/feeds/esp32-pwrmonitor.rel-33",	REL_33)
+
+#define REL_COUNT			4		// RELAY() lines (4 fit on the main screen)
+
+//********************* ACQUISITION CONFIG *********************//
+#define ACQ_USE_SYNTH		0		// 1 - synthetic signals instead of ADC (testing without sensing hardware)
+#define ACQ_SAMPLE_RATE		5000	// Scans per second (every channel is sampled once per scan)
+									// ESP32 DMA needs at least 20k conversions/s, so keep it >= 20000 / channels
+#define ACQ_BLOCK_SIZE		100		// Scans processed at once (20 ms @ 5 kHz)
+#define ACQ_RING_SIZE		2048	// Scans kept in ring buffer, power of 2
+#define ACQ_READ_TIMEOUT	100		// ms
+#define ACQ_CORE			1		// Network stack runs on core 0
+#define ACQ_TASK_PRIO		3		// Above Arduino loop (1)
+#define ACQ_TASK_STACK		4096
+
+//********************* FILTER CONFIG *********************//
+// Filter chains of up to 3 stages, running in fixed point on every sample (see filter.h):
+//	CicDecimator<R, stages>	- decimates by R, stages * log2(R) <= 15
+//	MovingAverage<N>		- average of N samples
+//	OnePoleIir<k>			- low-pass, alpha = 1 / 2^k
+#define FILT_NONE			FiltNone
+#define FILT_DC				Filter< CicDecimator<16, 3>, MovingAverage<16>, OnePoleIir<2> >	// 312 Hz out, ~40 ms step delay
+
+//********************* AC MEASUREMENT CONFIG *********************//
+#define AC_VOLTS_PER_MV		0.001f	// Rail volts per mV at the pin (set accordingly to AC sensor ratio)
+#define RMS_HYSTERESIS		32		// mV around DC level ignored by zero crossing detector
+#define RMS_MAX_WINDOW		(ACQ_SAMPLE_RATE / 10)	// Window is closed after 100 ms even without crossing
+
+//********************* FAULT DETECTION CONFIG *********************//
+#define TRIG_PRE			250		// Scans kept before trigger (50 ms @ 5 kHz)
+#define TRIG_POST			250		// Scans kept after trigger
+#define TRIG_SLOTS			2		// Captures waiting for upload
+#define TRIG_FEED			"esp32-pwrmonitor.fault"	// Captured windows - volts of the faulted rail, packed (tspack.h),
+														// timestamp of a row is its sample number (matches "#<n>" of event)
+#define TRIG_UPLOAD_ROWS	100		// Window samples sent in one message (5 messages per capture)
+
+// Trigger levels in calibrated mV at the pin: low (brown-out), high (over-voltage), max step between samples. 0 - disabled
+#define TRIG_NONE			0,		0,		0
+#define TRIG_AC				0,		0,		650
+#define TRIG_12				2250,	2900,	320
+#define TRIG_5				1050,	1530,	240
+#define TRIG_33				685,	1010,	160
+
+
+//********************* DISPLAY CONFIG *********************//
+#define UI_FRAME_MS			200		// Display refresh period (only changed fields are sent)
+#define UI_CORE				0		// Display task runs beside network stack, away from acquisition
+#define UI_TASK_PRIO		1
+#define UI_TASK_STACK		4096
+#define LCD_SPI_FREQ		40000000	// Hz, hardware SPI clock
+#define BL_PWM_CHANNEL		0		// LEDC channel dimming backlight
+#define BL_PWM_FREQ			5000	// Hz
+#define BL_FULL				255		// Backlight duty after activity (fault, command)...
+#define BL_DIM				24		// ...and after BL_IDLE_MS without it
+#define BL_IDLE_MS			30000
+#define UI_PAGE_BUTTON		0		// Button switching to debug screen (active low, T-Display left one), -1 - none
 
 
 //********************* HARDWARE *********************//
@@ -35,16 +213,21 @@
 #endif
 
 // Output relays GPIO
-#define REL_AC
-#define REL_12
-#define REL_5
-#define REL_33
+#define REL_AC			25
+#define REL_12			26
+#define REL_5			27
+#define REL_33			13
+#define REL_ACTIVE_HIGH	1		// 0 - relay modules switched on by LOW level
 
-// Voltage sensing GPIO
+// Voltage sensing GPIO (ADC1 only)
 #define SENS_AC			33
 #define SENS_12			32
 #define SENS_5			35
 #define SENS_33			34
 
+// External ADC I2C bus
+#define EXT_SDA			21
+#define EXT_SCL			22
+
 // Status LED GPIO
 // #define STATUS_LED		2
@@ -0,0 +1,160 @@
+#include "display.h"
+
+
+/*!
+	@brief	Creates display without fields.
+	@param	*tft
+			Initialized LCD driver.
+*/
+Display::Display(Adafruit_ST7789* tft)
+{
+	m_tft = tft;
+	m_fieldCnt = 0;
+	m_page = UI_PAGE_MAIN;
+	m_pixels = 0;
+	memset(m_fields, 0, sizeof(m_fields));
+}
+
+/*!
+	@brief	Class destructor.
+*/
+Display::~Display()
+{
+	for(uint8_t i = 0; i < m_fieldCnt; i++)
+		delete m_fields[i].canvas;
+}
+
+/*!
+	@brief		Adds dynamic field, its buffer is allocated once here (w * h * 2 bytes).
+	@param		x, y
+				Top left corner on the LCD.
+	@param		w
+				Width in pixels - longer text is cut.
+	@param		size
+				Text size, field height is one line of it.
+	@param		bg
+				Background colour, must match the screen around the field.
+	@param		page
+				Page the field is shown on.
+	@returns	Field index, -1 if there is no room for another one.
+*/
+int8_t Display::addField(int16_t x, int16_t y, uint16_t w, uint8_t size, uint16_t bg, uint8_t page)
+{
+	if(m_fieldCnt >= UI_MAX_FIELDS)
+		return -1;
+
+	ui_field_t* _f = &m_fields[m_fieldCnt];
+	_f->x = x;
+	_f->y = y;
+	_f->w = w;
+	_f->h = UI_CHAR_H * size;
+	_f->size = size;
+	_f->bg = bg;
+	_f->page = page;
+	_f->canvas = new GFXcanvas16(_f->w, _f->h);
+	_f->canvas->setTextSize(size);
+	_f->canvas->setTextWrap(false);
+	_f->dirty = true;
+	return m_fieldCnt++;
+}
+
+/*!
+	@brief	Sets field's text. Field is marked for redraw only if text or colour differ from the shown ones.
+	@param	field
+			Field index returned by addField().
+	@param	*text
+			New text.
+	@param	color
+			Text colour (RGB565).
+*/
+void Display::setText(uint8_t field, const char* text, uint16_t color)
+{
+	if(field >= m_fieldCnt || !text)
+		return;
+
+	ui_field_t* _f = &m_fields[field];
+	if(_f->color == color && strncmp(_f->text, text, UI_TEXT_LEN - 1) == 0)
+		return;
+
+	strlcpy(_f->text, text, UI_TEXT_LEN);
+	_f->color = color;
+	_f->dirty = true;
+}
+
+/*!
+	@brief	Sets field to a number with unit (e.g. "12.0V").
+			Formatted text is compared, so noise below shown precision doesn't cause redraw.
+*/
+void Display::setValue(uint8_t field, float value, uint8_t decimals, const char* unit, uint16_t color)
+{
+	char _buf[UI_TEXT_LEN];
+
+	snprintf(_buf, sizeof(_buf), "%.*f%s", decimals, value, unit ? unit : "");
+	setText(field, _buf, color);
+}
+
+/*!
+	@brief		Renders changed fields of the shown page into their buffers and pushes them to the LCD as partial windows.
+	@returns	Number of pushed fields.
+*/
+uint8_t Display::refresh()
+{
+	uint8_t _pushed = 0;
+
+	for(uint8_t i = 0; i < m_fieldCnt; i++)
+	{
+		ui_field_t* _f = &m_fields[i];
+		if(!_f->dirty || _f->page != m_page)
+			continue;
+
+		_f->canvas->fillScreen(_f->bg);
+		_f->canvas->setCursor(0, 0);
+		_f->canvas->setTextColor(_f->color);
+		_f->canvas->print(_f->text);
+
+		m_tft->drawRGBBitmap(_f->x, _f->y, _f->canvas->getBuffer(), _f->w, _f->h);
+		m_pixels += (uint32_t)_f->w * _f->h;
+		_f->dirty = false;
+		_pushed++;
+	}
+	return _pushed;
+}
+
+/*!
+	@brief	Marks all fields for redraw (e.g. after the LCD was cleared or reset).
+*/
+void Display::invalidate()
+{
+	for(uint8_t i = 0; i < m_fieldCnt; i++)
+		m_fields[i].dirty = true;
+}
+
+/*!
+	@brief	Switches shown page - its fields are redrawn by the next refresh().
+			Static elements of the page are the caller's job (LCD is drawn over, not cleared here).
+	@param	page
+			UI_PAGE_* to show.
+*/
+void Display::setPage(uint8_t page)
+{
+	m_page = page;
+	for(uint8_t i = 0; i < m_fieldCnt; i++)
+		if(m_fields[i].page == page)
+			m_fields[i].dirty = true;
+}
+
+/*!
+	@returns	Shown page.
+*/
+uint8_t Display::page() const
+{
+	return m_page;
+}
+
+/*!
+	@returns	Number of pixels sent to the LCD since start.
+*/
+uint32_t Display::pixelsPushed() const
+{
+	return m_pixels;
+}
@@ -0,0 +1,97 @@
+/*
+	Retained-mode UI on the ST7789 LCD.
+	Static elements (labels, lines) are drawn straight to the LCD once, every dynamic field
+	owns a small canvas and is redrawn and pushed only when its text or colour changes.
+	Fields belong to pages (screens) - only the shown page is pushed, the rest wait for it.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+
+#include "config.h"
+#include "acquire.h"
+#include "health.h"
+#include "snapshot.h"
+
+#include <Adafruit_ST7789.h>
+#include <Adafruit_GFX.h>
+
+
+#define UI_MAX_FIELDS		(8 + CH_COUNT + HL_STAGES + 6)	// Status, fault, relays, a value per channel and debug screen
+#define UI_TEXT_LEN			24
+#define UI_CHAR_W			6		// Default font cell at text size 1
+#define UI_CHAR_H			8
+
+// Pages
+#define UI_PAGE_MAIN		0		// Measurements and relays
+#define UI_PAGE_HEALTH		1		// Debug screen - stage timings and system counters
+
+
+/*!
+	@brief	Dynamic text field with its own off-screen buffer.
+*/
+typedef struct
+{
+	int16_t x;
+	int16_t y;
+	uint16_t w;
+	uint16_t h;
+	uint8_t size;					// Text size (font scale)
+	uint8_t page;
+	uint16_t bg;
+	uint16_t color;
+	char text[UI_TEXT_LEN];
+	bool dirty;						// Changed since last refresh()
+	GFXcanvas16* canvas;
+} ui_field_t;
+
+
+/*!
+	@brief	Everything shown on the display, handed over from the main loop to the display task.
+*/
+typedef struct
+{
+	float sens[CH_COUNT];			// Channel values [V]
+	uint8_t relays;					// Bitmask of relay states
+	bool connected;
+	char fault[UI_TEXT_LEN];		// Last fault, empty - none
+	uint8_t page;					// Page to show
+	health_report_t health;			// Shown on UI_PAGE_HEALTH
+} ui_data_t;
+
+
+// ############################################################################
+/*!
+	@brief	Display of dynamic fields - only changed ones are rendered and sent over SPI.
+*/
+class Display
+{
+public:
+	Display(Adafruit_ST7789* tft);
+	~Display();
+
+	int8_t addField(int16_t x, int16_t y, uint16_t w, uint8_t size, uint16_t bg = ST77XX_BLACK, uint8_t page = UI_PAGE_MAIN);
+	void setText(uint8_t field, const char* text, uint16_t color);
+	void setValue(uint8_t field, float value, uint8_t decimals, const char* unit, uint16_t color);
+
+	uint8_t refresh();
+	void invalidate();
+
+	void setPage(uint8_t page);
+	uint8_t page() const;
+
+	uint32_t pixelsPushed() const;
+
+private:
+	Adafruit_ST7789* m_tft;
+	ui_field_t m_fields[UI_MAX_FIELDS];
+	uint8_t m_fieldCnt;
+	uint8_t m_page;					// Shown page
+	uint32_t m_pixels;				// Pixels sent to LCD since start
+};
+
+
+#endif // DISPLAY_H
@@ -1,6 +1,38 @@
 
 
 #include "esp_aio.h"
+#include "tspack.h"
+
+#include <new>
+
+
+#if (AIO_FAST_RECONNECT == 1)
+#define AIO_AP_MAGIC		0x41504331		// "APC1"
+
+/*!
+	@brief	Access point of the last connection. Lives in RTC slow memory - kept over deep sleep, cleared on power loss.
+*/
+typedef struct
+{
+	uint32_t magic;
+	uint32_t ssidHash;			// Cache is valid only for the same network
+	uint8_t bssid[6];
+	int32_t channel;
+} aio_ap_cache_t;
+
+static RTC_DATA_ATTR aio_ap_cache_t s_apCache;
+
+/*!
+	@returns	FNV-1a hash of a string.
+*/
+static uint32_t _hash(const char* str)
+{
+	uint32_t _h = 2166136261UL;
+	while(*str)
+		_h = (_h ^ (uint8_t)*str++) * 16777619UL;
+	return _h;
+}
+#endif
 
 
 /*!
@@ -25,8 +57,24 @@ ESP_AIO_Client::ESP_AIO_Client(const char* ssid, const char* pass, const char* u
 	m_status = AIO_NET_DISCONNECTED;
 	m_client = new WiFiClientSecure();
 	m_mqtt_client = new Adafruit_MQTT_Client(m_client, m_host, PORT_SECURE, m_username, m_key);
-	m_pub_topic = nullptr;
-	m_sub_topic = nullptr;
+	m_pubCnt = 0;
+	m_subCnt = 0;
+	m_grpCnt = 0;
+	m_state = AIO_STATE_IDLE;
+	m_retryState = AIO_STATE_IDLE;
+	m_stateSince = 0;
+	m_backoff = AIO_BACKOFF_MIN;
+	m_retryDelay = 0;
+	m_reconnects = 0;
+	m_lastSent = 0;
+	m_lastPub = 0;
+	m_cadence = PUBLISH_INTERVAL * AIO_GROUP_BATCH;	// Until messages are actually sent
+	m_keepAlive = 0;
+	m_pings = 0;
+	m_rxStart = 0;
+	m_queued = 0;
+	m_coalesced = 0;
+	memset(m_queue, 0, sizeof(m_queue));
 }
 
 /*!
@@ -43,55 +91,32 @@ ESP_AIO_Client::~ESP_AIO_Client()
 	if(m_mqtt_client)
 		delete m_mqtt_client;
 
-	if(m_pub_topic)
-		free(m_pub_topic);
+	// Pooled objects were created with placement new
+	for(uint8_t i = 0; i < m_pubCnt; i++)
+		((AIO_Publish*)m_pubPool[i])->~AIO_Publish();
 
-	if(m_sub_topic)
-		free(m_sub_topic);
+	for(uint8_t i = 0; i < m_subCnt; i++)
+		((AIO_Subscribe*)m_subPool[i])->~AIO_Subscribe();
+
+	for(uint8_t i = 0; i < m_grpCnt; i++)
+		((AIO_Group*)m_grpPool[i])->~AIO_Group();
 }
 
 /*!
-	@brief	Initializes a connection to WiFi and AIO.
-			At first it tries to connect to a WiFi network - there are MAX_CONN_ATTEMPTS attempts.
-			If succeed, it makes MAX_CONN_ATTEMPTS / 2 attempts to connect to AIO.
+	@brief	Starts connecting to WiFi and AIO. Non-blocking - connection is established
+			(and re-established after every drop) by poll().
 */
 void ESP_AIO_Client::connect()
 {
 	DPRINT("[CONNECT] ");
 
-	_initNet();
-
-	if(m_isConnected)
+	if(m_state != AIO_STATE_IDLE)
 	{
-		DPRINT("Already connected to %s!\n", m_host);
+		DPRINT("Already connected or connecting to %s!\n", m_host);
 		return;
 	}
-	if(m_netEstablished)
-	{
-		DPRINT("Attempting connect to %s...\n", m_host);
-		uint8_t _attempts = MAX_CONN_ATTEMPTS / 2;
-		int8_t _ret;
-		while((_ret = m_mqtt_client->connect()) != 0)
-		{
-			DPRINT("Atempt %d\n", _attempts);
-			DPRINT("MQTT error: %s\n", m_mqtt_client->connectErrorString(_ret));
-			m_mqtt_client->disconnect();
-			delay(RETRY_DELAY * 6);
-			if(_attempts <= 0)
-			{
-				DPRINT("Failed to connect to the host: %s\n", m_host);
-				m_mqtt_client->disconnect();
-				m_status = AIO_CONNECT_FAILED;
-				return;
-			}
-			_attempts--;
-		}
-		m_status = AIO_CONNECTED;
-		m_isConnected = true;
-		DPRINT("MQTT connected!\n");
-	}
-	else
-		DPRINT("Can't connect to MQTT - internet connection not established!");
+	m_backoff = AIO_BACKOFF_MIN;
+	_initNet();
 }
 
 /*!
@@ -112,12 +137,13 @@ void ESP_AIO_Client::disconnect()
 	delay(AIO_NET_DISCONNECT_WAIT);
 	m_status = _netStatus();
 	m_netEstablished = false;
+	_setState(AIO_STATE_IDLE, millis());
 	DPRINT("Disconnected from network!\n");
 }
 
 /*!
-	@brief		Keeps MQTT connection alive by constantly pinging the server.
-	@warning	Use it ONLY if you're sending requests once every KEEPALIVE seconds (~5 mins).
+	@brief		Checks if the broker responds (blocks until it answers or MQTT library's ping timeout).
+				Not needed to keep connection alive - poll() pings by itself when nothing was sent for too long.
 	@returns	True if server is responding. Otherwise false.
 */
 bool ESP_AIO_Client::ping()
@@ -125,7 +151,11 @@ bool ESP_AIO_Client::ping()
 	if(m_isConnected)
 	{
 		if(m_mqtt_client->ping())
+		{
+			m_lastSent = millis();
+			m_pings++;
 			return true;
+		}
 		else
 		{
 			DPRINT("[PING] Error: No response from server!\n");
@@ -193,6 +223,48 @@ const char* ESP_AIO_Client::statusString() const
 	}
 }
 
+/*!
+	@brief		Returns step of the connection state machine.
+	@returns	aio_state_t
+*/
+aio_state_t ESP_AIO_Client::getState() const
+{
+	return m_state;
+}
+
+/*!
+	@returns	Number of connection drops (WiFi or MQTT) since start.
+*/
+uint32_t ESP_AIO_Client::reconnects() const
+{
+	return m_reconnects;
+}
+
+/*!
+	@returns	MQTT keepalive of the current (or the last) connection [s].
+*/
+uint16_t ESP_AIO_Client::keepAlive() const
+{
+	return m_keepAlive;
+}
+
+/*!
+	@returns	Pings sent because connection was idle (or by ping()).
+*/
+uint32_t ESP_AIO_Client::pings() const
+{
+	return m_pings;
+}
+
+/*!
+	@returns	micros() when the current poll() started reading incoming packets - subscription callbacks
+				use it as receipt time of their message (TLS record read and decrypted, then parsed).
+*/
+uint32_t ESP_AIO_Client::rxTime() const
+{
+	return m_rxStart;
+}
+
 /*!
 	@brief		Returns WiFi connection status.
 	@returns 	True if connected to WIFi. Otherwise false.
@@ -214,39 +286,84 @@ bool ESP_AIO_Client::hostConnected() const
 
 /*!
 	@brief		Creates AIO_Publish object that allows to send data to AIO and returns reference to it.
+				Object and its topic come from fixed pools, so it's safe to call from global constructors.
 	@param		*path
 				Path to AIO-side feed topic.
-	@returns	AIO_Publish*
+	@returns	AIO_Publish* or nullptr if pool is exhausted.
 */
 AIO_Publish* ESP_AIO_Client::makePublisher(const char *path)
 {
-	if(!path)
+	if(!path || m_pubCnt >= AIO_MAX_PUBLISHERS)
 		return nullptr;
 
-	m_pub_topic = (char*)malloc(sizeof(char) * (strlen(m_username) + strlen(path) + 1));
-	strcpy(m_pub_topic, m_username);
-	strcat(m_pub_topic, path);
-	return new AIO_Publish(m_mqtt_client, m_pub_topic);
+	const char* _topic = m_topics.intern(m_username, path);
+	if(!_topic)
+		return nullptr;
+	return new(m_pubPool[m_pubCnt++]) AIO_Publish(m_mqtt_client, _topic);
 }
 
 /*!
 	@brief		Creates AIO_Subscribe object that allows to receive data from AIO and returns reference to it.
 	@param		*path
 				Path to AIO-side feed topic.
-	@returns	AIO_Subscribe*
+	@returns	AIO_Subscribe* or nullptr if pool is exhausted.
 */
 AIO_Subscribe* ESP_AIO_Client::makeSubscriber(const char *path)
 {
-	if(!path)
+	if(!path || m_subCnt >= AIO_MAX_SUBSCRIBERS)
+		return nullptr;
+
+	const char* _topic = m_topics.intern(m_username, path);
+	if(!_topic)
+		return nullptr;
+	return new(m_subPool[m_subCnt++]) AIO_Subscribe(m_mqtt_client, _topic);
+}
+
+/*!
+	@brief		Creates AIO_Group object that allows to send values of many feeds in a single message.
+	@param		*name
+				Group key.
+	@param		batch
+				Rows sent in one message.
+	@returns	AIO_Group* or nullptr if pool is exhausted.
+*/
+AIO_Group* ESP_AIO_Client::attachGroup(const char *name, uint8_t batch)
+{
+	char _path[64];
+
+	if(!name || m_grpCnt >= AIO_MAX_GROUPS)
+		return nullptr;
+
+	snprintf(_path, sizeof(_path), "/groups/%s", name);
+	const char* _topic = m_topics.intern(m_username, _path);
+	if(!_topic)
+		return nullptr;
+	return new(m_grpPool[m_grpCnt++]) AIO_Group(m_mqtt_client, _topic, batch);
+}
+
+/*!
+	@brief		Creates AIO_Group object that sends rows packed (tspack.h) as text value of a single feed.
+	@param		*feed
+				Feed key.
+	@param		batch
+				Rows collected before publishing (as many as fit go in one message).
+	@returns	AIO_Group* or nullptr if pool is exhausted.
+*/
+AIO_Group* ESP_AIO_Client::attachPacked(const char *feed, uint8_t batch)
+{
+	char _path[64];
+
+	if(!feed || m_grpCnt >= AIO_MAX_GROUPS)
 		return nullptr;
 
-	m_sub_topic = (char*)malloc(sizeof(char) * (strlen(m_username) + strlen(path) + 1));
-	strcpy(m_sub_topic, m_username);
-	strcat(m_sub_topic, path);
-	return new AIO_Subscribe(m_mqtt_client, m_sub_topic);
+	snprintf(_path, sizeof(_path), "/feeds/%s", feed);
+	const char* _topic = m_topics.intern(m_username, _path);
+	if(!_topic)
+		return nullptr;
+	return new(m_grpPool[m_grpCnt++]) AIO_Group(m_mqtt_client, _topic, batch, true);
 }
 
-// TODO: Implement interface for handling Feed & Group topics
+// TODO: Implement interface for handling Feed topics
 // AIO_Feed* ESP_AIO_Client::attachFeed(const char *feedName)
 // {
 // 	if(!feedName)
@@ -255,56 +372,399 @@ AIO_Subscribe* ESP_AIO_Client::makeSubscriber(const char *path)
 // 	return nullptr;
 // }
 
-// AIO_Group* ESP_AIO_Client::attachGroup(const char *groupName)
-// {
-// 	if (!groupName)
-// 		return nullptr;
-//
-// 	return nullptr;
-// }
+/*!
+	@brief		Queues numeric value for upload. If the feed is already waiting, its value is replaced
+				(only the latest one is worth sending), so the queue never grows above one slot per feed.
+	@param		*pub
+				Feed publisher.
+	@param		value
+				Value to be sent.
+	@param		precision
+				Decimal places sent.
+	@returns	False if queue is full.
+*/
+bool ESP_AIO_Client::enqueue(AIO_Publish* pub, float value, uint8_t precision)
+{
+	aio_pending_t* _item = _slot(pub, nullptr);
+	if(!_item)
+		return false;
+
+	_item->value = value;
+	_item->precision = precision;
+	_item->text[0] = '\0';
+	return true;
+}
+
+/*!
+	@brief		Queues text value for upload, replacing one still waiting for the same feed.
+	@param		*pub
+				Feed publisher.
+	@param		*text
+				Text to be sent (copied, truncated to AIO_QUEUE_TEXT - 1 characters).
+	@param		coalesce
+				False for event feeds - every text takes its own slot and they are sent in order
+				(a burst of faults or messages isn't squashed into the last one).
+	@returns	False if queue is full.
+*/
+bool ESP_AIO_Client::enqueue(AIO_Publish* pub, const char* text, bool coalesce)
+{
+	if(!text)
+		return false;
+
+	aio_pending_t* _item = _slot(pub, nullptr, coalesce);
+	if(!_item)
+		return false;
+
+	strlcpy(_item->text, text, sizeof(_item->text));
+	return true;
+}
+
+/*!
+	@brief		Queues group for upload. Rows committed until the group gets a token are sent together.
+	@param		*group
+				Group with committed rows.
+	@returns	False if queue is full or group has nothing to send.
+*/
+bool ESP_AIO_Client::enqueue(AIO_Group* group)
+{
+	if(!group || group->rows() == 0)
+		return false;
+
+	return _slot(nullptr, group) != nullptr;
+}
+
+/*!
+	@brief		Non-blocking service of the connection - advances connection state machine,
+				handles incoming packets and sends queued values as long as rate limit allows.
+				Should be called from the main loop as often as possible. Two steps wait longer than
+				timeout_ms: TLS handshake of a new connection and keepalive ping of an idle one (see _keepAliveTick()).
+	@param		timeout_ms
+				Time spent waiting for incoming packets.
+	@returns	Number of messages sent.
+*/
+uint8_t ESP_AIO_Client::poll(uint16_t timeout_ms)
+{
+	uint8_t _sent = 0;
+
+	_tick(millis());
+	if(!m_isConnected)
+		return 0;
+
+	m_rxStart = micros();
+	m_mqtt_client->processPackets(timeout_ms);
+
+	while(m_queued > 0)
+	{
+		aio_pending_t _item = m_queue[0];
+
+		// Group has nothing left (e.g. its only row was dropped) - doesn't need a token
+		if(_item.group && _item.group->rows() == 0)
+		{
+			m_queued--;
+			memmove(&m_queue[0], &m_queue[1], sizeof(aio_pending_t) * m_queued);
+			continue;
+		}
+
+		if(!m_bucket.take(millis()))
+			break;
+
+		// Failed item stays at the head and is retried with the next token
+		if(!_send(&_item))
+		{
+			DPRINT("[POLL] Error: publish failed, %d values waiting\n", m_queued);
+			break;
+		}
+
+		m_queued--;
+		memmove(&m_queue[0], &m_queue[1], sizeof(aio_pending_t) * m_queued);
+		_sent++;
+
+		// Slowly decaying peak of gaps - bursts (e.g. relay acks) don't make keepalive short
+		uint32_t _now = millis();
+		m_cadence -= m_cadence / 8;
+		if(_now - m_lastPub > m_cadence)
+			m_cadence = _now - m_lastPub;
+		m_lastPub = m_lastSent = _now;
+
+		// Group rows which didn't fit into one message go after the other waiting items
+		if(_item.group && _item.group->rows() > 0)
+			m_queue[m_queued++] = _item;
+	}
+
+	_keepAliveTick(millis());
+	return _sent;
+}
 
 /*!
-	@brief	[INTERNAL METHOD] Initializes WiFi connection.
+	@returns	Number of feeds / groups waiting for upload.
+*/
+uint8_t ESP_AIO_Client::pending() const
+{
+	return m_queued;
+}
+
+/*!
+	@returns	True if group has a queue slot (waits for a token or for the broker to take it).
+*/
+bool ESP_AIO_Client::queued(const AIO_Group* group) const
+{
+	for(uint8_t i = 0; i < m_queued; i++)
+	{
+		if(m_queue[i].group == group)
+			return true;
+	}
+	return false;
+}
+
+/*!
+	@returns	Number of values replaced by newer ones before they were sent.
+*/
+uint32_t ESP_AIO_Client::coalesced() const
+{
+	return m_coalesced;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Starts WiFi association, poll() waits for its result.
 */
 void ESP_AIO_Client::_initNet()
 {
 	DPRINT("[NET INIT] ");
-	if(m_netEstablished)
-		return;
 	
 	if(strlen(m_ssid) == 0)
 	{
 		m_status = AIO_SSID_INVALID;
 		DPRINT("Error: %s\n", statusString());
+		_setState(AIO_STATE_IDLE, millis());
+		return;
 	}
-	else
-	{
-		DPRINT("Connecting to SSID: %s...\n", m_ssid);
-		uint8_t _attempts = MAX_CONN_ATTEMPTS;
 
-		WiFi.begin(m_ssid, m_password);
+	DPRINT("Connecting to SSID: %s...\n", m_ssid);
+	m_netEstablished = false;
+	m_status = AIO_NET_DISCONNECTED;
+	_netBegin();
+	_setState(AIO_STATE_NET_WAIT, millis());
+}
 
-		while (_netStatus() != AIO_NET_CONNECTED)
+/*!
+	@brief	[INTERNAL METHOD] Advances connection state machine. Every step returns immediately,
+			except MQTT connect which is limited by AIO_TLS_TIMEOUT.
+			Adafruit_MQTT::connect() subscribes all registered topics again, so nothing is lost on reconnect.
+	@param	now
+			Current time (millis()).
+*/
+void ESP_AIO_Client::_tick(uint32_t now)
+{
+	switch(m_state)
+	{
+	case AIO_STATE_NET_WAIT:
+		if(_netUp())
 		{
-		DPRINT("Atempt %d\n", _attempts);
-		if (_attempts <= 0)
+			m_netEstablished = true;
+			m_status = AIO_NET_CONNECTED;
+			m_client->setCACert(m_aio_ca);
+			m_client->setHandshakeTimeout(AIO_TLS_TIMEOUT);
+			configTime(0, 0, NTP_SERVER);	// UTC, used for timestamps of batched measurements
+#if (AIO_FAST_RECONNECT == 1)
+			s_apCache.magic = AIO_AP_MAGIC;
+			s_apCache.ssidHash = _hash(m_ssid);
+			memcpy(s_apCache.bssid, WiFi.BSSID(), sizeof(s_apCache.bssid));
+			s_apCache.channel = WiFi.channel();
+#endif
+			DPRINT("[NET] WiFi connection established!\n");
+			DPRINT("[NET] Current IP: %s\n", WiFi.localIP().toString().c_str());
+			_setState(AIO_STATE_HOST_CONNECT, now);
+		}
+		else if(now - m_stateSince >= AIO_NET_TIMEOUT)
 		{
-			DPRINT("Failed to connect to WiFi!\n");
-			WiFi.disconnect(); // Also resets device (setting default state)
+			DPRINT("[NET] Failed to connect to WiFi!\n");
+			WiFi.disconnect();
+#if (AIO_FAST_RECONNECT == 1)
+			s_apCache.magic = 0;		// AP may have moved to another channel - the next attempt scans
+#endif
 			m_status = AIO_NET_CONNECT_FAILED;
-			return;
+			_retry(AIO_STATE_NET_WAIT, now);
+		}
+		break;
+
+	case AIO_STATE_HOST_CONNECT:
+	{
+		if(!_netUp())
+		{
+			m_netEstablished = false;
+			m_status = AIO_NET_DISCONNECTED;
+			_retry(AIO_STATE_NET_WAIT, now);
+			break;
+		}
+
+		// Keepalive is part of CONNECT packet - set from cadence measured so far
+		m_keepAlive = _keepAliveFor(m_cadence);
+		m_mqtt_client->setKeepAliveInterval(m_keepAlive);
+
+		DPRINT("[HOST] Attempting connect to %s (keepalive %u s)...\n", m_host, m_keepAlive);
+		int8_t _ret = _hostConnect();
+		if(_ret == 0)
+		{
+			m_status = AIO_CONNECTED;
+			m_isConnected = true;
+			m_backoff = AIO_BACKOFF_MIN;
+			m_lastSent = m_lastPub = millis();
+			_setState(AIO_STATE_CONNECTED, now);
+			DPRINT("[HOST] MQTT connected!\n");
 		}
 		else
-			_attempts--;
-		delay(RETRY_DELAY);
+		{
+			DPRINT("[HOST] MQTT error: %s\n", m_mqtt_client->connectErrorString(_ret));
+			m_mqtt_client->disconnect();
+			m_status = AIO_CONNECT_FAILED;
+			_retry(AIO_STATE_HOST_CONNECT, now);
+		}
+		break;
+	}
+
+	case AIO_STATE_CONNECTED:
+		if(!_netUp())
+		{
+			DPRINT("[NET] WiFi connection lost!\n");
+			m_mqtt_client->disconnect();
+			m_isConnected = false;
+			m_netEstablished = false;
+			m_status = AIO_NET_DISCONNECTED;
+			m_reconnects++;
+			_retry(AIO_STATE_NET_WAIT, now);
+		}
+		else if(!_hostUp())
+		{
+			DPRINT("[HOST] MQTT connection lost!\n");
+			m_mqtt_client->disconnect();
+			m_isConnected = false;
+			m_status = AIO_DISCONNECTED;
+			m_reconnects++;
+			_retry(AIO_STATE_HOST_CONNECT, now);
 		}
-		m_status = _netStatus();
-		m_netEstablished = true;
-		m_client->setCACert(m_aio_ca);
-		DPRINT("WiFi connection established!\n");
-		DPRINT("Current IP: %s\n", WiFi.localIP().toString().c_str());
+		break;
+
+	case AIO_STATE_BACKOFF:
+		if(now - m_stateSince < m_retryDelay)
+			break;
+
+		if(m_retryState == AIO_STATE_NET_WAIT)
+			_initNet();
+		else
+			_setState(m_retryState, now);
+		break;
+
+	default:
+		break;
 	}
-	DPRINT("Status: %s\n", statusString());
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Changes state of the connection state machine.
+*/
+void ESP_AIO_Client::_setState(aio_state_t state, uint32_t now)
+{
+	m_state = state;
+	m_stateSince = now;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Schedules retry of a failed step with exponential backoff.
+			Delay is randomized ("equal jitter"), so many devices dropped at once don't reconnect in sync.
+	@param	state
+			Step to be retried.
+*/
+void ESP_AIO_Client::_retry(aio_state_t state, uint32_t now)
+{
+	m_retryDelay = m_backoff / 2 + random(m_backoff / 2 + 1);
+	m_retryState = state;
+
+	m_backoff *= 2;
+	if(m_backoff > AIO_BACKOFF_MAX)
+		m_backoff = AIO_BACKOFF_MAX;
+
+	DPRINT("[CONNECT] %s Retry in %u ms\n", statusString(), m_retryDelay);
+	_setState(AIO_STATE_BACKOFF, now);
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Pings broker after 3/4 of keepalive without any packet sent.
+			Broker which doesn't answer is treated as lost - poll() reconnects.
+			The library waits for PINGRESP (up to its PING_TIMEOUT_MS) and reads nothing else meanwhile -
+			PINGREQ can't be split from the answer, which processPackets() would swallow. Keepalive is twice
+			the publish cadence, so a connection carrying measurements is never pinged, only an idle one.
+*/
+void ESP_AIO_Client::_keepAliveTick(uint32_t now)
+{
+	if(!m_isConnected || m_keepAlive == 0 || now - m_lastSent < m_keepAlive * 750UL)
+		return;
+
+	if(!ping())
+	{
+		m_mqtt_client->disconnect();
+		m_lastSent = now;
+	}
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Computes keepalive for a gap between messages.
+	@param		cadence
+				Gap between messages [ms].
+	@returns	Keepalive [s].
+*/
+uint16_t ESP_AIO_Client::_keepAliveFor(uint32_t cadence) const
+{
+	uint32_t _ka = (2 * cadence + 999) / 1000;
+
+	if(_ka < AIO_KEEPALIVE_MIN)
+		return AIO_KEEPALIVE_MIN;
+	if(_ka > AIO_KEEPALIVE_MAX)
+		return AIO_KEEPALIVE_MAX;
+	return _ka;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Starts WiFi association.
+*/
+void ESP_AIO_Client::_netBegin()
+{
+#if (AIO_FAST_RECONNECT == 1)
+	// Known AP - no scan, association takes tens of ms instead of seconds
+	if(s_apCache.magic == AIO_AP_MAGIC && s_apCache.ssidHash == _hash(m_ssid))
+	{
+		DPRINT("[NET] Fast reconnect (channel %d)\n", (int)s_apCache.channel);
+		WiFi.begin(m_ssid, m_password, s_apCache.channel, s_apCache.bssid);
+		return;
+	}
+#endif
+	WiFi.begin(m_ssid, m_password);
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Checks WiFi link.
+	@returns	True if associated and IP was assigned.
+*/
+bool ESP_AIO_Client::_netUp()
+{
+	return _netStatus() == AIO_NET_CONNECTED;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Connects to MQTT broker (TCP + TLS + CONNECT + SUBSCRIBE).
+	@returns	0 on success, otherwise Adafruit_MQTT error code.
+*/
+int8_t ESP_AIO_Client::_hostConnect()
+{
+	return m_mqtt_client->connect();
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Checks MQTT connection.
+	@returns	True if socket to the broker is open.
+*/
+bool ESP_AIO_Client::_hostUp()
+{
+	return m_mqtt_client->connected();
 }
 
 /*!
@@ -326,3 +786,446 @@ aio_status_t ESP_AIO_Client::_netStatus(wl_status_t net_status)
 		return AIO_NET_DISCONNECTED;
 	}
 }
+
+
+/*!
+	@brief		[INTERNAL METHOD] Finds queue slot of a feed or group, takes a new one if it isn't queued yet.
+				Queued item keeps its place, so the oldest value is always sent first.
+	@param		coalesce
+				False - always takes a new slot (FIFO of values of the same feed).
+	@returns	aio_pending_t* or nullptr if queue is full.
+*/
+ESP_AIO_Client::aio_pending_t* ESP_AIO_Client::_slot(AIO_Publish* pub, AIO_Group* group, bool coalesce)
+{
+	if(!pub && !group)
+		return nullptr;
+
+	for(uint8_t i = 0; coalesce && i < m_queued; i++)
+	{
+		if(m_queue[i].pub == pub && m_queue[i].group == group)
+		{
+			m_coalesced++;
+			return &m_queue[i];
+		}
+	}
+
+	if(m_queued >= AIO_QUEUE_SLOTS)
+	{
+		DPRINT("[QUEUE] Error: no free slot!\n");
+		return nullptr;
+	}
+
+	aio_pending_t* _item = &m_queue[m_queued++];
+	memset(_item, 0, sizeof(aio_pending_t));
+	_item->pub = pub;
+	_item->group = group;
+	return _item;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Publishes single queued item.
+	@returns	True if message was sent.
+*/
+bool ESP_AIO_Client::_send(const aio_pending_t* item)
+{
+	if(item->group)
+		return item->group->publish();
+	if(item->text[0])
+		return item->pub->publish(item->text);
+	return item->pub->publish(item->value, item->precision);
+}
+
+
+// ############################################################################
+/*!
+	@brief	Creates an empty group.
+	@param	*mqtt
+			MQTT client used for publishing.
+	@param	*topic
+			Full group topic ("<user>/groups/<group>").
+	@param	batch
+			Rows sent in one message.
+	@param	packed
+			Rows are sent in compact encoding instead of JSON (topic is then a feed).
+*/
+AIO_Group::AIO_Group(Adafruit_MQTT_Client* mqtt, const char* topic, uint8_t batch, bool packed)
+{
+	m_mqtt = mqtt;
+	m_topic = topic;
+	m_feedCnt = 0;
+	m_batch = batch ? batch : 1;
+	m_rowCnt = 0;
+	m_packed = packed;
+	m_rows = new aio_row_t[m_batch];
+	memset(m_rows, 0, sizeof(aio_row_t) * m_batch);
+}
+
+/*!
+	@brief	Class destructor.
+*/
+AIO_Group::~AIO_Group()
+{
+	delete[] m_rows;
+}
+
+/*!
+	@brief		Adds feed to the group.
+	@param		*key
+				Feed key inside the group (e.g. "sens-ac" for "<group>.sens-ac").
+	@returns	Feed index used by set(), -1 if group is full.
+*/
+int8_t AIO_Group::addFeed(const char* key)
+{
+	if(!key || m_feedCnt >= AIO_GROUP_MAX_FEEDS)
+		return -1;
+
+	m_keys[m_feedCnt] = key;
+	return m_feedCnt++;
+}
+
+/*!
+	@brief	Sets value of a feed in the current row.
+	@param	feed
+			Feed index returned by addFeed().
+	@param	value
+			Value to be sent.
+	@param	precision
+			Decimal places sent.
+*/
+void AIO_Group::set(uint8_t feed, float value, uint8_t precision)
+{
+	if(feed >= m_feedCnt)
+		return;
+
+	// Batch is full and still waiting for upload - the oldest row gives way to the new one
+	if(m_rowCnt >= m_batch)
+	{
+		m_rowCnt--;
+		memmove(&m_rows[0], &m_rows[1], sizeof(m_rows[0]) * m_rowCnt);
+		memset(&m_rows[m_rowCnt], 0, sizeof(m_rows[0]));
+	}
+
+	m_rows[m_rowCnt].values[feed] = value;
+	m_rows[m_rowCnt].precision[feed] = precision;
+	m_rows[m_rowCnt].setMask |= (1UL << feed);
+}
+
+/*!
+	@brief		Closes the current row.
+	@param		timestamp
+				UNIX time of the row, 0 - no timestamp (broker assigns time of arrival).
+	@returns	True if batch is full and should be published.
+*/
+bool AIO_Group::commit(time_t timestamp)
+{
+	if(m_rowCnt < m_batch && m_rows[m_rowCnt].setMask)
+	{
+		m_rows[m_rowCnt].timestamp = timestamp;
+		m_rowCnt++;
+	}
+	return m_rowCnt >= m_batch;
+}
+
+/*!
+	@brief		Sends committed rows in one message and clears them.
+				Single row: {"feeds":{"key":"value",...}[,"created_at":"..."]}, more rows: JSON array of them.
+				Packed group sends base64 of TsEncoder message instead.
+				Rows which don't fit into AIO_GROUP_PAYLOAD stay for the next message, all of them stay if sending failed.
+	@returns	True if message was sent.
+*/
+bool AIO_Group::publish()
+{
+	if(m_rowCnt == 0)
+		return false;
+
+	uint8_t _rows = 0;
+	const char* _msg = m_packed ? _printPacked(&_rows) : _printJson(&_rows);
+
+	if(_rows == 0)
+	{
+		// Would block the group forever
+		DPRINT("[GROUP] Error: row doesn't fit in %d bytes, dropped!\n", AIO_GROUP_PAYLOAD);
+		m_rowCnt--;
+		memmove(&m_rows[0], &m_rows[1], sizeof(aio_row_t) * m_rowCnt);
+		memset(&m_rows[m_rowCnt], 0, sizeof(aio_row_t));
+		return false;
+	}
+
+	// Rows are kept until the broker took them - failed message is printed again with the next token
+	if(!m_mqtt->publish(m_topic, _msg))
+		return false;
+
+	m_rowCnt -= _rows;
+	memmove(&m_rows[0], &m_rows[_rows], sizeof(aio_row_t) * m_rowCnt);
+	memset(&m_rows[m_rowCnt], 0, sizeof(aio_row_t) * (m_batch - m_rowCnt));
+	return true;
+}
+
+/*!
+	@returns	Number of committed rows waiting for publish().
+*/
+uint8_t AIO_Group::rows() const
+{
+	return m_rowCnt;
+}
+
+/*!
+	@returns	Group topic.
+*/
+const char* AIO_Group::topic() const
+{
+	return m_topic;
+}
+
+/*!
+	@returns	Key of a feed, nullptr if there is no such feed.
+*/
+const char* AIO_Group::key(uint8_t feed) const
+{
+	return (feed < m_feedCnt) ? m_keys[feed] : nullptr;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Prints committed rows as JSON into payload buffer.
+	@param		*rows
+				Number of rows which fit.
+	@returns	Message text.
+*/
+const char* AIO_Group::_printJson(uint8_t* rows)
+{
+	size_t _len = 0;
+	uint8_t _rows = 0;
+
+	m_payload[_len++] = '[';
+	while(_rows < m_rowCnt)
+	{
+		// Room for separator, closing bracket and terminator
+		int _n = _printRow(&m_payload[_len], sizeof(m_payload) - _len - 2, _rows);
+		if(_n < 0)
+			break;
+		_len += _n;
+		m_payload[_len++] = ',';
+		_rows++;
+	}
+
+	*rows = _rows;
+	if(_rows == 0)
+		return nullptr;
+
+	// Trailing comma is replaced - single row is sent as plain object, more as array
+	if(_rows == 1)
+	{
+		m_payload[_len - 1] = '\0';
+		return &m_payload[1];
+	}
+	m_payload[_len - 1] = ']';
+	m_payload[_len] = '\0';
+	return m_payload;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Packs committed rows into payload buffer (base64 text).
+				Timestamps go as they are (0 - not set, seconds since 1970 otherwise).
+	@param		*rows
+				Number of rows which fit.
+	@returns	Message text.
+*/
+const char* AIO_Group::_printPacked(uint8_t* rows)
+{
+	uint8_t _raw[TSPACK_RAW_SIZE(AIO_GROUP_PAYLOAD)];
+	uint8_t _dec[AIO_GROUP_MAX_FEEDS];
+	TsEncoder _enc(_raw, sizeof(_raw));
+
+	// Precision is fixed per feed in the message - the one of its first value is taken
+	for(uint8_t f = 0; f < m_feedCnt; f++)
+	{
+		_dec[f] = 2;
+		for(uint8_t r = 0; r < m_rowCnt; r++)
+		{
+			if(m_rows[r].setMask & (1UL << f))
+			{
+				_dec[f] = m_rows[r].precision[f];
+				break;
+			}
+		}
+	}
+
+	*rows = 0;
+	if(!_enc.begin(m_feedCnt, _dec))
+		return nullptr;
+
+	while(*rows < m_rowCnt && _enc.add((uint32_t)m_rows[*rows].timestamp, m_rows[*rows].values, m_rows[*rows].setMask))
+		(*rows)++;
+
+	size_t _len = _enc.finish();
+	if(*rows == 0 || !tspack_base64(_raw, _len, m_payload, sizeof(m_payload)))
+	{
+		*rows = 0;
+		return nullptr;
+	}
+	return m_payload;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Prints single row as JSON object.
+	@returns	Number of printed characters or -1 if it doesn't fit.
+*/
+int AIO_Group::_printRow(char* dst, size_t len, uint8_t row)
+{
+	bool _first = true;
+	int _n = snprintf(dst, len, "{\"feeds\":{");
+	size_t _pos = _n;
+
+	for(uint8_t f = 0; f < m_feedCnt; f++)
+	{
+		if(!(m_rows[row].setMask & (1UL << f)))
+			continue;
+		if(_pos >= len)
+			return -1;
+
+		_n = snprintf(&dst[_pos], len - _pos, "%s\"%s\":\"%.*f\"", _first ? "" : ",",
+			m_keys[f], (int)m_rows[row].precision[f], m_rows[row].values[f]);
+		if(_n < 0)
+			return -1;
+		_pos += _n;
+		_first = false;
+	}
+	if(_pos >= len)
+		return -1;
+
+	if(m_rows[row].timestamp)
+	{
+		char _time[24];
+		struct tm _tm;
+		gmtime_r(&m_rows[row].timestamp, &_tm);
+		strftime(_time, sizeof(_time), "%Y-%m-%dT%H:%M:%SZ", &_tm);
+		_n = snprintf(&dst[_pos], len - _pos, "},\"created_at\":\"%s\"}", _time);
+	}
+	else
+		_n = snprintf(&dst[_pos], len - _pos, "}}");
+
+	if(_n < 0 || _pos + _n >= len)
+		return -1;
+	return _pos + _n;
+}
+
+
+// ############################################################################
+/*!
+	@brief	Creates a full token bucket.
+	@param	per_minute
+			Refill rate (messages per minute).
+	@param	burst
+			Bucket capacity - messages which can be sent back-to-back.
+*/
+AIO_TokenBucket::AIO_TokenBucket(uint16_t per_minute, uint8_t burst)
+{
+	m_rate = per_minute ? per_minute : 1;
+	m_capacity = (burst ? burst : 1) * ONE;
+	m_level = m_capacity;
+	m_last = 0;
+}
+
+/*!
+	@brief		Takes one token if available.
+	@param		now_ms
+				Current time (millis()).
+	@returns	True if message can be sent now.
+*/
+bool AIO_TokenBucket::take(uint32_t now_ms)
+{
+	_refill(now_ms);
+	if(m_level < ONE)
+		return false;
+
+	m_level -= ONE;
+	return true;
+}
+
+/*!
+	@param		now_ms
+				Current time (millis()).
+	@returns	Time in ms until next token is available, 0 - available now.
+*/
+uint32_t AIO_TokenBucket::waitTime(uint32_t now_ms)
+{
+	_refill(now_ms);
+	if(m_level >= ONE)
+		return 0;
+	return (ONE - m_level + m_rate - 1) / m_rate;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Adds tokens for time elapsed since the last refill.
+*/
+void AIO_TokenBucket::_refill(uint32_t now_ms)
+{
+	uint32_t _elapsed = now_ms - m_last;
+	m_last = now_ms;
+
+	// Compared before multiplying, so long idle time can't overflow
+	if(_elapsed >= (m_capacity - m_level) / m_rate + 1)
+		m_level = m_capacity;
+	else
+		m_level += _elapsed * m_rate;
+}
+
+
+// ############################################################################
+/*!
+	@brief	Creates empty topic table.
+*/
+AIO_TopicTable::AIO_TopicTable()
+{
+	m_used = 0;
+	m_cnt = 0;
+}
+
+/*!
+	@brief		Returns topic "<user><path>", building it only when it isn't in the table yet.
+	@param		*user
+				AIO username.
+	@param		*path
+				Topic path (e.g. "/feeds/<name>").
+	@returns	Stable topic string, nullptr if table or pool is full.
+*/
+const char* AIO_TopicTable::intern(const char* user, const char* path)
+{
+	size_t _userLen = strlen(user);
+	size_t _len = _userLen + strlen(path);
+
+	for(uint8_t i = 0; i < m_cnt; i++)
+	{
+		if(strncmp(m_topics[i], user, _userLen) == 0 && strcmp(&m_topics[i][_userLen], path) == 0)
+			return m_topics[i];
+	}
+
+	if(m_cnt >= AIO_MAX_TOPICS || m_used + _len + 1 > AIO_TOPIC_POOL)
+	{
+		DPRINT("[TOPIC] Error: no room for %s%s!\n", user, path);
+		return nullptr;
+	}
+
+	char* _topic = &m_pool[m_used];
+	memcpy(_topic, user, _userLen);
+	strcpy(&_topic[_userLen], path);
+	m_used += _len + 1;
+	m_topics[m_cnt++] = _topic;
+	return _topic;
+}
+
+/*!
+	@returns	Number of topics in the table.
+*/
+uint8_t AIO_TopicTable::count() const
+{
+	return m_cnt;
+}
+
+/*!
+	@returns	Bytes of the pool taken by topics.
+*/
+size_t AIO_TopicTable::used() const
+{
+	return m_used;
+}
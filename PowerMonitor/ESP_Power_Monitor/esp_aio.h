@@ -59,7 +59,114 @@ class AIO_Group;
 typedef Adafruit_MQTT_Publish 		AIO_Publish;
 typedef Adafruit_MQTT_Subscribe 	AIO_Subscribe;
 // typedef AdafruitIO_Feed 			AIO_Feed;
-// typedef AdafruitIO_Group 			AIO_Group;
+
+// ############################################################################
+/*!
+	@brief  Group of feeds published together in a single JSON message
+			(one packet / TLS record instead of one per feed).
+			Values are collected in rows - one row per measurement cycle, optionally timestamped.
+			Packed group sends rows in compact encoding (tspack.h) as base64 text of a single feed instead.
+*/
+class AIO_Group
+{
+public:
+	AIO_Group(Adafruit_MQTT_Client* mqtt, const char* topic, uint8_t batch = AIO_GROUP_BATCH, bool packed = false);
+	~AIO_Group();
+
+	int8_t addFeed(const char* key);
+	void set(uint8_t feed, float value, uint8_t precision = 2);
+	bool commit(time_t timestamp = 0);
+	bool publish();
+
+	uint8_t rows() const;
+	const char* topic() const;
+	const char* key(uint8_t feed) const;
+
+private:
+	Adafruit_MQTT_Client* m_mqtt;
+	const char* m_topic;
+
+	const char* m_keys[AIO_GROUP_MAX_FEEDS];
+	uint8_t m_feedCnt;
+
+	typedef struct
+	{
+		time_t timestamp;
+		float values[AIO_GROUP_MAX_FEEDS];
+		uint8_t precision[AIO_GROUP_MAX_FEEDS];
+		uint32_t setMask;		// Feeds with value in this row
+	} aio_row_t;
+
+	aio_row_t* m_rows;			// Allocated once, batch rows
+	uint8_t m_batch;
+	uint8_t m_rowCnt;
+	bool m_packed;
+
+	char m_payload[AIO_GROUP_PAYLOAD];
+
+	const char* _printJson(uint8_t* rows);
+	const char* _printPacked(uint8_t* rows);
+	int _printRow(char* dst, size_t len, uint8_t row);
+};
+
+#if (AIO_GROUP_MAX_FEEDS > 32)
+#error "AIO_GROUP_MAX_FEEDS must fit into row's set mask (32)!"
+#endif
+
+// Connection state machine steps
+typedef enum
+{
+	AIO_STATE_IDLE = 0,			// Not connecting (before connect() or after disconnect())
+	AIO_STATE_NET_WAIT,			// WiFi association in progress
+	AIO_STATE_HOST_CONNECT,		// WiFi up, MQTT connect pending
+	AIO_STATE_CONNECTED,		// Connection alive, watched for drops
+	AIO_STATE_BACKOFF			// Waiting before the next attempt
+} aio_state_t;
+
+// ############################################################################
+/*!
+	@brief  Token bucket limiting rate of sent messages.
+			Level is kept in 1/60000 of a token (ms per minute), so refill is exact in integer math.
+*/
+class AIO_TokenBucket
+{
+public:
+	AIO_TokenBucket(uint16_t per_minute = AIO_RATE_LIMIT, uint8_t burst = AIO_RATE_BURST);
+
+	bool take(uint32_t now_ms);
+	uint32_t waitTime(uint32_t now_ms);
+
+private:
+	static const uint32_t ONE = 60000;
+
+	uint32_t m_rate;		// Tokens per minute
+	uint32_t m_capacity;
+	uint32_t m_level;
+	uint32_t m_last;		// Time of the last refill
+
+	void _refill(uint32_t now_ms);
+};
+
+// ############################################################################
+/*!
+	@brief  Fixed-size table of topic strings. Every topic is built once in a static pool
+			and shared by all objects using it, so topics never touch the heap.
+*/
+class AIO_TopicTable
+{
+public:
+	AIO_TopicTable();
+
+	const char* intern(const char* user, const char* path);
+	uint8_t count() const;
+	size_t used() const;
+
+private:
+	char m_pool[AIO_TOPIC_POOL];
+	size_t m_used;
+	const char* m_topics[AIO_MAX_TOPICS];
+	uint8_t m_cnt;
+};
 
 // ############################################################################
 /*!
@@ -82,6 +189,11 @@ public:
 
 	Adafruit_MQTT_Client* getMQTTClient() const;
 	aio_status_t getStatus() const;
+	aio_state_t getState() const;
+	uint32_t reconnects() const;
+	uint16_t keepAlive() const;
+	uint32_t pings() const;
+	uint32_t rxTime() const;
 	const char* statusString() const;
 	bool hostConnected() const;
 	bool netConnected();
@@ -90,9 +202,18 @@ public:
 	AIO_Publish* makePublisher(const char* path);
 	AIO_Subscribe* makeSubscriber(const char* path);
 
-	// TODO: Implement appropriate classes for simpler Feed & Group handling
+	// TODO: Implement appropriate classes for simpler Feed handling
 	// AIO_Feed* attachFeed(const char* path);
-	// AIO_Group* attachGroup(const char* path);
+	AIO_Group* attachGroup(const char* name, uint8_t batch = AIO_GROUP_BATCH);
+	AIO_Group* attachPacked(const char* feed, uint8_t batch = AIO_PACKED_ROWS);
+
+	bool enqueue(AIO_Publish* pub, float value, uint8_t precision = 2);
+	bool enqueue(AIO_Publish* pub, const char* text, bool coalesce = true);
+	bool enqueue(AIO_Group* group);
+	uint8_t poll(uint16_t timeout_ms = AIO_POLL_TIMEOUT);
+	uint8_t pending() const;
+	bool queued(const AIO_Group* group) const;
+	uint32_t coalesced() const;
 
 
 protected:
@@ -109,14 +230,24 @@ protected:
 
 	void _initNet();
 
+	// Link layer hooks - overridden by test doubles to inject drops
+	virtual void _netBegin();
+	virtual bool _netUp();
+	virtual int8_t _hostConnect();
+	virtual bool _hostUp();
+
 
 private:
 	const uint16_t PORT_SECURE = 8883;
-	const uint8_t MAX_CONN_ATTEMPTS = 10;
-	const uint16_t RETRY_DELAY = 500;
 
-	char* m_pub_topic;
-	char* m_sub_topic;
+	// Topics and feed objects live in fixed pools, created with placement new
+	AIO_TopicTable m_topics;
+	alignas(AIO_Publish) uint8_t m_pubPool[AIO_MAX_PUBLISHERS][sizeof(AIO_Publish)];
+	alignas(AIO_Subscribe) uint8_t m_subPool[AIO_MAX_SUBSCRIBERS][sizeof(AIO_Subscribe)];
+	alignas(AIO_Group) uint8_t m_grpPool[AIO_MAX_GROUPS][sizeof(AIO_Group)];
+	uint8_t m_pubCnt;
+	uint8_t m_subCnt;
+	uint8_t m_grpCnt;
 
 	// SSL certificate
 	const char* m_aio_ca =
@@ -145,8 +276,45 @@ private:
 
 	bool m_isConnected;
 	bool m_netEstablished;
+
+	aio_state_t m_state;
+	aio_state_t m_retryState;		// Step resumed after backoff
+	uint32_t m_stateSince;			// millis() of the last state change
+	uint32_t m_backoff;				// Current retry delay (ms)
+	uint32_t m_retryDelay;			// Randomized delay of the pending retry
+	uint32_t m_reconnects;			// Connection drops since start
+
+	// Keepalive follows publish cadence, so the broker is pinged only when nothing else goes out
+	uint32_t m_lastSent;			// millis() of the last packet sent to the broker
+	uint32_t m_lastPub;				// millis() of the last published message
+	uint32_t m_cadence;				// Peak gap between messages (ms), decays slowly
+	uint16_t m_keepAlive;			// Keepalive of the current connection (s)
+	uint32_t m_pings;
+	uint32_t m_rxStart;			// micros() when poll() started reading incoming packets
+
+	// Values waiting for a token, oldest first
+	typedef struct
+	{
+		AIO_Publish* pub;			// Feed publisher...
+		AIO_Group* group;			// ...or group with committed rows
+		float value;
+		uint8_t precision;
+		char text[AIO_QUEUE_TEXT];	// Text value, empty - numeric one
+	} aio_pending_t;
+
+	aio_pending_t m_queue[AIO_QUEUE_SLOTS];
+	uint8_t m_queued;
+	uint32_t m_coalesced;			// Values replaced by newer ones before upload
+	AIO_TokenBucket m_bucket;
 	
 	aio_status_t _netStatus(wl_status_t net_status = WiFi.status());
+	void _tick(uint32_t now);
+	void _setState(aio_state_t state, uint32_t now);
+	void _retry(aio_state_t state, uint32_t now);
+	void _keepAliveTick(uint32_t now);
+	uint16_t _keepAliveFor(uint32_t cadence) const;
+	aio_pending_t* _slot(AIO_Publish* pub, AIO_Group* group, bool coalesce = true);
+	bool _send(const aio_pending_t* item);
 };
 
 
@@ -0,0 +1,302 @@
+#include "extadc.h"
+
+#include <string.h>
+
+#if defined(ARDUINO)
+#include "Arduino.h"
+#include <Wire.h>
+#endif
+
+
+#if defined(ARDUINO)
+// ADS1115 registers & config bits
+#define ADS_REG_CONV		0x00
+#define ADS_REG_CONFIG		0x01
+#define ADS_OS_SINGLE		0x8000		// Write: start conversion, read: 1 - idle
+#define ADS_MUX_SINGLE		0x4000		// AINx vs GND, x in bits 13:12
+#define ADS_PGA_4V			0x0200		// +-4.096 V
+#define ADS_MODE_SINGLE		0x0100
+#define ADS_DR_860SPS		0x00e0
+#define ADS_COMP_OFF		0x0003
+
+// ############################################################################
+/*!
+	@brief	Creates ADS1115 driver.
+	@param	base_addr
+			I2C address of the first board (ADDR pin to GND - 0x48).
+*/
+Ads1115::Ads1115(uint8_t base_addr)
+{
+	m_base = base_addr;
+	m_addr = base_addr;
+}
+
+/*!
+	@brief		Starts I2C bus and checks that the first board answers.
+	@returns	True if board was found.
+*/
+bool Ads1115::begin()
+{
+	Wire.begin(EXT_SDA, EXT_SCL, 400000);
+	Wire.beginTransmission(m_base);
+	return Wire.endTransmission() == 0;
+}
+
+/*!
+	@brief		Starts single conversion (~1.2 ms at 860 SPS).
+	@param		input
+				Input number, see class description.
+	@returns	False if board didn't acknowledge.
+*/
+bool Ads1115::start(uint8_t input)
+{
+	uint16_t _cfg = ADS_OS_SINGLE | ADS_MUX_SINGLE | ((input & 3) << 12) |
+		ADS_PGA_4V | ADS_MODE_SINGLE | ADS_DR_860SPS | ADS_COMP_OFF;
+
+	m_addr = m_base + (input >> 2);
+	Wire.beginTransmission(m_addr);
+	Wire.write(ADS_REG_CONFIG);
+	Wire.write(_cfg >> 8);
+	Wire.write(_cfg & 0xff);
+	return Wire.endTransmission() == 0;
+}
+
+/*!
+	@returns	1 if conversion is finished, 0 if it is running, -1 on bus error.
+*/
+int8_t Ads1115::ready()
+{
+	uint16_t _cfg;
+	if(!_readReg(ADS_REG_CONFIG, &_cfg))
+		return -1;
+	return (_cfg & ADS_OS_SINGLE) ? 1 : 0;
+}
+
+/*!
+	@brief		Reads result of the last conversion.
+	@param		*counts
+				Signed result.
+	@returns	False on bus error.
+*/
+bool Ads1115::read(int32_t* counts)
+{
+	uint16_t _raw;
+	if(!_readReg(ADS_REG_CONV, &_raw))
+		return false;
+
+	*counts = (int16_t)_raw;
+	return true;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Reads 16 bit register of the current board.
+*/
+bool Ads1115::_readReg(uint8_t reg, uint16_t* value)
+{
+	Wire.beginTransmission(m_addr);
+	Wire.write(reg);
+	if(Wire.endTransmission() != 0 || Wire.requestFrom(m_addr, (uint8_t)2) != 2)
+		return false;
+
+	*value = (uint16_t)Wire.read() << 8;
+	*value |= Wire.read();
+	return true;
+}
+#endif
+
+// ############################################################################
+/*!
+	@brief	Creates synthetic converter with all inputs at 0.
+*/
+SynthExtAdc::SynthExtAdc()
+{
+	memset(m_level, 0, sizeof(m_level));
+	memset(m_noise, 0, sizeof(m_noise));
+	m_input = -1;
+	m_seed = 1;
+}
+
+/*!
+	@brief	Sets level of an input.
+	@param	input
+			Input number.
+	@param	counts
+			Converted value.
+	@param	noise
+			Peak-to-peak uniform noise [counts].
+*/
+void SynthExtAdc::setInput(uint8_t input, int32_t counts, uint16_t noise)
+{
+	if(input >= EXT_MAX_CHANNELS)
+		return;
+
+	m_level[input] = counts;
+	m_noise[input] = noise;
+}
+
+bool SynthExtAdc::begin()
+{
+	return true;
+}
+
+bool SynthExtAdc::start(uint8_t input)
+{
+	if(input >= EXT_MAX_CHANNELS)
+		return false;
+
+	m_input = input;
+	return true;
+}
+
+int8_t SynthExtAdc::ready()
+{
+	return (m_input >= 0) ? 1 : -1;
+}
+
+bool SynthExtAdc::read(int32_t* counts)
+{
+	if(m_input < 0)
+		return false;
+
+	int32_t _v = m_level[m_input];
+	if(m_noise[m_input])
+	{
+		m_seed = m_seed * 1103515245 + 12345;
+		_v += (int32_t)((m_seed >> 16) % (m_noise[m_input] + 1)) - m_noise[m_input] / 2;
+	}
+
+	*counts = _v;
+	m_input = -1;
+	return true;
+}
+
+// ############################################################################
+/*!
+	@brief	Creates sampler without channels.
+	@param	*adc
+			Converter, nullptr - no external ADC (sampler does nothing).
+*/
+ExtSampler::ExtSampler(ExtAdc* adc)
+{
+	m_adc = adc;
+	m_cnt = 0;
+	m_cur = 0;
+	m_busy = false;
+	m_started = 0;
+	m_errors = 0;
+	memset(m_ch, 0, sizeof(m_ch));
+}
+
+/*!
+	@brief		Adds channel to the round.
+	@param		input
+				Converter input.
+	@returns	Channel index (order of adding), -1 if there is no room.
+*/
+int8_t ExtSampler::add(uint8_t input)
+{
+	if(m_cnt >= EXT_MAX_CHANNELS)
+		return -1;
+
+	m_ch[m_cnt].input = input;
+	return m_cnt++;
+}
+
+/*!
+	@returns	False if converter doesn't respond.
+*/
+bool ExtSampler::begin()
+{
+	if(!m_adc || m_cnt == 0)
+		return true;
+
+	return m_adc->begin();
+}
+
+/*!
+	@brief	Collects finished conversion and starts the next one. Never waits for the converter.
+	@param	now_ms
+			Current time [ms].
+*/
+void ExtSampler::poll(uint32_t now_ms)
+{
+	if(!m_adc || m_cnt == 0)
+		return;
+
+	if(!m_busy)
+	{
+		m_busy = _start(now_ms);
+		return;
+	}
+
+	int8_t _ready = m_adc->ready();
+	if(_ready == 0)
+	{
+		if(now_ms - m_started < EXT_CONV_TIMEOUT)
+			return;
+
+		// Conversion never finished (board reset, lost start command) - it won't without a new one
+		m_errors++;
+		_next(now_ms);
+		return;
+	}
+
+	int32_t _v;
+	if(_ready > 0 && m_adc->read(&_v))
+	{
+		m_ch[m_cur].sum += _v;
+		m_ch[m_cur].n++;
+	}
+	else
+		m_errors++;
+
+	_next(now_ms);
+}
+
+/*!
+	@brief	Returns means of all channels since previous call and starts new interval.
+	@param	*means
+			Array of added channels [counts].
+*/
+void ExtSampler::snapshot(float* means)
+{
+	for(uint8_t i = 0; i < m_cnt; i++)
+	{
+		if(m_ch[i].n > 0)
+			m_ch[i].mean = (float)m_ch[i].sum / m_ch[i].n;
+		m_ch[i].sum = 0;
+		m_ch[i].n = 0;
+		means[i] = m_ch[i].mean;
+	}
+}
+
+/*!
+	@returns	Number of failed bus transactions and timed out conversions.
+*/
+uint32_t ExtSampler::errors() const
+{
+	return m_errors;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Starts conversion of the current channel.
+*/
+bool ExtSampler::_start(uint32_t now_ms)
+{
+	m_started = now_ms;
+	if(m_adc->start(m_ch[m_cur].input))
+		return true;
+
+	m_errors++;
+	m_cur = (m_cur + 1) % m_cnt;
+	return false;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Moves to the next channel of the round and starts its conversion.
+*/
+void ExtSampler::_next(uint32_t now_ms)
+{
+	m_cur = (m_cur + 1) % m_cnt;
+	m_busy = _start(now_ms);
+}
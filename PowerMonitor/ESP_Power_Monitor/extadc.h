@@ -0,0 +1,124 @@
+/*
+	External ADC channels.
+	Slow rails which don't fit into ESP32 ADC1 scan are read from external converters.
+	Conversions are started and collected without waiting, so the sampler can be polled
+	from the main loop beside MQTT - every call does at most one bus transaction.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef EXTADC_H
+#define EXTADC_H
+
+
+#include "config.h"
+
+#include <stdint.h>
+
+
+// ############################################################################
+/*!
+	@brief	Interface of an external converter with single-shot conversions.
+*/
+class ExtAdc
+{
+public:
+	virtual ~ExtAdc() {}
+
+	virtual bool begin() = 0;
+	virtual bool start(uint8_t input) = 0;
+	virtual int8_t ready() = 0;			// 1 - conversion finished, 0 - running, -1 - bus error
+	virtual bool read(int32_t* counts) = 0;
+};
+
+
+#if defined(ARDUINO)
+// ############################################################################
+/*!
+	@brief	TI ADS1115 - 16 bit, 4 single-ended inputs, I2C.
+			Up to 4 boards on one bus, input n is AIN(n % 4) of the board at base address + n / 4.
+*/
+class Ads1115 : public ExtAdc
+{
+public:
+	Ads1115(uint8_t base_addr = 0x48);
+
+	bool begin() override;
+	bool start(uint8_t input) override;
+	int8_t ready() override;
+	bool read(int32_t* counts) override;
+
+private:
+	uint8_t m_base;
+	uint8_t m_addr;				// Board doing the current conversion
+
+	bool _readReg(uint8_t reg, uint16_t* value);
+};
+#endif
+
+// ############################################################################
+/*!
+	@brief	Synthetic converter - constant level with noise on every input.
+			Stand-in for testing without external boards and on host builds.
+*/
+class SynthExtAdc : public ExtAdc
+{
+public:
+	SynthExtAdc();
+
+	void setInput(uint8_t input, int32_t counts, uint16_t noise = 0);
+
+	bool begin() override;
+	bool start(uint8_t input) override;
+	int8_t ready() override;
+	bool read(int32_t* counts) override;
+
+private:
+	int32_t m_level[EXT_MAX_CHANNELS];
+	uint16_t m_noise[EXT_MAX_CHANNELS];
+	int16_t m_input;			// Input being "converted", -1 - none
+	uint32_t m_seed;
+};
+
+
+// ############################################################################
+/*!
+	@brief	Round-robin sampler of external channels, averages every one over the publish interval.
+			Bus error or conversion not finished within EXT_CONV_TIMEOUT is counted and the round goes on
+			with the next channel, so a board which stopped answering doesn't stall the others.
+*/
+class ExtSampler
+{
+public:
+	ExtSampler(ExtAdc* adc);
+
+	int8_t add(uint8_t input);
+	bool begin();
+	void poll(uint32_t now_ms);
+
+	void snapshot(float* means);
+	uint32_t errors() const;
+
+private:
+	ExtAdc* m_adc;
+
+	struct
+	{
+		uint8_t input;
+		int64_t sum;
+		uint32_t n;
+		float mean;				// Last reported mean, kept when no conversion finished in interval
+	} m_ch[EXT_MAX_CHANNELS];
+	uint8_t m_cnt;
+
+	uint8_t m_cur;				// Channel being converted
+	bool m_busy;
+	uint32_t m_started;			// ms when the current conversion was started
+	uint32_t m_errors;
+
+	bool _start(uint32_t now_ms);
+	void _next(uint32_t now_ms);
+};
+
+
+#endif // EXTADC_H
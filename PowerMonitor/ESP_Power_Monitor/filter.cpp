@@ -0,0 +1,144 @@
+#include "filter.h"
+
+#include <string.h>
+
+
+/*!
+	@brief	Creates filter of a type from channel table, FILT_NONE gives no filter.
+*/
+template<class F>
+static ChannelFilter* _make()
+{
+	return new F();
+}
+
+template<>
+ChannelFilter* _make<FiltNone>()
+{
+	return nullptr;
+}
+
+// Factory of every CHANNEL() line
+#define CHANNEL(name, feed, source, input, mode, scale, decimals, filter, trig) &_make< filter >,
+
+static ChannelFilter* (* const s_makers[CH_COUNT])() =
+{
+	CHANNEL_TABLE
+};
+
+#undef CHANNEL
+
+
+// ############################################################################
+/*!
+	@brief	Creates bank without filters.
+*/
+FilterBank::FilterBank()
+{
+	memset(m_filters, 0, sizeof(m_filters));
+	for(uint8_t s = 0; s < ACQ_CHANNELS; s++)
+	{
+		m_out[s] = 0;
+		m_outCnt[s] = 0;
+	}
+}
+
+/*!
+	@brief	Class destructor.
+*/
+FilterBank::~FilterBank()
+{
+	for(uint8_t s = 0; s < ACQ_CHANNELS; s++)
+		delete m_filters[s];
+}
+
+/*!
+	@brief		Creates filters of ADC channels as set in channel table. Must be called before acquisition starts.
+	@returns	Number of filtered channels.
+*/
+uint8_t FilterBank::begin()
+{
+	uint8_t _cnt = 0;
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		int8_t _slot = Channels::slot(c);
+		if(ch_table[c].source != CH_SRC_ADC || _slot < 0 || m_filters[_slot])
+			continue;
+
+		m_filters[_slot] = s_makers[c]();
+		if(m_filters[_slot])
+			_cnt++;
+	}
+	return _cnt;
+}
+
+/*!
+	@brief	Runs samples of every filtered channel through its chain.
+*/
+void FilterBank::onBlock(const acq_scan_t* scans, size_t count, uint32_t seq)
+{
+	for(uint8_t s = 0; s < ACQ_CHANNELS; s++)
+	{
+		ChannelFilter* _f = m_filters[s];
+		if(!_f)
+			continue;
+
+		int32_t _y = 0;
+		uint32_t _n = 0;
+		for(size_t i = 0; i < count; i++)
+		{
+			if(_f->step(scans[i].ch[s], &_y))
+				_n++;
+		}
+
+		// The last output of the block is the one anybody will see
+		if(_n)
+		{
+			m_out[s] = _y;
+			m_outCnt[s] = m_outCnt[s] + _n;
+		}
+	}
+}
+
+/*!
+	@brief	Restarts chains after a gap, so no output mixes samples from both sides of it.
+			The last outputs stay readable until new ones come.
+*/
+void FilterBank::onResume(uint32_t seq)
+{
+	for(uint8_t s = 0; s < ACQ_CHANNELS; s++)
+	{
+		if(m_filters[s])
+			m_filters[s]->reset();
+	}
+}
+
+/*!
+	@brief		Reads the latest filter output of a channel.
+	@param		ch
+				Channel index.
+	@param		*mv
+				Filtered value [mV].
+	@returns	False if channel isn't filtered or no output was produced yet.
+*/
+bool FilterBank::latest(uint8_t ch, float* mv) const
+{
+	int8_t _slot = Channels::slot(ch);
+	if(ch >= CH_COUNT || ch_table[ch].source != CH_SRC_ADC || _slot < 0 || m_outCnt[_slot] == 0)
+		return false;
+
+	*mv = (float)m_out[_slot] / (1 << FILT_FRAC);
+	return true;
+}
+
+/*!
+	@returns	Number of outputs produced by filter of a channel.
+*/
+uint32_t FilterBank::outputs(uint8_t ch) const
+{
+	int8_t _slot = Channels::slot(ch);
+	if(ch >= CH_COUNT || ch_table[ch].source != CH_SRC_ADC || _slot < 0)
+		return 0;
+	return m_outCnt[_slot];
+}
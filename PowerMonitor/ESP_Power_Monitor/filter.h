@@ -0,0 +1,264 @@
+/*
+	Fixed-point filters for channel readouts.
+	Filters are chains of up to three stages, every stage is a template with its coefficients
+	as parameters, so they are constants in the generated code. Samples enter in calibrated mV,
+	run in integers with FILT_FRAC fraction bits and leave at decimated rate.
+	Chains run in the acquisition task beside statistics, RMS and triggers, which still get raw samples.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FILTER_H
+#define FILTER_H
+
+
+#include "acquire.h"
+#include "channels.h"
+
+
+#define FILT_FRAC			4		// Fraction bits kept through filter stages
+#define FILT_INPUT_BITS		12		// Samples are below 4096 mV
+
+
+// ############################################################################
+/*!
+	@brief	Interface of a channel filter chain.
+*/
+class ChannelFilter
+{
+public:
+	virtual ~ChannelFilter() {}
+
+	/*!
+		@brief		Takes one sample.
+		@param		x
+					Sample [mV].
+		@param		*y
+					Filtered value [mV << FILT_FRAC], written only when the chain produces one.
+		@returns	True if output was produced (every decimation()-th sample).
+	*/
+	virtual bool step(int32_t x, int32_t* y) = 0;
+	virtual uint16_t decimation() const = 0;
+
+	/*!
+		@brief	Clears state of all stages - the next sample starts the chain like the first one.
+	*/
+	virtual void reset() = 0;
+};
+
+
+/*!
+	@brief	Empty stage, fills unused places of a chain.
+*/
+class FiltPass
+{
+public:
+	static const uint16_t DECIM = 1;
+
+	inline bool step(int32_t x, int32_t* y)
+	{
+		*y = x;
+		return true;
+	}
+};
+
+/*!
+	@brief	Marks channel without filter (FILT_NONE in channel table).
+*/
+class FiltNone
+{
+};
+
+
+/*!
+	@brief	One-pole IIR low-pass, y += (x - y) / 2^SHIFT.
+			State keeps SHIFT extra bits, so small steps aren't lost to rounding.
+*/
+template<uint8_t SHIFT>
+class OnePoleIir
+{
+public:
+	static const uint16_t DECIM = 1;
+
+	OnePoleIir() : m_acc(0), m_init(false) { }
+
+	inline bool step(int32_t x, int32_t* y)
+	{
+		// Starts from the first sample instead of ramping up from 0
+		if(!m_init)
+		{
+			m_acc = x * (1 << SHIFT);
+			m_init = true;
+		}
+		m_acc += x - (m_acc >> SHIFT);
+		*y = m_acc >> SHIFT;
+		return true;
+	}
+
+private:
+	static_assert(SHIFT >= 1 && SHIFT <= 12, "OnePoleIir: SHIFT out of range!");
+
+	int32_t m_acc;
+	bool m_init;
+};
+
+
+/*!
+	@brief	Moving average of the last N samples - ring buffer with running sum, O(1) per sample.
+*/
+template<uint16_t N>
+class MovingAverage
+{
+public:
+	static const uint16_t DECIM = 1;
+
+	MovingAverage() : m_sum(0), m_idx(0), m_init(false) { }
+
+	inline bool step(int32_t x, int32_t* y)
+	{
+		// Buffer is pre-filled with the first sample
+		if(!m_init)
+		{
+			for(uint16_t i = 0; i < N; i++)
+				m_buf[i] = x;
+			m_sum = x * (int32_t)N;
+			m_init = true;
+		}
+		m_sum += x - m_buf[m_idx];
+		m_buf[m_idx] = x;
+		if(++m_idx >= N)
+			m_idx = 0;
+		*y = m_sum / (int32_t)N;
+		return true;
+	}
+
+private:
+	static_assert(N >= 2 && (int64_t)N << (FILT_INPUT_BITS + FILT_FRAC) < INT32_MAX, "MovingAverage: N out of range!");
+
+	int32_t m_buf[N];
+	int32_t m_sum;
+	uint16_t m_idx;
+	bool m_init;
+};
+
+
+// Compile time helpers
+constexpr int32_t filt_pow(int32_t base, uint8_t exp)
+{
+	return exp ? base * filt_pow(base, exp - 1) : 1;
+}
+
+constexpr uint8_t filt_log2(uint32_t v)		// rounded up
+{
+	return v > 1 ? 1 + filt_log2((v + 1) / 2) : 0;
+}
+
+/*!
+	@brief	Decimating CIC (cascaded integrator-comb) filter - STAGES integrators at input rate,
+			STAGES combs at output rate, one output per R inputs. No multiplications,
+			registers wrap around safely as long as output fits (checked at compile time).
+*/
+template<uint16_t R, uint8_t STAGES>
+class CicDecimator
+{
+public:
+	static const uint16_t DECIM = R;
+
+	CicDecimator() : m_cnt(0)
+	{
+		for(uint8_t s = 0; s < STAGES; s++)
+			m_int[s] = m_comb[s] = 0;
+	}
+
+	inline bool step(int32_t x, int32_t* y)
+	{
+		uint32_t _v = (uint32_t)x;
+		for(uint8_t s = 0; s < STAGES; s++)
+			_v = m_int[s] += _v;
+
+		if(++m_cnt < R)
+			return false;
+		m_cnt = 0;
+
+		for(uint8_t s = 0; s < STAGES; s++)
+		{
+			uint32_t _in = _v;
+			_v -= m_comb[s];
+			m_comb[s] = _in;
+		}
+		*y = (int32_t)_v / filt_pow(R, STAGES);
+		return true;
+	}
+
+private:
+	static_assert(R >= 2 && STAGES >= 1, "CicDecimator: R or STAGES out of range!");
+	static_assert(FILT_INPUT_BITS + FILT_FRAC + STAGES * filt_log2(R) < 32, "CicDecimator: gain overflows 32 bit registers!");
+
+	uint32_t m_int[STAGES];
+	uint32_t m_comb[STAGES];
+	uint16_t m_cnt;
+};
+
+
+/*!
+	@brief	Chain of stages, e.g. Filter< CicDecimator<16, 3>, MovingAverage<8> >.
+*/
+template<class S1, class S2 = FiltPass, class S3 = FiltPass>
+class Filter : public ChannelFilter
+{
+public:
+	bool step(int32_t x, int32_t* y) override
+	{
+		int32_t _v = x * (1 << FILT_FRAC);
+
+		if(!m_s1.step(_v, &_v) || !m_s2.step(_v, &_v) || !m_s3.step(_v, &_v))
+			return false;
+		*y = _v;
+		return true;
+	}
+
+	uint16_t decimation() const override
+	{
+		return S1::DECIM * S2::DECIM * S3::DECIM;
+	}
+
+	void reset() override
+	{
+		m_s1 = S1();
+		m_s2 = S2();
+		m_s3 = S3();
+	}
+
+private:
+	S1 m_s1;
+	S2 m_s2;
+	S3 m_s3;
+};
+
+
+// ############################################################################
+/*!
+	@brief	Acquisition stage running filter of every ADC channel.
+			Latest outputs are single 32 bit words, so they are read without locking.
+*/
+class FilterBank : public AcqSink
+{
+public:
+	FilterBank();
+	~FilterBank();
+
+	uint8_t begin();
+	void onBlock(const acq_scan_t* scans, size_t count, uint32_t seq) override;
+	void onResume(uint32_t seq) override;
+
+	bool latest(uint8_t ch, float* mv) const;
+	uint32_t outputs(uint8_t ch) const;
+
+private:
+	ChannelFilter* m_filters[ACQ_CHANNELS];	// By scan slot, nullptr - not filtered
+	volatile int32_t m_out[ACQ_CHANNELS];
+	volatile uint32_t m_outCnt[ACQ_CHANNELS];
+};
+
+
+#endif // FILTER_H
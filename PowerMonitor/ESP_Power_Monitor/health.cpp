@@ -0,0 +1,250 @@
+#include "health.h"
+
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#endif
+
+
+// Indexed by hl_stage_t - also feed keys of diagnostics group
+static const char* s_stageNames[HL_STAGES] = { "loop", "acquire", "publish", "backlog", "display", "mqtt" };
+
+// Indexed by esp_reset_reason_t
+static const char* s_resetNames[] = { "unknown", "power on", "external", "software", "panic", "interrupt watchdog",
+	"task watchdog", "watchdog", "deep sleep", "brownout", "SDIO" };
+
+
+// ############################################################################
+LatencyHist::LatencyHist()
+{
+	for(uint8_t i = 0; i < HL_BUCKETS; i++)
+		m_counts[i] = 0;
+	for(uint8_t w = 0; w < HL_WINDOWS; w++)
+		m_peak[w] = 0;
+	memset(m_base, 0, sizeof(m_base));
+}
+
+/*!
+	@brief	Records duration. Called only by the task running the stage.
+	@param	us
+			Duration [us].
+*/
+void LatencyHist::add(uint32_t us)
+{
+	uint8_t _i = _bucket(us);
+	m_counts[_i] = m_counts[_i] + 1;
+
+	for(uint8_t w = 0; w < HL_WINDOWS; w++)
+		if(us > m_peak[w])
+			m_peak[w] = us;
+}
+
+/*!
+	@brief	Timing since the previous call for the same window, starts the next one.
+			Percentiles are interpolated within buckets, so they are exact to the bucket width at worst.
+	@param	window
+			HL_WINDOW_* of the caller - only one task may use a window.
+	@param	*dst
+			Result [us].
+*/
+void LatencyHist::stats(uint8_t window, hl_stats_t* dst)
+{
+	uint32_t _delta[HL_BUCKETS];
+	uint32_t _total = 0;
+
+	for(uint8_t i = 0; i < HL_BUCKETS; i++)
+	{
+		uint32_t _now = m_counts[i];
+		_delta[i] = _now - m_base[window][i];
+		m_base[window][i] = _now;
+		_total += _delta[i];
+	}
+	// Time recorded between these two lines gets into neither window's peak - it's diagnostics, not accounting
+	uint32_t _peak = m_peak[window];
+	m_peak[window] = 0;
+
+	dst->count = _total;
+	dst->max = _total ? _peak : 0;
+	dst->p50 = _percentile(_delta, _total, (uint32_t)(((uint64_t)_total * 50 + 99) / 100), _peak);
+	dst->p99 = _percentile(_delta, _total, (uint32_t)(((uint64_t)_total * 99 + 99) / 100), _peak);
+}
+
+/*!
+	@returns	Number of durations recorded since start.
+*/
+uint32_t LatencyHist::count() const
+{
+	uint32_t _total = 0;
+	for(uint8_t i = 0; i < HL_BUCKETS; i++)
+		_total += m_counts[i];
+	return _total;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Bucket of duration - exponent picks the octave, following HL_SUB_BITS the bucket in it.
+*/
+uint8_t LatencyHist::_bucket(uint32_t us)
+{
+	uint32_t _v = us / HL_BASE_US;
+	if(_v < HL_SUB)
+		return _v;
+
+	uint8_t _e = 31 - __builtin_clz(_v);
+	uint32_t _i = (_e - HL_SUB_BITS + 1) * HL_SUB + ((_v >> (_e - HL_SUB_BITS)) & (HL_SUB - 1));
+	return (_i < HL_BUCKETS) ? _i : HL_BUCKETS - 1;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Shortest duration of bucket [us].
+*/
+uint32_t LatencyHist::_lower(uint8_t bucket)
+{
+	if(bucket < HL_SUB)
+		return bucket * HL_BASE_US;
+
+	uint8_t _e = bucket / HL_SUB + HL_SUB_BITS - 1;
+	return ((uint32_t)(HL_SUB + bucket % HL_SUB) << (_e - HL_SUB_BITS)) * HL_BASE_US;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Value of rank-th shortest duration.
+	@returns	Duration [us], never above the longest one.
+*/
+uint32_t LatencyHist::_percentile(const uint32_t* counts, uint32_t total, uint32_t rank, uint32_t peak) const
+{
+	uint32_t _cum = 0;
+
+	if(total == 0)
+		return 0;
+
+	for(uint8_t i = 0; i < HL_BUCKETS; i++)
+	{
+		if(_cum + counts[i] < rank)
+		{
+			_cum += counts[i];
+			continue;
+		}
+
+		uint32_t _lo = _lower(i);
+		uint32_t _hi = (i < HL_BUCKETS - 1) ? _lower(i + 1) : peak;
+		if(_hi < _lo)
+			_hi = _lo;
+		uint32_t _val = _lo + (uint32_t)((uint64_t)(_hi - _lo) * (rank - _cum) / counts[i]);
+		return (_val < peak) ? _val : peak;
+	}
+	return peak;
+}
+
+
+// ############################################################################
+/*!
+	@brief		Arms task watchdog and subscribes the calling task (Arduino loop when called from setup()).
+	@param		timeout_s
+				Time without feed() after which the device resets [s]. Must be longer than the longest
+				blocking call (TLS handshake, light sleep).
+	@returns	True if the watchdog watches the calling task.
+*/
+bool Health::begin(uint32_t timeout_s)
+{
+#if defined(ARDUINO)
+	// Already running watchdog (idle tasks) is only reconfigured
+	if(esp_task_wdt_init(timeout_s, true) != ESP_OK)
+		return false;
+	return watch();
+#else
+	return true;
+#endif
+}
+
+/*!
+	@brief		Subscribes the calling task to the watchdog - from then on it must call feed() regularly.
+	@returns	True if the task is watched.
+*/
+bool Health::watch()
+{
+#if defined(ARDUINO)
+	esp_task_wdt_add(NULL);
+	return esp_task_wdt_status(NULL) == ESP_OK;
+#else
+	return true;
+#endif
+}
+
+/*!
+	@brief	Tells the watchdog the calling task is alive.
+*/
+void Health::feed()
+{
+#if defined(ARDUINO)
+	esp_task_wdt_reset();
+#endif
+}
+
+/*!
+	@brief	Records duration of a stage. Every stage must be recorded by a single task.
+	@param	stage
+			Timed stage.
+	@param	us
+			Duration [us].
+*/
+void Health::record(hl_stage_t stage, uint32_t us)
+{
+	m_hist[stage].add(us);
+}
+
+/*!
+	@returns	Histogram of the stage - given to modules timing themselves in their own task.
+*/
+LatencyHist* Health::stage(hl_stage_t stage)
+{
+	return &m_hist[stage];
+}
+
+/*!
+	@brief	Fills report with timings since the previous report of the window and current system state.
+			Connection counters are left 0 for the user.
+	@param	window
+			HL_WINDOW_* of the caller.
+	@param	*dst
+			Report.
+*/
+void Health::report(uint8_t window, health_report_t* dst)
+{
+	memset(dst, 0, sizeof(health_report_t));
+
+	for(uint8_t s = 0; s < HL_STAGES; s++)
+		m_hist[s].stats(window, &dst->stage[s]);
+
+#if defined(ARDUINO)
+	dst->heapFree = ESP.getFreeHeap();
+	dst->heapMin = ESP.getMinFreeHeap();
+	dst->heapBlock = ESP.getMaxAllocHeap();
+	dst->rssi = (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : 0;
+	dst->uptime = millis() / 1000;
+#endif
+}
+
+/*!
+	@returns	Reason of the last reset.
+*/
+const char* Health::resetReason() const
+{
+#if defined(ARDUINO)
+	uint8_t _reason = esp_reset_reason();
+	if(_reason < sizeof(s_resetNames) / sizeof(s_resetNames[0]))
+		return s_resetNames[_reason];
+#endif
+	return s_resetNames[0];
+}
+
+/*!
+	@returns	Short name of the stage.
+*/
+const char* Health::stageName(hl_stage_t stage)
+{
+	return (stage < HL_STAGES) ? s_stageNames[stage] : "?";
+}
@@ -0,0 +1,120 @@
+/*
+	Health of the monitor - task watchdog, timing of the main processing stages and system counters.
+	Every stage is timed by the task running it into a log-linear histogram (HDR-like), readers
+	take percentiles of what was recorded since their previous report, so the diagnostics feed
+	and the debug screen keep their own windows without disturbing each other or the writers.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+// Buckets of HL_BASE_US up to HL_SUB of them, then HL_SUB buckets per every power of 2 (error below 1 / HL_SUB).
+// 64 buckets go up to ~0.5 s, the last one takes the rest
+#define HL_BUCKETS			64
+#define HL_BASE_US			4
+#define HL_SUB_BITS			2
+#define HL_SUB				(1 << HL_SUB_BITS)
+
+// Independent report windows
+#define HL_WINDOW_FEED		0
+#define HL_WINDOW_UI		1
+#define HL_WINDOWS			2
+
+
+typedef enum
+{
+	HL_LOOP = 0,			// Whole pass of the main loop
+	HL_ACQUIRE,				// Processing of one ADC block by all sinks
+	HL_PUBLISH,				// Summary of channels, queuing of live data or storing it in backlog
+	HL_BACKLOG,				// Loading of fault window and stored records for upload
+	HL_DISPLAY,				// Frame of the display task
+	HL_MQTT,				// Connection upkeep, incoming packets and sending
+	HL_STAGES
+} hl_stage_t;
+
+
+/*!
+	@brief	Timing of a stage over a report window [us].
+*/
+typedef struct
+{
+	uint32_t count;
+	uint32_t p50;
+	uint32_t p99;
+	uint32_t max;
+} hl_stats_t;
+
+/*!
+	@brief	Everything reported - stage timings and system state at the time of report.
+*/
+typedef struct
+{
+	hl_stats_t stage[HL_STAGES];
+	uint32_t heapFree;				// Bytes
+	uint32_t heapMin;				// Lowest free heap since boot
+	uint32_t heapBlock;				// Largest allocatable block (fragmentation)
+	int8_t rssi;					// dBm, 0 - not associated
+	uint32_t uptime;				// s
+	uint32_t reconnects;			// Filled by the user (connection counters aren't known here)
+	uint32_t pings;
+	uint32_t overruns;
+} health_report_t;
+
+
+// ############################################################################
+/*!
+	@brief	Histogram of durations. Single writer, any number of readers with their own windows.
+*/
+class LatencyHist
+{
+public:
+	LatencyHist();
+
+	void add(uint32_t us);
+	void stats(uint8_t window, hl_stats_t* dst);
+
+	uint32_t count() const;
+
+private:
+	volatile uint32_t m_counts[HL_BUCKETS];			// Since start, written by the timed task only
+	volatile uint32_t m_peak[HL_WINDOWS];			// Longest time in every window
+	uint32_t m_base[HL_WINDOWS][HL_BUCKETS];		// Counts at the start of every window
+
+	static uint8_t _bucket(uint32_t us);
+	static uint32_t _lower(uint8_t bucket);
+	uint32_t _percentile(const uint32_t* counts, uint32_t total, uint32_t rank, uint32_t peak) const;
+};
+
+// ############################################################################
+/*!
+	@brief	Health subsystem - task watchdog and timings of all stages.
+*/
+class Health
+{
+public:
+	bool begin(uint32_t timeout_s = HEALTH_WDT_TIMEOUT);
+	bool watch();
+	void feed();
+
+	void record(hl_stage_t stage, uint32_t us);
+	LatencyHist* stage(hl_stage_t stage);
+	void report(uint8_t window, health_report_t* dst);
+
+	const char* resetReason() const;
+	static const char* stageName(hl_stage_t stage);
+
+private:
+	LatencyHist m_hist[HL_STAGES];
+};
+
+
+#endif // HEALTH_H
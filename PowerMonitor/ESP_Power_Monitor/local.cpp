@@ -0,0 +1,495 @@
+#include "local.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// Metrics exposed for every channel, in order of LocalStore::_promItem()
+static const char* const s_promNames[] = { "volts", "volts_min", "volts_max", "volts_stddev" };
+#define PROM_METRICS		(sizeof(s_promNames) / sizeof(s_promNames[0]))
+
+
+// ############################################################################
+/*!
+	@brief	Creates empty history.
+*/
+LocalStore::LocalStore()
+{
+	m_head = 0;
+	memset(m_rows, 0, sizeof(m_rows));
+	memset(m_stats, 0, sizeof(m_stats));
+}
+
+/*!
+	@brief	Adds row, the oldest one is dropped when history is full.
+	@param	time
+			UNIX time or seconds since boot.
+	@param	*values
+			CH_COUNT channel values [V].
+	@param	*stats
+			CH_COUNT statistics of the interval, nullptr - none (min = max = value).
+*/
+void LocalStore::push(uint32_t time, const float* values, const local_stats_t* stats)
+{
+	local_row_t* _row = &m_rows[m_head % LOCAL_HISTORY];
+
+	_row->time = time;
+	memcpy(_row->values, values, sizeof(_row->values));
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		if(stats)
+			m_stats[c] = stats[c];
+		else
+		{
+			m_stats[c].min = m_stats[c].max = values[c];
+			m_stats[c].stddev = 0;
+		}
+	}
+	m_head++;
+}
+
+/*!
+	@returns	Number of rows in history.
+*/
+uint16_t LocalStore::rows() const
+{
+	return (m_head < LOCAL_HISTORY) ? m_head : LOCAL_HISTORY;
+}
+
+/*!
+	@returns	Row of history, 0 - the oldest one. nullptr if there is no such row.
+*/
+const local_row_t* LocalStore::row(uint16_t idx) const
+{
+	if(idx >= rows())
+		return nullptr;
+	return &m_rows[(m_head - rows() + idx) % LOCAL_HISTORY];
+}
+
+/*!
+	@returns	Rows pushed since start.
+*/
+uint32_t LocalStore::pushed() const
+{
+	return m_head;
+}
+
+/*!
+	@brief		Formats next chunk of Prometheus text exposition (gauges of the latest row).
+	@param		*dst, len
+				Output buffer (null terminated).
+	@param		*pos
+				Cursor, 0 on the first call.
+	@returns	Length of the chunk, 0 - everything was written.
+*/
+size_t LocalStore::prometheus(char* dst, size_t len, uint32_t* pos) const
+{
+	return _fill(dst, len, pos, PROM_METRICS * (CH_COUNT + 1) + 1, &LocalStore::_promItem, 0);
+}
+
+/*!
+	@brief		Formats next chunk of JSON document:
+				{"channels":[names],"stats":[{"value":,"min":,"max":,"sd":},...],"rows":[[time,values...],...]}
+	@param		*dst, len
+				Output buffer (null terminated).
+	@param		*pos
+				Cursor, 0 on the first call.
+	@param		rows
+				Number of the latest rows included.
+	@returns	Length of the chunk, 0 - everything was written.
+*/
+size_t LocalStore::json(char* dst, size_t len, uint32_t* pos, uint16_t rows) const
+{
+	if(rows > this->rows())
+		rows = this->rows();
+	return _fill(dst, len, pos, CH_COUNT + 3 + rows, &LocalStore::_jsonItem, rows);
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Puts as many whole items into the buffer as fit.
+			Item which doesn't fit even into empty buffer is skipped.
+*/
+size_t LocalStore::_fill(char* dst, size_t len, uint32_t* pos, uint32_t items, item_fn fn, uint16_t rows) const
+{
+	size_t _used = 0;
+
+	if(len == 0)
+		return 0;
+	dst[0] = '\0';
+
+	while(*pos < items)
+	{
+		int _n = (this->*fn)(&dst[_used], len - _used, *pos, rows);
+		if(_n < 0 || (size_t)_n >= len - _used)
+		{
+			dst[_used] = '\0';
+			if(_used > 0)
+				break;
+			_n = 0;
+		}
+		_used += _n;
+		(*pos)++;
+	}
+	return _used;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Prometheus item - TYPE line of a metric, its value for a channel or rows counter.
+*/
+int LocalStore::_promItem(char* dst, size_t len, uint32_t item, uint16_t rows) const
+{
+	uint32_t _metric = item / (CH_COUNT + 1);
+	uint32_t _ch = item % (CH_COUNT + 1);
+
+	if(_metric >= PROM_METRICS)
+		return snprintf(dst, len, "# TYPE pwrmon_rows_total counter\npwrmon_rows_total %u\n", (unsigned)m_head);
+
+	if(_ch == 0)
+		return snprintf(dst, len, "# TYPE pwrmon_%s gauge\n", s_promNames[_metric]);
+
+	// Nothing measured yet - no samples rather than zeros
+	if(m_head == 0)
+		return 0;
+
+	_ch--;
+	const float _vals[PROM_METRICS] =
+	{
+		row(this->rows() - 1)->values[_ch], m_stats[_ch].min, m_stats[_ch].max, m_stats[_ch].stddev
+	};
+	return snprintf(dst, len, "pwrmon_%s{channel=\"%s\"} %.3f\n", s_promNames[_metric], ch_table[_ch].name, _vals[_metric]);
+}
+
+/*!
+	@brief	[INTERNAL METHOD] JSON item - head with channel names, stats of a channel, rows head, row or tail.
+*/
+int LocalStore::_jsonItem(char* dst, size_t len, uint32_t item, uint16_t rows) const
+{
+	int _n = 0;
+
+	if(item == 0)
+	{
+		_n = snprintf(dst, len, "{\"channels\":[");
+		for(uint8_t c = 0; c < CH_COUNT && _n >= 0 && (size_t)_n < len; c++)
+			_n += snprintf(&dst[_n], len - _n, "%s\"%s\"", c ? "," : "", ch_table[c].name);
+		if(_n >= 0 && (size_t)_n < len)
+			_n += snprintf(&dst[_n], len - _n, "],\"stats\":[");
+		return _n;
+	}
+
+	if(item <= CH_COUNT)
+	{
+		uint8_t _ch = item - 1;
+		const char* _sep = (_ch + 1 < CH_COUNT) ? "," : "";
+
+		if(m_head == 0)
+			return snprintf(dst, len, "null%s", _sep);
+		return snprintf(dst, len, "{\"value\":%.3f,\"min\":%.3f,\"max\":%.3f,\"sd\":%.3f}%s", row(this->rows() - 1)->values[_ch],
+			m_stats[_ch].min, m_stats[_ch].max, m_stats[_ch].stddev, _sep);
+	}
+
+	if(item == CH_COUNT + 1)
+		return snprintf(dst, len, "],\"rows\":[");
+
+	uint32_t _r = item - CH_COUNT - 2;
+	if(_r >= rows)
+		return snprintf(dst, len, "]}\n");
+
+	const local_row_t* _row = row(this->rows() - rows + _r);
+	_n = snprintf(dst, len, "[%u", (unsigned)_row->time);
+	for(uint8_t c = 0; c < CH_COUNT && _n >= 0 && (size_t)_n < len; c++)
+		_n += snprintf(&dst[_n], len - _n, ",%.*f", ch_table[c].decimals, _row->values[c]);
+	if(_n >= 0 && (size_t)_n < len)
+		_n += snprintf(&dst[_n], len - _n, "]%s", (_r + 1 < rows) ? "," : "");
+	return _n;
+}
+
+
+#if defined(ARDUINO)
+// ############################################################################
+/*!
+	@brief	Creates server, it starts listening when WiFi comes up.
+	@param	*store
+			Served data.
+	@param	port
+			TCP port.
+*/
+LocalHttp::LocalHttp(const LocalStore* store, uint16_t port) : m_server(port)
+{
+	m_store = store;
+	m_started = false;
+	m_reqLen = 0;
+	m_since = 0;
+	m_requests = 0;
+	m_answering = false;
+	m_route = LOCAL_ROUTE_NONE;
+	m_rows = LOCAL_HISTORY;
+	m_pos = 0;
+	m_outLen = 0;
+	m_outSent = 0;
+}
+
+/*!
+	@brief	Accepts connection, collects request and answers it once its head is complete - at most
+			one chunk of the answer per call. Never waits for the client - call it from the main loop.
+*/
+void LocalHttp::poll()
+{
+	if(WiFi.status() != WL_CONNECTED)
+		return;
+
+	if(!m_started)
+	{
+		m_server.begin();
+		m_server.setNoDelay(true);
+		m_started = true;
+	}
+
+	if(!m_client || !m_client.connected())
+	{
+		// Client gone in the middle of the answer - the rest is dropped
+		if(m_answering)
+			_close();
+
+		m_client = m_server.available();
+		if(!m_client)
+			return;
+		m_reqLen = 0;
+		m_since = millis();
+	}
+
+	if(m_answering)
+	{
+		_respond();
+		return;
+	}
+
+	while(m_client.available() && m_reqLen < sizeof(m_req) - 1)
+		m_req[m_reqLen++] = m_client.read();
+	m_req[m_reqLen] = '\0';
+
+	// Only the request line matters, rest of the head is dropped if it doesn't fit
+	if(strstr(m_req, "\r\n\r\n") || strstr(m_req, "\n\n") || m_reqLen >= sizeof(m_req) - 1)
+	{
+		m_rows = LOCAL_HISTORY;
+		m_route = parse(m_req, &m_rows);
+		m_pos = 0;
+		m_answering = true;
+		m_since = millis();
+
+		// Status line and headers are the first chunk, error answers have their whole body in it
+		static const char* const _heads[] =
+		{
+			"HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\nTry /metrics or /json?rows=N\n",
+			"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n",
+			"HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n",
+			"HTTP/1.0 400 Bad Request\r\nConnection: close\r\n\r\n"
+		};
+		m_outLen = strlcpy(m_out, _heads[m_route], sizeof(m_out));
+		m_outSent = 0;
+		_respond();
+	}
+	else if(millis() - m_since > LOCAL_HTTP_TIMEOUT)
+		m_client.stop();
+}
+
+/*!
+	@returns	True while an answer is being sent.
+*/
+bool LocalHttp::busy() const
+{
+	return m_answering;
+}
+
+/*!
+	@returns	Number of answered requests.
+*/
+uint32_t LocalHttp::requests() const
+{
+	return m_requests;
+}
+
+/*!
+	@brief		Parses request line.
+	@param		*req
+				Request head.
+	@param		*rows
+				Rows requested by ?rows=N (unchanged if not given).
+	@returns	local_route_t
+*/
+local_route_t LocalHttp::parse(const char* req, uint16_t* rows)
+{
+	if(!req || strncmp(req, "GET ", 4) != 0)
+		return LOCAL_ROUTE_BAD;
+
+	const char* _path = req + 4;
+	size_t _len = strcspn(_path, " ?\r\n");
+
+	if(_len == 8 && strncmp(_path, "/metrics", 8) == 0)
+		return LOCAL_ROUTE_METRICS;
+	if(_len != 5 || strncmp(_path, "/json", 5) != 0)
+		return LOCAL_ROUTE_NONE;
+
+	// Query is a part of the request line only
+	const char* _query = _path + _len;
+	size_t _qlen = strcspn(_query, " \r\n");
+	const char* _arg = strstr(_query, "rows=");
+	if(*_query == '?' && _arg && _arg < _query + _qlen)
+	{
+		long _n = atol(_arg + 5);
+		*rows = (_n < 0) ? 0 : (_n > LOCAL_HISTORY) ? LOCAL_HISTORY : _n;
+	}
+	return LOCAL_ROUTE_JSON;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Writes (the rest of) the current chunk, formats the next one once it went out.
+			Connection is closed after the last one, or when the client takes nothing for LOCAL_HTTP_TIMEOUT.
+*/
+void LocalHttp::_respond()
+{
+	if(m_outSent >= m_outLen)
+	{
+		m_outSent = 0;
+		if(m_route == LOCAL_ROUTE_METRICS)
+			m_outLen = m_store->prometheus(m_out, sizeof(m_out), &m_pos);
+		else if(m_route == LOCAL_ROUTE_JSON)
+			m_outLen = m_store->json(m_out, sizeof(m_out), &m_pos, m_rows);
+		else
+			m_outLen = 0;
+
+		if(m_outLen == 0)
+		{
+			m_requests++;
+			_close();
+			return;
+		}
+	}
+
+	// Socket takes what fits into its send buffer, the rest goes with the next poll
+	size_t _n = m_client.write((const uint8_t*)&m_out[m_outSent], m_outLen - m_outSent);
+	if(_n > 0)
+	{
+		m_outSent += _n;
+		m_since = millis();
+	}
+	else if(millis() - m_since > LOCAL_HTTP_TIMEOUT)
+		_close();
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Ends the connection, ready for the next client.
+*/
+void LocalHttp::_close()
+{
+	m_client.stop();
+	m_answering = false;
+	m_reqLen = 0;
+	m_outLen = 0;
+	m_outSent = 0;
+}
+
+// ############################################################################
+/*!
+	@brief	Creates MQTT client of a socket connected by its owner.
+	@param	*net
+			Socket.
+	@param	*host, port
+			Broker address.
+*/
+LocalMqttClient::LocalMqttClient(WiFiClient* net, const char* host, uint16_t port) : Adafruit_MQTT_Client(net, host, port, "", "")
+{
+	m_sock = net;
+}
+
+/*!
+	@brief		[INTERNAL METHOD] Called by connect() - uses the socket as it is instead of blocking in a new TCP connect.
+	@returns	True if the socket is connected.
+*/
+bool LocalMqttClient::connectServer()
+{
+	return m_sock->connected();
+}
+
+// ############################################################################
+/*!
+	@brief	Creates client of a local broker (no credentials).
+	@param	*host, port
+			Broker address.
+	@param	*prefix
+			Topic prefix.
+*/
+LocalMqtt::LocalMqtt(const char* host, uint16_t port, const char* prefix) : m_mqtt(&m_net, host, port)
+{
+	m_host = host;
+	m_port = port;
+	m_prefix = prefix;
+	m_lastTry = 0;
+	m_tried = false;
+	m_session = false;
+}
+
+/*!
+	@brief		Publishes value of every channel to its own topic.
+	@param		*values
+				CH_COUNT channel values [V].
+	@returns	Number of published values.
+*/
+uint8_t LocalMqtt::publish(const float* values)
+{
+	uint8_t _sent = 0;
+
+	if(!connected())
+		return 0;
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		char _topic[64];
+		char _payload[16];
+		snprintf(_topic, sizeof(_topic), "%s/%s", m_prefix, ch_table[c].feed);
+		snprintf(_payload, sizeof(_payload), "%.*f", ch_table[c].decimals, values[c]);
+		if(m_mqtt.publish(_topic, _payload))
+			_sent++;
+	}
+	return _sent;
+}
+
+/*!
+	@brief	Advances connection in the background, so it is up when the next row comes. Call from the main loop.
+*/
+void LocalMqtt::poll()
+{
+	connected();
+}
+
+/*!
+	@brief		Checks connection, reconnects at most every LOCAL_MQTT_RETRY ms. Every call does at most
+				one step - TCP connect (bounded by LOCAL_MQTT_CONNECT_MS) or MQTT handshake on the open socket.
+	@returns	True if broker is connected.
+*/
+bool LocalMqtt::connected()
+{
+	if(m_session && m_mqtt.connected())
+		return true;
+	m_session = false;
+	if(WiFi.status() != WL_CONNECTED)
+		return false;
+
+	// Socket opened by the previous call - broker on the LAN answers CONNECT right away
+	if(m_net.connected())
+	{
+		m_session = (m_mqtt.connect() == 0);
+		if(!m_session)
+			m_net.stop();
+		return m_session;
+	}
+
+	if(m_tried && millis() - m_lastTry < LOCAL_MQTT_RETRY)
+		return false;
+
+	m_tried = true;
+	m_lastTry = millis();
+	m_net.connect(m_host, m_port, LOCAL_MQTT_CONNECT_MS);
+	return false;
+}
+#endif
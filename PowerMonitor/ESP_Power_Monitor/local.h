@@ -0,0 +1,172 @@
+/*
+	Local data plane - measurements served on the LAN, independent of the cloud broker.
+	Recent rows are kept in a RAM ring and served over plain HTTP as Prometheus text (/metrics)
+	or JSON (/json), so dashboards can poll it as often as they like without touching
+	the rate-limited uplink. Optionally every row is also mirrored to a local MQTT broker.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef LOCAL_H
+#define LOCAL_H
+
+
+#include "channels.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ARDUINO)
+#include <WiFi.h>
+#include "Adafruit_MQTT_Client.h"
+#endif
+
+
+/*!
+	@brief	Channel statistics over the last publish interval [V].
+*/
+typedef struct
+{
+	float min;
+	float max;
+	float stddev;
+} local_stats_t;
+
+/*!
+	@brief	Row of history - all channel values of one publish interval.
+*/
+typedef struct
+{
+	uint32_t time;				// UNIX time or seconds since boot (below LOG_TIME_VALID)
+	float values[CH_COUNT];
+} local_row_t;
+
+
+// ############################################################################
+/*!
+	@brief	In-memory history with text formatters.
+			Output is produced in chunks of whole lines / rows - a cursor tells where the next chunk starts,
+			so any amount of history goes out through a small buffer.
+*/
+class LocalStore
+{
+public:
+	LocalStore();
+
+	void push(uint32_t time, const float* values, const local_stats_t* stats);
+
+	uint16_t rows() const;
+	const local_row_t* row(uint16_t idx) const;
+	uint32_t pushed() const;
+
+	size_t prometheus(char* dst, size_t len, uint32_t* pos) const;
+	size_t json(char* dst, size_t len, uint32_t* pos, uint16_t rows) const;
+
+private:
+	local_row_t m_rows[LOCAL_HISTORY];
+	uint32_t m_head;					// Rows pushed since start
+	local_stats_t m_stats[CH_COUNT];	// Of the latest row
+
+	typedef int (LocalStore::*item_fn)(char* dst, size_t len, uint32_t item, uint16_t rows) const;
+
+	size_t _fill(char* dst, size_t len, uint32_t* pos, uint32_t items, item_fn fn, uint16_t rows) const;
+	int _promItem(char* dst, size_t len, uint32_t item, uint16_t rows) const;
+	int _jsonItem(char* dst, size_t len, uint32_t item, uint16_t rows) const;
+};
+
+
+typedef enum
+{
+	LOCAL_ROUTE_NONE = 0,		// Unknown path - 404
+	LOCAL_ROUTE_METRICS,		// GET /metrics
+	LOCAL_ROUTE_JSON,			// GET /json[?rows=N]
+	LOCAL_ROUTE_BAD				// Not a GET request - 400
+} local_route_t;
+
+
+#if defined(ARDUINO)
+// ############################################################################
+/*!
+	@brief	Minimal HTTP/1.0 server - one connection at a time, polled from the main loop.
+			Answer goes out one chunk per poll(), so a long history doesn't hold the loop.
+*/
+class LocalHttp
+{
+public:
+	LocalHttp(const LocalStore* store, uint16_t port = LOCAL_HTTP_PORT);
+
+	void poll();
+	bool busy() const;
+	uint32_t requests() const;
+
+	static local_route_t parse(const char* req, uint16_t* rows);
+
+private:
+	const LocalStore* m_store;
+	WiFiServer m_server;
+	WiFiClient m_client;
+	bool m_started;
+
+	char m_req[LOCAL_HTTP_REQ];		// Request head received so far
+	uint16_t m_reqLen;
+	uint32_t m_since;				// Connection accept time / the last progress of the answer
+	uint32_t m_requests;
+
+	// Answer being sent
+	bool m_answering;
+	local_route_t m_route;
+	uint16_t m_rows;				// Rows of JSON answer
+	uint32_t m_pos;					// Cursor of the body formatter
+	char m_out[LOCAL_HTTP_CHUNK];	// Chunk being written
+	uint16_t m_outLen;
+	uint16_t m_outSent;
+
+	void _respond();
+	void _close();
+};
+
+// ############################################################################
+/*!
+	@brief	MQTT client over a socket opened beforehand - connect() does only the MQTT handshake.
+*/
+class LocalMqttClient : public Adafruit_MQTT_Client
+{
+public:
+	LocalMqttClient(WiFiClient* net, const char* host, uint16_t port);
+
+protected:
+	bool connectServer() override;
+
+private:
+	WiFiClient* m_sock;
+};
+
+// ############################################################################
+/*!
+	@brief	Mirror of channel values on a local MQTT broker ("<prefix>/<feed key>", no TLS, no rate limit).
+			Connection is made in steps of separate calls - TCP connect bounded by LOCAL_MQTT_CONNECT_MS,
+			then MQTT handshake - so a broker which is off doesn't stall the loop.
+*/
+class LocalMqtt
+{
+public:
+	LocalMqtt(const char* host, uint16_t port, const char* prefix);
+
+	uint8_t publish(const float* values);
+	void poll();
+	bool connected();
+
+private:
+	WiFiClient m_net;
+	LocalMqttClient m_mqtt;
+	const char* m_host;
+	uint16_t m_port;
+	const char* m_prefix;
+	uint32_t m_lastTry;				// Last connection attempt
+	bool m_tried;
+	bool m_session;					// MQTT handshake done on the current socket
+};
+#endif
+
+
+#endif // LOCAL_H
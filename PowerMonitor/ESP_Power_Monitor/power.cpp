@@ -0,0 +1,336 @@
+#include "power.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#endif
+
+
+// Current drawn in every state [mA], indexed by lp_state_t
+static const float s_current[LP_STATES] = { LP_CURRENT_AWAKE, LP_CURRENT_UPLINK, LP_CURRENT_SLEEP };
+
+static_assert(sizeof(lp_rtc_buf_t) <= 4096, "LP_RTC_RECORDS don't fit into RTC slow memory!");
+
+
+// ############################################################################
+/*!
+	@brief	Creates schedule.
+	@param	period
+			Time between starts of sampling windows [ms].
+	@param	awake
+			Length of sampling window [ms].
+	@param	flush
+			Time between uplinks [ms].
+	@param	uplink
+			Longest uplink [ms] - what isn't sent by then waits for the next one.
+*/
+DutyCycle::DutyCycle(uint32_t period, uint32_t awake, uint32_t flush, uint32_t uplink)
+{
+	m_period = period;
+	m_awake = (awake < period) ? awake : period;
+	m_flush = flush;
+	m_uplink = uplink;
+	m_state = LP_AWAKE;
+	m_since = 0;
+	m_window = 0;
+	m_lastFlush = 0;
+	m_cycles = 0;
+	memset(m_time, 0, sizeof(m_time));
+}
+
+/*!
+	@brief	Starts with sampling window. The first one is followed by uplink (clock sync, old backlog).
+*/
+void DutyCycle::begin(uint32_t now)
+{
+	m_state = LP_AWAKE;
+	m_since = now;
+	m_window = now;
+	m_lastFlush = now - m_flush;
+}
+
+/*!
+	@brief		Advances schedule.
+	@param		now
+				Current time [ms].
+	@param		flush_now
+				Uplink is needed regardless of LP_FLUSH_INTERVAL (e.g. RTC buffer is full).
+	@param		flushed
+				Everything was uploaded - uplink can end.
+	@returns	State to be in now.
+*/
+lp_state_t DutyCycle::tick(uint32_t now, bool flush_now, bool flushed)
+{
+	switch(m_state)
+	{
+	case LP_AWAKE:
+		if(now - m_window < m_awake)
+			break;
+
+		m_cycles++;
+		if(flush_now || now - m_lastFlush >= m_flush)
+			_enter(LP_UPLINK, now);
+		else
+			_enter(LP_SLEEP, now);
+		break;
+
+	case LP_UPLINK:
+		if(flushed || now - m_since >= m_uplink)
+		{
+			m_lastFlush = m_since;
+			_enter(LP_SLEEP, now);
+		}
+		break;
+
+	case LP_SLEEP:
+		if(sleepTime(now) > 0)
+			break;
+
+		// Windows keep their cadence, the one missed (e.g. by long uplink) starts now
+		m_window += m_period;
+		if(now - m_window >= m_awake)
+			m_window = now;
+		_enter(LP_AWAKE, now);
+		break;
+
+	default:
+		break;
+	}
+	return m_state;
+}
+
+/*!
+	@returns	Current state.
+*/
+lp_state_t DutyCycle::state() const
+{
+	return m_state;
+}
+
+/*!
+	@returns	Time left until the next sampling window [ms], 0 if not sleeping.
+*/
+uint32_t DutyCycle::sleepTime(uint32_t now) const
+{
+	if(m_state != LP_SLEEP)
+		return 0;
+
+	int32_t _left = (int32_t)(m_window + m_period - now);
+	return (_left > 0) ? _left : 0;
+}
+
+/*!
+	@returns	Time spent in a state [ms].
+*/
+uint64_t DutyCycle::residency(lp_state_t state) const
+{
+	return (state < LP_STATES) ? m_time[state] : 0;
+}
+
+/*!
+	@brief		Estimates average current from measured time in states and LP_CURRENT_* of them.
+	@returns	Average current [mA], 0 before the first state change.
+*/
+float DutyCycle::averageCurrent() const
+{
+	uint64_t _total = 0;
+	float _charge = 0;
+
+	for(uint8_t s = 0; s < LP_STATES; s++)
+	{
+		_total += m_time[s];
+		_charge += (float)m_time[s] * s_current[s];
+	}
+	return _total ? _charge / (float)_total : 0;
+}
+
+/*!
+	@returns	Sampling windows completed.
+*/
+uint32_t DutyCycle::cycles() const
+{
+	return m_cycles;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Closes the current state (its time is accounted) and enters another one.
+*/
+void DutyCycle::_enter(lp_state_t state, uint32_t now)
+{
+	m_time[m_state] += now - m_since;
+	m_state = state;
+	m_since = now;
+}
+
+
+// ############################################################################
+/*!
+	@brief	Creates log over a buffer.
+	@param	*mem
+			Buffer, normally placed in RTC memory.
+*/
+RtcLog::RtcLog(lp_rtc_buf_t* mem)
+{
+	m_mem = mem;
+}
+
+/*!
+	@brief		Checks buffer - garbage (after power-up) is cleared, valid records are kept.
+	@returns	True if records from before reset / sleep are there.
+*/
+bool RtcLog::begin()
+{
+	if(m_mem->magic != LP_RTC_MAGIC || m_mem->head >= LP_RTC_RECORDS || m_mem->count > LP_RTC_RECORDS)
+	{
+		memset(m_mem, 0, sizeof(lp_rtc_buf_t));
+		m_mem->magic = LP_RTC_MAGIC;
+	}
+	return m_mem->count > 0;
+}
+
+/*!
+	@brief	Adds record, the oldest one is overwritten when full.
+	@param	time
+			Timestamp (as in backlog).
+	@param	*values
+			CH_COUNT values [V].
+*/
+void RtcLog::push(uint32_t time, const float* values)
+{
+	if(m_mem->count >= LP_RTC_RECORDS)
+	{
+		m_mem->head = (m_mem->head + 1) % LP_RTC_RECORDS;
+		m_mem->count--;
+		m_mem->lost++;
+	}
+
+	log_rec_t* _rec = &m_mem->recs[(m_mem->head + m_mem->count) % LP_RTC_RECORDS];
+	_rec->time = time;
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		float _v = values[c] * LOG_VALUE_SCALE;
+		if(_v > INT16_MAX)
+			_v = INT16_MAX;
+		if(_v < INT16_MIN)
+			_v = INT16_MIN;
+		_rec->values[c] = (int16_t)lroundf(_v);
+	}
+	m_mem->count++;
+}
+
+/*!
+	@brief		Takes the oldest record.
+	@returns	False if log is empty.
+*/
+bool RtcLog::pop(uint32_t* time, float* values)
+{
+	if(m_mem->count == 0)
+		return false;
+
+	const log_rec_t* _rec = &m_mem->recs[m_mem->head];
+	*time = _rec->time;
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		values[c] = (float)_rec->values[c] / LOG_VALUE_SCALE;
+
+	m_mem->head = (m_mem->head + 1) % LP_RTC_RECORDS;
+	m_mem->count--;
+	return true;
+}
+
+/*!
+	@returns	Records waiting.
+*/
+uint16_t RtcLog::count() const
+{
+	return m_mem->count;
+}
+
+/*!
+	@returns	True if the next push() overwrites a record.
+*/
+bool RtcLog::full() const
+{
+	return m_mem->count >= LP_RTC_RECORDS;
+}
+
+/*!
+	@returns	Records overwritten before upload.
+*/
+uint32_t RtcLog::lost() const
+{
+	return m_mem->lost;
+}
+
+
+#if defined(ARDUINO)
+// ############################################################################
+/*!
+	@brief	Creates backlight driver.
+	@param	pin
+			Backlight GPIO.
+	@param	channel
+			LEDC channel used.
+*/
+Backlight::Backlight(uint8_t pin, uint8_t channel)
+{
+	m_pin = pin;
+	m_channel = channel;
+	m_level = 0;
+	m_lastTouch = 0;
+}
+
+/*!
+	@brief	Sets up PWM and turns backlight on.
+*/
+void Backlight::begin()
+{
+	ledcSetup(m_channel, BL_PWM_FREQ, 8);
+	ledcAttachPin(m_pin, m_channel);
+	touch();
+}
+
+/*!
+	@brief	Marks activity (fault, command...) - full brightness for BL_IDLE_MS.
+*/
+void Backlight::touch()
+{
+	m_lastTouch = millis();
+	if(m_level != BL_FULL)
+	{
+		m_level = BL_FULL;
+		ledcWrite(m_channel, m_level);
+	}
+}
+
+/*!
+	@brief	Dims backlight when idle (or restores it after off()). Call periodically.
+*/
+void Backlight::tick()
+{
+	uint8_t _level = (millis() - m_lastTouch < BL_IDLE_MS) ? BL_FULL : BL_DIM;
+	if(_level != m_level)
+	{
+		m_level = _level;
+		ledcWrite(m_channel, m_level);
+	}
+}
+
+/*!
+	@brief	Turns backlight off (before sleep - PWM doesn't run in light sleep), tick() turns it on again.
+*/
+void Backlight::off()
+{
+	m_level = 0;
+	ledcWrite(m_channel, 0);
+}
+
+/*!
+	@returns	Current PWM duty (0-255).
+*/
+uint8_t Backlight::level() const
+{
+	return m_level;
+}
+#endif
@@ -0,0 +1,132 @@
+/*
+	Duty-cycled low-power operation for battery-backed deployments.
+	The monitor wakes every LP_PERIOD, samples rails for LP_AWAKE_MS and stores the summary
+	as a compact record in RTC memory, then goes to light sleep. WiFi is powered only every
+	LP_FLUSH_INTERVAL (or when the buffer fills up) to upload the batch through store-and-forward log.
+	Time spent in every state is measured and turned into estimate of average current.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef POWER_H
+#define POWER_H
+
+
+#include "backlog.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define LP_RTC_MAGIC		0x4c505231		// "LPR1"
+
+
+typedef enum
+{
+	LP_AWAKE = 0,			// Sampling window, radio off
+	LP_UPLINK,				// Radio on, batch being uploaded
+	LP_SLEEP,				// Light sleep until the next window
+	LP_STATES
+} lp_state_t;
+
+
+// ############################################################################
+/*!
+	@brief	Schedule of the duty cycle. Pure state machine driven by time - caller does the actual work
+			on state changes (records summary when AWAKE ends, powers radio for UPLINK, sleeps in SLEEP).
+*/
+class DutyCycle
+{
+public:
+	DutyCycle(uint32_t period = LP_PERIOD, uint32_t awake = LP_AWAKE_MS,
+		uint32_t flush = LP_FLUSH_INTERVAL, uint32_t uplink = LP_UPLINK_TIMEOUT);
+
+	void begin(uint32_t now);
+	lp_state_t tick(uint32_t now, bool flush_now, bool flushed);
+
+	lp_state_t state() const;
+	uint32_t sleepTime(uint32_t now) const;
+
+	uint64_t residency(lp_state_t state) const;
+	float averageCurrent() const;
+	uint32_t cycles() const;
+
+private:
+	uint32_t m_period;
+	uint32_t m_awake;
+	uint32_t m_flush;
+	uint32_t m_uplink;
+
+	lp_state_t m_state;
+	uint32_t m_since;				// Start of the current state
+	uint32_t m_window;				// Start of the current sampling window
+	uint32_t m_lastFlush;
+	uint64_t m_time[LP_STATES];		// ms spent in every state (completed ones)
+	uint32_t m_cycles;				// Sampling windows completed
+
+	void _enter(lp_state_t state, uint32_t now);
+};
+
+
+/*!
+	@brief	Records waiting for uplink. Placed in RTC memory by the user - kept over light / deep sleep
+			and software resets (checked by magic), lost only with power.
+*/
+typedef struct
+{
+	uint32_t magic;
+	uint16_t head;					// Index of the oldest record
+	uint16_t count;
+	uint32_t lost;					// Records overwritten when full
+	log_rec_t recs[LP_RTC_RECORDS];
+} lp_rtc_buf_t;
+
+// ############################################################################
+/*!
+	@brief	FIFO of compact records (values in LOG_VALUE_SCALE units, as in backlog) over lp_rtc_buf_t.
+*/
+class RtcLog
+{
+public:
+	RtcLog(lp_rtc_buf_t* mem);
+
+	bool begin();
+	void push(uint32_t time, const float* values);
+	bool pop(uint32_t* time, float* values);
+
+	uint16_t count() const;
+	bool full() const;
+	uint32_t lost() const;
+
+private:
+	lp_rtc_buf_t* m_mem;
+};
+
+
+#if defined(ARDUINO)
+// ############################################################################
+/*!
+	@brief	LCD backlight on PWM - full brightness after activity, dimmed after BL_IDLE_MS without it.
+*/
+class Backlight
+{
+public:
+	Backlight(uint8_t pin, uint8_t channel = BL_PWM_CHANNEL);
+
+	void begin();
+	void touch();
+	void tick();
+	void off();
+
+	uint8_t level() const;
+
+private:
+	uint8_t m_pin;
+	uint8_t m_channel;
+	uint8_t m_level;				// Duty currently set
+	uint32_t m_lastTouch;
+};
+#endif
+
+
+#endif // POWER_H
@@ -0,0 +1,189 @@
+#include "relay.h"
+
+#include <ctype.h>
+
+
+// Table expanded from RELAY() lines
+#define RELAY(name, feed, pin) \
+	{ name, feed, feed "-state", pin },
+
+const relay_t rel_table[REL_COUNT] =
+{
+	RELAY_TABLE
+};
+
+#undef RELAY
+
+static_assert(sizeof(rel_table) / sizeof(rel_table[0]) == REL_COUNT, "REL_COUNT doesn't match RELAY_TABLE!");
+static_assert(REL_COUNT <= RELAY_MAX, "Too many relays!");
+
+
+/*!
+	@brief	Creates empty set of relays.
+	@param	*aio
+			Client used to acknowledge new states.
+*/
+Relays::Relays(ESP_AIO_Client* aio)
+{
+	m_aio = aio;
+	m_cnt = 0;
+	m_commands = 0;
+	m_lastLatency = 0;
+	m_maxLatency = 0;
+	memset(m_relays, 0, sizeof(m_relays));
+}
+
+/*!
+	@brief		Adds relay (off by default).
+	@param		pin
+				Relay's GPIO.
+	@param		*ack
+				Feed receiving relay state after every change.
+	@returns	Relay index, -1 if there is no room for another one.
+*/
+int8_t Relays::add(uint8_t pin, AIO_Publish* ack)
+{
+	if(m_cnt >= RELAY_MAX)
+		return -1;
+
+	m_relays[m_cnt].pin = pin;
+	m_relays[m_cnt].ack = ack;
+	m_relays[m_cnt].state = false;
+	return m_cnt++;
+}
+
+/*!
+	@brief	Configures GPIOs and switches all relays off.
+*/
+void Relays::begin()
+{
+	for(uint8_t i = 0; i < m_cnt; i++)
+	{
+		digitalWrite(m_relays[i].pin, REL_ACTIVE_HIGH ? LOW : HIGH);
+		pinMode(m_relays[i].pin, OUTPUT);
+	}
+}
+
+/*!
+	@brief		Executes command received from a feed.
+	@param		relay
+				Relay index.
+	@param		*data
+				Received payload (not null terminated).
+	@param		len
+				Payload length.
+	@param		received_us
+				micros() when the message was received (ESP_AIO_Client::rxTime()) - latency includes its
+				reading and parsing, not only the handling.
+	@returns	False if payload isn't a valid command.
+*/
+bool Relays::handle(uint8_t relay, const char* data, uint16_t len, uint32_t received_us)
+{
+	if(relay >= m_cnt)
+		return false;
+
+	relay_cmd_t _cmd = parse(data, len);
+	if(_cmd == RELAY_CMD_INVALID)
+	{
+		DPRINT("[RELAY %d] Invalid command: %.*s\n", relay, (int)len, data);
+		return false;
+	}
+
+	bool _on = (_cmd == RELAY_CMD_TOGGLE) ? !m_relays[relay].state : (_cmd == RELAY_CMD_ON);
+	set(relay, _on);
+
+	m_lastLatency = micros() - received_us;
+	if(m_lastLatency > m_maxLatency)
+		m_maxLatency = m_lastLatency;
+	m_commands++;
+	DPRINT("[RELAY %d] %s in %u us\n", relay, _on ? "ON" : "OFF", m_lastLatency);
+	return true;
+}
+
+/*!
+	@brief	Switches relay and acknowledges its state (also when it didn't change, so sender always gets an answer).
+	@param	relay
+			Relay index.
+	@param	on
+			New state.
+*/
+void Relays::set(uint8_t relay, bool on)
+{
+	if(relay >= m_cnt)
+		return;
+
+	digitalWrite(m_relays[relay].pin, (on == (bool)REL_ACTIVE_HIGH) ? HIGH : LOW);
+	m_relays[relay].state = on;
+
+	if(m_relays[relay].ack && m_aio)
+		m_aio->enqueue(m_relays[relay].ack, on ? "ON" : "OFF");
+}
+
+/*!
+	@returns	Current relay state, false for unknown relay.
+*/
+bool Relays::state(uint8_t relay) const
+{
+	return (relay < m_cnt) ? m_relays[relay].state : false;
+}
+
+/*!
+	@returns	Number of executed commands.
+*/
+uint32_t Relays::commands() const
+{
+	return m_commands;
+}
+
+/*!
+	@returns	Time from receipt of the last command to its GPIO write (us).
+*/
+uint32_t Relays::lastLatency() const
+{
+	return m_lastLatency;
+}
+
+/*!
+	@returns	The longest time from receipt of a command to its GPIO write (us).
+*/
+uint32_t Relays::maxLatency() const
+{
+	return m_maxLatency;
+}
+
+/*!
+	@brief		Parses relay command - ON/OFF, 1/0, TRUE/FALSE or TOGGLE, case insensitive,
+				surrounding whitespace and quotes are ignored.
+	@returns	relay_cmd_t
+*/
+relay_cmd_t Relays::parse(const char* data, uint16_t len)
+{
+	static const struct
+	{
+		const char* text;
+		relay_cmd_t cmd;
+	} _cmds[] =
+	{
+		{ "ON", RELAY_CMD_ON }, { "1", RELAY_CMD_ON }, { "TRUE", RELAY_CMD_ON },
+		{ "OFF", RELAY_CMD_OFF }, { "0", RELAY_CMD_OFF }, { "FALSE", RELAY_CMD_OFF },
+		{ "TOGGLE", RELAY_CMD_TOGGLE }
+	};
+
+	if(!data)
+		return RELAY_CMD_INVALID;
+
+	while(len > 0 && (isspace((uint8_t)*data) || *data == '"'))
+	{
+		data++;
+		len--;
+	}
+	while(len > 0 && (isspace((uint8_t)data[len - 1]) || data[len - 1] == '"'))
+		len--;
+
+	for(uint8_t i = 0; i < sizeof(_cmds) / sizeof(_cmds[0]); i++)
+	{
+		if(strlen(_cmds[i].text) == len && strncasecmp(_cmds[i].text, data, len) == 0)
+			return _cmds[i].cmd;
+	}
+	return RELAY_CMD_INVALID;
+}
@@ -0,0 +1,82 @@
+/*
+	Output relays controlled from Adafruit IO feeds.
+	Commands set an explicit state (ON/OFF, 1/0, TRUE/FALSE) or TOGGLE it,
+	the new state is acknowledged by publishing it to a separate state feed.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef RELAY_H
+#define RELAY_H
+
+
+#include "esp_aio.h"
+
+
+#define RELAY_MAX			8
+
+
+/*!
+	@brief	Static description of a relay, built from RELAY_TABLE in config.h.
+*/
+typedef struct
+{
+	const char* name;		// Label on display
+	const char* cmdFeed;	// Feed of commands
+	const char* stateFeed;	// Feed of acknowledged states
+	uint8_t pin;
+} relay_t;
+
+
+extern const relay_t rel_table[REL_COUNT];
+
+
+typedef enum
+{
+	RELAY_CMD_INVALID = -1,
+	RELAY_CMD_OFF = 0,
+	RELAY_CMD_ON,
+	RELAY_CMD_TOGGLE
+} relay_cmd_t;
+
+
+// ############################################################################
+/*!
+	@brief	Set of relays driven by GPIO.
+*/
+class Relays
+{
+public:
+	Relays(ESP_AIO_Client* aio);
+
+	int8_t add(uint8_t pin, AIO_Publish* ack = nullptr);
+	void begin();
+
+	bool handle(uint8_t relay, const char* data, uint16_t len, uint32_t received_us);
+	void set(uint8_t relay, bool on);
+	bool state(uint8_t relay) const;
+
+	uint32_t commands() const;
+	uint32_t lastLatency() const;
+	uint32_t maxLatency() const;
+
+	static relay_cmd_t parse(const char* data, uint16_t len);
+
+private:
+	ESP_AIO_Client* m_aio;
+
+	struct
+	{
+		uint8_t pin;
+		AIO_Publish* ack;			// State feed, nullptr - no acknowledge
+		bool state;
+	} m_relays[RELAY_MAX];
+	uint8_t m_cnt;
+
+	uint32_t m_commands;
+	uint32_t m_lastLatency;			// us from command receipt to GPIO write
+	uint32_t m_maxLatency;
+};
+
+
+#endif // RELAY_H
@@ -0,0 +1,142 @@
+#include "rms.h"
+
+#include <math.h>
+#include <string.h>
+
+
+/*!
+	@brief	Creates RMS meter.
+	@param	channel
+			Channel index in scan.
+	@param	volts_per_count
+			Scale of a raw ADC count at the measured rail (including sensor ratio).
+*/
+TrueRMS::TrueRMS(uint8_t channel, float volts_per_count)
+{
+	m_channel = channel;
+	m_vpc = volts_per_count;
+	m_dc = 2048;			// mid-scale until the first window is measured
+	m_prev = 0;
+	m_armed = false;
+	m_sumSq = 0;
+	m_sum = 0;
+	m_peak = 0;
+	m_n = 0;
+	m_start = 0;
+	m_startFrac = 0.0f;
+	m_synced = false;
+	memset(m_result, 0, sizeof(m_result));
+	m_latest = 0;
+}
+
+/*!
+	@brief	Accumulates block of samples. Costs a multiply-add and a few compares per sample,
+			all the division work happens once per window.
+*/
+void TrueRMS::onBlock(const acq_scan_t* scans, size_t count, uint32_t seq)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		int32_t _raw = scans[i].ch[m_channel];
+		int32_t _x = _raw - m_dc;
+
+		if(_x < -RMS_HYSTERESIS)
+			m_armed = true;
+
+		// Rising zero crossing - between previous and this sample
+		if(m_armed && m_prev < 0 && _x >= 0)
+		{
+			m_armed = false;
+			_close(seq + i, (float)(-m_prev) / (float)(_x - m_prev), true);
+		}
+		else if(m_n >= RMS_MAX_WINDOW)
+			_close(seq + i, 0.0f, false);	// no crossings (DC or no signal)
+
+		uint32_t _abs = (_x < 0) ? -_x : _x;
+		m_sumSq += (uint64_t)((int64_t)_x * _x);
+		m_sum += _raw;
+		if(_abs > m_peak)
+			m_peak = _abs;
+		m_n++;
+		m_prev = _x;
+	}
+}
+
+/*!
+	@brief	Drops window open before the gap (it isn't whole cycles), the next one waits for a crossing
+			again. DC level of the last window is kept.
+*/
+void TrueRMS::onResume(uint32_t seq)
+{
+	m_n = 0;
+	_close(seq, 0.0f, false);
+	m_armed = false;
+	m_prev = 0;
+}
+
+/*!
+	@brief	Copies the latest finished window.
+	@returns False if no window was finished yet.
+*/
+bool TrueRMS::result(rms_result_t* dst) const
+{
+	uint32_t _idx;
+
+	do
+	{
+		_idx = m_latest;
+		*dst = m_result[_idx & 1];
+	} while(_idx != m_latest);	// writer finished another window meanwhile
+
+	return _idx != 0;
+}
+
+/*!
+	@returns Number of finished windows.
+*/
+uint32_t TrueRMS::windows() const
+{
+	return m_latest;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Finishes current window and opens a new one at sample seq.
+	@param	seq
+			Sequence number of the first sample of a new window.
+	@param	frac
+			Fractional position of zero crossing before seq (0 - 1, 1 = at seq).
+	@param	crossed
+			True if window is closed by zero crossing.
+*/
+void TrueRMS::_close(uint32_t seq, float frac, bool crossed)
+{
+	if(m_n > 0)
+	{
+		// Result slot which readers don't use right now
+		rms_result_t* _r = &m_result[(m_latest + 1) & 1];
+		float _mean = (float)m_sumSq / m_n;
+
+		_r->rms = sqrtf(_mean) * m_vpc;
+		_r->peak = m_peak * m_vpc;
+		_r->crest = (_r->rms > 0.0f) ? _r->peak / _r->rms : 0.0f;
+		_r->samples = m_n;
+		_r->seq = m_start;
+
+		// Period measured between interpolated crossings
+		float _period = (float)m_n + m_startFrac - (1.0f - frac);
+		_r->freq = (crossed && m_synced && _period > 0.0f) ? (float)ACQ_SAMPLE_RATE / _period : 0.0f;
+
+		m_latest = m_latest + 1;
+
+		// Window of whole cycles - its mean is the DC level for the next one
+		m_dc = (int32_t)(m_sum / m_n);
+	}
+
+	m_sumSq = 0;
+	m_sum = 0;
+	m_peak = 0;
+	m_n = 0;
+	m_start = seq;
+	m_startFrac = crossed ? 1.0f - frac : 0.0f;
+	m_synced = crossed;
+}
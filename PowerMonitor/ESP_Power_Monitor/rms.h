@@ -0,0 +1,69 @@
+/*
+	True-RMS measurement of the AC rail.
+	Sum of squares is accumulated in integer over windows aligned to rising zero crossings,
+	so every result covers whole mains cycles.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef RMS_H
+#define RMS_H
+
+
+#include "acquire.h"
+
+
+/*!
+	@brief	Result of a single measurement window.
+*/
+typedef struct
+{
+	float rms;			// [V]
+	float peak;			// [V], max absolute deviation from DC level
+	float crest;		// peak / rms
+	float freq;			// [Hz], 0 if no zero crossing was found
+	uint32_t samples;	// Samples in window
+	uint32_t seq;		// Sequence number of the first sample
+} rms_result_t;
+
+
+// ############################################################################
+/*!
+	@brief	Incremental true-RMS meter for a single channel.
+*/
+class TrueRMS : public AcqSink
+{
+public:
+	TrueRMS(uint8_t channel, float volts_per_count);
+
+	void onBlock(const acq_scan_t* scans, size_t count, uint32_t seq) override;
+	void onResume(uint32_t seq) override;
+
+	bool result(rms_result_t* dst) const;
+	uint32_t windows() const;
+
+private:
+	uint8_t m_channel;
+	float m_vpc;
+
+	int32_t m_dc;				// DC level (mean of the previous window) [counts]
+	int32_t m_prev;				// Previous DC-free sample
+	bool m_armed;				// Signal went below -hysteresis, rising crossing may come
+
+	// Current window
+	uint64_t m_sumSq;
+	int64_t m_sum;
+	uint32_t m_peak;
+	uint32_t m_n;
+	uint32_t m_start;			// Sequence number of first sample
+	float m_startFrac;			// Fractional position of the crossing which opened the window
+	bool m_synced;				// Window was opened by a crossing
+
+	rms_result_t m_result[2];	// Double buffer, readers take m_result[m_latest & 1]
+	volatile uint32_t m_latest;
+
+	void _close(uint32_t seq, float frac, bool crossed);
+};
+
+
+#endif // RMS_H
@@ -0,0 +1,65 @@
+/*
+	Lock-free hand-over of a value from one writer task to reader tasks.
+	Writer fills the slot readers don't use and bumps a counter, reader retries
+	if the counter changed while it was copying - nobody ever waits on a lock.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+
+#include <stdint.h>
+
+
+template<typename T>
+class Snapshot
+{
+public:
+	Snapshot() : m_buf(), m_latest(0) { }
+
+	/*!
+		@brief	Stores new value. Single writer only.
+	*/
+	void publish(const T& value)
+	{
+		m_buf[(m_latest + 1) & 1] = value;
+		__sync_synchronize();	// whole value is visible before the counter
+		m_latest = m_latest + 1;
+	}
+
+	/*!
+		@brief		Copies the latest consistent value.
+		@returns	False if nothing was published yet.
+	*/
+	bool read(T* dst) const
+	{
+		uint32_t _idx;
+
+		do
+		{
+			_idx = m_latest;
+			__sync_synchronize();
+			*dst = m_buf[_idx & 1];
+			__sync_synchronize();
+		} while(_idx != m_latest);	// writer published twice meanwhile
+
+		return _idx != 0;
+	}
+
+	/*!
+		@returns	Number of published values.
+	*/
+	uint32_t version() const
+	{
+		return m_latest;
+	}
+
+private:
+	T m_buf[2];
+	volatile uint32_t m_latest;
+};
+
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,123 @@
+#include "stats.h"
+
+#include <math.h>
+
+
+/*!
+	@brief	Creates empty statistics.
+*/
+RailStats::RailStats()
+{
+#if defined(ARDUINO)
+	m_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+	_reset();
+}
+
+/*!
+	@brief	Reduces block to exact integer sums, then merges it into interval accumulators.
+			Lock is held only for the merge (once per block per channel), never per sample.
+*/
+void RailStats::onBlock(const acq_scan_t* scans, size_t count, uint32_t seq)
+{
+	if(count == 0)
+		return;
+
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+	{
+		// Sums relative to the first sample keep the numbers small
+		int32_t _ref = scans[0].ch[c];
+		int64_t _sum = 0;
+		uint64_t _sumSq = 0;
+		uint16_t _min = 0xffff;
+		uint16_t _max = 0;
+
+		for(size_t i = 0; i < count; i++)
+		{
+			uint16_t _v = scans[i].ch[c];
+			int32_t _d = (int32_t)_v - _ref;
+
+			_sum += _d;
+			_sumSq += (uint64_t)((int64_t)_d * _d);
+			if(_v < _min)
+				_min = _v;
+			if(_v > _max)
+				_max = _v;
+		}
+
+		double _bMean = (double)_sum / count;
+		double _bM2 = (double)_sumSq - (double)_sum * _bMean;
+		_bMean += _ref;
+
+		_lock();
+		uint32_t _n = m_acc[c].n + count;
+		double _delta = _bMean - m_acc[c].mean;
+		m_acc[c].mean += _delta * count / _n;
+		m_acc[c].m2 += _bM2 + _delta * _delta * ((double)m_acc[c].n * count / _n);
+		m_acc[c].n = _n;
+		if(_min < m_acc[c].min)
+			m_acc[c].min = _min;
+		if(_max > m_acc[c].max)
+			m_acc[c].max = _max;
+		_unlock();
+	}
+}
+
+/*!
+	@brief	Returns statistics of all channels since the previous call and starts a new interval.
+	@param	*dst
+			Array of ACQ_CHANNELS elements.
+*/
+void RailStats::snapshot(stats_t* dst)
+{
+	_lock();
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+	{
+		dst[c].count = m_acc[c].n;
+		dst[c].mean = m_acc[c].mean;
+		dst[c].stddev = (m_acc[c].n > 1) ? sqrt(m_acc[c].m2 / (m_acc[c].n - 1)) : 0.0f;
+		dst[c].min = (m_acc[c].n > 0) ? m_acc[c].min : 0.0f;
+		dst[c].max = m_acc[c].max;
+	}
+	_reset();
+	_unlock();
+}
+
+/*!
+	@brief	[INTERNAL METHOD]
+*/
+void RailStats::_lock()
+{
+#if defined(ARDUINO)
+	portENTER_CRITICAL(&m_lock);
+#else
+	m_lock.lock();
+#endif
+}
+
+/*!
+	@brief	[INTERNAL METHOD]
+*/
+void RailStats::_unlock()
+{
+#if defined(ARDUINO)
+	portEXIT_CRITICAL(&m_lock);
+#else
+	m_lock.unlock();
+#endif
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Clears accumulators, must be called with lock held (or from constructor).
+*/
+void RailStats::_reset()
+{
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+	{
+		m_acc[c].n = 0;
+		m_acc[c].mean = 0.0;
+		m_acc[c].m2 = 0.0;
+		m_acc[c].min = 0xffff;
+		m_acc[c].max = 0;
+	}
+}
@@ -0,0 +1,72 @@
+/*
+	Streaming statistics of all rails over the publish interval.
+	Every published value summarizes all samples acquired since the previous one,
+	memory use doesn't depend on sample rate.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+
+#include "acquire.h"
+
+#if defined(ARDUINO)
+#include "freertos/FreeRTOS.h"
+#else
+#include <mutex>
+#endif
+
+
+/*!
+	@brief	Summary of a single channel over an interval (values in raw ADC counts).
+*/
+typedef struct
+{
+	uint32_t count;
+	float mean;
+	float stddev;
+	float min;
+	float max;
+} stats_t;
+
+
+// ############################################################################
+/*!
+	@brief	Per-channel running min / max / mean / standard deviation.
+			Block sums are exact integers, blocks are merged into interval
+			accumulators with Welford's (parallel) update.
+*/
+class RailStats : public AcqSink
+{
+public:
+	RailStats();
+
+	void onBlock(const acq_scan_t* scans, size_t count, uint32_t seq) override;
+
+	void snapshot(stats_t* dst);
+
+private:
+	struct
+	{
+		uint32_t n;
+		double mean;
+		double m2;			// Sum of squared deviations from mean
+		uint16_t min;
+		uint16_t max;
+	} m_acc[ACQ_CHANNELS];
+
+#if defined(ARDUINO)
+	portMUX_TYPE m_lock;
+#else
+	std::mutex m_lock;
+#endif
+
+	void _lock();
+	void _unlock();
+	void _reset();
+};
+
+
+#endif // STATS_H
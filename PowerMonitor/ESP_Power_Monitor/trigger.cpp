@@ -0,0 +1,162 @@
+#include "trigger.h"
+
+#include <string.h>
+
+
+/*!
+	@brief	Creates fault detector with all triggers disabled.
+	@param	*acq
+			Acquisition engine, capture windows are copied from its ring buffer.
+*/
+FaultTrigger::FaultTrigger(Acquisition* acq)
+{
+	m_acq = acq;
+	memset(m_cfg, 0, sizeof(m_cfg));
+	m_pending = false;
+	m_since = 0;
+	m_head = 0;
+	m_tail = 0;
+	m_events = 0;
+	m_dropped = 0;
+}
+
+/*!
+	@brief	Sets triggers of a rail. Should be called before acquisition is started.
+	@param	channel
+			Channel index.
+	@param	low
+			Brown-out threshold [counts], 0 disables.
+	@param	high
+			Over-voltage threshold [counts], 0 disables.
+	@param	slope
+			Max step between consecutive samples [counts], 0 disables.
+*/
+void FaultTrigger::configure(uint8_t channel, uint16_t low, uint16_t high, uint16_t slope)
+{
+	if(channel >= ACQ_CHANNELS)
+		return;
+	m_cfg[channel].low = low;
+	m_cfg[channel].high = high;
+	m_cfg[channel].slope = slope;
+}
+
+/*!
+	@brief	Checks every sample against triggers - a few compares per channel, nothing else
+			happens unless a trigger fires.
+*/
+void FaultTrigger::onBlock(const acq_scan_t* scans, size_t count, uint32_t seq)
+{
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+	{
+		uint16_t _low = m_cfg[c].low;
+		uint16_t _high = m_cfg[c].high ? m_cfg[c].high : 0xffff;
+		uint16_t _slope = m_cfg[c].slope;
+		uint16_t _prev = m_cfg[c].prev;
+
+		for(size_t i = 0; i < count; i++)
+		{
+			uint16_t _v = scans[i].ch[c];
+			bool _out = (_v < _low) || (_v > _high);
+
+			if(_out && !m_cfg[c].faulted)
+				_fire(seq + i, c, (_v < _low) ? TRIG_UNDER : TRIG_OVER, _v);
+			else if(_slope && (uint16_t)((_v > _prev) ? _v - _prev : _prev - _v) > _slope && (seq + i) != m_since)
+				_fire(seq + i, c, TRIG_SLOPE, _v);
+
+			m_cfg[c].faulted = _out;
+			_prev = _v;
+		}
+		m_cfg[c].prev = _prev;
+	}
+
+	// Window is complete once enough post-trigger samples are in the ring
+	if(m_pending && (seq + count) >= m_slots[m_head % TRIG_SLOTS].seq + TRIG_POST)
+		_freeze();
+}
+
+/*!
+	@brief	Starts over after a gap in sampling - capture waiting for post-trigger samples is frozen
+			with those taken before the gap, the first sample isn't compared with the last one before it
+			and pre-trigger windows don't reach behind it.
+*/
+void FaultTrigger::onResume(uint32_t seq)
+{
+	if(m_pending)
+		_freeze();
+	m_since = seq;
+}
+
+/*!
+	@brief	Returns the oldest capture waiting for upload, keeps it in queue until release().
+	@returns Capture or nullptr if queue is empty.
+*/
+const capture_t* FaultTrigger::peek() const
+{
+	if(m_tail == m_head)
+		return nullptr;
+	return &m_slots[m_tail % TRIG_SLOTS];
+}
+
+/*!
+	@brief	Removes the oldest capture from queue.
+*/
+void FaultTrigger::release()
+{
+	if(m_tail != m_head)
+		m_tail = m_tail + 1;
+}
+
+/*!
+	@returns Number of all triggers fired (including dropped ones).
+*/
+uint32_t FaultTrigger::events() const
+{
+	return m_events;
+}
+
+/*!
+	@returns Number of triggers lost because capture queue was full or a capture was in progress.
+*/
+uint32_t FaultTrigger::dropped() const
+{
+	return m_dropped;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Reserves capture slot for a new trigger.
+*/
+void FaultTrigger::_fire(uint32_t seq, uint8_t channel, trig_cause_t cause, uint16_t value)
+{
+	m_events++;
+
+	if(m_pending || (m_head - m_tail) >= TRIG_SLOTS)
+	{
+		m_dropped++;
+		return;
+	}
+
+	capture_t* _cap = &m_slots[m_head % TRIG_SLOTS];
+	_cap->seq = seq;
+	_cap->channel = channel;
+	_cap->cause = cause;
+	_cap->value = value;
+	_cap->count = 0;
+	m_pending = true;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Copies capture window from acquisition ring and publishes it to consumer.
+*/
+void FaultTrigger::_freeze()
+{
+	capture_t* _cap = &m_slots[m_head % TRIG_SLOTS];
+	uint32_t _from = (_cap->seq - m_since >= TRIG_PRE) ? _cap->seq - TRIG_PRE : m_since;
+	uint16_t _skip = TRIG_PRE - (_cap->seq - _from);	// missing pre-trigger samples right after (re)start
+
+	if(_skip)
+		memset(_cap->scans, 0, _skip * sizeof(acq_scan_t));
+	_cap->count = m_acq->copy(_from, &_cap->scans[_skip], TRIG_WINDOW - _skip) + _skip;
+
+	m_pending = false;
+	m_head = m_head + 1;
+}
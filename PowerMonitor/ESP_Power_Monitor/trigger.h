@@ -0,0 +1,89 @@
+/*
+	Fault detector for voltage rails.
+	Threshold and slope triggers run on every acquired sample, on trigger a window of
+	pre- and post-trigger samples is frozen from the acquisition ring (like an oscilloscope)
+	and queued for upload and display.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+
+#include "acquire.h"
+
+
+#define TRIG_WINDOW		(TRIG_PRE + TRIG_POST)
+
+#if (TRIG_WINDOW + ACQ_BLOCK_SIZE > ACQ_HISTORY)
+#error "Capture window doesn't fit into acquisition ring history!"
+#endif
+
+
+typedef enum
+{
+	TRIG_UNDER = 0,		// Brown-out - below low threshold
+	TRIG_OVER,			// Over-voltage - above high threshold
+	TRIG_SLOPE			// Step between two samples above slope limit
+} trig_cause_t;
+
+/*!
+	@brief	Frozen fault window.
+*/
+typedef struct
+{
+	uint32_t seq;						// Sequence number of triggering sample
+	uint8_t channel;
+	trig_cause_t cause;
+	uint16_t value;						// Triggering sample [counts]
+	uint16_t count;						// Valid scans in window
+	acq_scan_t scans[TRIG_WINDOW];		// scans[TRIG_PRE] is the triggering one
+} capture_t;
+
+
+// ############################################################################
+/*!
+	@brief	Per-rail threshold & slope trigger with capture queue.
+*/
+class FaultTrigger : public AcqSink
+{
+public:
+	FaultTrigger(Acquisition* acq);
+
+	void configure(uint8_t channel, uint16_t low, uint16_t high, uint16_t slope);
+	void onBlock(const acq_scan_t* scans, size_t count, uint32_t seq) override;
+	void onResume(uint32_t seq) override;
+
+	const capture_t* peek() const;
+	void release();
+
+	uint32_t events() const;
+	uint32_t dropped() const;
+
+private:
+	Acquisition* m_acq;
+
+	struct
+	{
+		uint16_t low;		// 0 - disabled
+		uint16_t high;		// 0 - disabled
+		uint16_t slope;		// 0 - disabled
+		uint16_t prev;
+		bool faulted;		// Rail is out of window, re-arms after coming back
+	} m_cfg[ACQ_CHANNELS];
+
+	bool m_pending;			// Trigger fired, waiting for post-trigger samples
+	uint32_t m_since;		// First sample after (re)start - nothing before it is compared or captured
+	capture_t m_slots[TRIG_SLOTS];
+	volatile uint32_t m_head;	// Captures produced
+	volatile uint32_t m_tail;	// Captures released by consumer
+	uint32_t m_events;
+	uint32_t m_dropped;
+
+	void _fire(uint32_t seq, uint8_t channel, trig_cause_t cause, uint16_t value);
+	void _freeze();
+};
+
+
+#endif // TRIGGER_H
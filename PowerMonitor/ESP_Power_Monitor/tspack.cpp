@@ -0,0 +1,502 @@
+#include "tspack.h"
+
+#include <string.h>
+#include <math.h>
+
+
+// Widths of the short codes after '10', '110' and '1110' prefixes ('1111' is always 32 bits)
+static const uint8_t s_timeCodes[3] = { 7, 9, 12 };
+static const uint8_t s_valueCodes[3] = { 6, 12, 20 };
+
+static const int32_t s_pow10[TSPACK_MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+static const char s_b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define TSPACK_HEADER		3		// Bytes before decimals
+
+
+/*!
+	@brief	Maps signed number to unsigned one, small magnitudes to small numbers (0, -1, 1, -2...).
+*/
+static inline uint32_t _zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t _unzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/*!
+	@returns	Mask of all feeds.
+*/
+static inline uint32_t _fullMask(uint8_t feeds)
+{
+	return (feeds >= 32) ? 0xffffffff : ((1UL << feeds) - 1);
+}
+
+
+// ############################################################################
+/*!
+	@brief	Creates encoder writing into a buffer.
+	@param	*buf
+			Output buffer.
+	@param	size
+			Its size in bytes.
+*/
+TsEncoder::TsEncoder(uint8_t* buf, size_t size)
+{
+	m_buf = buf;
+	m_size = buf ? size : 0;
+	m_bit = 0;
+	m_overflow = false;
+	m_feeds = 0;
+	m_rows = 0;
+	m_prevTime = 0;
+	m_prevDelta = 0;
+}
+
+/*!
+	@brief		Starts a message - writes header.
+	@param		feeds
+				Values in every row (1 - TSPACK_MAX_FEEDS).
+	@param		*decimals
+				Decimal places kept of every feed (up to TSPACK_MAX_DECIMALS).
+	@returns	False if parameters are invalid or header doesn't fit.
+*/
+bool TsEncoder::begin(uint8_t feeds, const uint8_t* decimals)
+{
+	m_bit = 0;
+	m_overflow = false;
+	m_rows = 0;
+	m_feeds = 0;
+
+	if(feeds == 0 || feeds > TSPACK_MAX_FEEDS || !decimals)
+		return false;
+
+	_put(TSPACK_VERSION, 8);
+	_put(feeds, 8);
+	_put(0, 8);					// Rows, set by finish()
+	for(uint8_t f = 0; f < feeds; f++)
+	{
+		uint8_t _dec = (decimals[f] > TSPACK_MAX_DECIMALS) ? TSPACK_MAX_DECIMALS : decimals[f];
+		m_scale[f] = s_pow10[_dec];
+		m_prev[f] = 0;
+		_put(_dec, 8);
+	}
+	if(m_overflow)
+		return false;
+
+	m_feeds = feeds;
+	m_prevTime = 0;
+	m_prevDelta = 0;
+	return true;
+}
+
+/*!
+	@brief		Appends row.
+	@param		time
+				Timestamp of the row [s].
+	@param		*values
+				Values of all feeds (ones out of mask aren't read).
+	@param		mask
+				Feeds present in the row.
+	@returns	False if row doesn't fit (buffer is left as before) or encoder isn't started.
+*/
+bool TsEncoder::add(uint32_t time, const float* values, uint32_t mask)
+{
+	if(m_feeds == 0 || !values || m_rows == 0xff)
+		return false;
+
+	size_t _start = m_bit;
+	int32_t _q[TSPACK_MAX_FEEDS];
+	int32_t _delta = (int32_t)(time - m_prevTime);
+
+	if(m_rows == 0)
+	{
+		_put(time, 32);
+		_delta = 0;
+	}
+	else
+		_putCode((int32_t)((uint32_t)_delta - (uint32_t)m_prevDelta), s_timeCodes);
+
+	mask &= _fullMask(m_feeds);
+	if(mask == _fullMask(m_feeds))
+		_put(0, 1);
+	else
+	{
+		_put(1, 1);
+		_put(mask, m_feeds);
+	}
+
+	for(uint8_t f = 0; f < m_feeds; f++)
+	{
+		_q[f] = m_prev[f];
+		if(!(mask & (1UL << f)))
+			continue;
+
+		// Quantized to published precision, out of range values are clamped
+		float _v = values[f] * m_scale[f];
+		if(!(_v > -2.0e9f))
+			_v = -2.0e9f;
+		else if(_v > 2.0e9f)
+			_v = 2.0e9f;
+		_q[f] = (int32_t)lroundf(_v);
+
+		_putCode((int32_t)((uint32_t)_q[f] - (uint32_t)m_prev[f]), s_valueCodes);
+	}
+
+	if(m_overflow)
+	{
+		m_bit = _start;
+		m_overflow = false;
+		return false;
+	}
+
+	memcpy(m_prev, _q, sizeof(int32_t) * m_feeds);
+	m_prevTime = time;
+	m_prevDelta = _delta;
+	m_rows++;
+	return true;
+}
+
+/*!
+	@brief		Completes message.
+	@returns	Length of the message in bytes, 0 if encoder isn't started.
+*/
+size_t TsEncoder::finish()
+{
+	if(m_feeds == 0)
+		return 0;
+
+	// Padding bits of the last byte are zeroed
+	if(m_bit & 7)
+		_put(0, 8 - (m_bit & 7));
+
+	m_buf[2] = m_rows;
+	return m_bit / 8;
+}
+
+/*!
+	@returns	Rows written so far.
+*/
+uint8_t TsEncoder::rows() const
+{
+	return m_rows;
+}
+
+/*!
+	@returns	Bits written so far.
+*/
+size_t TsEncoder::bits() const
+{
+	return m_bit;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Writes lowest bits of a value, MSB first. Sets overflow flag when buffer ends.
+			Bits are overwritten (not OR-ed), so position can be moved back without clearing.
+*/
+void TsEncoder::_put(uint32_t value, uint8_t bits)
+{
+	while(bits)
+	{
+		size_t _byte = m_bit >> 3;
+		if(_byte >= m_size)
+		{
+			m_overflow = true;
+			return;
+		}
+
+		uint8_t _free = 8 - (m_bit & 7);
+		uint8_t _take = (bits < _free) ? bits : _free;
+		uint8_t _shift = _free - _take;
+		uint8_t _mask = ((1U << _take) - 1) << _shift;
+		uint8_t _part = (value >> (bits - _take)) & ((1U << _take) - 1);
+
+		m_buf[_byte] = (m_buf[_byte] & ~_mask) | (_part << _shift);
+		m_bit += _take;
+		bits -= _take;
+	}
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Writes signed number with the shortest prefix code which holds it.
+*/
+void TsEncoder::_putCode(int32_t value, const uint8_t* widths)
+{
+	if(value == 0)
+	{
+		_put(0, 1);
+		return;
+	}
+
+	uint32_t _zz = _zigzag(value);
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		if(_zz < (1UL << widths[i]))
+		{
+			// '10', '110', '1110'
+			_put(((1U << (i + 1)) - 1) << 1, i + 2);
+			_put(_zz, widths[i]);
+			return;
+		}
+	}
+	_put(0x0f, 4);
+	_put(_zz, 32);
+}
+
+
+// ############################################################################
+/*!
+	@brief	Creates decoder of a message.
+	@param	*buf
+			Message (decoded from base64).
+	@param	len
+			Its length in bytes.
+*/
+TsDecoder::TsDecoder(const uint8_t* buf, size_t len)
+{
+	m_buf = buf;
+	m_len = buf ? len : 0;
+	m_bit = 0;
+	m_underflow = false;
+	m_feeds = 0;
+	m_rows = 0;
+	m_read = 0;
+	m_prevTime = 0;
+	m_prevDelta = 0;
+}
+
+/*!
+	@brief		Reads header.
+	@returns	False if message isn't valid packed data.
+*/
+bool TsDecoder::begin()
+{
+	m_bit = 0;
+	m_underflow = false;
+	m_read = 0;
+
+	if(m_len < TSPACK_HEADER || m_buf[0] != TSPACK_VERSION || m_buf[1] == 0 || m_buf[1] > TSPACK_MAX_FEEDS
+		|| m_len < (size_t)TSPACK_HEADER + m_buf[1])
+	{
+		m_feeds = 0;
+		return false;
+	}
+
+	m_feeds = m_buf[1];
+	m_rows = m_buf[2];
+	for(uint8_t f = 0; f < m_feeds; f++)
+	{
+		m_decimals[f] = m_buf[TSPACK_HEADER + f];
+		m_prev[f] = 0;
+		if(m_decimals[f] > TSPACK_MAX_DECIMALS)
+		{
+			m_feeds = 0;
+			return false;
+		}
+	}
+	m_bit = (TSPACK_HEADER + m_feeds) * 8;
+	m_prevTime = 0;
+	m_prevDelta = 0;
+	return true;
+}
+
+/*!
+	@brief		Decodes next row.
+	@param		*time
+				Timestamp of the row [s].
+	@param		*values
+				Values of feeds - only ones present in the row are written.
+	@param		*mask
+				Feeds present in the row.
+	@returns	False after the last row or if message is truncated.
+*/
+bool TsDecoder::next(uint32_t* time, float* values, uint32_t* mask)
+{
+	if(m_feeds == 0 || m_read >= m_rows || m_underflow)
+		return false;
+
+	uint32_t _time;
+	int32_t _delta = 0;
+
+	if(m_read == 0)
+		_time = _get(32);
+	else
+	{
+		_delta = (int32_t)((uint32_t)m_prevDelta + (uint32_t)_getCode(s_timeCodes));
+		_time = m_prevTime + (uint32_t)_delta;
+	}
+
+	uint32_t _mask = _fullMask(m_feeds);
+	if(_get(1))
+		_mask = _get(m_feeds);
+
+	int32_t _q[TSPACK_MAX_FEEDS];
+	for(uint8_t f = 0; f < m_feeds; f++)
+	{
+		_q[f] = m_prev[f];
+		if(_mask & (1UL << f))
+			_q[f] = (int32_t)((uint32_t)m_prev[f] + (uint32_t)_getCode(s_valueCodes));
+	}
+
+	if(m_underflow)
+		return false;
+
+	for(uint8_t f = 0; f < m_feeds; f++)
+	{
+		if(_mask & (1UL << f))
+			values[f] = (float)_q[f] / s_pow10[m_decimals[f]];
+	}
+	memcpy(m_prev, _q, sizeof(int32_t) * m_feeds);
+	m_prevTime = _time;
+	m_prevDelta = _delta;
+	m_read++;
+
+	*time = _time;
+	*mask = _mask;
+	return true;
+}
+
+/*!
+	@returns	Values in every row, 0 if header wasn't read.
+*/
+uint8_t TsDecoder::feeds() const
+{
+	return m_feeds;
+}
+
+/*!
+	@returns	Rows in the message.
+*/
+uint8_t TsDecoder::rows() const
+{
+	return m_rows;
+}
+
+/*!
+	@returns	Decimal places of a feed.
+*/
+uint8_t TsDecoder::decimals(uint8_t feed) const
+{
+	return (feed < m_feeds) ? m_decimals[feed] : 0;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Reads bits, MSB first. Sets underflow flag at the end of message.
+*/
+uint32_t TsDecoder::_get(uint8_t bits)
+{
+	uint32_t _v = 0;
+
+	while(bits)
+	{
+		size_t _byte = m_bit >> 3;
+		if(_byte >= m_len)
+		{
+			m_underflow = true;
+			return 0;
+		}
+
+		uint8_t _avail = 8 - (m_bit & 7);
+		uint8_t _take = (bits < _avail) ? bits : _avail;
+		uint8_t _part = (m_buf[_byte] >> (_avail - _take)) & ((1U << _take) - 1);
+
+		_v = (_v << _take) | _part;
+		m_bit += _take;
+		bits -= _take;
+	}
+	return _v;
+}
+
+/*!
+	@brief	[INTERNAL METHOD] Reads signed number written by TsEncoder::_putCode().
+*/
+int32_t TsDecoder::_getCode(const uint8_t* widths)
+{
+	uint8_t _ones = 0;
+	while(_ones < 4 && _get(1))
+		_ones++;
+
+	if(_ones == 0)
+		return 0;
+	return _unzigzag(_get((_ones < 4) ? widths[_ones - 1] : 32));
+}
+
+
+// ############################################################################
+/*!
+	@brief		Encodes binary data as base64 text (with padding).
+	@param		*src
+				Data.
+	@param		len
+				Its length.
+	@param		*dst
+				Text buffer.
+	@param		size
+				Its size, including terminator.
+	@returns	Length of the text, 0 if it doesn't fit.
+*/
+size_t tspack_base64(const uint8_t* src, size_t len, char* dst, size_t size)
+{
+	size_t _out = (len + 2) / 3 * 4;
+	if(!dst || _out + 1 > size)
+		return 0;
+
+	char* _p = dst;
+	for(size_t i = 0; i < len; i += 3)
+	{
+		uint32_t _w = (uint32_t)src[i] << 16;
+		if(i + 1 < len)
+			_w |= (uint32_t)src[i + 1] << 8;
+		if(i + 2 < len)
+			_w |= src[i + 2];
+
+		*_p++ = s_b64[(_w >> 18) & 0x3f];
+		*_p++ = s_b64[(_w >> 12) & 0x3f];
+		*_p++ = (i + 1 < len) ? s_b64[(_w >> 6) & 0x3f] : '=';
+		*_p++ = (i + 2 < len) ? s_b64[_w & 0x3f] : '=';
+	}
+	*_p = '\0';
+	return _out;
+}
+
+/*!
+	@brief		Decodes base64 text (padding is optional).
+	@param		*src
+				Text.
+	@param		*dst
+				Data buffer.
+	@param		size
+				Its size.
+	@returns	Length of the data, 0 if text is invalid or data doesn't fit.
+*/
+size_t tspack_unbase64(const char* src, uint8_t* dst, size_t size)
+{
+	uint32_t _w = 0;
+	uint8_t _bits = 0;
+	size_t _len = 0;
+
+	if(!src || !dst)
+		return 0;
+
+	for(; *src && *src != '='; src++)
+	{
+		const char* _c = strchr(s_b64, *src);
+		if(!_c)
+			return 0;
+
+		_w = (_w << 6) | (uint32_t)(_c - s_b64);
+		_bits += 6;
+		if(_bits >= 8)
+		{
+			if(_len >= size)
+				return 0;
+			_bits -= 8;
+			dst[_len++] = (_w >> _bits) & 0xff;
+		}
+	}
+	return _len;
+}
@@ -0,0 +1,111 @@
+/*
+	Compact encoding of measurement rows for batched uploads.
+	Rows are packed into a bit stream in the way of Gorilla time-series database:
+	timestamps as delta-of-delta, values quantized to their published decimals and sent as
+	deltas from the previous row, both with short prefix codes for the frequent small numbers.
+	Steady rails cost a few bits per value instead of tens of bytes of JSON text.
+	Message is base64 text, so it can be a value of an ordinary feed.
+
+	Layout:
+		header:	version, feeds, rows, decimals of every feed (bytes)
+		row:	timestamp, feed mask flag ('0' - all feeds [, '1' + mask]), value of every present feed
+
+		timestamp (the first one - 32 bits raw), delta-of-delta D:
+			'0' D = 0 | '10' + 7 bits | '110' + 9 bits | '1110' + 12 bits | '1111' + 32 bits
+		value delta V (from the previous value of the feed, the first one from 0):
+			'0' V = 0 | '10' + 6 bits | '110' + 12 bits | '1110' + 20 bits | '1111' + 32 bits
+		signed numbers are zigzag coded (0, -1, 1, -2...), bits are written MSB first.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef TSPACK_H
+#define TSPACK_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define TSPACK_VERSION		1
+#define TSPACK_MAX_FEEDS	32		// Feed mask is 32 bit
+#define TSPACK_MAX_DECIMALS	6
+
+// Bytes of packed data which fit into base64 text of a buffer (with terminator)
+#define TSPACK_RAW_SIZE(text_size)	((((text_size) - 1) / 4) * 3)
+
+
+// ############################################################################
+/*!
+	@brief	Encoder of rows into caller's buffer.
+			A row which doesn't fit isn't written at all, so the buffer always holds complete rows.
+*/
+class TsEncoder
+{
+public:
+	TsEncoder(uint8_t* buf, size_t size);
+
+	bool begin(uint8_t feeds, const uint8_t* decimals);
+	bool add(uint32_t time, const float* values, uint32_t mask = 0xffffffff);
+	size_t finish();
+
+	uint8_t rows() const;
+	size_t bits() const;
+
+private:
+	uint8_t* m_buf;
+	size_t m_size;
+	size_t m_bit;				// Write position
+	bool m_overflow;
+
+	uint8_t m_feeds;
+	uint8_t m_rows;
+	int32_t m_scale[TSPACK_MAX_FEEDS];		// 10^decimals
+	int32_t m_prev[TSPACK_MAX_FEEDS];		// Quantized values of the previous row
+	uint32_t m_prevTime;
+	int32_t m_prevDelta;
+
+	void _put(uint32_t value, uint8_t bits);
+	void _putCode(int32_t value, const uint8_t* widths);
+};
+
+// ############################################################################
+/*!
+	@brief	Decoder of packed rows.
+*/
+class TsDecoder
+{
+public:
+	TsDecoder(const uint8_t* buf, size_t len);
+
+	bool begin();
+	bool next(uint32_t* time, float* values, uint32_t* mask);
+
+	uint8_t feeds() const;
+	uint8_t rows() const;
+	uint8_t decimals(uint8_t feed) const;
+
+private:
+	const uint8_t* m_buf;
+	size_t m_len;
+	size_t m_bit;				// Read position
+	bool m_underflow;
+
+	uint8_t m_feeds;
+	uint8_t m_rows;
+	uint8_t m_read;				// Rows decoded so far
+	uint8_t m_decimals[TSPACK_MAX_FEEDS];
+	int32_t m_prev[TSPACK_MAX_FEEDS];
+	uint32_t m_prevTime;
+	int32_t m_prevDelta;
+
+	uint32_t _get(uint8_t bits);
+	int32_t _getCode(const uint8_t* widths);
+};
+
+
+size_t tspack_base64(const uint8_t* src, size_t len, char* dst, size_t size);
+size_t tspack_unbase64(const char* src, uint8_t* dst, size_t size);
+
+
+#endif // TSPACK_H
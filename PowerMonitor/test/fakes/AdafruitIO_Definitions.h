@@ -0,0 +1,35 @@
+/*
+	Host stand-in of the Adafruit IO definitions used by esp_aio (same values as the library).
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_ADAFRUITIO_DEFINITIONS_H
+#define FAKE_ADAFRUITIO_DEFINITIONS_H
+
+
+#define AIO_NET_DISCONNECT_WAIT		300
+
+
+typedef enum
+{
+	AIO_IDLE = 0,
+	AIO_NET_DISCONNECTED = 1,
+	AIO_DISCONNECTED = 2,
+	AIO_FINGERPRINT_UNKOWN = 3,
+
+	AIO_NET_CONNECT_FAILED = 10,
+	AIO_CONNECT_FAILED = 11,
+	AIO_FINGERPRINT_INVALID = 12,
+	AIO_AUTH_FAILED = 13,
+	AIO_SSID_INVALID = 14,
+
+	AIO_NET_CONNECTED = 20,
+	AIO_CONNECTED = 21,
+	AIO_CONNECTED_INSECURE = 22,
+	AIO_FINGERPRINT_UNSUPPORTED = 23,
+	AIO_FINGERPRINT_VALID = 24
+} aio_status_t;
+
+
+#endif // FAKE_ADAFRUITIO_DEFINITIONS_H
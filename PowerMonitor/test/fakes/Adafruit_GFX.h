@@ -0,0 +1,67 @@
+/*
+	Host stand-in of the Adafruit GFX library. Text is drawn as solid character cells
+	(5x7 per size unit in a 6x8 cell, like the default font), so tests can see where text
+	of which colour landed without real glyphs.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_ADAFRUIT_GFX_H
+#define FAKE_ADAFRUIT_GFX_H
+
+
+#include "Arduino.h"
+
+
+class Adafruit_GFX : public Print
+{
+public:
+	Adafruit_GFX(int16_t w, int16_t h);
+
+	virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+	virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	virtual void fillScreen(uint16_t color);
+	virtual void drawRGBBitmap(int16_t x, int16_t y, uint16_t* bitmap, int16_t w, int16_t h);
+	void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+	void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+
+	void setCursor(int16_t x, int16_t y);
+	void setTextColor(uint16_t c);
+	void setTextColor(uint16_t c, uint16_t bg);
+	void setTextSize(uint8_t s);
+	void setTextWrap(bool w);
+	void setRotation(uint8_t r) {}
+
+	size_t write(uint8_t c) override;
+	using Print::write;
+
+	int16_t width() const;
+	int16_t height() const;
+
+protected:
+	int16_t _width;
+	int16_t _height;
+	int16_t cursor_x;
+	int16_t cursor_y;
+	uint16_t textcolor;
+	uint16_t textbgcolor;
+	uint8_t textsize;
+	bool wrap;
+};
+
+// ############################################################################
+class GFXcanvas16 : public Adafruit_GFX
+{
+public:
+	GFXcanvas16(uint16_t w, uint16_t h);
+	~GFXcanvas16();
+
+	void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+	uint16_t* getBuffer() const;
+
+private:
+	uint16_t* buffer;
+};
+
+
+#endif // FAKE_ADAFRUIT_GFX_H
@@ -0,0 +1,101 @@
+/*
+	Host stand-in of the Adafruit MQTT library. Same structure as the real one (connect() opens
+	the socket through connectServer() and subscribes every registered topic again), but packets
+	go to a simulated broker of fake.h instead of the network.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_ADAFRUIT_MQTT_H
+#define FAKE_ADAFRUIT_MQTT_H
+
+
+#include "Arduino.h"
+
+
+#define MQTT_QOS_1				0x01
+#define MQTT_QOS_0				0x00
+
+#define MAXSUBSCRIPTIONS		5
+#define SUBSCRIPTIONDATALEN		20
+
+
+class Adafruit_MQTT_Subscribe;
+
+typedef void (*SubscribeCallbackUInt32Type)(uint32_t);
+typedef void (*SubscribeCallbackDoubleType)(double);
+typedef void (*SubscribeCallbackBufferType)(char* str, uint16_t len);
+
+
+// ############################################################################
+class Adafruit_MQTT
+{
+public:
+	Adafruit_MQTT(const char* server, uint16_t port, const char* user = "", const char* pass = "");
+	virtual ~Adafruit_MQTT() {}
+
+	int8_t connect();
+	int8_t connect(const char* user, const char* pass);
+	bool disconnect();
+	virtual bool connected() = 0;
+
+	// Real library returns flash string - plain one here, so printing it with %s is well-formed on host
+	const char* connectErrorString(int8_t code);
+
+	bool publish(const char* topic, const char* payload, uint8_t qos = 0, bool retain = false);
+	bool publish(const char* topic, uint8_t* payload, uint16_t len, uint8_t qos = 0, bool retain = false);
+	bool subscribe(Adafruit_MQTT_Subscribe* sub);
+	void processPackets(int16_t timeout);
+	bool ping(uint8_t num = 1);
+	Adafruit_MQTT& setKeepAliveInterval(uint16_t keepAlive);
+
+protected:
+	virtual bool connectServer() = 0;
+	virtual bool disconnectServer() = 0;
+
+	const char* servername;
+	uint16_t portnum;
+	uint16_t keepAliveInterval;
+	Adafruit_MQTT_Subscribe* subscriptions[MAXSUBSCRIPTIONS];
+};
+
+// ############################################################################
+class Adafruit_MQTT_Publish
+{
+public:
+	Adafruit_MQTT_Publish(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos = 0);
+
+	bool publish(const char* s);
+	bool publish(double f, uint8_t precision = 2);
+	bool publish(int32_t i);
+	bool publish(uint32_t i);
+
+	const char* topic;
+
+private:
+	Adafruit_MQTT* mqtt;
+	uint8_t qos;
+};
+
+// ############################################################################
+class Adafruit_MQTT_Subscribe
+{
+public:
+	Adafruit_MQTT_Subscribe(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos = 0);
+
+	void setCallback(SubscribeCallbackUInt32Type callb);
+	void setCallback(SubscribeCallbackDoubleType callb);
+	void setCallback(SubscribeCallbackBufferType callb);
+
+	const char* topic;
+	uint8_t qos;
+	uint8_t lastread[SUBSCRIPTIONDATALEN];
+	uint16_t datalen;
+
+	SubscribeCallbackUInt32Type callback_uint32;
+	SubscribeCallbackDoubleType callback_double;
+	SubscribeCallbackBufferType callback_buffer;
+};
+
+
+#endif // FAKE_ADAFRUIT_MQTT_H
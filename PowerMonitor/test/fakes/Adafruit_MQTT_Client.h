@@ -0,0 +1,31 @@
+/*
+	Host stand-in of the Adafruit MQTT client of an Arduino Client socket.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_ADAFRUIT_MQTT_CLIENT_H
+#define FAKE_ADAFRUIT_MQTT_CLIENT_H
+
+
+#include "Adafruit_MQTT.h"
+#include "WiFi.h"
+
+
+class Adafruit_MQTT_Client : public Adafruit_MQTT
+{
+public:
+	Adafruit_MQTT_Client(Client* client, const char* server, uint16_t port, const char* user = "", const char* key = "")
+		: Adafruit_MQTT(server, port, user, key), client(client) {}
+
+	bool connected() override;
+
+protected:
+	bool connectServer() override;
+	bool disconnectServer() override;
+
+	Client* client;
+};
+
+
+#endif // FAKE_ADAFRUIT_MQTT_CLIENT_H
@@ -0,0 +1,54 @@
+/*
+	Host stand-in of the ST7789 LCD driver - keeps the picture in RAM and counts what went over SPI.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_ADAFRUIT_ST7789_H
+#define FAKE_ADAFRUIT_ST7789_H
+
+
+#include "Adafruit_GFX.h"
+
+#include <vector>
+
+
+#define ST77XX_BLACK		0x0000
+#define ST77XX_WHITE		0xFFFF
+#define ST77XX_RED			0xF800
+#define ST77XX_GREEN		0x07E0
+#define ST77XX_BLUE			0x001F
+#define ST77XX_CYAN			0x07FF
+#define ST77XX_MAGENTA		0xF81F
+#define ST77XX_YELLOW		0xFFE0
+#define ST77XX_ORANGE		0xFC00
+
+
+class SPIClass;
+
+class Adafruit_ST7789 : public Adafruit_GFX
+{
+public:
+	Adafruit_ST7789(int8_t cs, int8_t dc, int8_t rst);
+	Adafruit_ST7789(SPIClass* spi, int8_t cs, int8_t dc, int8_t rst);
+
+	void init(uint16_t width, uint16_t height, uint8_t spiMode = 0);
+	void setSPISpeed(uint32_t freq) {}
+	void enableDisplay(bool enable) {}
+
+	void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+	void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+	void drawRGBBitmap(int16_t x, int16_t y, uint16_t* bitmap, int16_t w, int16_t h) override;
+
+	uint16_t pixel(int16_t x, int16_t y) const;
+
+	// Recorded
+	uint32_t pixelsSent = 0;		// Every pixel written over SPI
+	uint32_t windows = 0;			// Address windows set (one per drawn rectangle / bitmap)
+
+private:
+	std::vector<uint16_t> m_ram;
+};
+
+
+#endif // FAKE_ADAFRUIT_ST7789_H
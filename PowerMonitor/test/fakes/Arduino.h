@@ -0,0 +1,116 @@
+/*
+	Host stand-in of the Arduino core - only the part used by the sketch modules under test.
+	Time is simulated: millis() / micros() return the fake clock (fake.h), delay() advances it.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#define HIGH			1
+#define LOW				0
+#define INPUT			0x01
+#define OUTPUT			0x03
+#define INPUT_PULLUP	0x05
+
+typedef bool boolean;
+
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void yield();
+
+long random(long max);
+long random(long min, long max);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+void configTime(long gmtOffset, int dstOffset, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size);
+
+
+// ############################################################################
+class Print
+{
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* buf, size_t len);
+
+	size_t print(const char* str);
+	size_t println(const char* str = "");
+	size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available() { return 0; }
+	virtual int read() { return -1; }
+};
+
+// Serial goes to stdout
+class HardwareSerial : public Stream
+{
+public:
+	void begin(unsigned long baud) {}
+	void flush() { fflush(stdout); }
+	size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+	using Print::write;
+	operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+
+// ############################################################################
+class String
+{
+public:
+	String(const char* str = "");
+	const char* c_str() const;
+
+private:
+	char m_buf[64];
+};
+
+class IPAddress
+{
+public:
+	IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0);
+	String toString() const;
+
+private:
+	uint8_t m_addr[4];
+};
+
+class EspClass
+{
+public:
+	uint32_t getFreeHeap() { return 200000; }
+	uint32_t getMinFreeHeap() { return 180000; }
+	uint32_t getMaxAllocHeap() { return 110000; }
+};
+extern EspClass ESP;
+
+
+#endif // FAKE_ARDUINO_H
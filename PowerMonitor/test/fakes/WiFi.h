@@ -0,0 +1,107 @@
+/*
+	Host stand-in of the ESP32 WiFi library. Association and sockets are simulated by fake.h -
+	a test decides when the access point is in range, which hosts accept connections
+	and what LAN clients send.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_WIFI_H
+#define FAKE_WIFI_H
+
+
+#include "Arduino.h"
+
+#include <memory>
+
+
+typedef enum
+{
+	WL_IDLE_STATUS = 0,
+	WL_NO_SSID_AVAIL,
+	WL_SCAN_COMPLETED,
+	WL_CONNECTED,
+	WL_CONNECT_FAILED,
+	WL_CONNECTION_LOST,
+	WL_DISCONNECTED
+} wl_status_t;
+
+typedef enum
+{
+	WIFI_OFF = 0,
+	WIFI_STA = 1
+} wifi_mode_t;
+
+
+namespace fake { struct Socket; }
+
+
+// ############################################################################
+class WiFiClass
+{
+public:
+	wl_status_t begin(const char* ssid, const char* pass, int32_t channel = 0, const uint8_t* bssid = nullptr, bool connect = true);
+	wl_status_t status();
+	bool disconnect(bool wifioff = false, bool eraseap = false);
+	bool mode(wifi_mode_t mode);
+	bool setSleep(bool enable);
+
+	IPAddress localIP();
+	int8_t RSSI();
+	uint8_t* BSSID();
+	int32_t channel();
+};
+extern WiFiClass WiFi;
+
+// ############################################################################
+class Client : public Stream
+{
+public:
+	virtual int connect(const char* host, uint16_t port) = 0;
+	virtual uint8_t connected() = 0;
+	virtual void stop() = 0;
+};
+
+/*!
+	@brief	TCP socket - copies share the connection like the real class does.
+*/
+class WiFiClient : public Client
+{
+public:
+	WiFiClient();
+	explicit WiFiClient(std::shared_ptr<fake::Socket> sock);
+
+	int connect(const char* host, uint16_t port) override;
+	int connect(const char* host, uint16_t port, int32_t timeout_ms);
+	uint8_t connected() override;
+	void stop() override;
+
+	int available() override;
+	int read() override;
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t* buf, size_t len) override;
+	using Print::write;
+
+	void setNoDelay(bool nodelay) {}
+	operator bool();
+
+private:
+	std::shared_ptr<fake::Socket> m_sock;
+};
+
+class WiFiServer
+{
+public:
+	WiFiServer(uint16_t port);
+
+	void begin();
+	void setNoDelay(bool nodelay) {}
+	WiFiClient available();
+
+private:
+	uint16_t m_port;
+	bool m_listening;
+};
+
+
+#endif // FAKE_WIFI_H
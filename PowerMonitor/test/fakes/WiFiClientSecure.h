@@ -0,0 +1,25 @@
+/*
+	Host stand-in of the ESP32 TLS client - certificate and handshake settings are only recorded.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_WIFI_CLIENT_SECURE_H
+#define FAKE_WIFI_CLIENT_SECURE_H
+
+
+#include "WiFi.h"
+
+
+class WiFiClientSecure : public WiFiClient
+{
+public:
+	void setCACert(const char* cert) { m_cert = cert; }
+	void setHandshakeTimeout(unsigned long timeout_s) { m_handshake = timeout_s; }
+
+	const char* m_cert = nullptr;
+	unsigned long m_handshake = 0;
+};
+
+
+#endif // FAKE_WIFI_CLIENT_SECURE_H
@@ -0,0 +1,232 @@
+#include "fake.h"
+#include "WiFi.h"
+
+#include <stdarg.h>
+#include <random>
+
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static uint32_t s_millis = 0;
+static std::mt19937 s_rng;
+
+namespace fake
+{
+
+static Wifi s_wifi;
+static std::map<std::string, Broker> s_brokers;
+std::deque<std::pair<uint16_t, std::shared_ptr<Socket>>> g_dialed;
+
+/*!
+	@brief	Fresh world - clock at 1 s, AP in range, no brokers, no pending LAN clients, fixed random sequence.
+*/
+void reset()
+{
+	s_millis = 1000;
+	s_rng.seed(2023);
+	s_wifi = Wifi();
+	s_brokers.clear();
+	g_dialed.clear();
+}
+
+void setMillis(uint32_t ms)
+{
+	s_millis = ms;
+}
+
+void advance(uint32_t ms)
+{
+	s_millis += ms;
+}
+
+// ############################################################################
+/*!
+	@returns	True if associated (association time passed since WiFi.begin()).
+*/
+bool Wifi::up() const
+{
+	return joining && inRange && (int32_t)(s_millis - upAt) >= 0;
+}
+
+/*!
+	@brief	AP lost. WiFi.begin() has to be called again even if it comes back in range.
+*/
+void Wifi::drop()
+{
+	joining = false;
+}
+
+Wifi& wifi()
+{
+	return s_wifi;
+}
+
+// ############################################################################
+/*!
+	@brief	Closes the client's connection - its socket reports not connected from now on.
+*/
+void Broker::drop()
+{
+	session++;
+}
+
+/*!
+	@brief	Queues message for subscribers of the topic.
+*/
+void Broker::deliver(const char* topic, const char* payload)
+{
+	inbox.push_back({ topic, payload, s_millis });
+}
+
+/*!
+	@returns	Number of messages published to the topic.
+*/
+size_t Broker::count(const char* topic) const
+{
+	size_t _n = 0;
+	for(const Message& m : published)
+		_n += (m.topic == topic);
+	return _n;
+}
+
+/*!
+	@returns	The latest message of the topic, nullptr if there is none.
+*/
+const Message* Broker::last(const char* topic) const
+{
+	for(auto it = published.rbegin(); it != published.rend(); it++)
+		if(it->topic == topic)
+			return &*it;
+	return nullptr;
+}
+
+Broker& broker(const char* host)
+{
+	return s_brokers[host];
+}
+
+// ############################################################################
+std::shared_ptr<Socket> dial(uint16_t port, const char* request)
+{
+	std::shared_ptr<Socket> _sock = std::make_shared<Socket>();
+	_sock->rx = request;
+	g_dialed.push_back({ port, _sock });
+	return _sock;
+}
+
+}
+
+
+// ############################################################################
+unsigned long millis()
+{
+	return s_millis;
+}
+
+unsigned long micros()
+{
+	return (unsigned long)s_millis * 1000;
+}
+
+void delay(uint32_t ms)
+{
+	s_millis += ms;
+}
+
+void yield()
+{
+}
+
+long random(long max)
+{
+	return (max > 0) ? (long)(s_rng() % (unsigned long)max) : 0;
+}
+
+long random(long min, long max)
+{
+	return (max > min) ? min + random(max - min) : min;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+	return LOW;
+}
+
+void configTime(long gmtOffset, int dstOffset, const char* server1, const char* server2, const char* server3)
+{
+}
+
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size)
+{
+	size_t _len = strlen(src);
+	if(size)
+	{
+		size_t _n = (_len < size - 1) ? _len : size - 1;
+		memcpy(dst, src, _n);
+		dst[_n] = '\0';
+	}
+	return _len;
+}
+
+// ############################################################################
+size_t Print::write(const uint8_t* buf, size_t len)
+{
+	size_t _n = 0;
+	while(_n < len && write(buf[_n]))
+		_n++;
+	return _n;
+}
+
+size_t Print::print(const char* str)
+{
+	return write((const uint8_t*)str, strlen(str));
+}
+
+size_t Print::println(const char* str)
+{
+	return print(str) + print("\r\n");
+}
+
+size_t Print::printf(const char* fmt, ...)
+{
+	char _buf[256];
+	va_list _args;
+	va_start(_args, fmt);
+	vsnprintf(_buf, sizeof(_buf), fmt, _args);
+	va_end(_args);
+	return print(_buf);
+}
+
+String::String(const char* str)
+{
+	strlcpy(m_buf, str, sizeof(m_buf));
+}
+
+const char* String::c_str() const
+{
+	return m_buf;
+}
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+	m_addr[0] = a;
+	m_addr[1] = b;
+	m_addr[2] = c;
+	m_addr[3] = d;
+}
+
+String IPAddress::toString() const
+{
+	char _buf[16];
+	snprintf(_buf, sizeof(_buf), "%u.%u.%u.%u", m_addr[0], m_addr[1], m_addr[2], m_addr[3]);
+	return String(_buf);
+}
@@ -0,0 +1,121 @@
+/*
+	Control side of the host stand-ins - simulated clock, access point, MQTT brokers and LAN sockets.
+	Tests set up the world here, run the module and check what the stand-ins recorded.
+	fake::reset() at the start of every test gives a fresh world.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FAKE_H
+#define FAKE_H
+
+
+#include "Arduino.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+
+
+namespace fake
+{
+
+void reset();
+
+// Simulated time - millis() returns it, delay() and blocking calls advance it
+void setMillis(uint32_t ms);
+void advance(uint32_t ms);
+
+
+// ############################################################################
+/*!
+	@brief	Access point. Association takes assocMs after WiFi.begin() if it is in range.
+*/
+struct Wifi
+{
+	bool inRange = true;
+	uint32_t assocMs = 100;
+	uint8_t bssid[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+	int32_t channel = 6;
+
+	// Recorded
+	uint32_t begins = 0;
+	uint32_t fastBegins = 0;		// begin() with known channel and BSSID
+	uint32_t disconnects = 0;
+
+	bool joining = false;
+	uint32_t upAt = 0;
+
+	bool up() const;
+	void drop();					// AP lost - association and all sockets are gone
+};
+Wifi& wifi();
+
+// ############################################################################
+struct Message
+{
+	std::string topic;
+	std::string payload;
+	uint32_t time;
+};
+
+/*!
+	@brief	MQTT broker of one host. Unreachable one lets TCP connect time out.
+*/
+struct Broker
+{
+	bool reachable = true;
+	uint32_t connectMs = 50;		// TCP (+ TLS) + CONNACK
+	uint32_t timeoutMs = 5000;		// Spent on connect to unreachable host
+	int8_t refuse = 0;				// CONNACK code, 0 - accepted
+	int failPublishes = 0;			// Next publishes which fail
+	bool pingOk = true;
+	uint32_t pingMs = 0;			// Waiting for PINGRESP (library's ping timeout if unanswered)
+	uint32_t readMs = 0;			// Reading (TLS decrypt) of every delivered message
+
+	// Recorded
+	uint32_t session = 0;			// Bumped by every accepted connection and drop
+	uint32_t attempts = 0;			// TCP connects tried
+	uint32_t connects = 0;			// Accepted CONNECTs
+	uint32_t pings = 0;
+	uint16_t keepAlive = 0;			// Of the last CONNECT
+	std::vector<Message> published;
+	std::map<std::string, int> subscribes;	// SUBSCRIBE packets per topic
+	std::deque<Message> inbox;		// Sent to subscribers by processPackets()
+
+	void drop();					// Closes connection of the client
+	void deliver(const char* topic, const char* payload);
+	size_t count(const char* topic) const;
+	const Message* last(const char* topic) const;
+};
+Broker& broker(const char* host);
+
+// ############################################################################
+/*!
+	@brief	TCP connection. Device side is WiFiClient, test side reads tx and fills rx.
+*/
+struct Socket
+{
+	std::string host;				// Broker host, empty - accepted by WiFiServer
+	uint32_t session = 0;
+	std::string rx;					// Bytes waiting for the device
+	std::string tx;					// Bytes written by the device
+	uint32_t writes = 0;			// write() calls
+	size_t window = 0;				// Bytes taken by one write() (free send buffer), 0 - everything
+	bool open = true;				// Not stopped by the device
+	bool peerOpen = true;			// Not closed by the peer
+};
+
+// Connection of a LAN client to a WiFiServer port, accepted by its next available()
+std::shared_ptr<Socket> dial(uint16_t port, const char* request = "");
+
+// Pending connections, taken by WiFiServer
+extern std::deque<std::pair<uint16_t, std::shared_ptr<Socket>>> g_dialed;
+
+}
+
+
+#endif // FAKE_H
@@ -0,0 +1,199 @@
+#include "Adafruit_ST7789.h"
+
+
+// ############################################################################
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+{
+	_width = w;
+	_height = h;
+	cursor_x = cursor_y = 0;
+	textcolor = textbgcolor = 0xFFFF;
+	textsize = 1;
+	wrap = true;
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	for(int16_t j = y; j < y + h; j++)
+		for(int16_t i = x; i < x + w; i++)
+			drawPixel(i, j, color);
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color)
+{
+	fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawRGBBitmap(int16_t x, int16_t y, uint16_t* bitmap, int16_t w, int16_t h)
+{
+	for(int16_t j = 0; j < h; j++)
+		for(int16_t i = 0; i < w; i++)
+			drawPixel(x + i, y + j, bitmap[j * w + i]);
+}
+
+/*!
+	@brief	Horizontal and vertical lines only - the only ones the sketch draws.
+*/
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+	if(y0 == y1)
+		fillRect((x0 < x1) ? x0 : x1, y0, abs(x1 - x0) + 1, 1, color);
+	else
+		fillRect(x0, (y0 < y1) ? y0 : y1, 1, abs(y1 - y0) + 1, color);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	fillRect(x, y, w, 1, color);
+}
+
+void Adafruit_GFX::setCursor(int16_t x, int16_t y)
+{
+	cursor_x = x;
+	cursor_y = y;
+}
+
+void Adafruit_GFX::setTextColor(uint16_t c)
+{
+	// Transparent background, like the real library
+	textcolor = textbgcolor = c;
+}
+
+void Adafruit_GFX::setTextColor(uint16_t c, uint16_t bg)
+{
+	textcolor = c;
+	textbgcolor = bg;
+}
+
+void Adafruit_GFX::setTextSize(uint8_t s)
+{
+	textsize = s ? s : 1;
+}
+
+void Adafruit_GFX::setTextWrap(bool w)
+{
+	wrap = w;
+}
+
+/*!
+	@brief	Character as a solid 5x7 cell (scaled), space as nothing.
+*/
+size_t Adafruit_GFX::write(uint8_t c)
+{
+	if(c == '\n')
+	{
+		cursor_x = 0;
+		cursor_y += textsize * 8;
+		return 1;
+	}
+	if(c == '\r')
+		return 1;
+
+	if(wrap && cursor_x + textsize * 6 > _width)
+	{
+		cursor_x = 0;
+		cursor_y += textsize * 8;
+	}
+	if(c != ' ')
+		fillRect(cursor_x, cursor_y, textsize * 5, textsize * 7, textcolor);
+	cursor_x += textsize * 6;
+	return 1;
+}
+
+int16_t Adafruit_GFX::width() const
+{
+	return _width;
+}
+
+int16_t Adafruit_GFX::height() const
+{
+	return _height;
+}
+
+// ############################################################################
+GFXcanvas16::GFXcanvas16(uint16_t w, uint16_t h) : Adafruit_GFX(w, h)
+{
+	buffer = new uint16_t[w * h]();
+}
+
+GFXcanvas16::~GFXcanvas16()
+{
+	delete[] buffer;
+}
+
+void GFXcanvas16::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+	if(x >= 0 && y >= 0 && x < _width && y < _height)
+		buffer[y * _width + x] = color;
+}
+
+uint16_t* GFXcanvas16::getBuffer() const
+{
+	return buffer;
+}
+
+// ############################################################################
+Adafruit_ST7789::Adafruit_ST7789(int8_t cs, int8_t dc, int8_t rst) : Adafruit_GFX(0, 0)
+{
+}
+
+Adafruit_ST7789::Adafruit_ST7789(SPIClass* spi, int8_t cs, int8_t dc, int8_t rst) : Adafruit_GFX(0, 0)
+{
+}
+
+void Adafruit_ST7789::init(uint16_t width, uint16_t height, uint8_t spiMode)
+{
+	_width = width;
+	_height = height;
+	m_ram.assign(width * height, 0);
+}
+
+/*!
+	@brief	Single pixel costs its own address window.
+*/
+void Adafruit_ST7789::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+	if(x < 0 || y < 0 || x >= _width || y >= _height)
+		return;
+	m_ram[y * _width + x] = color;
+	pixelsSent++;
+	windows++;
+}
+
+void Adafruit_ST7789::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	windows++;
+	for(int16_t j = y; j < y + h; j++)
+	{
+		for(int16_t i = x; i < x + w; i++)
+		{
+			if(i < 0 || j < 0 || i >= _width || j >= _height)
+				continue;
+			m_ram[j * _width + i] = color;
+			pixelsSent++;
+		}
+	}
+}
+
+void Adafruit_ST7789::drawRGBBitmap(int16_t x, int16_t y, uint16_t* bitmap, int16_t w, int16_t h)
+{
+	windows++;
+	for(int16_t j = 0; j < h; j++)
+	{
+		for(int16_t i = 0; i < w; i++)
+		{
+			if(x + i < 0 || y + j < 0 || x + i >= _width || y + j >= _height)
+				continue;
+			m_ram[(y + j) * _width + x + i] = bitmap[j * w + i];
+			pixelsSent++;
+		}
+	}
+}
+
+/*!
+	@returns	Colour of a pixel on the LCD.
+*/
+uint16_t Adafruit_ST7789::pixel(int16_t x, int16_t y) const
+{
+	return m_ram[y * _width + x];
+}
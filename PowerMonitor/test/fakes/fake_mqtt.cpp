@@ -0,0 +1,234 @@
+#include "fake.h"
+#include "Adafruit_MQTT_Client.h"
+
+
+// ############################################################################
+Adafruit_MQTT::Adafruit_MQTT(const char* server, uint16_t port, const char* user, const char* pass)
+{
+	servername = server;
+	portnum = port;
+	keepAliveInterval = 300;
+	for(uint8_t i = 0; i < MAXSUBSCRIPTIONS; i++)
+		subscriptions[i] = nullptr;
+}
+
+/*!
+	@brief		Opens socket, sends CONNECT and SUBSCRIBE of every registered topic (like the real library).
+	@returns	0 on success, -1 no connection, CONNACK code if refused.
+*/
+int8_t Adafruit_MQTT::connect()
+{
+	if(!connectServer())
+		return -1;
+
+	fake::Broker& _b = fake::broker(servername);
+	if(_b.refuse)
+	{
+		disconnectServer();
+		return _b.refuse;
+	}
+
+	_b.connects++;
+	_b.keepAlive = keepAliveInterval;
+	for(uint8_t i = 0; i < MAXSUBSCRIPTIONS; i++)
+		if(subscriptions[i])
+			_b.subscribes[subscriptions[i]->topic]++;
+	return 0;
+}
+
+int8_t Adafruit_MQTT::connect(const char* user, const char* pass)
+{
+	return connect();
+}
+
+bool Adafruit_MQTT::disconnect()
+{
+	return disconnectServer();
+}
+
+const char* Adafruit_MQTT::connectErrorString(int8_t code)
+{
+	switch(code)
+	{
+	case 1:
+		return "The Server does not support the level of the MQTT protocol requested";
+	case 4:
+		return "The data in the user name or password is malformed";
+	case 5:
+		return "Not authorized to connect";
+	case -1:
+		return "Connection failed";
+	default:
+		return "Unknown error";
+	}
+}
+
+bool Adafruit_MQTT::publish(const char* topic, const char* payload, uint8_t qos, bool retain)
+{
+	return publish(topic, (uint8_t*)payload, strlen(payload), qos, retain);
+}
+
+/*!
+	@brief	Message is recorded by the broker unless it was told to fail it.
+*/
+bool Adafruit_MQTT::publish(const char* topic, uint8_t* payload, uint16_t len, uint8_t qos, bool retain)
+{
+	if(!connected())
+		return false;
+
+	fake::Broker& _b = fake::broker(servername);
+	if(_b.failPublishes > 0)
+	{
+		_b.failPublishes--;
+		return false;
+	}
+	_b.published.push_back({ topic, std::string((const char*)payload, len), (uint32_t)millis() });
+	return true;
+}
+
+bool Adafruit_MQTT::subscribe(Adafruit_MQTT_Subscribe* sub)
+{
+	for(uint8_t i = 0; i < MAXSUBSCRIPTIONS; i++)
+	{
+		if(subscriptions[i] == sub)
+			return true;
+		if(!subscriptions[i])
+		{
+			subscriptions[i] = sub;
+			if(connected())
+				fake::broker(servername).subscribes[sub->topic]++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+	@brief	Hands messages delivered by the broker to callbacks of matching subscriptions.
+			Doesn't wait - tests advance the clock themselves, only reading of every message takes readMs.
+*/
+void Adafruit_MQTT::processPackets(int16_t timeout)
+{
+	fake::Broker& _b = fake::broker(servername);
+
+	while(connected() && !_b.inbox.empty())
+	{
+		fake::Message _msg = _b.inbox.front();
+		_b.inbox.pop_front();
+		fake::advance(_b.readMs);
+
+		for(uint8_t i = 0; i < MAXSUBSCRIPTIONS; i++)
+		{
+			Adafruit_MQTT_Subscribe* _sub = subscriptions[i];
+			if(!_sub || _msg.topic != _sub->topic)
+				continue;
+
+			_sub->datalen = (_msg.payload.size() < SUBSCRIPTIONDATALEN) ? _msg.payload.size() : SUBSCRIPTIONDATALEN - 1;
+			memcpy(_sub->lastread, _msg.payload.data(), _sub->datalen);
+			_sub->lastread[_sub->datalen] = 0;
+
+			if(_sub->callback_buffer)
+				_sub->callback_buffer((char*)_sub->lastread, _sub->datalen);
+			else if(_sub->callback_double)
+				_sub->callback_double(atof((char*)_sub->lastread));
+			else if(_sub->callback_uint32)
+				_sub->callback_uint32(strtoul((char*)_sub->lastread, nullptr, 10));
+		}
+	}
+}
+
+bool Adafruit_MQTT::ping(uint8_t num)
+{
+	if(!connected())
+		return false;
+
+	fake::Broker& _b = fake::broker(servername);
+	_b.pings++;
+	fake::advance(_b.pingMs);
+	return _b.pingOk;
+}
+
+Adafruit_MQTT& Adafruit_MQTT::setKeepAliveInterval(uint16_t keepAlive)
+{
+	keepAliveInterval = keepAlive;
+	return *this;
+}
+
+// ############################################################################
+bool Adafruit_MQTT_Client::connected()
+{
+	return client->connected();
+}
+
+bool Adafruit_MQTT_Client::connectServer()
+{
+	return client->connect(servername, portnum);
+}
+
+bool Adafruit_MQTT_Client::disconnectServer()
+{
+	if(connected())
+		client->stop();
+	return true;
+}
+
+// ############################################################################
+Adafruit_MQTT_Publish::Adafruit_MQTT_Publish(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos)
+{
+	this->mqtt = mqtt;
+	this->topic = feed;
+	this->qos = qos;
+}
+
+bool Adafruit_MQTT_Publish::publish(const char* s)
+{
+	return mqtt->publish(topic, s, qos);
+}
+
+bool Adafruit_MQTT_Publish::publish(double f, uint8_t precision)
+{
+	char _payload[41];
+	snprintf(_payload, sizeof(_payload), "%.*f", precision, f);
+	return mqtt->publish(topic, _payload, qos);
+}
+
+bool Adafruit_MQTT_Publish::publish(int32_t i)
+{
+	char _payload[12];
+	snprintf(_payload, sizeof(_payload), "%ld", (long)i);
+	return mqtt->publish(topic, _payload, qos);
+}
+
+bool Adafruit_MQTT_Publish::publish(uint32_t i)
+{
+	char _payload[11];
+	snprintf(_payload, sizeof(_payload), "%lu", (unsigned long)i);
+	return mqtt->publish(topic, _payload, qos);
+}
+
+// ############################################################################
+Adafruit_MQTT_Subscribe::Adafruit_MQTT_Subscribe(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos)
+{
+	topic = feed;
+	this->qos = qos;
+	datalen = 0;
+	lastread[0] = 0;
+	callback_uint32 = nullptr;
+	callback_double = nullptr;
+	callback_buffer = nullptr;
+}
+
+void Adafruit_MQTT_Subscribe::setCallback(SubscribeCallbackUInt32Type callb)
+{
+	callback_uint32 = callb;
+}
+
+void Adafruit_MQTT_Subscribe::setCallback(SubscribeCallbackDoubleType callb)
+{
+	callback_double = callb;
+}
+
+void Adafruit_MQTT_Subscribe::setCallback(SubscribeCallbackBufferType callb)
+{
+	callback_buffer = callb;
+}
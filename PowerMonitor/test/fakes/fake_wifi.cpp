@@ -0,0 +1,201 @@
+#include "fake.h"
+#include "WiFi.h"
+
+
+WiFiClass WiFi;
+
+
+// ############################################################################
+/*!
+	@brief	Starts association, it completes assocMs later if the AP is in range.
+			Known channel and BSSID (fast reconnect) are counted separately.
+*/
+wl_status_t WiFiClass::begin(const char* ssid, const char* pass, int32_t channel, const uint8_t* bssid, bool connect)
+{
+	fake::Wifi& _w = fake::wifi();
+
+	_w.begins++;
+	if(channel == _w.channel && bssid && memcmp(bssid, _w.bssid, sizeof(_w.bssid)) == 0)
+		_w.fastBegins++;
+	_w.joining = true;
+	_w.upAt = millis() + _w.assocMs;
+	return status();
+}
+
+wl_status_t WiFiClass::status()
+{
+	return fake::wifi().up() ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap)
+{
+	fake::wifi().disconnects++;
+	fake::wifi().drop();
+	return true;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode)
+{
+	if(mode == WIFI_OFF)
+		fake::wifi().drop();
+	return true;
+}
+
+bool WiFiClass::setSleep(bool enable)
+{
+	return true;
+}
+
+IPAddress WiFiClass::localIP()
+{
+	return fake::wifi().up() ? IPAddress(192, 168, 1, 50) : IPAddress();
+}
+
+int8_t WiFiClass::RSSI()
+{
+	return fake::wifi().up() ? -60 : 0;
+}
+
+uint8_t* WiFiClass::BSSID()
+{
+	return fake::wifi().bssid;
+}
+
+int32_t WiFiClass::channel()
+{
+	return fake::wifi().channel;
+}
+
+
+// ############################################################################
+WiFiClient::WiFiClient()
+{
+}
+
+WiFiClient::WiFiClient(std::shared_ptr<fake::Socket> sock) : m_sock(sock)
+{
+}
+
+/*!
+	@brief	No timeout of its own - the host decides how long it takes (connectMs or timeoutMs).
+*/
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+	return connect(host, port, INT32_MAX);
+}
+
+/*!
+	@brief	Opens connection to a broker host. Blocks (advances the clock) for connectMs,
+			or up to timeout_ms when the host doesn't answer in time.
+*/
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeout_ms)
+{
+	fake::Broker& _b = fake::broker(host);
+
+	stop();
+	if(!fake::wifi().up())
+		return 0;
+
+	_b.attempts++;
+	if(!_b.reachable || (int32_t)_b.connectMs > timeout_ms)
+	{
+		delay((timeout_ms < (int32_t)_b.timeoutMs) ? timeout_ms : _b.timeoutMs);
+		return 0;
+	}
+
+	delay(_b.connectMs);
+	m_sock = std::make_shared<fake::Socket>();
+	m_sock->host = host;
+	m_sock->session = _b.session;
+	return 1;
+}
+
+/*!
+	@brief	Connection is alive until either side closes it, the broker drops it or WiFi goes down.
+*/
+uint8_t WiFiClient::connected()
+{
+	if(!m_sock || !m_sock->open || !fake::wifi().up())
+		return 0;
+	if(!m_sock->host.empty() && fake::broker(m_sock->host.c_str()).session != m_sock->session)
+		m_sock->peerOpen = false;
+	// Received data can still be read after the peer closed
+	return m_sock->peerOpen || !m_sock->rx.empty();
+}
+
+void WiFiClient::stop()
+{
+	if(m_sock)
+		m_sock->open = false;
+	m_sock.reset();
+}
+
+int WiFiClient::available()
+{
+	return (m_sock && m_sock->open) ? m_sock->rx.size() : 0;
+}
+
+int WiFiClient::read()
+{
+	if(!available())
+		return -1;
+
+	uint8_t _c = m_sock->rx[0];
+	m_sock->rx.erase(0, 1);
+	return _c;
+}
+
+size_t WiFiClient::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t len)
+{
+	if(!connected())
+		return 0;
+
+	if(m_sock->window && len > m_sock->window)
+		len = m_sock->window;
+	m_sock->writes++;
+	m_sock->tx.append((const char*)buf, len);
+	return len;
+}
+
+WiFiClient::operator bool()
+{
+	return connected();
+}
+
+
+// ############################################################################
+WiFiServer::WiFiServer(uint16_t port)
+{
+	m_port = port;
+	m_listening = false;
+}
+
+void WiFiServer::begin()
+{
+	m_listening = true;
+}
+
+/*!
+	@returns	The oldest LAN client dialed to this port, empty client if there is none.
+*/
+WiFiClient WiFiServer::available()
+{
+	if(!m_listening || !fake::wifi().up())
+		return WiFiClient();
+
+	for(auto it = fake::g_dialed.begin(); it != fake::g_dialed.end(); it++)
+	{
+		if(it->first == m_port)
+		{
+			WiFiClient _client(it->second);
+			fake::g_dialed.erase(it);
+			return _client;
+		}
+	}
+	return WiFiClient();
+}
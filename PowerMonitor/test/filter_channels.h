@@ -0,0 +1,23 @@
+/*
+	Channel table of test_filter - the rails of the sketch and two rails of an external ADC board,
+	whose slots 0 and 1 are the same numbers as scan slots of an unfiltered and a filtered ADC channel.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef FILTER_CHANNELS_H
+#define FILTER_CHANNELS_H
+
+
+#define CHANNEL_TABLE \
+	CHANNEL("AC",	"sens-ac",	CH_SRC_ADC,	SENS_AC,	CH_RMS,		AC_VOLTS_PER_MV,	1,	FILT_NONE,	TRIG_AC) \
+	CHANNEL("12V",	"sens-12",	CH_SRC_ADC,	SENS_12,	CH_MEAN,	DC_VOLTS_PER_MV,	2,	FILT_DC,	TRIG_12) \
+	CHANNEL("5V",	"sens-5",	CH_SRC_ADC,	SENS_5,		CH_MEAN,	DC_VOLTS_PER_MV,	2,	FILT_DC,	TRIG_5) \
+	CHANNEL("3.3V",	"sens-33",	CH_SRC_ADC,	SENS_33,	CH_MEAN,	DC_VOLTS_PER_MV,	2,	FILT_DC,	TRIG_33) \
+	CHANNEL("24V",	"sens-24",	CH_SRC_EXT,	0,			CH_MEAN,	EXT_VOLTS_PER_COUNT * 11,	2,	FILT_NONE,	TRIG_NONE) \
+	CHANNEL("48V",	"sens-48",	CH_SRC_EXT,	1,			CH_MEAN,	EXT_VOLTS_PER_COUNT * 22,	2,	FILT_DC,	TRIG_NONE)
+
+#define CH_COUNT			6
+
+
+#endif // FILTER_CHANNELS_H
@@ -0,0 +1,51 @@
+/*
+	Minimal runner of host tests - every test is a function of CHECK()s, main() runs them with RUN_TEST()
+	and returns TEST_RESULT() (non-zero if anything failed), so make stops on the first failing binary.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#ifndef TEST_H
+#define TEST_H
+
+
+#include <stdio.h>
+#include <math.h>
+
+
+static int s_checks = 0;
+static int s_failed = 0;
+
+#define CHECK(cond) \
+	do { \
+		s_checks++; \
+		if(!(cond)) \
+		{ \
+			s_failed++; \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while(0)
+
+// Values compared as doubles, both are printed on failure
+#define CHECK_NEAR(val, expected, tol) \
+	do { \
+		double _v = (val), _e = (expected); \
+		s_checks++; \
+		if(fabs(_v - _e) > (tol)) \
+		{ \
+			s_failed++; \
+			printf("%s:%d: %s = %g, expected %g +- %g\n", __FILE__, __LINE__, #val, _v, _e, (double)(tol)); \
+		} \
+	} while(0)
+
+#define RUN_TEST(fn) \
+	do { \
+		int _before = s_failed; \
+		fn(); \
+		printf("  %-40s %s\n", #fn, (s_failed == _before) ? "ok" : "FAILED"); \
+	} while(0)
+
+#define TEST_RESULT()	(printf("  %d checks, %d failed\n", s_checks, s_failed), s_failed ? 1 : 0)
+
+
+#endif // TEST_H
@@ -0,0 +1,256 @@
+/*
+	Acquisition pipeline fed by synthetic source - blocks handed to sinks are contiguous and in order,
+	ring history is readable back, DC levels and mains RMS come out of the sinks as generated, nothing
+	is joined across the gap of a suspend (slope trigger, capture windows, RMS windows).
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "acquire.h"
+#include "rms.h"
+#include "stats.h"
+#include "trigger.h"
+
+#include <string.h>
+
+
+/*!
+	@brief	Sink checking sequence of blocks, keeps the last scan.
+*/
+class SeqSink : public AcqSink
+{
+public:
+	uint32_t next = 0;
+	uint32_t blocks = 0;
+	uint32_t gaps = 0;
+	uint32_t oversized = 0;
+	acq_scan_t last;
+
+	void onBlock(const acq_scan_t* scans, size_t count, uint32_t seq) override
+	{
+		if(seq != next)
+			gaps++;
+		if(count == 0 || count > ACQ_BLOCK_SIZE)
+			oversized++;
+		next = seq + count;
+		blocks++;
+		last = scans[count - 1];
+	}
+};
+
+
+// ############################################################################
+static void test_blocks_in_order()
+{
+	SynthSource _src;
+	Acquisition _acq(&_src);
+	SeqSink _sink;
+
+	_src.setChannel(0, 1000, 500, 50, 20);
+	CHECK(_acq.attach(&_sink));
+	CHECK(_acq.begin());
+
+	// Several times around the ring - blocks are cut at its end, never wrap
+	for(int i = 0; i < 100; i++)
+		CHECK(_acq.poll(0) > 0);
+
+	CHECK(_sink.gaps == 0);
+	CHECK(_sink.oversized == 0);
+	CHECK(_sink.next == _acq.head());
+	CHECK(_acq.head() > 3 * ACQ_RING_SIZE);
+	CHECK(_sink.blocks > _acq.head() / ACQ_BLOCK_SIZE);		// cut blocks
+}
+
+static void test_history()
+{
+	SynthSource _src;
+	Acquisition _acq(&_src);
+	SeqSink _sink;
+	static acq_scan_t _buf[ACQ_RING_SIZE];
+	acq_scan_t _latest;
+
+	_src.setChannel(1, 2000, 0, 0, 200);
+	_acq.attach(&_sink);
+	_acq.begin();
+	CHECK(!_acq.latest(&_latest));
+
+	for(int i = 0; i < 50; i++)
+		_acq.poll(0);
+	uint32_t _head = _acq.head();
+
+	CHECK(_acq.latest(&_latest));
+	CHECK(memcmp(&_latest, &_sink.last, sizeof(acq_scan_t)) == 0);
+
+	// Everything but the block being written is kept
+	CHECK(_acq.copy(_head - ACQ_HISTORY, _buf, ACQ_HISTORY) == ACQ_HISTORY);
+	CHECK(_acq.copy(_head - ACQ_HISTORY - 1, _buf, 10) == 0);
+	// Scans not acquired yet are cut off
+	CHECK(_acq.copy(_head - 5, _buf, 10) == 5);
+	CHECK(memcmp(&_buf[4], &_sink.last, sizeof(acq_scan_t)) == 0);
+}
+
+static void test_dc_levels()
+{
+	SynthSource _src;
+	Acquisition _acq(&_src);
+	RailStats _stats;
+	stats_t _st[ACQ_CHANNELS];
+	static const float _dc[] = { 300, 1650, 2500, 4000 };
+
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+		_src.setChannel(c, _dc[c % 4], 0, 0, 40);
+	_acq.attach(&_stats);
+	_acq.begin();
+
+	for(int i = 0; i < 100; i++)
+		_acq.poll(0);
+	_stats.snapshot(_st);
+
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+	{
+		CHECK(_st[c].count == _acq.head());
+		CHECK_NEAR(_st[c].mean, _dc[c % 4], 1.0);
+		CHECK(_st[c].min >= _dc[c % 4] - 40 && _st[c].max <= _dc[c % 4] + 40);
+		CHECK_NEAR(_st[c].stddev, 81 / sqrt(12.0), 2.0);		// uniform noise
+	}
+
+	// Snapshot starts the next interval
+	_stats.snapshot(_st);
+	CHECK(_st[0].count == 0);
+}
+
+static void test_mains_rms()
+{
+	SynthSource _src;
+	Acquisition _acq(&_src);
+	TrueRMS _rms(0, 1.0f);
+	rms_result_t _res;
+
+	_src.setChannel(0, 1650, 1200, 50, 16);
+	_acq.attach(&_rms);
+	_acq.begin();
+	CHECK(!_rms.result(&_res));
+
+	for(int i = 0; i < 50; i++)
+		_acq.poll(0);
+
+	CHECK(_rms.windows() > 10);
+	CHECK(_rms.result(&_res));
+	CHECK_NEAR(_res.rms, 1200 / sqrt(2.0), 5.0);
+	CHECK_NEAR(_res.freq, 50.0, 0.1);
+	CHECK_NEAR(_res.crest, sqrt(2.0), 0.05);
+}
+
+static void test_suspend()
+{
+	SynthSource _src;
+	Acquisition _acq(&_src);
+	SeqSink _sink;
+
+	_acq.attach(&_sink);
+	_acq.begin();
+	_acq.poll(0);
+	uint32_t _head = _acq.head();
+
+	// Takes effect with the next poll, nothing is acquired until resumed
+	_acq.suspend(true);
+	CHECK(!_acq.suspended());
+	CHECK(_acq.poll(0) == 0);
+	CHECK(_acq.suspended());
+	CHECK(_acq.poll(0) == 0);
+	CHECK(_acq.head() == _head);
+
+	_acq.suspend(false);
+	CHECK(_acq.poll(0) > 0);
+	CHECK(!_acq.suspended());
+	CHECK(_sink.gaps == 0);
+}
+
+
+static void test_resume()
+{
+	SynthSource _src;
+	Acquisition _acq(&_src);
+	FaultTrigger _trig(&_acq);
+	TrueRMS _rms(1, 1.0f);
+	rms_result_t _res;
+
+	_src.setChannel(0, 1000, 0, 0);
+	_src.setChannel(1, 1650, 1200, 50);
+	_trig.configure(0, 0, 0, 200);
+	_acq.attach(&_trig);
+	_acq.attach(&_rms);
+	_acq.begin();
+	for(int i = 0; i < 10; i++)
+		_acq.poll(0);
+	CHECK(_trig.events() == 0);
+
+	// Rail changed while asleep - not a step between two samples
+	_acq.suspend(true);
+	_acq.poll(0);
+	_src.setChannel(0, 2000, 0, 0);
+	uint32_t _windows = _rms.windows();
+	_acq.suspend(false);
+	uint32_t _resumed = _acq.head();
+	CHECK(_acq.poll(0) == ACQ_BLOCK_SIZE);
+	CHECK(_trig.events() == 0);
+
+	// Window open before the gap is dropped, the next ones start after it
+	CHECK(_rms.windows() <= _windows + 1);
+	_acq.poll(0);
+	CHECK(_rms.result(&_res));
+	CHECK(_res.seq >= _resumed);
+
+	// Step right after resume - pre-trigger part doesn't reach behind the gap
+	_src.setChannel(0, 3000, 0, 0);
+	for(int i = 0; i < 4; i++)
+		_acq.poll(0);
+	CHECK(_trig.events() == 1);
+	const capture_t* _cap = _trig.peek();
+	CHECK(_cap != nullptr);
+	if(_cap)
+	{
+		uint16_t _before = _cap->seq - _resumed;
+		CHECK(_cap->cause == TRIG_SLOPE);
+		CHECK(_cap->count == TRIG_WINDOW);
+		CHECK(_before < TRIG_PRE);
+		CHECK(_cap->scans[TRIG_PRE - _before - 1].ch[0] == 0);		// missing, not a sample from before the sleep
+		CHECK(_cap->scans[TRIG_PRE - _before].ch[0] == 2000);
+		CHECK(_cap->scans[TRIG_PRE].ch[0] == 3000);
+	}
+	_trig.release();
+
+	// Suspended before post-trigger samples came - capture ends at the gap
+	_src.setChannel(0, 1000, 0, 0);
+	_acq.poll(0);
+	CHECK(_trig.events() == 2);
+	CHECK(_trig.peek() == nullptr);
+	_acq.suspend(true);
+	_acq.poll(0);
+	_acq.suspend(false);
+	_acq.poll(0);
+	_cap = _trig.peek();
+	CHECK(_cap != nullptr);
+	if(_cap)
+	{
+		CHECK(_cap->scans[TRIG_PRE].ch[0] == 1000);
+		CHECK(_cap->count < TRIG_WINDOW);
+		CHECK(_cap->count == TRIG_PRE + (_cap->seq % ACQ_BLOCK_SIZE ? ACQ_BLOCK_SIZE - _cap->seq % ACQ_BLOCK_SIZE : ACQ_BLOCK_SIZE));
+	}
+	CHECK(_trig.dropped() == 0);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_blocks_in_order);
+	RUN_TEST(test_history);
+	RUN_TEST(test_dc_levels);
+	RUN_TEST(test_mains_rms);
+	RUN_TEST(test_suspend);
+	RUN_TEST(test_resume);
+	return TEST_RESULT();
+}
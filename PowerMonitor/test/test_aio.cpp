@@ -0,0 +1,601 @@
+/*
+	Connection handling of ESP_AIO_Client against stand-ins of WiFi and the MQTT broker (fakes/) -
+	retry delays grow exponentially with jitter and are capped, drops of WiFi, MQTT and unanswered
+	pings end in a reconnect, keepalive follows publish cadence so only an idle connection is pinged,
+	subscriptions are sent again on every connect, failed group messages keep their rows, rows of wide
+	groups are split to fit the payload, packed batches decode to the rows committed, event texts go out
+	one by one in order, rows which found the queue full get a slot later and relay latency counts from receipt.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+#include "fake.h"
+
+#include "esp_aio.h"
+#include "relay.h"
+#include "tspack.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+static const char* s_relay;
+static int s_relayCalls;
+
+static void onRelay(char* data, uint16_t len)
+{
+	s_relay = data;
+	s_relayCalls++;
+}
+
+static ESP_AIO_Client* s_aio;
+static Relays* s_relays;
+
+static void onRelayCmd(char* data, uint16_t len)
+{
+	s_relays->handle(0, data, len, s_aio->rxTime());
+}
+
+/*!
+	@brief	Polls the client every step ms for the given time.
+*/
+static void run(ESP_AIO_Client* aio, uint32_t ms, uint32_t step = 10)
+{
+	for(uint32_t t = 0; t < ms; t += step)
+	{
+		fake::advance(step);
+		aio->poll(0);
+	}
+}
+
+/*!
+	@brief	Polls until the client is connected.
+	@returns	False if it didn't connect within the time limit.
+*/
+static bool runUntilConnected(ESP_AIO_Client* aio, uint32_t limit_ms)
+{
+	for(uint32_t t = 0; t < limit_ms; t += 10)
+	{
+		fake::advance(10);
+		aio->poll(0);
+		if(aio->getState() == AIO_STATE_CONNECTED)
+			return true;
+	}
+	return false;
+}
+
+
+/*!
+	@brief		One pass of the sketch's DrainBacklog() over records numbered from *next up to total.
+	@returns	True if new rows were loaded.
+*/
+static bool drain(ESP_AIO_Client* aio, AIO_Group* grp, uint32_t* next, uint32_t total)
+{
+	if(!aio->hostConnected())
+		return false;
+	if(grp->rows() > 0)
+	{
+		if(!aio->queued(grp))
+			aio->enqueue(grp);
+		return false;
+	}
+
+	bool _full = false;
+	while(!_full && *next < total)
+	{
+		grp->set(0, (float)*next, 0);
+		_full = grp->commit(1700000000 + *next);
+		(*next)++;
+	}
+	if(grp->rows() == 0)
+		return false;
+	aio->enqueue(grp);
+	return true;
+}
+
+
+// ############################################################################
+static void test_connect()
+{
+	fake::reset();
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+
+	_aio.poll(0);
+	CHECK(_aio.getState() == AIO_STATE_IDLE);
+
+	_aio.connect();
+	CHECK(_aio.getState() == AIO_STATE_NET_WAIT);
+	CHECK(fake::wifi().begins == 1);
+
+	CHECK(runUntilConnected(&_aio, 1000));
+	CHECK(_aio.hostConnected());
+	CHECK(fake::broker(AIO_SERVER).connects == 1);
+	CHECK(fake::broker(AIO_SERVER).keepAlive == AIO_KEEPALIVE_MIN);
+	CHECK(_aio.reconnects() == 0);
+
+	_aio.disconnect();
+	CHECK(_aio.getState() == AIO_STATE_IDLE);
+	CHECK(!fake::wifi().up());
+}
+
+static void test_backoff_jitter()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	std::vector<uint32_t> _at;
+
+	_b.reachable = false;
+	_b.timeoutMs = 0;
+	_aio.connect();
+
+	// Every attempt is recorded with its time, gaps between them are the retry delays
+	uint32_t _seen = 0;
+	for(uint32_t t = 0; t < 8 * 60000UL && _at.size() < 12; t++)
+	{
+		fake::advance(1);
+		_aio.poll(0);
+		if(_b.attempts != _seen)
+		{
+			_seen = _b.attempts;
+			_at.push_back(millis());
+		}
+	}
+	CHECK(_at.size() == 12);
+
+	uint32_t _backoff = AIO_BACKOFF_MIN;
+	bool _jitter = false;
+	for(size_t i = 1; i < _at.size(); i++)
+	{
+		uint32_t _gap = _at[i] - _at[i - 1];
+		CHECK(_gap >= _backoff / 2);
+		CHECK(_gap <= _backoff + 2);			// + poll steps of the state machine
+		if(_gap < _backoff - _backoff / 8)
+			_jitter = true;
+		_backoff = (_backoff * 2 > AIO_BACKOFF_MAX) ? AIO_BACKOFF_MAX : _backoff * 2;
+	}
+	CHECK(_backoff == AIO_BACKOFF_MAX);		// cap was reached...
+	CHECK(_at.back() - _at[_at.size() - 2] <= AIO_BACKOFF_MAX + 2);	// ...and held
+	CHECK(_jitter);
+	CHECK(_aio.getStatus() == AIO_CONNECT_FAILED);
+
+	// Success resets backoff - the next drop is retried after the shortest delay again
+	_b.reachable = true;
+	CHECK(runUntilConnected(&_aio, AIO_BACKOFF_MAX + 1000));
+	_b.drop();
+	uint32_t _dropped = millis();
+	CHECK(runUntilConnected(&_aio, 10000));
+	CHECK(millis() - _dropped <= AIO_BACKOFF_MIN + _b.connectMs + 20);
+}
+
+static void test_reconnect()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+
+	// Broker closes the connection
+	_b.drop();
+	run(&_aio, 10);
+	CHECK(_aio.getState() == AIO_STATE_BACKOFF);
+	CHECK(_aio.getStatus() == AIO_DISCONNECTED);
+	CHECK(_aio.reconnects() == 1);
+	CHECK(runUntilConnected(&_aio, 2000));
+	CHECK(_b.connects == 2);
+	CHECK(fake::wifi().begins == 1);			// WiFi wasn't touched
+
+	// WiFi lost - association again, to the cached access point without scanning
+	uint32_t _fast = fake::wifi().fastBegins;
+	fake::wifi().drop();
+	run(&_aio, 10);
+	CHECK(_aio.reconnects() == 2);
+	CHECK(_aio.getStatus() == AIO_NET_DISCONNECTED);
+	CHECK(runUntilConnected(&_aio, 2000));
+	CHECK(fake::wifi().begins == 2);
+	CHECK(fake::wifi().fastBegins == _fast + 1);
+	CHECK(_b.connects == 3);
+
+	// AP out of range for a while - association times out and is retried until it is back
+	fake::wifi().inRange = false;
+	fake::wifi().drop();
+	run(&_aio, 60000, 100);
+	CHECK(_aio.getState() != AIO_STATE_CONNECTED);
+	CHECK(_aio.reconnects() == 3);
+	CHECK(fake::wifi().begins >= 4);
+	fake::wifi().inRange = true;
+	CHECK(runUntilConnected(&_aio, AIO_BACKOFF_MAX + AIO_NET_TIMEOUT));
+	CHECK(_b.connects == 4);
+
+	// Broker stops answering pings of an idle connection
+	_b.pingOk = false;
+	uint32_t _pings = _b.pings;
+	run(&_aio, _aio.keepAlive() * 1000UL, 100);
+	CHECK(_b.pings == _pings + 1);
+	CHECK(_aio.reconnects() == 4);
+	_b.pingOk = true;
+	CHECK(runUntilConnected(&_aio, 5000));
+	CHECK(_b.connects == 5);
+}
+
+static void test_keepalive_cadence()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	AIO_Publish* _temp = _aio.makePublisher("/feeds/temp");
+
+	// Ping holds poll() until PINGRESP
+	_b.pingMs = 500;
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+	CHECK(_aio.keepAlive() == AIO_KEEPALIVE_MIN);
+
+	// Summary every PUBLISH_INTERVAL for 10 min - never pinged, so no poll() waits
+	uint32_t _longest = 0;
+	for(uint32_t t = 0; t < 600000; t += 10)
+	{
+		if(t % PUBLISH_INTERVAL == 0)
+			_aio.enqueue(_temp, t / 1000.0f);
+		fake::advance(10);
+		uint32_t _start = millis();
+		_aio.poll(0);
+		if(millis() - _start > _longest)
+			_longest = millis() - _start;
+	}
+	CHECK(_b.count("user/feeds/temp") == 600000 / PUBLISH_INTERVAL);
+	CHECK(_b.pings == 0);
+	CHECK(_longest == 0);
+
+	// Nothing to send - pinged after every 3/4 of keepalive
+	run(&_aio, 90000, 100);
+	CHECK(_b.pings == 90000 / (AIO_KEEPALIVE_MIN * 750));
+	CHECK(_aio.pings() == _b.pings);
+
+	// Summary every minute - the next connection gets keepalive of twice the gap (the idle peak decays).
+	// Pings of the old 30 s keepalive come between them, instant ones keep the gap at 60 s
+	_b.pingMs = 0;
+	for(int i = 0; i < 8; i++)
+	{
+		_aio.enqueue(_temp, (float)i);
+		run(&_aio, 60000, 100);
+	}
+	_b.drop();
+	CHECK(runUntilConnected(&_aio, 5000));
+	printf("  keepalive %u s at 60 s cadence\n", _aio.keepAlive());
+	CHECK(_b.keepAlive == 120);
+	CHECK(_aio.keepAlive() == 120);
+
+	// ...which the same cadence never lets run out
+	uint32_t _pings = _b.pings;
+	for(int i = 0; i < 10; i++)
+	{
+		_aio.enqueue(_temp, (float)i);
+		run(&_aio, 60000, 100);
+	}
+	CHECK(_b.pings == _pings);
+	CHECK(_b.connects == 2);
+}
+
+static void test_resubscribe()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+
+	// Registered before connecting, like the sketch does in setup()
+	AIO_Subscribe* _sub = _aio.makeSubscriber("/feeds/relay");
+	CHECK(_sub != nullptr);
+	_sub->setCallback(onRelay);
+	CHECK(_aio.getMQTTClient()->subscribe(_sub));
+	s_relayCalls = 0;
+
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+	CHECK(_b.subscribes["user/feeds/relay"] == 1);
+
+	_b.drop();
+	CHECK(runUntilConnected(&_aio, 2000));
+	CHECK(_b.subscribes["user/feeds/relay"] == 2);
+
+	fake::wifi().drop();
+	CHECK(runUntilConnected(&_aio, 2000));
+	CHECK(_b.subscribes["user/feeds/relay"] == 3);
+
+	// Messages reach the callback over the new connection
+	_b.deliver("user/feeds/relay", "ON");
+	_aio.poll(0);
+	CHECK(s_relayCalls == 1);
+	CHECK(s_relay && strcmp(s_relay, "ON") == 0);
+}
+
+static void test_group_publish_failure()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	AIO_Group* _grp = _aio.attachGroup("rails", 2);
+
+	CHECK(_grp->addFeed("ac") == 0);
+	CHECK(_grp->addFeed("dc") == 1);
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+
+	_grp->set(0, 230.5f, 1);
+	_grp->set(1, 12.04f, 2);
+	CHECK(!_grp->commit());
+	_grp->set(0, 231.0f, 1);
+	CHECK(_grp->commit());
+	CHECK(_aio.enqueue(_grp));
+
+	// Broker doesn't take the message - rows stay for the next token
+	_b.failPublishes = 1;
+	CHECK(_aio.poll(0) == 0);
+	CHECK(_grp->rows() == 2);
+	CHECK(_aio.pending() == 1);
+	CHECK(_b.count("user/groups/rails") == 0);
+
+	run(&_aio, 3000);
+	CHECK(_grp->rows() == 0);
+	CHECK(_aio.pending() == 0);
+	CHECK(_b.count("user/groups/rails") == 1);
+
+	const fake::Message* _msg = _b.last("user/groups/rails");
+	CHECK(_msg && _msg->payload == "[{\"feeds\":{\"ac\":\"230.5\",\"dc\":\"12.04\"}},{\"feeds\":{\"ac\":\"231.0\"}}]");
+}
+
+static void test_wide_group()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	AIO_Group* _grp = _aio.attachGroup("wide", 4);
+	static char _keys[18][16];				// Group keeps pointers to keys, like to the channel table
+
+	// 18 rails, four timestamped rows - can't go in one message
+	for(uint8_t f = 0; f < 18; f++)
+	{
+		snprintf(_keys[f], sizeof(_keys[f]), "sens-%u", f);
+		CHECK(_grp->addFeed(_keys[f]) == f);
+	}
+	for(uint32_t r = 0; r < 4; r++)
+	{
+		for(uint8_t f = 0; f < 18; f++)
+			_grp->set(f, 12.345f + f, 2);
+		CHECK(_grp->commit(1700000000 + r) == (r == 3));
+	}
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+	CHECK(_aio.enqueue(_grp));
+	run(&_aio, 10000, 100);
+	CHECK(_grp->rows() == 0);
+
+	// Rows are split between messages, none is cut
+	size_t _rows = 0, _msgs = 0;
+	for(const fake::Message& m : _b.published)
+	{
+		if(m.topic != "user/groups/wide")
+			continue;
+		_msgs++;
+		CHECK(m.payload.size() < AIO_GROUP_PAYLOAD);
+		CHECK(m.payload.back() == '}' || m.payload.back() == ']');
+		for(size_t p = 0; (p = m.payload.find("created_at", p)) != std::string::npos; p++)
+			_rows++;
+	}
+	CHECK(_msgs > 1);
+	CHECK(_rows == 4);
+}
+
+static void test_packed_group()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	AIO_Group* _grp = _aio.attachPacked("pm.packed", 200);
+	static const char* const _keys[] = { "ac", "12", "5", "33" };
+
+	CHECK(_grp != nullptr);
+	CHECK(strcmp(_grp->topic(), "user/feeds/pm.packed") == 0);
+	for(uint8_t f = 0; f < 4; f++)
+		CHECK(_grp->addFeed(_keys[f]) == f);
+
+	// Row 3 misses feed 2
+	for(uint32_t r = 0; r < 200; r++)
+	{
+		for(uint8_t f = 0; f < 4; f++)
+			if(r != 3 || f != 2)
+				_grp->set(f, 10.0f * f + (r % 5) * 0.01f, f ? 2 : 1);
+		_grp->commit(1700000000 + 2 * r);
+	}
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+	CHECK(_aio.enqueue(_grp));
+	run(&_aio, 20000, 100);
+	CHECK(_grp->rows() == 0);
+
+	// Every message is a complete batch, all rows come back in order
+	uint32_t _rows = 0, _msgs = 0;
+	for(const fake::Message& m : _b.published)
+	{
+		if(m.topic != "user/feeds/pm.packed")
+			continue;
+		_msgs++;
+		CHECK(m.payload.size() < AIO_GROUP_PAYLOAD);
+
+		uint8_t _raw[AIO_GROUP_PAYLOAD];
+		TsDecoder _dec(_raw, tspack_unbase64(m.payload.c_str(), _raw, sizeof(_raw)));
+		CHECK(_dec.begin());
+		CHECK(_dec.decimals(0) == 1 && _dec.decimals(1) == 2);
+
+		uint32_t _t, _m;
+		float _vals[4];
+		while(_dec.next(&_t, _vals, &_m))
+		{
+			CHECK(_t == 1700000000 + 2 * _rows);
+			CHECK(_m == ((_rows == 3) ? 0xbu : 0xfu));
+			CHECK_NEAR(_vals[1], 10 + (_rows % 5) * 0.01, 1e-4);
+			_rows++;
+		}
+	}
+	CHECK(_msgs > 1);
+	CHECK(_rows == 200);
+}
+
+static void test_events_in_order()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	AIO_Publish* _events = _aio.makePublisher("/feeds/events");
+	AIO_Publish* _temp = _aio.makePublisher("/feeds/temp");
+	char _text[16];
+
+	// Queued while offline - values of a feed are coalesced, event texts are not
+	CHECK(_aio.enqueue(_temp, 20.0f));
+	for(int i = 0; i < 3; i++)
+	{
+		snprintf(_text, sizeof(_text), "event %d", i);
+		CHECK(_aio.enqueue(_events, _text, false));
+	}
+	CHECK(_aio.enqueue(_temp, 21.5f, 1));
+	CHECK(_aio.pending() == 4);
+	CHECK(_aio.coalesced() == 1);
+
+	// Full queue refuses instead of overwriting the oldest event
+	for(int i = 3; i < AIO_QUEUE_SLOTS + 1; i++)
+	{
+		snprintf(_text, sizeof(_text), "event %d", i);
+		CHECK(_aio.enqueue(_events, _text, false) == (i < AIO_QUEUE_SLOTS - 1));
+	}
+	CHECK(_aio.pending() == AIO_QUEUE_SLOTS);
+
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+	run(&_aio, 60000, 100);
+	CHECK(_aio.pending() == 0);
+
+	std::vector<std::string> _got;
+	for(const fake::Message& m : _b.published)
+		if(m.topic == "user/feeds/events")
+			_got.push_back(m.payload);
+
+	CHECK(_got.size() == AIO_QUEUE_SLOTS - 1);
+	for(size_t i = 0; i < _got.size(); i++)
+	{
+		snprintf(_text, sizeof(_text), "event %d", (int)i);
+		CHECK(_got[i] == _text);
+	}
+	CHECK(_b.count("user/feeds/temp") == 1);
+	CHECK(_b.last("user/feeds/temp")->payload == "21.5");
+}
+
+static void test_backlog_queue_full()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	AIO_Publish* _events = _aio.makePublisher("/feeds/events");
+	AIO_Group* _grp = _aio.attachGroup("backlog", 10);
+	uint32_t _next = 0;
+
+	CHECK(_grp->addFeed("v") == 0);
+
+	// Faults of an outage took every slot (broker doesn't take them yet) - rows loaded at reconnect don't get one
+	for(int i = 0; i < AIO_QUEUE_SLOTS; i++)
+		CHECK(_aio.enqueue(_events, "fault", false));
+	_b.failPublishes = 1000000;
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+	CHECK(_aio.pending() == AIO_QUEUE_SLOTS);
+	CHECK(drain(&_aio, _grp, &_next, 35));
+	CHECK(_grp->rows() == 10);
+	CHECK(!_aio.queued(_grp));
+	_b.failPublishes = 0;
+
+	// ...they get it once events went out, and the rest of the log follows
+	for(uint32_t t = 0; t < 120000; t += 100)
+	{
+		fake::advance(100);
+		_aio.poll(0);
+		drain(&_aio, _grp, &_next, 35);
+	}
+	CHECK(_next == 35);
+	CHECK(_grp->rows() == 0);
+	CHECK(_aio.pending() == 0);
+	CHECK(_b.count("user/feeds/events") == AIO_QUEUE_SLOTS);
+
+	uint32_t _rows = 0;
+	for(const fake::Message& m : _b.published)
+	{
+		if(m.topic != "user/groups/backlog")
+			continue;
+		for(size_t p = 0; (p = m.payload.find("created_at", p)) != std::string::npos; p++)
+			_rows++;
+	}
+	CHECK(_rows == 35);
+}
+
+static void test_relay_latency()
+{
+	fake::reset();
+	fake::Broker& _b = fake::broker(AIO_SERVER);
+	ESP_AIO_Client _aio("ssid", "pass", "user", "key");
+	Relays _relays(&_aio);
+	AIO_Subscribe* _cmd = _aio.makeSubscriber("/feeds/relay-cmd");
+	AIO_Publish* _ack = _aio.makePublisher("/feeds/relay-state");
+
+	s_aio = &_aio;
+	s_relays = &_relays;
+	CHECK(_relays.add(25, _ack) == 0);
+	_cmd->setCallback(onRelayCmd);
+	CHECK(_aio.getMQTTClient()->subscribe(_cmd));
+	_aio.connect();
+	CHECK(runUntilConnected(&_aio, 1000));
+
+	// Two commands read in one poll, 3 ms each - the second one waited for the first
+	_b.readMs = 3;
+	_b.deliver("user/feeds/relay-cmd", "ON");
+	_aio.poll(0);
+	CHECK(_relays.state(0));
+	CHECK(_relays.lastLatency() == 3000);
+
+	_b.deliver("user/feeds/relay-cmd", "OFF");
+	_b.deliver("user/feeds/relay-cmd", "TOGGLE");
+	_aio.poll(0);
+	CHECK(_relays.commands() == 3);
+	CHECK(_relays.state(0));
+	CHECK(_relays.lastLatency() == 6000);
+	CHECK(_relays.maxLatency() == 6000);
+
+	// Invalid command isn't counted
+	_b.deliver("user/feeds/relay-cmd", "MAYBE");
+	_aio.poll(0);
+	CHECK(_relays.commands() == 3);
+
+	// New state is acknowledged
+	run(&_aio, 3000);
+	CHECK(_b.count("user/feeds/relay-state") >= 1);
+	CHECK(_b.last("user/feeds/relay-state")->payload == "ON");
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_connect);
+	RUN_TEST(test_backoff_jitter);
+	RUN_TEST(test_reconnect);
+	RUN_TEST(test_keepalive_cadence);
+	RUN_TEST(test_resubscribe);
+	RUN_TEST(test_group_publish_failure);
+	RUN_TEST(test_wide_group);
+	RUN_TEST(test_packed_group);
+	RUN_TEST(test_events_in_order);
+	RUN_TEST(test_backlog_queue_full);
+	RUN_TEST(test_relay_latency);
+	return TEST_RESULT();
+}
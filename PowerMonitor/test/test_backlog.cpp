@@ -0,0 +1,252 @@
+/*
+	Store-and-forward log on a host file standing in for LittleFS - records come back in order,
+	peeked records stay on "flash" until committed (a reset before commit sends them again),
+	full ring drops the oldest chunk, corrupted chunks and records of unknown time are skipped.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "backlog.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define T0		1700000000UL		// Valid UNIX time of the first record
+
+
+static char s_path[64];
+
+/*!
+	@brief	Fresh, empty ring file.
+*/
+static void newFile()
+{
+	strcpy(s_path, "/tmp/backlog_XXXXXX");
+	int _fd = mkstemp(s_path);
+	if(_fd >= 0)
+		close(_fd);
+}
+
+static void values(uint32_t n, float* dst)
+{
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		dst[c] = (float)(n % 1000) / 4 + c;
+}
+
+static void append(Backlog* log, uint32_t first, uint32_t count)
+{
+	float _vals[CH_COUNT];
+	for(uint32_t n = first; n < first + count; n++)
+	{
+		values(n, _vals);
+		log->append(T0 + n, _vals);
+	}
+}
+
+/*!
+	@brief		Peeks up to max records, checks they are the consecutive ones starting at first.
+	@returns	Number of records peeked.
+*/
+static uint32_t peekRun(Backlog* log, uint32_t first, uint32_t max, uint32_t clock_offset = 0)
+{
+	uint32_t _time;
+	float _vals[CH_COUNT], _exp[CH_COUNT];
+	uint32_t _n = 0;
+
+	while(_n < max && log->peek(&_time, _vals, clock_offset))
+	{
+		CHECK(_time == T0 + first + _n);
+		values(first + _n, _exp);
+		for(uint8_t c = 0; c < CH_COUNT; c++)
+			CHECK_NEAR(_vals[c], _exp[c], 0.006);
+		_n++;
+	}
+	return _n;
+}
+
+
+// ############################################################################
+static void test_round_trip()
+{
+	newFile();
+	Backlog _log;
+	uint32_t _time;
+	float _vals[CH_COUNT];
+
+	CHECK(_log.begin(s_path));
+	CHECK(!_log.peek(&_time, _vals, 0));
+	CHECK(_log.pending() == 0);
+
+	// Whole chunks on flash and a part still in RAM
+	append(&_log, 0, 2 * LOG_BATCH + 3);
+	CHECK(_log.pending() == 2 * LOG_BATCH + 3);
+	CHECK(peekRun(&_log, 0, 1000) == 2 * LOG_BATCH + 3);
+	CHECK(_log.pending() == 3 * LOG_BATCH);			// nothing committed yet, RAM part is a (full) chunk now
+
+	_log.commit();
+	CHECK(_log.pending() == 0);
+	CHECK(_log.lost() == 0);
+	CHECK(!_log.peek(&_time, _vals, 0));
+	unlink(s_path);
+}
+
+static void test_reset_before_commit()
+{
+	newFile();
+	{
+		Backlog _log;
+		CHECK(_log.begin(s_path));
+		append(&_log, 0, 3 * LOG_BATCH);
+		CHECK(peekRun(&_log, 0, 2 * LOG_BATCH) == 2 * LOG_BATCH);
+		// Reset while the message is on its way - nothing was confirmed
+	}
+	{
+		Backlog _log;
+		CHECK(_log.begin(s_path));
+		CHECK(_log.pending() == 3 * LOG_BATCH);
+		CHECK(peekRun(&_log, 0, LOG_BATCH + 4) == LOG_BATCH + 4);
+
+		// First chunk is sent, the second one only partly - its slot stays
+		_log.commit();
+		CHECK(_log.pending() == 2 * LOG_BATCH - 4);
+		CHECK(peekRun(&_log, LOG_BATCH + 4, 3) == 3);
+	}
+	{
+		// Partly sent chunk goes again whole (at least once), the freed one doesn't
+		Backlog _log;
+		CHECK(_log.begin(s_path));
+		CHECK(_log.pending() == 2 * LOG_BATCH);
+		CHECK(peekRun(&_log, LOG_BATCH, 1000) == 2 * LOG_BATCH);
+		_log.commit();
+		CHECK(_log.pending() == 0);
+		CHECK(_log.lost() == 0);
+	}
+	unlink(s_path);
+}
+
+static void test_commit_in_steps()
+{
+	newFile();
+	Backlog _log;
+	uint32_t _next = 0;
+
+	CHECK(_log.begin(s_path));
+	append(&_log, 0, 5 * LOG_BATCH);
+
+	// Drain the way the sketch does - a few rows, commit once they went out
+	for(int i = 0; i < 100; i++)
+	{
+		uint32_t _n = peekRun(&_log, _next, LOG_DRAIN_ROWS);
+		_next += _n;
+		_log.commit();
+		CHECK(_log.pending() == 5 * LOG_BATCH - _next);
+		if(_n == 0)
+			break;
+	}
+	CHECK(_next == 5 * LOG_BATCH);
+
+	// New records after drain
+	append(&_log, _next, LOG_BATCH);
+	CHECK(peekRun(&_log, _next, 1000) == LOG_BATCH);
+	unlink(s_path);
+}
+
+static void test_overwrite_when_full()
+{
+	newFile();
+	Backlog _log;
+
+	CHECK(_log.begin(s_path));
+	append(&_log, 0, (LOG_SLOTS + 2) * LOG_BATCH);
+	CHECK(_log.lost() == 2 * LOG_BATCH);
+	CHECK(_log.pending() == LOG_SLOTS * LOG_BATCH);
+	CHECK(peekRun(&_log, 2 * LOG_BATCH, 10) == 10);
+
+	// Chunk being peeked is overwritten - its records are already out of flash, so they aren't lost
+	append(&_log, (LOG_SLOTS + 2) * LOG_BATCH, LOG_BATCH);
+	CHECK(_log.lost() == 2 * LOG_BATCH);
+	CHECK(peekRun(&_log, 2 * LOG_BATCH + 10, LOG_BATCH - 10) == LOG_BATCH - 10);
+	_log.commit();
+	CHECK(_log.pending() == LOG_SLOTS * LOG_BATCH);
+	unlink(s_path);
+}
+
+static void test_corrupted_chunk()
+{
+	newFile();
+	{
+		Backlog _log;
+		CHECK(_log.begin(s_path));
+		append(&_log, 0, 3 * LOG_BATCH);
+	}
+
+	// Bit flip in a record of the second chunk (slot 2, chunk numbers start at 1)
+	FILE* _f = fopen(s_path, "r+b");
+	CHECK(_f != nullptr);
+	fseek(_f, 2 * sizeof(log_chunk_t) + offsetof(log_chunk_t, recs) + 4, SEEK_SET);
+	int _c = fgetc(_f);
+	fseek(_f, -1, SEEK_CUR);
+	fputc(_c ^ 0x10, _f);
+	fclose(_f);
+
+	Backlog _log;
+	CHECK(_log.begin(s_path));
+	CHECK(peekRun(&_log, 0, LOG_BATCH) == LOG_BATCH);
+	CHECK(peekRun(&_log, 2 * LOG_BATCH, 1000) == LOG_BATCH);
+	CHECK(_log.lost() == LOG_BATCH);
+	_log.commit();
+	CHECK(_log.pending() == 0);
+	unlink(s_path);
+}
+
+static void test_boot_relative_time()
+{
+	newFile();
+	float _vals[CH_COUNT] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	uint32_t _time;
+	float _out[CH_COUNT];
+	{
+		// Clock not set - seconds since boot, fixed once the boot time is known
+		Backlog _log;
+		CHECK(_log.begin(s_path));
+		_log.append(10, _vals);
+		_log.flush();
+		CHECK(!_log.peek(&_time, _out, 0));			// can't be fixed yet - dropped
+		CHECK(_log.lost() == 1);
+
+		_log.append(12, _vals);
+		_log.flush();
+		CHECK(_log.peek(&_time, _out, T0));
+		CHECK(_time == T0 + 12);
+		CHECK_NEAR(_out[3], 4.0, 0.006);
+
+		_log.append(20, _vals);
+		_log.flush();
+	}
+	{
+		// Another boot - time of the previous one is unknown
+		Backlog _log;
+		CHECK(_log.begin(s_path));
+		CHECK(!_log.peek(&_time, _out, T0));
+		CHECK(_log.lost() == 3);						// none of them was committed, so all come up again
+	}
+	unlink(s_path);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_round_trip);
+	RUN_TEST(test_reset_before_commit);
+	RUN_TEST(test_commit_in_steps);
+	RUN_TEST(test_overwrite_when_full);
+	RUN_TEST(test_corrupted_chunk);
+	RUN_TEST(test_boot_relative_time);
+	return TEST_RESULT();
+}
@@ -0,0 +1,232 @@
+/*
+	ADC calibration - lookup table sampled from a reference transfer curve (offset, soft knee at the top
+	like ESP32 at 11 dB) follows it within a millivolt and a half over the whole 12 bit range, source
+	decorator hands out converted scans, channel corrections are fitted from one or two points and
+	survive save / load.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "calib.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define BENCH_SCANS		100000
+
+
+/*!
+	@returns	Pin mV of raw value - ESP32 at 11 dB: offset near 0, slope ~0.8 mV, soft knee above ~2.6 V.
+*/
+static double ref(double raw)
+{
+	double _mv = 142 + raw * 0.805;
+	if(raw > 3000)
+		_mv += (raw - 3000) * (raw - 3000) * 0.00018;
+	return _mv;
+}
+
+/*!
+	@brief	Fills the table the way AdcCal::begin() does from eFuse characterization.
+*/
+static void fill(AdcCal* cal)
+{
+	for(uint8_t k = 0; k < CAL_LUT_SIZE - 1; k++)
+		cal->setKnot(k, (uint16_t)lround(ref(k * CAL_LUT_STEP)));
+
+	long _top = lround(ref(4095));
+	long _prev = lround(ref(4096 - CAL_LUT_STEP));
+	cal->setKnot(CAL_LUT_SIZE - 1, _top + (_top - _prev) / (CAL_LUT_STEP - 1));
+}
+
+/*!
+	@brief	Source of constant raw scans, every channel its own level.
+*/
+class RawSource : public AcqSource
+{
+public:
+	uint16_t raw[ACQ_CHANNELS];
+	bool paused = false;
+
+	bool begin(uint32_t rate) override
+	{
+		return true;
+	}
+
+	size_t read(acq_scan_t* dst, size_t max, uint32_t timeout_ms) override
+	{
+		for(size_t i = 0; i < max; i++)
+			memcpy(dst[i].ch, raw, sizeof(raw));
+		return max;
+	}
+
+	void pause(bool p) override
+	{
+		paused = p;
+	}
+};
+
+
+// ############################################################################
+static void test_ideal_line()
+{
+	AdcCal _cal;
+
+	CHECK(_cal.begin() == CAL_IDEAL);
+	CHECK(_cal.convert(0) == 0);
+	CHECK_NEAR(_cal.convert(2048), 1650, 1);
+	CHECK_NEAR(_cal.convert(4095), 3300 * 4095.0 / 4096, 1);
+}
+
+static void test_reference_curve()
+{
+	AdcCal _cal;
+	double _maxErr = 0;
+	uint16_t _at = 0;
+
+	fill(&_cal);
+	for(uint16_t r = 0; r < 4096; r++)
+	{
+		double _err = fabs(_cal.convert(r) - ref(r));
+		if(_err > _maxErr)
+		{
+			_maxErr = _err;
+			_at = r;
+		}
+	}
+	printf("  max error %.2f mV at raw %u\n", _maxErr, _at);
+	CHECK(_maxErr < 1.5);
+
+	// Monotonic - no step back at knots, nor above the last full knot
+	for(uint16_t r = 1; r < 4096; r++)
+		CHECK(_cal.convert(r) >= _cal.convert(r - 1));
+}
+
+static void test_apply()
+{
+	static acq_scan_t _scans[BENCH_SCANS];
+	static acq_scan_t _raw[BENCH_SCANS];
+	AdcCal _cal;
+
+	fill(&_cal);
+	for(uint32_t i = 0; i < BENCH_SCANS; i++)
+		for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+			_raw[i].ch[c] = (i * 7 + c * 131) & 4095;
+	memcpy(_scans, _raw, sizeof(_scans));
+
+	auto _t0 = std::chrono::steady_clock::now();
+	_cal.apply(_scans, BENCH_SCANS);
+	auto _t1 = std::chrono::steady_clock::now();
+	printf("  %.2f ns/sample\n", std::chrono::duration<double, std::nano>(_t1 - _t0).count() / (BENCH_SCANS * ACQ_CHANNELS));
+
+	uint32_t _wrong = 0;
+	for(uint32_t i = 0; i < BENCH_SCANS; i++)
+		for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+			if(_scans[i].ch[c] != _cal.convert(_raw[i].ch[c]))
+				_wrong++;
+	CHECK(_wrong == 0);
+}
+
+static void test_cal_source()
+{
+	RawSource _raw;
+	AdcCal _cal;
+	CalSource _src(&_raw, &_cal);
+	acq_scan_t _scans[4];
+
+	fill(&_cal);
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+		_raw.raw[c] = 1000 * c + 10;
+
+	CHECK(_src.begin(ACQ_SAMPLE_RATE));
+	CHECK(_src.read(_scans, 4, 0) == 4);
+	for(uint8_t c = 0; c < ACQ_CHANNELS; c++)
+		CHECK_NEAR(_scans[3].ch[c], ref(1000 * c + 10), 1.5);
+
+	_src.pause(true);
+	CHECK(_raw.paused);
+	_src.pause(false);
+	CHECK(!_raw.paused);
+}
+
+static void test_channel_points()
+{
+	ChannelCal _cc;
+
+	// Default gain of the table
+	CHECK_NEAR(_cc.gain(1), ch_table[1].scale, 1e-9);
+	CHECK_NEAR(_cc.volts(1, 12000), 12000 * ch_table[1].scale, 1e-3);
+
+	// One point - line through 0
+	CHECK(_cc.point(1, 3000, 12.0f));
+	CHECK_NEAR(_cc.volts(1, 3000), 12.0, 1e-4);
+	CHECK_NEAR(_cc.volts(1, 0), 0, 1e-6);
+
+	// Second point far enough - gain & offset, both points hit
+	CHECK(_cc.point(1, 1500, 6.1f));
+	CHECK_NEAR(_cc.volts(1, 3000), 12.0, 1e-4);
+	CHECK_NEAR(_cc.volts(1, 1500), 6.1, 1e-4);
+
+	// Point too close to the first one starts over as a single point
+	CHECK(_cc.point(2, 3000, 5.0f));
+	CHECK(_cc.point(2, 3100, 5.2f));
+	CHECK_NEAR(_cc.volts(2, 0), 0, 1e-6);
+	CHECK_NEAR(_cc.volts(2, 3100), 5.2, 1e-4);
+
+	// Unusable points
+	CHECK(!_cc.point(1, 0.1f, 1.0f));
+	CHECK(!_cc.point(CH_COUNT, 1000, 1.0f));
+
+	_cc.reset(2);
+	CHECK_NEAR(_cc.gain(2), ch_table[2].scale, 1e-9);
+}
+
+static void test_save_load()
+{
+	char _path[] = "/tmp/cal_XXXXXX";
+	int _fd = mkstemp(_path);
+	if(_fd >= 0)
+		close(_fd);
+
+	ChannelCal _cc;
+	CHECK(_cc.point(1, 3000, 12.0f));
+	CHECK(_cc.point(1, 1500, 6.1f));
+	CHECK(_cc.save(_path));
+
+	ChannelCal _loaded;
+	CHECK(_loaded.load(_path));
+	CHECK_NEAR(_loaded.volts(1, 1500), 6.1, 1e-4);
+	CHECK_NEAR(_loaded.volts(0, 100), _cc.volts(0, 100), 1e-6);
+
+	// File of another channel table is refused, corrections stay
+	FILE* _f = fopen(_path, "r+b");
+	CHECK(_f != nullptr);
+	fseek(_f, 4, SEEK_SET);
+	uint32_t _cnt = CH_COUNT + 1;
+	fwrite(&_cnt, sizeof(_cnt), 1, _f);
+	fclose(_f);
+	ChannelCal _other;
+	CHECK(!_other.load(_path));
+	CHECK_NEAR(_other.gain(1), ch_table[1].scale, 1e-9);
+
+	unlink(_path);
+	CHECK(!_other.load(_path));
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_ideal_line);
+	RUN_TEST(test_reference_curve);
+	RUN_TEST(test_apply);
+	RUN_TEST(test_cal_source);
+	RUN_TEST(test_channel_points);
+	RUN_TEST(test_save_load);
+	return TEST_RESULT();
+}
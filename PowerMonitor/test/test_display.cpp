@@ -0,0 +1,196 @@
+/*
+	Retained-mode display on a stand-in LCD which counts pixels sent over SPI - the first frame pushes
+	only the fields, unchanged ones cost nothing, a typical update is a fraction of a full-screen redraw,
+	text lands inside its field and hidden pages wait until they are shown.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "display.h"
+
+#include <string.h>
+
+
+#define LCD_W			135
+#define LCD_H			240
+#define FULL_FRAME		(LCD_W * LCD_H)		// Pixels of the canvas pushed by the old full redraw
+
+
+static Adafruit_ST7789 s_tft(nullptr, -1, -1, -1);
+
+static int8_t s_status, s_fault;
+static int8_t s_relays[4];
+static const char* s_relNames[] = { "AC", "12V", "5V", "3.3V" };
+static int8_t s_sens[CH_COUNT];
+static int8_t s_stage[HL_STAGES];
+
+/*!
+	@brief	Fields of both pages at the places the sketch puts them.
+*/
+static void layout(Display* ui)
+{
+	s_tft.init(LCD_W, LCD_H);
+	s_tft.fillScreen(ST77XX_BLACK);
+
+	for(uint8_t s = 0; s < HL_STAGES; s++)
+		s_stage[s] = ui->addField(30, 42 + s * 10, LCD_W - 30, 1, ST77XX_BLACK, UI_PAGE_HEALTH);
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		s_sens[c] = ui->addField(70, 140 + c * 25, LCD_W - 70, 2);
+	s_status = ui->addField(50, 7, LCD_W - 50, 1);
+	s_fault = ui->addField(0, 16, LCD_W, 1);
+	for(uint8_t r = 0; r < 4; r++)
+	{
+		int16_t _w = strlen(s_relNames[r]) * UI_CHAR_W * 2;
+		s_relays[r] = ui->addField((r % 2) ? LCD_W - 20 - _w : 20, 55 + (r / 2) * 30, _w, 2);
+	}
+}
+
+/*!
+	@returns	Pixels of all fields of the main page.
+*/
+static uint32_t mainArea()
+{
+	uint32_t _area = CH_COUNT * (LCD_W - 70) * 16;			// values
+	_area += (LCD_W - 50) * 8 + LCD_W * 8;				// status, fault
+	_area += (2 + 3 + 2 + 4) * UI_CHAR_W * 2 * 16;		// relays
+	return _area;
+}
+
+
+// ############################################################################
+static void test_first_frame()
+{
+	Display _ui(&s_tft);
+	layout(&_ui);
+
+	uint32_t _sent = s_tft.pixelsSent;
+	uint32_t _windows = s_tft.windows;
+
+	// Everything of the shown page goes once, nothing of the hidden one
+	CHECK(_ui.refresh() == CH_COUNT + 6);
+	CHECK(_ui.pixelsPushed() == mainArea());
+	CHECK(s_tft.pixelsSent - _sent == mainArea());
+	CHECK(s_tft.windows - _windows == CH_COUNT + 6);
+	CHECK(mainArea() < FULL_FRAME / 3);
+
+	// Nothing changed - nothing is sent
+	CHECK(_ui.refresh() == 0);
+	CHECK(_ui.pixelsPushed() == mainArea());
+}
+
+static void test_typical_update()
+{
+	Display _ui(&s_tft);
+	layout(&_ui);
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		_ui.setValue(s_sens[c], 12.0f, 2, "V", ST77XX_GREEN);
+	for(uint8_t r = 0; r < 4; r++)
+		_ui.setText(s_relays[r], s_relNames[r], ST77XX_RED);
+	_ui.setText(s_status, "Connected", ST77XX_GREEN);
+	_ui.refresh();
+
+	// Values differ only below shown precision, relays and status are the same
+	uint32_t _before = _ui.pixelsPushed();
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		_ui.setValue(s_sens[c], 12.001f, 2, "V", ST77XX_GREEN);
+	for(uint8_t r = 0; r < 4; r++)
+		_ui.setText(s_relays[r], s_relNames[r], ST77XX_RED);
+	CHECK(_ui.refresh() == 0);
+	CHECK(_ui.pixelsPushed() == _before);
+
+	// Every value changes - the usual update
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		_ui.setValue(s_sens[c], 11.5f + c, 2, "V", ST77XX_GREEN);
+	CHECK(_ui.refresh() == CH_COUNT);
+	CHECK((_ui.pixelsPushed() - _before) * 7 < FULL_FRAME);
+
+	// ...and every relay colour with them - the most a measurement update does
+	_before = _ui.pixelsPushed();
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		_ui.setValue(s_sens[c], 10.5f + c, 2, "V", ST77XX_GREEN);
+	for(uint8_t r = 0; r < 4; r++)
+		_ui.setText(s_relays[r], s_relNames[r], ST77XX_GREEN);
+	CHECK(_ui.refresh() == CH_COUNT + 4);
+	CHECK((_ui.pixelsPushed() - _before) * 5 < FULL_FRAME);
+
+	// Single value
+	_before = _ui.pixelsPushed();
+	_ui.setValue(s_sens[0], 3.3f, 2, "V", ST77XX_GREEN);
+	CHECK(_ui.refresh() == 1);
+	CHECK(_ui.pixelsPushed() - _before == (LCD_W - 70) * 16);
+}
+
+static void test_text_in_field()
+{
+	Display _ui(&s_tft);
+	layout(&_ui);
+
+	// Label next to the field must survive its redraw
+	s_tft.fillRect(0, 140, 70, 16, ST77XX_ORANGE);
+
+	_ui.setText(s_sens[0], "1234567890", ST77XX_WHITE);
+	_ui.refresh();
+
+	// Characters are 6 px cells of size 2 text (12 px), 5 of them fit into 65 px
+	CHECK(s_tft.pixel(70, 140) == ST77XX_WHITE);
+	CHECK(s_tft.pixel(70 + 9, 140 + 13) == ST77XX_WHITE);
+	CHECK(s_tft.pixel(70 + 10, 140) == ST77XX_BLACK);		// gap between characters
+	CHECK(s_tft.pixel(70 + 12 * 5, 140) == ST77XX_WHITE);	// cut sixth character
+	CHECK(s_tft.pixel(69, 140) == ST77XX_ORANGE);
+	CHECK(s_tft.pixel(LCD_W - 1, 139) == ST77XX_BLACK);
+
+	// Shorter text clears the rest of the field
+	_ui.setText(s_sens[0], "1", ST77XX_RED);
+	_ui.refresh();
+	CHECK(s_tft.pixel(70, 140) == ST77XX_RED);
+	CHECK(s_tft.pixel(70 + 12 * 3, 140) == ST77XX_BLACK);
+	CHECK(s_tft.pixel(69, 140) == ST77XX_ORANGE);
+}
+
+static void test_pages()
+{
+	Display _ui(&s_tft);
+	layout(&_ui);
+	_ui.refresh();
+
+	// Hidden page is updated but not pushed
+	uint32_t _before = _ui.pixelsPushed();
+	_ui.setText(s_stage[0], "0.1 0.2 0.3", ST77XX_WHITE);
+	CHECK(_ui.refresh() == 0);
+	CHECK(_ui.pixelsPushed() == _before);
+
+	// Switch - every field of the new page is drawn over its static elements
+	s_tft.fillScreen(ST77XX_BLACK);
+	_ui.setPage(UI_PAGE_HEALTH);
+	CHECK(_ui.page() == UI_PAGE_HEALTH);
+	CHECK(_ui.refresh() == HL_STAGES);
+	CHECK(_ui.pixelsPushed() - _before == HL_STAGES * (LCD_W - 30) * 8);
+	CHECK(s_tft.pixel(30, 42) == ST77XX_WHITE);
+
+	// Main page values changed meanwhile come back with it
+	_ui.setValue(s_sens[1], 5.05f, 2, "V", ST77XX_GREEN);
+	CHECK(_ui.refresh() == 0);
+	s_tft.fillScreen(ST77XX_BLACK);
+	_ui.setPage(UI_PAGE_MAIN);
+	CHECK(_ui.refresh() == CH_COUNT + 6);
+	CHECK(s_tft.pixel(70, 165) == ST77XX_GREEN);
+
+	// LCD reset - everything shown again
+	_ui.invalidate();
+	CHECK(_ui.refresh() == CH_COUNT + 6);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_first_frame);
+	RUN_TEST(test_typical_update);
+	RUN_TEST(test_text_in_field);
+	RUN_TEST(test_pages);
+	return TEST_RESULT();
+}
@@ -0,0 +1,191 @@
+/*
+	Channel registry and round-robin sampler of external ADC channels - table lines map to source slots,
+	every channel is averaged over the interval, bus errors and conversions which never finish are
+	counted and the round goes on instead of waiting for the failed board forever.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "channels.h"
+#include "extadc.h"
+
+#include <string.h>
+
+
+#define INPUTS			14			// 16+ rails - 4 ADC ones and a few ADS1115 boards
+
+
+/*!
+	@brief	Converter failing on demand - every input converts its number * 100 within convMs.
+*/
+class FlakyAdc : public ExtAdc
+{
+public:
+	uint32_t now = 0;				// Test clock [ms]
+	uint32_t convMs = 2;
+	int16_t busError = -1;			// Input whose board doesn't answer ready(), -1 - none
+	int16_t stuck = -1;				// Input whose conversion never finishes, -1 - none
+	uint32_t starts[EXT_MAX_CHANNELS] = {};
+
+	bool begin() override
+	{
+		return true;
+	}
+
+	bool start(uint8_t input) override
+	{
+		m_input = input;
+		m_started = now;
+		starts[input]++;
+		return true;
+	}
+
+	int8_t ready() override
+	{
+		if(m_input == busError)
+			return -1;
+		if(m_input == stuck)
+			return 0;
+		return (now - m_started >= convMs) ? 1 : 0;
+	}
+
+	bool read(int32_t* counts) override
+	{
+		*counts = m_input * 100;
+		return true;
+	}
+
+private:
+	int16_t m_input = -1;
+	uint32_t m_started = 0;
+};
+
+/*!
+	@brief	Polls sampler every ms for the given time.
+*/
+static void run(ExtSampler* sampler, FlakyAdc* adc, uint32_t ms)
+{
+	for(uint32_t t = 0; t < ms; t++)
+	{
+		adc->now++;
+		sampler->poll(adc->now);
+	}
+}
+
+
+// ############################################################################
+static void test_channel_table()
+{
+	CHECK(Channels::begin());
+	CHECK(Channels::count(CH_SRC_ADC) == ACQ_CHANNELS);
+	CHECK(Channels::count(CH_SRC_ADC) + Channels::count(CH_SRC_EXT) == CH_COUNT);
+
+	// Every channel has a slot and the slot leads back to it
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		int8_t _slot = Channels::slot(c);
+		CHECK(_slot >= 0);
+		CHECK(Channels::fromSlot(ch_table[c].source, _slot) == c);
+		if(ch_table[c].source == CH_SRC_ADC)
+			CHECK(Channels::adcPins()[_slot] == ch_table[c].input);
+	}
+	CHECK(Channels::slot(CH_COUNT) == -1);
+	CHECK(Channels::fromSlot(CH_SRC_ADC, ACQ_CHANNELS) == -1);
+}
+
+static void test_synth_means()
+{
+	SynthExtAdc _adc;
+	ExtSampler _sampler(&_adc);
+	float _means[EXT_MAX_CHANNELS];
+
+	for(uint8_t i = 0; i < INPUTS; i++)
+	{
+		CHECK(_sampler.add(i) == i);
+		_adc.setInput(i, 1000 * i, 10);
+	}
+	CHECK(_sampler.begin());
+
+	// Start + collect per conversion, 50 rounds
+	for(uint32_t i = 0; i < INPUTS * 50 * 2 + 1; i++)
+		_sampler.poll(i);
+	_sampler.snapshot(_means);
+	for(uint8_t i = 0; i < INPUTS; i++)
+		CHECK_NEAR(_means[i], 1000 * i, 5);
+	CHECK(_sampler.errors() == 0);
+
+	// Nothing converted in the next interval - the last means are kept
+	_sampler.snapshot(_means);
+	CHECK_NEAR(_means[INPUTS - 1], 1000 * (INPUTS - 1), 5);
+}
+
+static void test_bus_error()
+{
+	FlakyAdc _adc;
+	ExtSampler _sampler(&_adc);
+	float _means[EXT_MAX_CHANNELS];
+
+	for(uint8_t i = 0; i < 8; i++)
+		_sampler.add(i);
+	_sampler.begin();
+
+	// Board of input 5 doesn't answer - counted once per round, the others keep converting
+	_adc.busError = 5;
+	run(&_sampler, &_adc, 1000);
+	CHECK(_sampler.errors() > 0);
+	CHECK(_sampler.errors() <= _adc.starts[5]);
+	CHECK(_adc.starts[0] > 50);
+	CHECK(_adc.starts[7] > 50);
+	_sampler.snapshot(_means);
+	CHECK_NEAR(_means[4], 400, 0.01);
+	CHECK_NEAR(_means[6], 600, 0.01);
+	CHECK_NEAR(_means[5], 0, 0.01);				// never read
+
+	// Board answers again
+	_adc.busError = -1;
+	uint32_t _errors = _sampler.errors();
+	run(&_sampler, &_adc, 1000);
+	CHECK(_sampler.errors() == _errors);
+	_sampler.snapshot(_means);
+	CHECK_NEAR(_means[5], 500, 0.01);
+}
+
+static void test_conversion_timeout()
+{
+	FlakyAdc _adc;
+	ExtSampler _sampler(&_adc);
+	float _means[EXT_MAX_CHANNELS];
+
+	for(uint8_t i = 0; i < 4; i++)
+		_sampler.add(i);
+	_sampler.begin();
+
+	// Conversion of input 2 never finishes - given up after EXT_CONV_TIMEOUT, round goes on
+	_adc.stuck = 2;
+	run(&_sampler, &_adc, 1000);
+	uint32_t _round = 3 * _adc.convMs + EXT_CONV_TIMEOUT;
+	CHECK(_sampler.errors() >= 1000 / _round - 1);
+	CHECK(_sampler.errors() <= 1000 / _round + 1);
+	CHECK(_adc.starts[3] >= 1000 / _round - 1);
+	_sampler.snapshot(_means);
+	CHECK_NEAR(_means[3], 300, 0.01);
+
+	// Stuck board is converted again once it recovers
+	_adc.stuck = -1;
+	run(&_sampler, &_adc, 100);
+	_sampler.snapshot(_means);
+	CHECK_NEAR(_means[2], 200, 0.01);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_channel_table);
+	RUN_TEST(test_synth_means);
+	RUN_TEST(test_bus_error);
+	RUN_TEST(test_conversion_timeout);
+	return TEST_RESULT();
+}
@@ -0,0 +1,235 @@
+/*
+	Fixed-point filter chains - every stage and the default DC chain pass a constant through unchanged,
+	decimate by the product of their stages, delay a step by ~40 ms and take the noise of ADC down,
+	the bank runs only filtered ADC channels and doesn't mix external slots with scan slots.
+	Prints the noise, the step delay and the cost per sample. Built with filter_channels.h table.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "filter.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+
+#define NOISE_SD		23.4		// [mV] ADC noise of a DC rail
+#define COST_SAMPLES	5000000
+
+
+/*!
+	@brief		Feeds the same sample n times.
+	@returns	Number of outputs, the last one in *y.
+*/
+static uint32_t feed(ChannelFilter* f, int32_t x, uint32_t n, int32_t* y)
+{
+	uint32_t _outs = 0;
+
+	for(uint32_t i = 0; i < n; i++)
+	{
+		if(f->step(x, y))
+			_outs++;
+	}
+	return _outs;
+}
+
+/*!
+	@brief	Constants at both ends of the input range come out the same, so the gain is exactly 1.
+*/
+static void dcGain(ChannelFilter* f)
+{
+	const int32_t _levels[] = { 0, 1, 1234, (1 << FILT_INPUT_BITS) - 1 };
+	int32_t _y = -1;
+
+	for(int32_t x : _levels)
+	{
+		f->reset();
+		CHECK(feed(f, x, 64 * f->decimation(), &_y) == 64);
+		CHECK(_y == x * (1 << FILT_FRAC));
+	}
+}
+
+
+// ############################################################################
+static void test_dc_gain()
+{
+	Filter< OnePoleIir<2> > _iir;
+	Filter< MovingAverage<16> > _ma;
+	Filter< CicDecimator<16, 3> > _cic;
+	FILT_DC _dc;
+
+	dcGain(&_iir);
+	dcGain(&_ma);
+	dcGain(&_cic);
+	dcGain(&_dc);
+}
+
+static void test_decimation()
+{
+	Filter< OnePoleIir<4>, MovingAverage<4> > _full;
+	Filter< CicDecimator<4, 2>, CicDecimator<8, 1> > _two;
+	FILT_DC _dc;
+	int32_t _y;
+
+	CHECK(_full.decimation() == 1);
+	CHECK(_two.decimation() == 32);
+	CHECK(_dc.decimation() == 16);
+
+	CHECK(feed(&_full, 100, 1000, &_y) == 1000);
+	CHECK(feed(&_two, 100, 1000, &_y) == 1000 / 32);
+	CHECK(feed(&_dc, 100, 1600, &_y) == 100);
+
+	// Every decimation()-th sample gives the output
+	_dc.reset();
+	CHECK(feed(&_dc, 100, 15, &_y) == 0);
+	CHECK(feed(&_dc, 100, 1, &_y) == 1);
+}
+
+static void test_step_delay()
+{
+	FILT_DC _dc;
+	int32_t _y = 0;
+	uint32_t n = 0;
+
+	// Settled at 1 V, step to 2 V - samples until the output is half way
+	feed(&_dc, 1000, 1600, &_y);
+	while(n < ACQ_SAMPLE_RATE && _y < 1500 * (1 << FILT_FRAC))
+	{
+		_dc.step(2000, &_y);
+		n++;
+	}
+	double _ms = 1000.0 * n / ACQ_SAMPLE_RATE;
+	printf("  50%% step delay %.1f ms (%u samples)\n", _ms, n);
+	CHECK(_ms > 30 && _ms < 50);
+
+	// No overshoot, ends at the new level
+	int32_t _max = _y;
+	for(uint32_t i = 0; i < ACQ_SAMPLE_RATE; i++)
+	{
+		if(_dc.step(2000, &_y) && _y > _max)
+			_max = _y;
+	}
+	CHECK(_max == 2000 * (1 << FILT_FRAC));
+	CHECK(_y == 2000 * (1 << FILT_FRAC));
+}
+
+static void test_noise()
+{
+	FILT_DC _dc;
+	std::mt19937 _rng(1);
+	std::normal_distribution<double> _n(2000, NOISE_SD);
+	double _in = 0, _in2 = 0, _out = 0, _out2 = 0;
+	uint32_t _ins = 0, _outs = 0;
+	int32_t _y;
+
+	// A second of samples, the first 100 ms of outputs are the chain settling
+	for(uint32_t i = 0; i < ACQ_SAMPLE_RATE; i++)
+	{
+		int32_t x = (int32_t)lround(_n(_rng));
+		_in += x;
+		_in2 += (double)x * x;
+		_ins++;
+		if(_dc.step(x, &_y) && i >= ACQ_SAMPLE_RATE / 10)
+		{
+			double _mv = (double)_y / (1 << FILT_FRAC);
+			_out += _mv;
+			_out2 += _mv * _mv;
+			_outs++;
+		}
+	}
+	double _sdIn = sqrt(_in2 / _ins - (_in / _ins) * (_in / _ins));
+	double _sdOut = sqrt(_out2 / _outs - (_out / _outs) * (_out / _outs));
+	printf("  noise sd %.1f -> %.1f mV, mean %.1f mV\n", _sdIn, _sdOut, _out / _outs);
+	CHECK(_sdOut < _sdIn / 10);
+	CHECK_NEAR(_out / _outs, 2000, 2);
+}
+
+static void test_cost()
+{
+	FILT_DC _dc;
+	ChannelFilter* _f = &_dc;		// Called the way the bank does it
+	std::vector<int32_t> _x(COST_SAMPLES);
+	std::mt19937 _rng(2);
+	int32_t _y = 0, _sum = 0;
+
+	for(int32_t& x : _x)
+		x = 2000 + (int32_t)(_rng() % 64);
+
+	auto _t0 = std::chrono::steady_clock::now();
+	for(int32_t x : _x)
+	{
+		if(_f->step(x, &_y))
+			_sum += _y;
+	}
+	std::chrono::duration<double, std::nano> _t = std::chrono::steady_clock::now() - _t0;
+	printf("  %.1f ns/sample (host)\n", _t.count() / COST_SAMPLES);
+	CHECK(_sum != 0);
+}
+
+static void test_bank()
+{
+	FilterBank _bank;
+	acq_scan_t _scans[160];
+	float _mv;
+
+	CHECK(Channels::begin());
+	CHECK(Channels::count(CH_SRC_EXT) == 2);
+	CHECK(_bank.begin() == 3);		// DC rails of the scan, not AC (FILT_NONE) nor the external one
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+		CHECK(!_bank.latest(c, &_mv));
+
+	for(acq_scan_t& _s : _scans)
+	{
+		for(uint8_t s = 0; s < ACQ_CHANNELS; s++)
+			_s.ch[s] = 1000 + 100 * s;
+	}
+	// CIC integrators start from 0, so the first outputs are low until the chain settles
+	for(uint32_t b = 0; b < 6; b++)
+		_bank.onBlock(_scans, 160, b * 160);
+
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		bool _filtered = (ch_table[c].source == CH_SRC_ADC && c > 0);
+		CHECK(_bank.latest(c, &_mv) == _filtered);
+		CHECK(_bank.outputs(c) == (_filtered ? 60u : 0u));
+		if(_filtered)
+			CHECK(_mv == 1000 + 100 * Channels::slot(c));
+	}
+
+	// External slot 1 is scan slot of 12V - not read through it
+	CHECK(Channels::slot(5) == 1 && Channels::slot(1) == 1);
+	CHECK(!_bank.latest(5, &_mv));
+
+	// Unknown channels
+	CHECK(!_bank.latest(CH_COUNT, &_mv));
+	CHECK(!_bank.latest(255, &_mv));
+	CHECK(_bank.outputs(CH_COUNT) == 0);
+
+	// Gap - chains start over, the last output stays readable until the new level comes through
+	_bank.onResume(10000);
+	CHECK(_bank.latest(1, &_mv) && _mv == 1100);
+	for(acq_scan_t& _s : _scans)
+		_s.ch[1] = 3000;
+	for(uint32_t b = 0; b < 6; b++)
+		_bank.onBlock(_scans, 160, 10000 + b * 160);
+	CHECK(_bank.latest(1, &_mv));
+	CHECK(_mv == 3000);
+	CHECK(_bank.outputs(1) == 120);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_dc_gain);
+	RUN_TEST(test_decimation);
+	RUN_TEST(test_step_delay);
+	RUN_TEST(test_noise);
+	RUN_TEST(test_cost);
+	RUN_TEST(test_bank);
+	return TEST_RESULT();
+}
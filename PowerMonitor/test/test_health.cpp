@@ -0,0 +1,132 @@
+/*
+	Stage timing histograms - percentiles of uniform and constant durations are within a bucket width
+	of the true ones, report windows restart independently of each other, outliers and huge values
+	are kept as the maximum, acquisition records the processing time of every block.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "health.h"
+#include "acquire.h"
+
+#include <random>
+
+
+// ############################################################################
+static void test_linear()
+{
+	LatencyHist _h;
+	hl_stats_t _st;
+
+	// Every duration up to 600 ms once - the last bucket takes everything above ~0.5 s
+	for(uint32_t us = 0; us < 600000; us++)
+		_h.add(us);
+	_h.stats(HL_WINDOW_FEED, &_st);
+	printf("  0 - 600 ms: p50 %u, p99 %u us\n", _st.p50, _st.p99);
+	CHECK(_st.count == 600000);
+	CHECK(_st.max == 599999);
+	CHECK_NEAR(_st.p50, 300000, 300000 / HL_SUB);
+	CHECK(_st.p99 > 590000 && _st.p99 <= _st.max);
+}
+
+static void test_bucket_error()
+{
+	hl_stats_t _st;
+
+	// Single duration anywhere in the range - never above it, at most a bucket width below
+	for(uint32_t us = 1; us < 500000; us += 1 + us / 50)
+	{
+		LatencyHist _h;
+		_h.add(us);
+		_h.stats(HL_WINDOW_FEED, &_st);
+		CHECK(_st.p50 <= us && _st.p99 <= us);
+		CHECK(us - _st.p50 <= us / HL_SUB + HL_BASE_US);
+	}
+}
+
+static void test_windows()
+{
+	Health _health;
+	LatencyHist* _loop = _health.stage(HL_LOOP);
+	std::mt19937 _rng(1);
+	hl_stats_t _st;
+
+	// Uniform 0 - 10 ms with one outlier
+	for(int i = 0; i < 1000; i++)
+		_health.record(HL_LOOP, _rng() % 10000);
+	_health.record(HL_LOOP, 250000);
+	_loop->stats(HL_WINDOW_FEED, &_st);
+	printf("  uniform: p50 %u, p99 %u, max %u us\n", _st.p50, _st.p99, _st.max);
+	CHECK(_st.count == 1001);
+	CHECK(_st.max == 250000);
+	CHECK(_st.p50 > 4000 && _st.p50 < 6000);
+	CHECK(_st.p99 > 9000 && _st.p99 <= 11000);
+
+	// Feed window starts over, the UI one still has everything
+	_loop->stats(HL_WINDOW_FEED, &_st);
+	CHECK(_st.count == 0 && _st.max == 0 && _st.p99 == 0);
+	_health.record(HL_LOOP, 100);
+	_loop->stats(HL_WINDOW_FEED, &_st);
+	CHECK(_st.count == 1 && _st.max == 100);
+	CHECK(_st.p50 >= 64 && _st.p50 <= 100);
+	_loop->stats(HL_WINDOW_UI, &_st);
+	CHECK(_st.count == 1002 && _st.max == 250000);
+	CHECK(_loop->count() == 1002);
+}
+
+static void test_report()
+{
+	Health _health;
+	health_report_t _r;
+
+	// Constant duration - clamped to the maximum, never above it
+	for(int i = 0; i < 500; i++)
+		_health.record(HL_MQTT, 10200);
+
+	// Huge one goes to the last bucket
+	_health.record(HL_DISPLAY, 0);
+	_health.record(HL_DISPLAY, 4000000000UL);
+
+	_health.report(HL_WINDOW_FEED, &_r);
+	CHECK(_r.stage[HL_MQTT].count == 500);
+	CHECK(_r.stage[HL_MQTT].p99 == 10200);
+	CHECK(_r.stage[HL_MQTT].p50 >= 8192 && _r.stage[HL_MQTT].p50 <= 10200);
+	CHECK(_r.stage[HL_DISPLAY].max == 4000000000UL);
+	CHECK(_r.stage[HL_DISPLAY].p99 <= 4000000000UL);
+	CHECK(_r.stage[HL_PUBLISH].count == 0);
+	CHECK(_r.stage[HL_BACKLOG].count == 0);
+
+	for(uint8_t s = 0; s < HL_STAGES; s++)
+		CHECK(Health::stageName((hl_stage_t)s) != nullptr);
+}
+
+static void test_acquire_timing()
+{
+	Health _health;
+	SynthSource _src;
+	Acquisition _acq(&_src);
+	health_report_t _r;
+
+	_acq.timing(_health.stage(HL_ACQUIRE));
+	CHECK(_acq.begin());
+	for(int i = 0; i < 10; i++)
+		_acq.poll(0);
+
+	_health.report(HL_WINDOW_UI, &_r);
+	CHECK(_r.stage[HL_ACQUIRE].count == 10);
+	CHECK(_r.stage[HL_ACQUIRE].p50 <= _r.stage[HL_ACQUIRE].max);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_linear);
+	RUN_TEST(test_bucket_error);
+	RUN_TEST(test_windows);
+	RUN_TEST(test_report);
+	RUN_TEST(test_acquire_timing);
+	return TEST_RESULT();
+}
@@ -0,0 +1,300 @@
+/*
+	Local data plane against stand-ins of LAN clients and a mosquitto-like broker (fakes/) - formatters
+	give the same text through any buffer size, HTTP answers go out one chunk per poll (also through
+	a nearly full send buffer) and are dropped when the client leaves, the local broker is connected
+	in short steps and an absent one never holds the loop longer than LOCAL_MQTT_CONNECT_MS.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+#include "fake.h"
+
+#include "local.h"
+
+#include <string>
+#include <vector>
+
+
+/*!
+	@brief	700 rows, more than the history keeps.
+*/
+static void fill(LocalStore* store)
+{
+	float _v[CH_COUNT];
+	local_stats_t _st[CH_COUNT];
+
+	for(int i = 0; i < 700; i++)
+	{
+		for(uint8_t c = 0; c < CH_COUNT; c++)
+		{
+			_v[c] = i + c * 0.5f;
+			_st[c] = { _v[c] - 1, _v[c] + 1, 0.25f };
+		}
+		store->push(1000 + i, _v, _st);
+	}
+}
+
+/*!
+	@returns	Whole document formatted through a buffer of the given size.
+*/
+static std::string format(const LocalStore& store, size_t chunk, bool prom, uint16_t rows)
+{
+	std::string _out;
+	std::vector<char> _buf(chunk);
+	uint32_t _pos = 0;
+	size_t _n;
+
+	while((_n = prom ? store.prometheus(_buf.data(), chunk, &_pos) : store.json(_buf.data(), chunk, &_pos, rows)) > 0)
+	{
+		CHECK(strlen(_buf.data()) == _n);
+		_out.append(_buf.data(), _n);
+	}
+	return _out;
+}
+
+/*!
+	@brief		Polls server until it closes the connection.
+	@returns	Number of polls, 0 if it didn't close within the limit.
+*/
+static uint32_t serve(LocalHttp* http, std::shared_ptr<fake::Socket> sock, uint32_t limit = 1000)
+{
+	for(uint32_t n = 1; n <= limit; n++)
+	{
+		uint32_t _writes = sock->writes;
+		http->poll();
+		CHECK(sock->writes - _writes <= 1);		// never more than one chunk per poll
+		fake::advance(1);
+		if(!sock->open)
+			return n;
+	}
+	return 0;
+}
+
+/*!
+	@returns	Body of HTTP answer (after the head).
+*/
+static std::string body(const std::string& answer)
+{
+	size_t _p = answer.find("\r\n\r\n");
+	return (_p == std::string::npos) ? "" : answer.substr(_p + 4);
+}
+
+
+// ############################################################################
+static void test_formatters()
+{
+	LocalStore _store;
+
+	// Nothing measured yet - valid documents without values
+	std::string _empty = format(_store, 512, false, LOCAL_HISTORY);
+	CHECK(_empty.find("\"rows\":[]}") != std::string::npos);
+	CHECK(format(_store, 512, true, 0).find("{channel=") == std::string::npos);
+
+	fill(&_store);
+	CHECK(_store.rows() == LOCAL_HISTORY);
+	CHECK(_store.pushed() == 700);
+	CHECK(_store.row(0)->time == 1000 + 700 - LOCAL_HISTORY);
+
+	// Any buffer gives the same text
+	std::string _json = format(_store, 65536, false, LOCAL_HISTORY);
+	CHECK(format(_store, 64, false, LOCAL_HISTORY) == _json);
+	CHECK(_json.back() == '\n');
+	CHECK(_json.find("[1400,") != std::string::npos);			// the oldest row kept
+	CHECK(_json.find("[1399,") == std::string::npos);
+	CHECK(_json.find("[1699,") != std::string::npos);
+
+	std::string _prom = format(_store, 65536, true, 0);
+	CHECK(format(_store, 96, true, 0) == _prom);
+	CHECK(_prom.find("pwrmon_rows_total 700\n") != std::string::npos);
+
+	// The latest rows only
+	std::string _last = format(_store, 128, false, 3);
+	char _row[32];
+	snprintf(_row, sizeof(_row), "[%u,", 1000 + 699);
+	CHECK(_last.find(_row) != std::string::npos);
+	snprintf(_row, sizeof(_row), "[%u,", 1000 + 696);
+	CHECK(_last.find(_row) == std::string::npos);
+}
+
+static void test_parse()
+{
+	uint16_t _rows = 300;
+
+	CHECK(LocalHttp::parse("GET /metrics HTTP/1.1\r\n", &_rows) == LOCAL_ROUTE_METRICS);
+	CHECK(LocalHttp::parse("GET /json?rows=5 HTTP/1.1\r\n", &_rows) == LOCAL_ROUTE_JSON);
+	CHECK(_rows == 5);
+
+	// Query only from the request line
+	_rows = 300;
+	CHECK(LocalHttp::parse("GET /json HTTP/1.1\r\nX: rows=7\r\n", &_rows) == LOCAL_ROUTE_JSON);
+	CHECK(_rows == 300);
+	CHECK(LocalHttp::parse("GET /json?rows=99999 HTTP/1.0\r\n", &_rows) == LOCAL_ROUTE_JSON);
+	CHECK(_rows == LOCAL_HISTORY);
+
+	CHECK(LocalHttp::parse("GET /jsonx HTTP/1.0\r\n", &_rows) == LOCAL_ROUTE_NONE);
+	CHECK(LocalHttp::parse("POST /json", &_rows) == LOCAL_ROUTE_BAD);
+}
+
+static void test_http_chunks()
+{
+	fake::reset();
+	fake::wifi().joining = true;
+	LocalStore _store;
+	LocalHttp _http(&_store);
+	fill(&_store);
+
+	// Whole history - many chunks, each in its own poll
+	std::shared_ptr<fake::Socket> _sock = fake::dial(LOCAL_HTTP_PORT, "GET /json HTTP/1.1\r\nHost: pm\r\n\r\n");
+	uint32_t _polls = serve(&_http, _sock);
+	std::string _json = format(_store, 65536, false, LOCAL_HISTORY);
+	CHECK(_polls > _json.size() / LOCAL_HTTP_CHUNK);
+	CHECK(_sock->writes >= _json.size() / LOCAL_HTTP_CHUNK + 1);
+	CHECK(_sock->tx.compare(0, 15, "HTTP/1.0 200 OK") == 0);
+	CHECK(body(_sock->tx) == _json);
+	CHECK(_http.requests() == 1);
+	CHECK(!_http.busy());
+
+	// Send buffer nearly full - the rest of a chunk goes with the next polls, nothing is lost
+	_sock = fake::dial(LOCAL_HTTP_PORT, "GET /metrics HTTP/1.1\r\n\r\n");
+	_sock->window = 100;
+	CHECK(serve(&_http, _sock) > 0);
+	CHECK(body(_sock->tx) == format(_store, 65536, true, 0));
+	CHECK(_http.requests() == 2);
+
+	// Errors answered at once
+	_sock = fake::dial(LOCAL_HTTP_PORT, "GET /nothing HTTP/1.1\r\n\r\n");
+	CHECK(serve(&_http, _sock) <= 3);
+	CHECK(_sock->tx.compare(0, 22, "HTTP/1.0 404 Not Found") == 0);
+	_sock = fake::dial(LOCAL_HTTP_PORT, "DELETE /json HTTP/1.1\r\n\r\n");
+	CHECK(serve(&_http, _sock) <= 3);
+	CHECK(_sock->tx.compare(0, 24, "HTTP/1.0 400 Bad Request") == 0);
+}
+
+static void test_http_clients()
+{
+	fake::reset();
+	fake::wifi().joining = true;
+	LocalStore _store;
+	LocalHttp _http(&_store);
+	fill(&_store);
+
+	// Client leaves in the middle of the answer - dropped, the next one is served
+	std::shared_ptr<fake::Socket> _gone = fake::dial(LOCAL_HTTP_PORT, "GET /json HTTP/1.1\r\n\r\n");
+	std::shared_ptr<fake::Socket> _next = fake::dial(LOCAL_HTTP_PORT, "GET /json?rows=2 HTTP/1.1\r\n\r\n");
+	for(int i = 0; i < 3; i++)
+		_http.poll();
+	CHECK(_http.busy());
+	_gone->peerOpen = false;
+	CHECK(serve(&_http, _next) > 0);
+	CHECK(body(_next->tx) == format(_store, 65536, false, 2));
+	CHECK(_http.requests() == 1);
+
+	// Client which doesn't send its request is closed after the timeout
+	std::shared_ptr<fake::Socket> _mute = fake::dial(LOCAL_HTTP_PORT, "GET /js");
+	_http.poll();
+	CHECK(_mute->open);
+	fake::advance(LOCAL_HTTP_TIMEOUT + 1);
+	_http.poll();
+	CHECK(!_mute->open);
+	CHECK(_mute->tx.empty());
+
+}
+
+static void test_mqtt_absent_broker()
+{
+	fake::reset();
+	fake::wifi().joining = true;
+	fake::Broker& _b = fake::broker(LOCAL_MQTT_HOST);
+	LocalMqtt _mqtt(LOCAL_MQTT_HOST, LOCAL_MQTT_PORT, LOCAL_MQTT_PREFIX);
+	float _v[CH_COUNT] = { 230.0f, 12.0f, 5.0f, 3.3f };
+
+	// Host doesn't answer - the loop waits only the short TCP timeout, once per retry period
+	_b.reachable = false;
+	uint32_t _longest = 0;
+	for(uint32_t t = 0; t < 2 * LOCAL_MQTT_RETRY; t += 100)
+	{
+		uint32_t _start = millis();
+		_mqtt.poll();
+		if(millis() - _start > _longest)
+			_longest = millis() - _start;
+		fake::advance(100);
+	}
+	CHECK(_longest <= LOCAL_MQTT_CONNECT_MS);
+	CHECK(_b.attempts == 2);
+	CHECK(_mqtt.publish(_v) == 0);
+	CHECK(_b.published.empty());
+}
+
+static void test_mqtt_mirror()
+{
+	fake::reset();
+	fake::wifi().joining = true;
+	fake::Broker& _b = fake::broker(LOCAL_MQTT_HOST);
+	LocalMqtt _mqtt(LOCAL_MQTT_HOST, LOCAL_MQTT_PORT, LOCAL_MQTT_PREFIX);
+	float _v[CH_COUNT] = { 230.04f, 12.046f, 5.0f, 3.3f };
+	char _topic[64];
+
+	// LAN broker - TCP in one step, MQTT handshake in the next one
+	_b.connectMs = 2;
+	_mqtt.poll();
+	CHECK(_b.attempts == 1);
+	CHECK(_b.connects == 0);
+	_mqtt.poll();
+	CHECK(_b.connects == 1);
+	CHECK(_mqtt.connected());
+
+	CHECK(_mqtt.publish(_v) == CH_COUNT);
+	for(uint8_t c = 0; c < CH_COUNT; c++)
+	{
+		snprintf(_topic, sizeof(_topic), "%s/%s", LOCAL_MQTT_PREFIX, ch_table[c].feed);
+		CHECK(_b.count(_topic) == 1);
+	}
+	snprintf(_topic, sizeof(_topic), "%s/%s", LOCAL_MQTT_PREFIX, ch_table[1].feed);
+	CHECK(_b.last(_topic)->payload == "12.05");
+
+	// Broker restarted - new connection at once (the last attempt was long ago), in steps again
+	fake::advance(LOCAL_MQTT_RETRY);
+	_b.drop();
+	CHECK(!_mqtt.connected());
+	CHECK(_b.attempts == 2);
+	_mqtt.poll();
+	CHECK(_b.connects == 2);
+	CHECK(_mqtt.publish(_v) == CH_COUNT);
+
+	// Broker refuses the client - socket closed, retried after LOCAL_MQTT_RETRY
+	_b.drop();
+	_b.refuse = 5;
+	fake::advance(LOCAL_MQTT_RETRY);
+	_mqtt.poll();
+	_mqtt.poll();
+	CHECK(_b.attempts == 3);
+	for(int i = 0; i < 10; i++)
+		_mqtt.poll();
+	CHECK(_b.attempts == 3);
+	_b.refuse = 0;
+	fake::advance(LOCAL_MQTT_RETRY);
+	_mqtt.poll();
+	_mqtt.poll();
+	CHECK(_mqtt.connected());
+	CHECK(_b.connects == 3);
+
+	// Without WiFi nothing is tried
+	fake::wifi().drop();
+	fake::advance(LOCAL_MQTT_RETRY);
+	CHECK(!_mqtt.connected());
+	CHECK(_b.attempts == 4);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_formatters);
+	RUN_TEST(test_parse);
+	RUN_TEST(test_http_chunks);
+	RUN_TEST(test_http_clients);
+	RUN_TEST(test_mqtt_absent_broker);
+	RUN_TEST(test_mqtt_mirror);
+	return TEST_RESULT();
+}
@@ -0,0 +1,142 @@
+/*
+	Duty cycle of battery operation simulated over one day - a sampling window every LP_PERIOD, an uplink
+	every LP_FLUSH_INTERVAL which takes all the records gathered meanwhile, slow uplinks shift only the next
+	window. RTC log drops the oldest records when full and survives a software reset.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "power.h"
+
+#include <string.h>
+
+
+#define DAY_MS			86400000UL
+#define UPLINK_MS		4000		// Fast reconnect + flush of the batch
+#define STEP_MS			10			// Main loop pass while awake
+
+
+// ############################################################################
+static void test_one_day()
+{
+	static lp_rtc_buf_t _mem;
+	DutyCycle _dc;
+	RtcLog _log(&_mem);
+	const float _values[CH_COUNT] = { 230.1f, 12.03f, 5.01f, 3.3f };
+
+	// RTC memory after power-up holds garbage
+	memset(&_mem, 0xa5, sizeof(_mem));
+	CHECK(!_log.begin());
+	CHECK(_log.count() == 0);
+
+	uint32_t _now = 0, _upStart = 0, _lastWindow = 0, _maxGap = 0;
+	uint32_t _uplinks = 0, _records = 0, _sent = 0;
+	lp_state_t _prev = LP_AWAKE;
+	_dc.begin(_now);
+
+	// The sketch loop - the work is done on state changes, sleep jumps the clock
+	while(_now < DAY_MS)
+	{
+		bool _flushed = (_prev == LP_UPLINK && _now - _upStart >= UPLINK_MS);
+		lp_state_t _s = _dc.tick(_now, _log.full(), _flushed);
+
+		if(_s != _prev)
+		{
+			if(_prev == LP_AWAKE)
+			{
+				_log.push(_now / 1000, _values);
+				_records++;
+			}
+			if(_s == LP_UPLINK)
+			{
+				uint32_t _t;
+				float _v[CH_COUNT];
+
+				_upStart = _now;
+				_uplinks++;
+				while(_log.pop(&_t, _v))
+					_sent++;
+			}
+			if(_s == LP_AWAKE)
+			{
+				if(_lastWindow && _now - _lastWindow > _maxGap)
+					_maxGap = _now - _lastWindow;
+				_lastWindow = _now;
+			}
+			_prev = _s;
+		}
+		_now += (_s == LP_SLEEP) ? _dc.sleepTime(_now) : STEP_MS;
+	}
+
+	printf("  %u windows, %u records, %u uplinks, max gap %u ms\n", _dc.cycles(), _records, _uplinks, _maxGap);
+	printf("  awake %.1f%%, uplink %.2f%%, sleep %.1f%% - %.2f mA average (%.0f mA always connected)\n",
+		100.0 * _dc.residency(LP_AWAKE) / DAY_MS, 100.0 * _dc.residency(LP_UPLINK) / DAY_MS,
+		100.0 * _dc.residency(LP_SLEEP) / DAY_MS, _dc.averageCurrent(), (double)LP_CURRENT_UPLINK);
+
+	CHECK(_dc.cycles() == DAY_MS / LP_PERIOD);
+	CHECK(_uplinks == DAY_MS / LP_FLUSH_INTERVAL);
+	CHECK(_uplinks == 288);
+	CHECK(_sent + _log.count() == _records);
+	CHECK(_log.lost() == 0);
+	CHECK(_maxGap <= LP_PERIOD + STEP_MS);
+	CHECK(_dc.averageCurrent() < LP_CURRENT_UPLINK / 20);
+}
+
+static void test_slow_uplink()
+{
+	DutyCycle _dc(10000, 300, 60000, 30000);
+
+	_dc.begin(0);
+	CHECK(_dc.state() == LP_AWAKE);
+
+	// The first window ends with an uplink which never finishes - cut by the timeout
+	_dc.tick(300, false, false);
+	CHECK(_dc.state() == LP_UPLINK);
+	CHECK(_dc.tick(30300, false, false) == LP_SLEEP);
+
+	// Windows it covered are missed, the next one starts right away and keeps its length
+	CHECK(_dc.sleepTime(30300) == 0);
+	CHECK(_dc.tick(30300, false, false) == LP_AWAKE);
+	CHECK(_dc.tick(30500, false, false) == LP_AWAKE);
+	CHECK(_dc.tick(30600, false, false) == LP_SLEEP);
+	CHECK(_dc.sleepTime(30600) == 9700);
+}
+
+static void test_rtc_log()
+{
+	static lp_rtc_buf_t _mem;
+	RtcLog _log(&_mem);
+	float _vals[CH_COUNT];
+	uint32_t _t;
+
+	_log.begin();
+	for(uint32_t i = 0; i < LP_RTC_RECORDS + 5; i++)
+	{
+		for(uint8_t c = 0; c < CH_COUNT; c++)
+			_vals[c] = i + 0.01f * c;
+		_log.push(i, _vals);
+	}
+	CHECK(_log.full());
+	CHECK(_log.lost() == 5);
+
+	// Software reset - records are still there, the oldest five were overwritten
+	RtcLog _after(&_mem);
+	CHECK(_after.begin());
+	CHECK(_after.count() == LP_RTC_RECORDS);
+	CHECK(_after.pop(&_t, _vals));
+	CHECK(_t == 5);
+	CHECK_NEAR(_vals[1], 5.01, 1e-3);
+	printf("  RTC buffer %u bytes\n", (unsigned)sizeof(lp_rtc_buf_t));
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_one_day);
+	RUN_TEST(test_slow_uplink);
+	RUN_TEST(test_rtc_log);
+	return TEST_RESULT();
+}
@@ -0,0 +1,132 @@
+/*
+	Lock-free hand-over of the display data - readers running against a writer on other threads never
+	see a torn value or an older one than they already had, and the last published value arrives.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "snapshot.h"
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+
+#define WORDS			64			// Payload about the size of ui_data_t
+#define PUBLISHES		2000000
+#define READERS			3
+
+
+/*!
+	@brief	Every word holds the sequence number - any mix of two values is visible.
+*/
+typedef struct
+{
+	uint32_t word[WORDS];
+} payload_t;
+
+static Snapshot<payload_t> s_snap;
+static std::atomic<bool> s_done;
+
+
+typedef struct
+{
+	uint32_t reads;
+	uint32_t torn;
+	uint32_t backwards;
+	uint32_t last;
+} reader_t;
+
+static void reader(reader_t* r)
+{
+	payload_t _p;
+
+	while(!s_done.load())
+	{
+		if(!s_snap.read(&_p))
+			continue;
+
+		r->reads++;
+		for(uint16_t i = 1; i < WORDS; i++)
+		{
+			if(_p.word[i] != _p.word[0])
+			{
+				r->torn++;
+				break;
+			}
+		}
+		if(_p.word[0] < r->last)
+			r->backwards++;
+		r->last = _p.word[0];
+	}
+
+	// Value after the writer finished
+	s_snap.read(&_p);
+	r->last = _p.word[0];
+}
+
+
+// ############################################################################
+static void test_single_thread()
+{
+	Snapshot<payload_t> _snap;
+	payload_t _p;
+
+	CHECK(!_snap.read(&_p));
+	CHECK(_snap.version() == 0);
+
+	for(uint32_t n = 1; n <= 3; n++)
+	{
+		for(uint16_t i = 0; i < WORDS; i++)
+			_p.word[i] = n;
+		_snap.publish(_p);
+	}
+
+	memset(&_p, 0, sizeof(_p));
+	CHECK(_snap.read(&_p));
+	CHECK(_p.word[0] == 3);
+	CHECK(_p.word[WORDS - 1] == 3);
+	CHECK(_snap.version() == 3);
+}
+
+static void test_stress()
+{
+	reader_t _r[READERS];
+	std::thread _threads[READERS];
+	payload_t _p;
+
+	memset(_r, 0, sizeof(_r));
+	s_done = false;
+	for(uint8_t t = 0; t < READERS; t++)
+		_threads[t] = std::thread(reader, &_r[t]);
+
+	for(uint32_t n = 1; n <= PUBLISHES; n++)
+	{
+		for(uint16_t i = 0; i < WORDS; i++)
+			_p.word[i] = n;
+		s_snap.publish(_p);
+	}
+	s_done = true;
+
+	for(uint8_t t = 0; t < READERS; t++)
+	{
+		_threads[t].join();
+		CHECK(_r[t].reads > 0);
+		CHECK(_r[t].torn == 0);
+		CHECK(_r[t].backwards == 0);
+		CHECK(_r[t].last == PUBLISHES);
+		printf("  reader %u: %u reads\n", t, _r[t].reads);
+	}
+	CHECK(s_snap.version() == PUBLISHES);
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_single_thread);
+	RUN_TEST(test_stress);
+	return TEST_RESULT();
+}
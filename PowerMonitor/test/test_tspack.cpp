@@ -0,0 +1,214 @@
+/*
+	Packed encoding of measurement rows - noisy rails with a dip and timestamp jitter come back from
+	base64 messages within half of the last published digit, rows with missing feeds keep their mask,
+	a cut message gives only its complete rows, extreme values survive. Prints bytes per sample
+	against the JSON group text and the cost of encoding.
+
+	Copyright Patryk Sienkiewcz @ WUST, 2023
+*/
+
+#include "test.h"
+
+#include "tspack.h"
+
+#include <chrono>
+#include <random>
+#include <string.h>
+
+
+#define ROWS			5000
+#define FEEDS			4
+#define MSG_TEXT		512			// Base64 text of one message, like AIO_GROUP_PAYLOAD
+
+
+static const uint8_t s_decimals[FEEDS] = { 1, 2, 2, 2 };
+
+static float s_vals[ROWS][FEEDS];
+static uint32_t s_time[ROWS];
+
+/*!
+	@brief	Rails of the sketch with noise - AC, 12 V (dips for a while), 5 V, 3.3 V, row every 2 s with jitter.
+*/
+static void generate()
+{
+	std::mt19937 _rng(1);
+	std::normal_distribution<float> _n(0, 1);
+
+	for(int i = 0; i < ROWS; i++)
+	{
+		s_time[i] = 1700000000 + 2 * i + ((i % 97) == 0);
+		s_vals[i][0] = 230 + 0.4f * _n(_rng);
+		s_vals[i][1] = 12.05f + 0.01f * _n(_rng);
+		s_vals[i][2] = 5.02f + 0.005f * _n(_rng);
+		s_vals[i][3] = 3.31f + 0.003f * _n(_rng);
+		if(i > 2500 && i < 2510)
+			s_vals[i][1] = 9.8f;
+	}
+}
+
+/*!
+	@returns	Every 50th row has feeds 1 and 3 missing.
+*/
+static uint32_t mask(int row)
+{
+	return (row % 50 == 7) ? 0x5 : 0xffffffff;
+}
+
+/*!
+	@returns	Bytes of the row in JSON group message (AIO_Group::_printRow()).
+*/
+static int jsonRow(const float* v)
+{
+	char _row[256];
+	return snprintf(_row, sizeof(_row), "{\"feeds\":{\"sens-ac\":\"%.1f\",\"sens-12\":\"%.2f\",\"sens-5\":\"%.2f\",\"sens-33\":\"%.2f\"},\"created_at\":\"2023-05-01T12:00:00Z\"},",
+		v[0], v[1], v[2], v[3]);
+}
+
+
+// ############################################################################
+static void test_round_trip()
+{
+	uint8_t _raw[TSPACK_RAW_SIZE(MSG_TEXT)];
+	uint8_t _back[MSG_TEXT];
+	char _text[MSG_TEXT];
+	int _row = 0, _msgs = 0, _partial = 0;
+	size_t _bytes = 0, _json = 0;
+	double _maxErr[FEEDS] = {};
+	std::chrono::duration<double, std::nano> _encode(0);
+
+	generate();
+	while(_row < ROWS)
+	{
+		int _first = _row;
+
+		// Encoding - as many rows as fit into the message
+		auto _t0 = std::chrono::steady_clock::now();
+		TsEncoder _enc(_raw, sizeof(_raw));
+		CHECK(_enc.begin(FEEDS, s_decimals));
+		while(_row < ROWS && _enc.add(s_time[_row], s_vals[_row], mask(_row)))
+			_row++;
+		size_t _len = _enc.finish();
+		size_t _textLen = tspack_base64(_raw, _len, _text, sizeof(_text));
+		_encode += std::chrono::steady_clock::now() - _t0;
+
+		CHECK(_row > _first);
+		CHECK(_textLen > 0 && _textLen < MSG_TEXT);
+		_msgs++;
+		_bytes += _textLen;
+
+		// Decoding
+		size_t _backLen = tspack_unbase64(_text, _back, sizeof(_back));
+		CHECK(_backLen == _len && memcmp(_back, _raw, _len) == 0);
+
+		TsDecoder _dec(_back, _backLen);
+		CHECK(_dec.begin());
+		CHECK(_dec.rows() == _row - _first);
+		CHECK(_dec.feeds() == FEEDS);
+		CHECK(_dec.decimals(0) == 1 && _dec.decimals(3) == 2);
+
+		uint32_t _t, _m;
+		float _v[FEEDS];
+		int r = _first;
+		while(_dec.next(&_t, _v, &_m))
+		{
+			CHECK(_t == s_time[r]);
+			CHECK(_m == (mask(r) & 0xf));
+			for(uint8_t f = 0; f < FEEDS; f++)
+				if(_m & (1u << f))
+					_maxErr[f] = fmax(_maxErr[f], fabs(_v[f] - s_vals[r][f]));
+			if(_m != 0xf)
+				_partial++;
+			r++;
+		}
+		CHECK(r == _row);
+
+		// Message cut in half - only complete rows, fewer of them
+		TsDecoder _cut(_back, _backLen / 2);
+		int _cutRows = 0;
+		CHECK(_cut.begin());
+		while(_cut.next(&_t, _v, &_m))
+			_cutRows++;
+		CHECK(_cutRows < _dec.rows());
+	}
+
+	// Quantized to the published decimals - within half of the last digit
+	for(uint8_t f = 0; f < FEEDS; f++)
+		CHECK(_maxErr[f] <= 0.5 * pow(10, -s_decimals[f]) + 1e-4);
+	CHECK(_partial == ROWS / 50);
+
+	for(int r = 0; r < ROWS; r++)
+		_json += jsonRow(s_vals[r]);
+	printf("  %d msgs, %.1f rows/msg, %.2f B/sample packed, %.2f B/sample JSON (%.1fx)\n",
+		_msgs, (double)ROWS / _msgs, (double)_bytes / ROWS / FEEDS, (double)_json / ROWS / FEEDS, (double)_json / _bytes);
+	printf("  encode + base64 %.0f ns/row\n", _encode.count() / ROWS);
+	CHECK(_bytes * 5 < _json);
+}
+
+static void test_extremes()
+{
+	uint8_t _buf[600];
+	uint8_t _decimals[TSPACK_MAX_FEEDS];
+	float _v[TSPACK_MAX_FEEDS], _out[TSPACK_MAX_FEEDS];
+	uint32_t _t, _m;
+
+	// All 32 feeds, values beyond int32 after scaling (clamped), timestamp going back over the wrap
+	for(uint8_t f = 0; f < TSPACK_MAX_FEEDS; f++)
+	{
+		_decimals[f] = f % 7;
+		_v[f] = (f % 2 ? 1 : -1) * 3e9f;
+	}
+	TsEncoder _enc(_buf, sizeof(_buf));
+	CHECK(_enc.begin(TSPACK_MAX_FEEDS, _decimals));
+	CHECK(_enc.add(0xffffffff, _v, 0xfffffffe));
+	for(uint8_t f = 0; f < TSPACK_MAX_FEEDS; f++)
+		_v[f] = -_v[f];
+	CHECK(_enc.add(5, _v));
+
+	TsDecoder _dec(_buf, _enc.finish());
+	CHECK(_dec.begin());
+	CHECK(_dec.next(&_t, _out, &_m));
+	CHECK(_t == 0xffffffff && _m == 0xfffffffe);
+	CHECK(_dec.next(&_t, _out, &_m));
+	CHECK(_t == 5 && _m == 0xffffffff);
+	CHECK(_out[0] == 2e9f);
+	CHECK(_out[1] == -2e9f / 10);
+	CHECK(!_dec.next(&_t, _out, &_m));
+
+	// Tiny buffer - rows which don't fit aren't written
+	uint8_t _tiny[12];
+	uint8_t _dec1 = 2;
+	float _one = 1;
+	TsEncoder _small(_tiny, sizeof(_tiny));
+	CHECK(_small.begin(1, &_dec1));
+	uint32_t k = 0;
+	while(_small.add(k, &_one))
+		k++;
+	CHECK(k > 0 && _small.rows() == k);
+	CHECK((_small.bits() + 7) / 8 <= sizeof(_tiny));
+
+	// Unknown version
+	CHECK(!TsDecoder((const uint8_t*)"\x02\x01\x00\x00", 4).begin());
+}
+
+static void test_base64()
+{
+	char _s[16];
+	uint8_t _o[4];
+
+	CHECK(tspack_base64((const uint8_t*)"ab", 2, _s, sizeof(_s)) == 4);
+	CHECK(strcmp(_s, "YWI=") == 0);
+	CHECK(tspack_unbase64("YWI=", _o, sizeof(_o)) == 2);
+	CHECK(memcmp(_o, "ab", 2) == 0);
+	CHECK(tspack_unbase64("YW!", _o, sizeof(_o)) == 0);
+	CHECK(tspack_base64((const uint8_t*)"abcdef", 6, _s, 8) == 0);		// no room for terminator
+}
+
+
+// ############################################################################
+int main()
+{
+	RUN_TEST(test_round_trip);
+	RUN_TEST(test_extremes);
+	RUN_TEST(test_base64);
+	return TEST_RESULT();
+}